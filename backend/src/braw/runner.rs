@@ -1,9 +1,10 @@
 // Startet braw-bridge + FFmpeg Pipeline fuer BRAW-Proxy-Generierung.
-// braw-bridge liefert rawvideo rgb24 auf stdout und NDJSON-Events auf stderr.
+// braw-bridge liefert Rohframes (Format siehe --pix-fmt) auf stdout und
+// NDJSON-Events auf stderr.
 // FFmpeg liest die rohen Frames von stdin und encodiert sie als Proxy.
 
 use anyhow::{Context, Result};
-use std::os::unix::io::{FromRawFd, IntoRawFd};
+use std::ffi::OsString;
 use std::path::{Path, PathBuf};
 use std::sync::atomic::{AtomicU32, Ordering};
 use std::sync::{Arc, Mutex};
@@ -12,7 +13,15 @@ use tokio::process::Command;
 use tokio::sync::mpsc;
 use tokio_util::sync::CancellationToken;
 
-use crate::ffmpeg::runner::{is_prores, nvenc_available, vaapi_available, push_proxy_codec_args, FfmpegEvent};
+use crate::ffmpeg::runner::{
+    bridge_can_scale, bridge_frames, bridge_output_size, bridge_pix_fmt, is_prores, nvenc_available, vaapi_available,
+    push_bridge_input_args, push_proxy_codec_args, wants_bridge_nut, BridgeFrames, FfmpegEvent,
+};
+use crate::ffmpeg::bridge_daemon::{self, BridgeRun};
+use crate::ffmpeg::bridge_encode;
+use crate::ffmpeg::bridge_probe;
+use crate::ffmpeg::segments::{self, FrameRange, SegmentEncode};
+use crate::ffmpeg::shm::{self, ShmChannel};
 use crate::ipc::protocol::JobOptions;
 
 /// Metadaten einer BRAW-Datei, geliefert von braw-bridge.
@@ -53,27 +62,18 @@ fn find_braw_bridge() -> PathBuf {
     PathBuf::from("braw-bridge")
 }
 
-/// Ermittelt BRAW-Metadaten via `braw-bridge --input <file> --probe-only`.
-/// Startet den Prozess, liest die erste stderr-Zeile (metadata JSON) und beendet sich.
-pub async fn probe_braw_metadata(input_path: &Path) -> Result<BrawMetadata> {
+/// Ermittelt die BRAW-Metadaten vieler Clips mit einem `braw-bridge
+/// --probe-only`-Lauf (siehe ffmpeg::bridge_probe) und ruft
+/// `on_clip(index, Ergebnis)` fuer jeden Clip, sobald er fertig ist.
+pub async fn probe_braw_clips<F>(input_paths: &[PathBuf], mut on_clip: F)
+where
+    F: FnMut(usize, Result<BrawMetadata>),
+{
     let bridge = find_braw_bridge();
-    let output = Command::new(&bridge)
-        .arg("--input")
-        .arg(input_path.as_os_str())
-        .arg("--probe-only")
-        .stdout(std::process::Stdio::null())
-        .stderr(std::process::Stdio::piped())
-        .output()
-        .await
-        .with_context(|| format!("braw-bridge konnte nicht gestartet werden: {:?}", bridge))?;
-
-    let stderr = String::from_utf8_lossy(&output.stderr);
-    let first_line = stderr
-        .lines()
-        .next()
-        .context("braw-bridge hat keine Metadaten ausgegeben")?;
-
-    parse_metadata_json(first_line)
+    bridge_probe::probe_clips(&bridge, "braw-bridge", input_paths, |i, line| {
+        on_clip(i, line.and_then(parse_metadata_json))
+    })
+    .await;
 }
 
 /// Parst eine JSON-Zeile mit BRAW-Metadaten.
@@ -106,13 +106,26 @@ fn parse_metadata_json(json_str: &str) -> Result<BrawMetadata> {
 
 /// Extrahiert Audio aus einer BRAW-Datei als temporaere WAV-Datei.
 /// Gibt den Pfad zur WAV-Datei zurueck, oder None wenn kein Audio vorhanden.
-async fn extract_braw_audio(bridge: &Path, input_path: &Path, job_id: &str) -> Option<PathBuf> {
+async fn extract_braw_audio(
+    bridge: &Path,
+    input_path: &Path,
+    job_id: &str,
+    range: Option<FrameRange>,
+) -> Option<PathBuf> {
     let wav_path = std::env::temp_dir().join(format!("proxy-gen-audio-{}.wav", job_id));
+    let args = [
+        OsString::from("--input"),
+        input_path.as_os_str().to_owned(),
+        OsString::from("--extract-audio"),
+        wav_path.as_os_str().to_owned(),
+    ];
+    let args: Vec<OsString> = args.into_iter().chain(range.iter().flat_map(|r| r.bridge_args())).collect();
+    if let Ok((_, code)) = bridge_daemon::run(bridge, "extract-audio", &args).await {
+        return (code == 0 && wav_path.exists()).then_some(wav_path);
+    }
+
     let status = Command::new(bridge)
-        .arg("--input")
-        .arg(input_path.as_os_str())
-        .arg("--extract-audio")
-        .arg(&wav_path)
+        .args(&args)
         .stdout(std::process::Stdio::null())
         .stderr(std::process::Stdio::null())
         .status()
@@ -125,14 +138,29 @@ async fn extract_braw_audio(bridge: &Path, input_path: &Path, job_id: &str) -> O
     }
 }
 
+/// Frame-Groesse nach Debayer (ohne `--output-size`).
+/// probe_braw_metadata liefert die volle Sensor-Aufloesung.
+fn debayered_size(options: &JobOptions, meta: &BrawMetadata) -> (u32, u32) {
+    match options.debayer_quality.to_lowercase().as_str() {
+        "half"    => (meta.width / 2, meta.height / 2),
+        "quarter" => (meta.width / 4, meta.height / 4),
+        "eighth"  => (meta.width / 8, meta.height / 8),
+        _         => (meta.width, meta.height),
+    }
+}
+
 /// Baut FFmpeg-Argumente fuer BRAW-Proxy-Encoding.
-/// Input ist rawvideo rgb24 von stdin (pipe:0).
-/// Optional: audio_path fuer einen zweiten WAV-Input.
+/// Input sind die Bridge-Frames von stdin (pipe:0), siehe `BridgeFrames`.
+/// Optional: audio_path fuer einen zweiten WAV-Input (entfaellt beim NUT-Stream,
+/// der das Audio selbst mitbringt).
 fn build_braw_ffmpeg_args(
     output_path: &Path,
     options: &JobOptions,
     meta: &BrawMetadata,
+    frames: &BridgeFrames,
+    bridge_scales: bool,
     audio_path: Option<&Path>,
+    segment: Option<SegmentEncode>,
 ) -> Vec<String> {
     let mut args = Vec::new();
 
@@ -143,17 +171,8 @@ fn build_braw_ffmpeg_args(
     args.push("-loglevel".to_string());
     args.push("warning".to_string());
 
-    // Tatsaechliche Frame-Dimensionen nach Debayer berechnen.
-    // probe_braw_metadata liefert die volle Sensor-Aufloesung; braw-bridge
-    // gibt aber bei half/quarter entsprechend kleinere Frames aus.
-    let (frame_width, frame_height) = match options.debayer_quality.to_lowercase().as_str() {
-        "half"    => (meta.width / 2, meta.height / 2),
-        "quarter" => (meta.width / 4, meta.height / 4),
-        _         => (meta.width, meta.height),
-    };
-
     // HW-Accel Init-Flags VOR -i (nur fuer GPU-Encoder, nicht fuer ProRes)
-    // NVDEC ist nicht moeglich (Input ist bereits dekodiertes rgb24),
+    // NVDEC ist nicht moeglich (Input sind bereits dekodierte Rohframes),
     // aber NVENC/VAAPI koennen den Encode-Schritt auf der GPU ausfuehren.
     if !is_prores(&options.proxy_codec) {
         match options.hw_accel.as_str() {
@@ -171,17 +190,8 @@ fn build_braw_ffmpeg_args(
         }
     }
 
-    // Input 0: Raw-Video von stdin
-    args.push("-f".to_string());
-    args.push("rawvideo".to_string());
-    args.push("-pix_fmt".to_string());
-    args.push("rgb24".to_string());
-    args.push("-s".to_string());
-    args.push(format!("{}x{}", frame_width, frame_height));
-    args.push("-r".to_string());
-    args.push(format!("{}/{}", meta.fps_num, meta.fps_den));
-    args.push("-i".to_string());
-    args.push("pipe:0".to_string());
+    // Input 0: Bridge-Frames von stdin, im Format, das die Bridge meldet
+    push_bridge_input_args(&mut args, frames, meta.fps_num, meta.fps_den);
 
     // Input 1: Audio-WAV (optional)
     if let Some(wav) = audio_path {
@@ -189,18 +199,26 @@ fn build_braw_ffmpeg_args(
         args.push(wav.to_string_lossy().to_string());
     }
 
-    // Stream-Mapping (nur explizit wenn Audio vorhanden, sonst auto)
+    // Stream-Mapping (nur explizit wenn Audio vorhanden, sonst auto);
+    // im NUT-Stream ist Audio optional
     if audio_path.is_some() {
         args.push("-map".to_string());
         args.push("0:v:0".to_string());
         args.push("-map".to_string());
         args.push("1:a".to_string());
+    } else if frames.nut {
+        args.push("-map".to_string());
+        args.push("0:v:0".to_string());
+        args.push("-map".to_string());
+        args.push("0:a?".to_string());
     }
 
     // Video-Codec
+    // Skaliert die Bridge bereits (--output-size), entfaellt der FFmpeg-Scale
     let resolution = options
         .proxy_resolution
         .as_deref()
+        .filter(|_| !bridge_scales)
         .map(|r| r.replace('x', ":"));
     push_proxy_codec_args(
         &mut args,
@@ -210,8 +228,13 @@ fn build_braw_ffmpeg_args(
         false, // full_gpu=false: kein NVDEC moeglich, CPU-Decode → GPU-Encode
     );
 
+    // Segment-Encode: feste GOP-Laenge und Thread-Anteil, siehe ffmpeg::segments
+    if let Some(segment) = &segment {
+        segments::push_segment_args(&mut args, segment);
+    }
+
     // Audio-Codec (PCM, nur wenn Audio vorhanden)
-    if audio_path.is_some() {
+    if audio_path.is_some() || frames.nut {
         args.push("-c:a".to_string());
         args.push("pcm_s16le".to_string());
     }
@@ -228,59 +251,160 @@ fn build_braw_ffmpeg_args(
     args
 }
 
+/// CPU-Threads fuer eine Bridge-Instanz (braw-bridge `--threads`, r3d-bridge
+/// `--decompression-threads`), wenn bis zu `max_parallel` Jobs
+/// gleichzeitig laufen. Ohne Aufteilung startet jede Instanz einen SDK-Pool
+/// ueber alle Kerne und die Jobs verdraengen sich gegenseitig.
+pub fn bridge_thread_budget(max_parallel: usize) -> u32 {
+    let cores = std::thread::available_parallelism()
+        .map(|n| n.get())
+        .unwrap_or(1);
+    (cores / max_parallel.max(1)).max(1) as u32
+}
+
 /// Startet braw-bridge + FFmpeg Pipeline und sendet Events ueber den Channel.
 ///
-/// Ablauf:
-/// 1. Audio-Extraktion (braw-bridge --extract-audio) in temp-WAV
-/// 2. braw-bridge stdout (rawvideo rgb24) → FFmpeg stdin
+/// Ablauf (mit `bridge_encode` nur ein Bridge-Lauf, siehe ffmpeg::bridge_encode):
+/// 1. Audio-Extraktion (braw-bridge --extract-audio) in temp-WAV, entfaellt
+///    mit `--mux nut` (Frames und Audio in einem NUT-Stream, siehe
+///    `wants_bridge_nut`)
+/// 2. braw-bridge stdout (Rohframes, --pix-fmt, ggf. als NUT) → FFmpeg stdin
 /// 3. FFmpeg muxed Video + Audio (falls vorhanden) in Proxy
 /// 4. Temp-WAV wird nach Abschluss geloescht
+///
+/// Mit `range` nur diese Frames (ein Segment, siehe ffmpeg::segments): Audio,
+/// Timecode und Fortschritt beziehen sich dann auf den Bereich.
 pub async fn run_braw_job(
     job_id: String,
     input_path: PathBuf,
     output_path: PathBuf,
     options: &JobOptions,
-    meta: BrawMetadata,
+    mut meta: BrawMetadata,
+    range: Option<FrameRange>,
+    threads: u32,
     tx: mpsc::Sender<FfmpegEvent>,
     cancel: CancellationToken,
     pid_slot: Arc<AtomicU32>,
 ) -> Result<()> {
     let bridge = find_braw_bridge();
 
-    // Schritt 1: Audio extrahieren (blockierend, aber schnell)
-    let audio_wav = extract_braw_audio(&bridge, &input_path, &job_id).await;
-
-    let ffmpeg_args = build_braw_ffmpeg_args(&output_path, options, &meta, audio_wav.as_deref());
+    // Zielaufloesung an die Bridge durchreichen: sie waehlt die kleinste
+    // passende SDK-Decode-Stufe und skaliert den Rest selbst
+    let debayered = debayered_size(options, &meta);
+    // (nur 8 Bit: RGB oder yuv420p/nv12; 10/16 Bit und DPX skaliert FFmpeg).
+    // Das Pixel-Format ist das Eingangsformat des Encoders, siehe bridge_pix_fmt.
+    let wanted_size = options
+        .proxy_resolution
+        .as_deref()
+        .and_then(|r| bridge_output_size(r, debayered.0, debayered.1));
+    let pix_fmt = bridge_pix_fmt(options);
+    let output_size = wanted_size.filter(|_| bridge_can_scale(&pix_fmt));
 
-    // Schritt 2: braw-bridge starten
+    // Schritt 2: braw-bridge starten (bzw. beim Daemon anfragen)
     let debayer_arg = options.debayer_quality.to_lowercase();
-    let mut bridge_child = Command::new(&bridge)
-        .arg("--input")
-        .arg(input_path.as_os_str())
-        .arg("--debayer")
-        .arg(&debayer_arg)
-        .stdout(std::process::Stdio::piped())
-        .stderr(std::process::Stdio::piped())
-        .spawn()
-        .with_context(|| format!("braw-bridge konnte nicht gestartet werden: {:?}", bridge))?;
-
-    // PID von braw-bridge speichern (fuer Pause/Resume SIGSTOP/SIGCONT)
-    pid_slot.store(bridge_child.id().unwrap_or(0), Ordering::Release);
+    let mut bridge_args: Vec<OsString> = vec![
+        "--input".into(),
+        input_path.as_os_str().to_owned(),
+    ];
+    if let Some(range) = &range {
+        bridge_args.extend(range.bridge_args());
+    }
+    bridge_args.extend([
+        "--debayer".into(),
+        debayer_arg.into(),
+    ]);
+    if let Some(size) = &output_size {
+        bridge_args.extend(["--output-size".into(), size.into()]);
+    }
+    bridge_args.extend([
+        "--pix-fmt".into(),
+        pix_fmt.as_str().into(),
+        "--yuv-range".into(),
+        options.bridge_yuv_range.as_str().into(),
+        "--threads".into(),
+        threads.to_string().into(),
+    ]);
+
+    // Encodiert die Bridge selbst, entfallen FFmpeg und die Audio-Extraktion
+    if bridge_encode::wants_bridge_encode(
+        options,
+        &pix_fmt,
+        options.proxy_resolution.is_some() && output_size.is_none(),
+        &bridge_encode::bridge_encode_codecs(&bridge),
+    ) {
+        let mut bridge_cmd = Command::new(&bridge);
+        bridge_cmd.args(&bridge_args);
+        bridge_encode::push_encode_args(&mut bridge_cmd, &output_path, options);
+        return bridge_encode::run_bridge_encode(
+            "braw-bridge",
+            bridge_cmd,
+            job_id,
+            &output_path,
+            range.map_or(meta.frame_count, |r| r.count),
+            tx,
+            cancel,
+            pid_slot,
+        )
+        .await;
+    }
 
-    let bridge_stdout = bridge_child
-        .stdout
-        .take()
-        .context("Konnte stdout von braw-bridge nicht lesen")?;
+    // Schritt 1: Audio extrahieren (blockierend, aber schnell)
+    // (mit --mux nut liefert die Bridge das Audio im Stream mit)
+    let mux_nut = wants_bridge_nut(options, &pix_fmt);
+    if mux_nut {
+        bridge_args.extend(["--mux".into(), "nut".into()]);
+    }
+    let audio_wav = if mux_nut {
+        None
+    } else {
+        extract_braw_audio(&bridge, &input_path, &job_id, range).await
+    };
 
-    let bridge_stderr = bridge_child
-        .stderr
-        .take()
-        .context("Konnte stderr von braw-bridge nicht lesen")?;
+    // Frames ueber stdout-Pipe oder Shared-Memory-Ring (--shm-socket).
+    // Ueber die Pipe nimmt bevorzugt der Daemon den Decode an (siehe
+    // ffmpeg::bridge_daemon); der Report kommt dann ueber seine Verbindung.
+    let shm_channel = if shm::wants_shm(options) { Some(ShmChannel::new()?) } else { None };
+    let daemon_decode = match shm_channel {
+        Some(_) => None,
+        None => bridge_daemon::decode(&bridge, &bridge_args).await.ok(),
+    };
+    let (mut bridge_run, mut stderr_reader, bridge_stdout) = match daemon_decode {
+        Some((report, frames)) => (BridgeRun::Daemon(None), report, Some(frames)),
+        None => {
+            let mut bridge_cmd = Command::new(&bridge);
+            bridge_cmd.args(&bridge_args).stderr(std::process::Stdio::piped());
+            match &shm_channel {
+                Some(channel) => channel.attach(&mut bridge_cmd),
+                None => {
+                    bridge_cmd.stdout(std::process::Stdio::piped());
+                }
+            }
+            let mut bridge_child = bridge_cmd
+                .spawn()
+                .with_context(|| format!("braw-bridge konnte nicht gestartet werden: {:?}", bridge))?;
+
+            // PID von braw-bridge speichern (fuer Pause/Resume SIGSTOP/SIGCONT)
+            pid_slot.store(bridge_child.id().unwrap_or(0), Ordering::Release);
+
+            let bridge_stdout = match bridge_child.stdout.take() {
+                Some(stdout) => Some(
+                    stdout.into_owned_fd().context("Konnte braw-bridge stdout FD nicht uebernehmen")?,
+                ),
+                None => None,
+            };
+            let bridge_stderr = bridge_child
+                .stderr
+                .take()
+                .context("Konnte stderr von braw-bridge nicht lesen")?;
+            (BridgeRun::Process(bridge_child), bridge_daemon::report(bridge_stderr), bridge_stdout)
+        }
+    };
 
-    // Erste stderr-Zeile lesen: Metadaten (bereits in `meta` vorhanden, ueberspringen)
-    let mut stderr_reader = BufReader::new(bridge_stderr).lines();
+    // Erste Report-Zeile lesen: Metadaten. Gebraucht werden daraus nur
+    // Ausgabegroesse (bei --output-size rechnet die Bridge -2 aus) und
+    // Pixel-Format der Frames
     let first_line = stderr_reader.next_line().await?;
-    if first_line.is_none() {
+    let Some(first_line) = first_line else {
         cleanup_audio(&audio_wav);
         let _ = tx
             .send(FfmpegEvent::Error {
@@ -289,23 +413,57 @@ pub async fn run_braw_job(
             })
             .await;
         return Ok(());
+    };
+    let frames = bridge_frames(&first_line, debayered);
+    // Ein Frame-Bereich beginnt mit eigenem Timecode
+    if let Some(timecode) = serde_json::from_str::<serde_json::Value>(&first_line)
+        .ok()
+        .and_then(|v| v["start_timecode"].as_str().map(str::to_string))
+    {
+        meta.timecode = timecode;
     }
+    let ffmpeg_args = build_braw_ffmpeg_args(
+        &output_path,
+        options,
+        &meta,
+        &frames,
+        output_size.is_some(),
+        audio_wav.as_deref(),
+        range.map(|_| SegmentEncode {
+            gop: segments::segment_gop(options),
+            threads,
+        }),
+    );
 
-    // Schritt 3: FFmpeg starten mit braw-bridge stdout als stdin.
-    // tokio::ChildStdout → OwnedFd → std::process::Stdio
-    let bridge_stdout_raw: std::process::Stdio = {
-        let owned_fd = bridge_stdout.into_owned_fd()
-            .context("Konnte braw-bridge stdout FD nicht uebernehmen")?;
-        unsafe { std::process::Stdio::from_raw_fd(owned_fd.into_raw_fd()) }
+    // Schritt 3: FFmpeg starten mit braw-bridge stdout (bzw. der
+    // Daemon-Pipe) als stdin.
+    // Beim Shared-Memory-Transport fuettert der Reader-Thread FFmpeg stdin
+    let ffmpeg_stdin: std::process::Stdio = match bridge_stdout {
+        Some(bridge_stdout) => bridge_stdout.into(),
+        None => std::process::Stdio::piped(),
     };
     let mut ffmpeg_child = Command::new("ffmpeg")
         .args(&ffmpeg_args)
-        .stdin(bridge_stdout_raw)
+        .stdin(ffmpeg_stdin)
         .stdout(std::process::Stdio::null())
         .stderr(std::process::Stdio::piped())
         .spawn()
         .context("FFmpeg konnte nicht gestartet werden")?;
 
+    // Den Daemon selbst kann Pause nicht anhalten, ohne alle seine Jobs
+    // anzuhalten: gestoppt wird FFmpeg, die volle Pipe haelt dann den Decode an
+    if matches!(bridge_run, BridgeRun::Daemon(_)) {
+        pid_slot.store(ffmpeg_child.id().unwrap_or(0), Ordering::Release);
+    }
+
+    let mut shm_reader = match shm_channel {
+        Some(channel) => {
+            let stdin = ffmpeg_child.stdin.take().context("Konnte stdin von FFmpeg nicht uebernehmen")?;
+            Some(channel.spawn_reader(stdin.into_owned_fd()?))
+        }
+        None => None,
+    };
+
     // FFmpeg-stderr asynchron in Puffer sammeln (wird bei Fehler angezeigt)
     let ffmpeg_stderr_buf = Arc::new(Mutex::new(String::new()));
     {
@@ -326,18 +484,17 @@ pub async fn run_braw_job(
         });
     }
 
-    let total_frames = meta.frame_count;
+    let total_frames = range.map_or(meta.frame_count, |r| r.count);
 
-    // Event-Loop: braw-bridge stderr lesen fuer Progress, Cancel abfangen
+    // Event-Loop: braw-bridge-Report lesen fuer Progress, Cancel abfangen
     loop {
         tokio::select! {
             _ = cancel.cancelled() => {
-                // braw-bridge mit SIGTERM killen → pipe bricht ab → ffmpeg stoppt
-                let bridge_pid = pid_slot.load(Ordering::Acquire);
-                if bridge_pid != 0 {
-                    unsafe { libc::kill(bridge_pid as libc::pid_t, libc::SIGTERM); }
-                }
-                let _ = bridge_child.wait().await;
+                // braw-bridge mit SIGTERM killen bzw. die Daemon-Anfrage schliessen
+                // → pipe bricht ab → ffmpeg stoppt
+                drop(stderr_reader);
+                bridge_run.terminate();
+                let _ = bridge_run.wait().await;
                 let _ = ffmpeg_child.wait().await;
                 pid_slot.store(0, Ordering::Release);
                 cleanup_audio(&audio_wav);
@@ -351,6 +508,7 @@ pub async fn run_braw_job(
             line = stderr_reader.next_line() => {
                 match line {
                     Ok(Some(line)) => {
+                        bridge_run.observe(&line);
                         // Progress-Events parsen: {"type":"progress","frame":42,"total":1200}
                         if let Ok(v) = serde_json::from_str::<serde_json::Value>(&line) {
                             if v["type"].as_str() == Some("progress") {
@@ -373,9 +531,10 @@ pub async fn run_braw_job(
                         }
                     }
                     Ok(None) => {
-                        // stderr geschlossen – braw-bridge beendet
-                        let bridge_status = bridge_child.wait().await?;
+                        // Report zu Ende – braw-bridge bzw. die Anfrage beendet
+                        let bridge_status = bridge_run.wait().await?;
                         let ffmpeg_status = ffmpeg_child.wait().await?;
+                        let reader_result = shm::join_reader(shm_reader.take()).await;
                         pid_slot.store(0, Ordering::Release);
                         cleanup_audio(&audio_wav);
 
@@ -409,6 +568,13 @@ pub async fn run_braw_job(
                                     message: format!("braw-bridge {exit_info}"),
                                 })
                                 .await;
+                        } else if let Err(e) = reader_result {
+                            let _ = tx
+                                .send(FfmpegEvent::Error {
+                                    id: job_id.clone(),
+                                    message: format!("Shared-Memory-Transport: {e:#}"),
+                                })
+                                .await;
                         } else {
                             let _ = tx
                                 .send(FfmpegEvent::Done { id: job_id.clone() })
@@ -418,8 +584,8 @@ pub async fn run_braw_job(
                     }
                     Err(e) => {
                         // Lesefehler – beide Prozesse killen
-                        let _ = bridge_child.kill().await;
-                        let _ = bridge_child.wait().await;
+                        bridge_run.kill().await;
+                        let _ = bridge_run.wait().await;
                         let _ = ffmpeg_child.kill().await;
                         let _ = ffmpeg_child.wait().await;
                         pid_slot.store(0, Ordering::Release);
@@ -427,7 +593,7 @@ pub async fn run_braw_job(
                         let _ = tx
                             .send(FfmpegEvent::Error {
                                 id: job_id.clone(),
-                                message: format!("Fehler beim Lesen von braw-bridge stderr: {e}"),
+                                message: format!("Fehler beim Lesen des braw-bridge-Reports: {e}"),
                             })
                             .await;
                         return Ok(());
@@ -0,0 +1,334 @@
+// bridge_daemon – Client fuer den --serve-Modus der RAW-Bridges.
+//
+// Statt fuer jeden Probe-, Audio- und Decode-Lauf eine Bridge zu starten
+// (jedes Mal SDK-Initialisierung und ein neuer Decoder-Pool), startet das
+// Backend pro Bridge-Binary einmal `<bridge> --serve <socket>` und schickt
+// ihm jede Anfrage als NDJSON-Zeile (Protokoll siehe bridge-common/serve.h).
+// Die Frame-Pipe eines Decodes geht per SCM_RIGHTS mit. Zurueck kommen auf
+// derselben Verbindung die NDJSON-Zeilen, die sonst auf stderr stuenden,
+// zum Schluss {"type":"exit","code":N}. Verbindung schliessen = abbrechen.
+//
+// Ist kein Daemon erreichbar (alte Bridge ohne --serve, Start fehlgeschlagen),
+// liefern die Funktionen hier einen Fehler und die Runner starten die Bridge
+// wie bisher als eigenen Prozess.
+
+use anyhow::{bail, Context, Result};
+use std::collections::HashMap;
+use std::ffi::OsString;
+use std::io::Write;
+use std::os::unix::io::{AsRawFd, FromRawFd, OwnedFd, RawFd};
+use std::os::unix::net::UnixStream;
+use std::os::unix::process::ExitStatusExt;
+use std::path::{Path, PathBuf};
+use std::process::ExitStatus;
+use std::sync::{Arc, OnceLock};
+use std::time::{Duration, Instant};
+use tokio::io::{AsyncBufReadExt, AsyncRead, BufReader, Lines};
+use tokio::process::{Child, Command};
+use tokio::sync::Mutex;
+
+/// Gleichzeitige Anfragen pro Daemon (Probes, Audio, Decodes aller Jobs).
+const MAX_REQUESTS: u32 = 8;
+
+/// So lange darf ein frisch gestarteter Daemon brauchen, bis sein Socket lauscht.
+const START_TIMEOUT: Duration = Duration::from_secs(5);
+
+/// NDJSON-Report einer Bridge: stderr des Prozesses oder die Daemon-Verbindung.
+pub type Report = Lines<BufReader<Box<dyn AsyncRead + Send + Unpin>>>;
+
+pub fn report<R: AsyncRead + Send + Unpin + 'static>(reader: R) -> Report {
+    BufReader::new(Box::new(reader) as Box<dyn AsyncRead + Send + Unpin>).lines()
+}
+
+enum DaemonState {
+    Stopped,
+    Running(Child),
+    /// Start fehlgeschlagen; bis zum Backend-Neustart wird gespawnt.
+    Failed,
+}
+
+struct Daemon {
+    socket: PathBuf,
+    state: DaemonState,
+}
+
+/// Ein Daemon pro Bridge-Binary.
+fn daemon_for(bridge: &Path) -> Arc<Mutex<Daemon>> {
+    static DAEMONS: OnceLock<std::sync::Mutex<HashMap<PathBuf, Arc<Mutex<Daemon>>>>> = OnceLock::new();
+    let mut daemons = DAEMONS.get_or_init(Default::default).lock().unwrap();
+    daemons
+        .entry(bridge.to_path_buf())
+        .or_insert_with(|| {
+            let name = bridge.file_name().map(|n| n.to_string_lossy().into_owned());
+            let socket = std::env::temp_dir().join(format!(
+                "proxy-gen-{}-{}.sock",
+                name.as_deref().unwrap_or("bridge"),
+                std::process::id()
+            ));
+            Arc::new(Mutex::new(Daemon { socket, state: DaemonState::Stopped }))
+        })
+        .clone()
+}
+
+/// Verbindung zum Daemon von `bridge`; startet ihn beim ersten Mal (und
+/// neu, falls er sich beendet hat).
+async fn connect(bridge: &Path) -> Result<UnixStream> {
+    let daemon = daemon_for(bridge);
+    let mut guard = daemon.lock().await;
+    let daemon = &mut *guard;
+
+    match &mut daemon.state {
+        DaemonState::Failed => bail!("{:?} --serve nicht verfuegbar", bridge),
+        DaemonState::Running(child) => {
+            if child.try_wait()?.is_none() {
+                if let Ok(stream) = UnixStream::connect(&daemon.socket) {
+                    return Ok(stream);
+                }
+            }
+            daemon.state = DaemonState::Stopped;
+        }
+        DaemonState::Stopped => {}
+    }
+
+    let _ = std::fs::remove_file(&daemon.socket);
+    let mut cmd = Command::new(bridge);
+    cmd.arg("--serve")
+        .arg(&daemon.socket)
+        .arg("--max-requests")
+        .arg(MAX_REQUESTS.to_string())
+        .stdin(std::process::Stdio::null())
+        .stdout(std::process::Stdio::null())
+        .stderr(std::process::Stdio::null());
+    // Endet das Backend, endet der Daemon mit (SIGTERM: er raeumt den
+    // Socket selbst weg). Gilt fuer den startenden Thread, und die
+    // Runtime-Worker leben so lange wie das Backend.
+    unsafe {
+        cmd.pre_exec(|| {
+            libc::prctl(libc::PR_SET_PDEATHSIG, libc::SIGTERM);
+            Ok(())
+        });
+    }
+    let mut child = match cmd.spawn() {
+        Ok(child) => child,
+        Err(e) => {
+            daemon.state = DaemonState::Failed;
+            return Err(e).with_context(|| format!("{:?} --serve konnte nicht gestartet werden", bridge));
+        }
+    };
+
+    let deadline = Instant::now() + START_TIMEOUT;
+    loop {
+        if let Ok(stream) = UnixStream::connect(&daemon.socket) {
+            daemon.state = DaemonState::Running(child);
+            return Ok(stream);
+        }
+        if child.try_wait()?.is_some() || Instant::now() >= deadline {
+            let _ = child.start_kill();
+            daemon.state = DaemonState::Failed;
+            bail!("{:?} --serve hat seinen Socket nicht geoeffnet", bridge);
+        }
+        tokio::time::sleep(Duration::from_millis(20)).await;
+    }
+}
+
+/// Anfrage-Zeile: `args` sind die Kommandozeilen-Optionen der Bridge.
+fn request_line(op: &str, args: &[OsString]) -> Result<String> {
+    let args = args
+        .iter()
+        .map(|a| a.to_str().context("Argument ist kein UTF-8"))
+        .collect::<Result<Vec<_>>>()?;
+    Ok(format!("{}\n", serde_json::json!({ "op": op, "args": args })))
+}
+
+/// Exit-Code aus der letzten Zeile einer Antwort, sonst None.
+pub fn exit_code(line: &str) -> Option<i32> {
+    let v: serde_json::Value = serde_json::from_str(line).ok()?;
+    if v["type"].as_str() != Some("exit") {
+        return None;
+    }
+    v["code"].as_i64().map(|c| c as i32)
+}
+
+/// Schickt die Anfrage-Zeile, `fd` haengt per SCM_RIGHTS am ersten Byte.
+fn send_request(stream: &mut UnixStream, line: &str, fd: Option<RawFd>) -> Result<()> {
+    let bytes = line.as_bytes();
+    let mut iov = libc::iovec {
+        iov_base: bytes.as_ptr() as *mut libc::c_void,
+        iov_len: bytes.len(),
+    };
+    let space = unsafe { libc::CMSG_SPACE(std::mem::size_of::<RawFd>() as u32) } as usize;
+    let mut control = vec![0u64; space.div_ceil(8)];
+    let mut msg: libc::msghdr = unsafe { std::mem::zeroed() };
+    msg.msg_iov = &mut iov;
+    msg.msg_iovlen = 1;
+    if let Some(fd) = fd {
+        msg.msg_control = control.as_mut_ptr() as *mut libc::c_void;
+        msg.msg_controllen = space as _;
+        unsafe {
+            let cmsg = libc::CMSG_FIRSTHDR(&msg);
+            (*cmsg).cmsg_level = libc::SOL_SOCKET;
+            (*cmsg).cmsg_type = libc::SCM_RIGHTS;
+            (*cmsg).cmsg_len = libc::CMSG_LEN(std::mem::size_of::<RawFd>() as u32) as _;
+            std::ptr::copy_nonoverlapping(&fd, libc::CMSG_DATA(cmsg) as *mut RawFd, 1);
+        }
+    }
+
+    let sent = loop {
+        let n = unsafe { libc::sendmsg(stream.as_raw_fd(), &msg, libc::MSG_NOSIGNAL) };
+        if n < 0 && std::io::Error::last_os_error().kind() == std::io::ErrorKind::Interrupted {
+            continue;
+        }
+        break n;
+    };
+    if sent < 0 {
+        return Err(std::io::Error::last_os_error()).context("sendmsg an den Bridge-Daemon");
+    }
+    stream
+        .write_all(&bytes[sent as usize..])
+        .context("Anfrage an den Bridge-Daemon")?;
+    Ok(())
+}
+
+/// Stellt eine Anfrage und liefert ihren Report. `fd` wird nach dem Senden
+/// hier geschlossen, der Daemon haelt seine eigene Kopie.
+pub async fn request(
+    bridge: &Path,
+    op: &str,
+    args: &[OsString],
+    fd: Option<OwnedFd>,
+) -> Result<Report> {
+    let line = request_line(op, args)?;
+    let mut stream = connect(bridge).await?;
+    send_request(&mut stream, &line, fd.as_ref().map(|fd| fd.as_raw_fd()))?;
+    drop(fd);
+    stream.set_nonblocking(true)?;
+    Ok(report(tokio::net::UnixStream::from_std(stream)?))
+}
+
+/// Stellt eine Anfrage ohne Frames und sammelt den Report bis zur exit-Zeile.
+/// Liefert die Report-Zeilen und den Exit-Code.
+pub async fn run(bridge: &Path, op: &str, args: &[OsString]) -> Result<(Vec<String>, i32)> {
+    let mut report = request(bridge, op, args, None).await?;
+    let mut lines = Vec::new();
+    while let Some(line) = report.next_line().await? {
+        if let Some(code) = exit_code(&line) {
+            return Ok((lines, code));
+        }
+        lines.push(line);
+    }
+    bail!("Bridge-Daemon hat die Verbindung ohne Exit-Zeile beendet")
+}
+
+/// Decode-Anfrage: die Frames kommen am gelieferten Lese-Ende einer Pipe an.
+pub async fn decode(bridge: &Path, args: &[OsString]) -> Result<(Report, OwnedFd)> {
+    let mut pipe = [0 as RawFd; 2];
+    if unsafe { libc::pipe2(pipe.as_mut_ptr(), libc::O_CLOEXEC) } != 0 {
+        return Err(std::io::Error::last_os_error()).context("pipe fuer Bridge-Frames");
+    }
+    let (read_end, write_end) = unsafe { (OwnedFd::from_raw_fd(pipe[0]), OwnedFd::from_raw_fd(pipe[1])) };
+    let report = request(bridge, "decode", args, Some(write_end)).await?;
+    Ok((report, read_end))
+}
+
+/// Ein laufender Bridge-Decode: eigener Prozess oder Anfrage an den Daemon.
+pub enum BridgeRun {
+    Process(Child),
+    /// Exit-Code aus der exit-Zeile, sobald gelesen
+    Daemon(Option<i32>),
+}
+
+impl BridgeRun {
+    /// Merkt sich die exit-Zeile einer Daemon-Anfrage.
+    pub fn observe(&mut self, line: &str) {
+        if let BridgeRun::Daemon(exit) = self {
+            if let Some(code) = exit_code(line) {
+                *exit = Some(code);
+            }
+        }
+    }
+
+    /// Prozess: SIGTERM. Eine Daemon-Anfrage endet, wenn ihr Report
+    /// (die Verbindung) geschlossen wird.
+    pub fn terminate(&self) {
+        if let BridgeRun::Process(child) = self {
+            if let Some(pid) = child.id() {
+                unsafe { libc::kill(pid as libc::pid_t, libc::SIGTERM); }
+            }
+        }
+    }
+
+    pub async fn kill(&mut self) {
+        if let BridgeRun::Process(child) = self {
+            let _ = child.kill().await;
+        }
+    }
+
+    /// Exit-Status, nachdem der Report zu Ende gelesen ist.
+    pub async fn wait(&mut self) -> Result<ExitStatus> {
+        match self {
+            BridgeRun::Process(child) => Ok(child.wait().await?),
+            BridgeRun::Daemon(Some(code)) => Ok(ExitStatus::from_raw((*code & 0xff) << 8)),
+            BridgeRun::Daemon(None) => bail!("Bridge-Daemon hat die Verbindung ohne Exit-Zeile beendet"),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn request_line_and_exit_code() {
+        let args = [OsString::from("--input"), OsString::from("/card/A001 \"x\".braw")];
+        let line = request_line("probe", &args).unwrap();
+        assert!(line.ends_with('\n'));
+        let v: serde_json::Value = serde_json::from_str(line.trim_end()).unwrap();
+        assert_eq!(v["op"], "probe");
+        assert_eq!(v["args"][1], "/card/A001 \"x\".braw");
+
+        assert_eq!(exit_code(r#"{"type":"exit","code":3}"#), Some(3));
+        assert_eq!(exit_code(r#"{"type":"progress","frame":1,"total":2}"#), None);
+        assert_eq!(exit_code("kein json"), None);
+    }
+
+    #[test]
+    fn send_request_passes_fd() {
+        let (mut ours, theirs) = UnixStream::pair().unwrap();
+        let mut pipe = [0 as RawFd; 2];
+        assert_eq!(unsafe { libc::pipe(pipe.as_mut_ptr()) }, 0);
+        let (read_end, write_end) = unsafe { (OwnedFd::from_raw_fd(pipe[0]), OwnedFd::from_raw_fd(pipe[1])) };
+
+        send_request(&mut ours, "{\"op\":\"decode\",\"args\":[]}\n", Some(write_end.as_raw_fd())).unwrap();
+        drop(write_end);
+
+        // Empfangen wie serve.cpp: Zeile und ein fd
+        let mut payload = [0u8; 64];
+        let mut iov = libc::iovec {
+            iov_base: payload.as_mut_ptr() as *mut libc::c_void,
+            iov_len: payload.len(),
+        };
+        let space = unsafe { libc::CMSG_SPACE(std::mem::size_of::<RawFd>() as u32) } as usize;
+        let mut control = vec![0u64; space.div_ceil(8)];
+        let mut msg: libc::msghdr = unsafe { std::mem::zeroed() };
+        msg.msg_iov = &mut iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.as_mut_ptr() as *mut libc::c_void;
+        msg.msg_controllen = space as _;
+        let n = unsafe { libc::recvmsg(theirs.as_raw_fd(), &mut msg, 0) };
+        assert_eq!(&payload[..n as usize], b"{\"op\":\"decode\",\"args\":[]}\n");
+
+        let cmsg = unsafe { libc::CMSG_FIRSTHDR(&msg) };
+        assert!(!cmsg.is_null());
+        let mut fd: RawFd = -1;
+        unsafe { std::ptr::copy_nonoverlapping(libc::CMSG_DATA(cmsg) as *const RawFd, &mut fd, 1) };
+        let mut received = unsafe { std::fs::File::from_raw_fd(fd) };
+
+        // Das empfangene Schreib-Ende speist die Pipe des Absenders
+        received.write_all(b"frame").unwrap();
+        drop(received);
+        let mut read_end = std::fs::File::from(read_end);
+        let mut got = String::new();
+        std::io::Read::read_to_string(&mut read_end, &mut got).unwrap();
+        assert_eq!(got, "frame");
+    }
+}
@@ -0,0 +1,266 @@
+// bridge_encode – Proxy direkt in der RAW-Bridge encodieren (`--encode`).
+//
+// Eine mit -DBRIDGE_LIBAV=ON gebaute Bridge encodiert und muxt selbst
+// (libx264/libx265/prores_ks, PCM-Audio und Timecode aus dem Clip, siehe
+// bridge-common/av_encoder.h). Es gibt dann keinen FFmpeg-Prozess, keine
+// Pipe und keine separate Audio-Extraktion; der Job ist ein einziger
+// Bridge-Lauf, dessen stderr-Progress hier ausgewertet wird.
+//
+// Ob eine Bridge das kann, meldet sie selbst (`--capabilities`, einmal pro
+// Binary abgefragt): ohne libav, ohne den Encoder in libavcodec oder als
+// aeltere Bridge ohne die Option bleibt der Job beim FFmpeg-Pfad.
+
+use anyhow::{Context, Result};
+use std::collections::HashMap;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU32, Ordering};
+use std::sync::{Arc, Mutex, OnceLock};
+use tokio::io::{AsyncBufReadExt, BufReader};
+use tokio::process::Command;
+use tokio::sync::mpsc;
+use tokio_util::sync::CancellationToken;
+
+use crate::ffmpeg::runner::{is_prores, nvenc_available, vaapi_available, FfmpegEvent};
+use crate::ipc::protocol::JobOptions;
+
+/// Ob die Bridge den Job selbst encodiert. Nur mit `bridge_encode`, nur wenn
+/// die Bridge den Codec in ihrem Build encodieren kann (`encode_codecs`,
+/// siehe `bridge_encode_codecs`), nur fuer die Software-Encoder (ein
+/// verfuegbarer GPU-Encoder bleibt bei FFmpeg), nur wenn die Frames im
+/// Eingangsformat des Encoders kommen und nur wenn kein FFmpeg-Scale noetig
+/// ist (`ffmpeg_scales`: die Bridge kann die Zielgroesse in diesem
+/// Pixel-Format nicht liefern).
+pub fn wants_bridge_encode(
+    options: &JobOptions,
+    pix_fmt: &str,
+    ffmpeg_scales: bool,
+    encode_codecs: &[String],
+) -> bool {
+    if !options.bridge_encode
+        || ffmpeg_scales
+        || !encode_codecs.iter().any(|c| *c == options.proxy_codec)
+    {
+        return false;
+    }
+    let hw_encoder = match options.hw_accel.as_str() {
+        "vaapi" => vaapi_available(),
+        "nvenc" => nvenc_available(),
+        _ => false,
+    };
+    match options.proxy_codec.as_str() {
+        c if is_prores(c) => pix_fmt == "yuv422p10le",
+        "h264" | "h265" => !hw_encoder && pix_fmt == "yuv420p",
+        _ => false,
+    }
+}
+
+/// Die Codecs, die `bridge` in-process encodiert (`--capabilities`). Wird
+/// einmal pro Binary abgefragt und gecacht; leer, wenn die Bridge ohne
+/// libav gebaut ist, die Option nicht kennt oder nicht startet.
+pub fn bridge_encode_codecs(bridge: &Path) -> Vec<String> {
+    static CODECS: OnceLock<Mutex<HashMap<PathBuf, Vec<String>>>> = OnceLock::new();
+    let mut codecs = CODECS.get_or_init(Default::default).lock().unwrap();
+    codecs
+        .entry(bridge.to_path_buf())
+        .or_insert_with(|| {
+            let Ok(out) = std::process::Command::new(bridge).arg("--capabilities").output() else {
+                return Vec::new();
+            };
+            if !out.status.success() {
+                return Vec::new();
+            }
+            parse_encode_codecs(&String::from_utf8_lossy(&out.stderr))
+        })
+        .clone()
+}
+
+/// `encode_codecs` aus der `{"type":"capabilities"}`-Zeile auf stderr.
+fn parse_encode_codecs(stderr: &str) -> Vec<String> {
+    stderr
+        .lines()
+        .filter_map(|line| serde_json::from_str::<serde_json::Value>(line).ok())
+        .find(|v| v["type"] == "capabilities")
+        .and_then(|v| {
+            v["encode_codecs"].as_array().map(|codecs| {
+                codecs.iter().filter_map(|c| c.as_str().map(str::to_string)).collect()
+            })
+        })
+        .unwrap_or_default()
+}
+
+/// `--encode` / `--encode-codec` fuer den Bridge-Aufruf.
+pub fn push_encode_args(cmd: &mut Command, output_path: &Path, options: &JobOptions) {
+    cmd.arg("--encode")
+        .arg(output_path.as_os_str())
+        .arg("--encode-codec")
+        .arg(&options.proxy_codec);
+}
+
+/// Startet die Bridge im Encode-Modus und sendet Events ueber den Channel.
+/// `name` erscheint in Fehlermeldungen ("braw-bridge", "r3d-bridge").
+pub async fn run_bridge_encode(
+    name: &str,
+    mut bridge_cmd: Command,
+    job_id: String,
+    output_path: &Path,
+    total_frames: u64,
+    tx: mpsc::Sender<FfmpegEvent>,
+    cancel: CancellationToken,
+    pid_slot: Arc<AtomicU32>,
+) -> Result<()> {
+    let mut child = bridge_cmd
+        .stdout(std::process::Stdio::null())
+        .stderr(std::process::Stdio::piped())
+        .spawn()
+        .with_context(|| format!("{name} konnte nicht gestartet werden"))?;
+
+    // PID registrieren (fuer Pause/Resume SIGSTOP/SIGCONT)
+    pid_slot.store(child.id().unwrap_or(0), Ordering::Release);
+
+    let stderr = child
+        .stderr
+        .take()
+        .with_context(|| format!("Konnte stderr von {name} nicht lesen"))?;
+    let mut lines = BufReader::new(stderr).lines();
+    // Letzte Fehlermeldung der Bridge ({"type":"error"}) fuer den Fehlerfall
+    let mut last_error = String::new();
+
+    loop {
+        tokio::select! {
+            _ = cancel.cancelled() => {
+                let pid = pid_slot.load(Ordering::Acquire);
+                if pid != 0 {
+                    unsafe { libc::kill(pid as libc::pid_t, libc::SIGTERM); }
+                }
+                let _ = child.wait().await;
+                pid_slot.store(0, Ordering::Release);
+                let _ = std::fs::remove_file(output_path); // partial file cleanup
+                let _ = tx.send(FfmpegEvent::Cancelled { id: job_id.clone() }).await;
+                return Ok(());
+            }
+            line = lines.next_line() => {
+                match line {
+                    Ok(Some(line)) => {
+                        let Ok(v) = serde_json::from_str::<serde_json::Value>(&line) else {
+                            continue;
+                        };
+                        match v["type"].as_str() {
+                            Some("progress") => {
+                                let frame = v["frame"].as_u64().unwrap_or(0);
+                                let percent = if total_frames > 0 {
+                                    (frame as f32 / total_frames as f32 * 100.0).clamp(0.0, 100.0)
+                                } else {
+                                    0.0
+                                };
+                                let _ = tx
+                                    .send(FfmpegEvent::Progress {
+                                        id: job_id.clone(),
+                                        percent,
+                                        fps: 0.0,
+                                        speed: 0.0,
+                                        frame,
+                                    })
+                                    .await;
+                            }
+                            Some("error") => {
+                                last_error = v["message"].as_str().unwrap_or_default().to_string();
+                            }
+                            _ => {}
+                        }
+                    }
+                    Ok(None) => {
+                        // stderr geschlossen – Bridge beendet
+                        let status = child.wait().await?;
+                        pid_slot.store(0, Ordering::Release);
+                        if status.success() {
+                            let _ = tx.send(FfmpegEvent::Done { id: job_id.clone() }).await;
+                        } else {
+                            let _ = std::fs::remove_file(output_path); // partial file cleanup
+                            let exit_info = match status.code() {
+                                Some(c) => format!("Exit-Code: {c}"),
+                                None => "durch Signal beendet".to_string(),
+                            };
+                            let hint = if last_error.is_empty() {
+                                String::new()
+                            } else {
+                                format!("\n{last_error}")
+                            };
+                            let _ = tx
+                                .send(FfmpegEvent::Error {
+                                    id: job_id.clone(),
+                                    message: format!("{name} {exit_info}{hint}"),
+                                })
+                                .await;
+                        }
+                        return Ok(());
+                    }
+                    Err(e) => {
+                        let _ = child.kill().await;
+                        let _ = child.wait().await;
+                        pid_slot.store(0, Ordering::Release);
+                        let _ = std::fs::remove_file(output_path); // partial file cleanup
+                        let _ = tx
+                            .send(FfmpegEvent::Error {
+                                id: job_id.clone(),
+                                message: format!("Fehler beim Lesen von {name} stderr: {e}"),
+                            })
+                            .await;
+                        return Ok(());
+                    }
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn options(codec: &str) -> JobOptions {
+        JobOptions {
+            proxy_codec: codec.to_string(),
+            hw_accel: "none".to_string(),
+            bridge_encode: true,
+            ..JobOptions::default()
+        }
+    }
+
+    fn codecs(names: &[&str]) -> Vec<String> {
+        names.iter().map(|n| n.to_string()).collect()
+    }
+
+    #[test]
+    fn encodes_in_bridge_only_in_encoder_format_without_ffmpeg_scale() {
+        let all = codecs(&["h264", "h265", "prores_hq"]);
+        assert!(wants_bridge_encode(&options("h264"), "yuv420p", false, &all));
+        assert!(wants_bridge_encode(&options("prores_hq"), "yuv422p10le", false, &all));
+        assert!(!wants_bridge_encode(&options("prores_hq"), "yuv422p10le", true, &all));
+        assert!(!wants_bridge_encode(&options("h265"), "nv12", false, &all));
+        assert!(!wants_bridge_encode(&options("av1"), "yuv420p", false, &all));
+        let off = JobOptions { bridge_encode: false, ..options("h264") };
+        assert!(!wants_bridge_encode(&off, "yuv420p", false, &all));
+    }
+
+    #[test]
+    fn encodes_in_bridge_only_with_the_codec_in_its_build() {
+        // Bridge ohne libav (oder ohne --capabilities): FFmpeg-Pfad
+        assert!(!wants_bridge_encode(&options("h264"), "yuv420p", false, &[]));
+        // libavcodec ohne libx265
+        let no_x265 = codecs(&["h264", "prores_proxy", "prores_hq"]);
+        assert!(wants_bridge_encode(&options("h264"), "yuv420p", false, &no_x265));
+        assert!(!wants_bridge_encode(&options("h265"), "yuv420p", false, &no_x265));
+    }
+
+    #[test]
+    fn parses_encode_codecs_from_capabilities_line() {
+        let stderr = "{\"type\":\"warning\",\"message\":\"x\"}\n\
+                      {\"type\":\"capabilities\",\"encode\":true,\"encode_codecs\":[\"h264\",\"prores_hq\"]}\n";
+        assert_eq!(parse_encode_codecs(stderr), codecs(&["h264", "prores_hq"]));
+        let none = "{\"type\":\"capabilities\",\"encode\":false,\"encode_codecs\":[]}\n";
+        assert!(parse_encode_codecs(none).is_empty());
+        // Aeltere Bridge: "Unknown argument" und eine Fehlerzeile
+        let old = "Unknown argument: --capabilities\n{\"type\":\"error\",\"message\":\"Invalid arguments\"}\n";
+        assert!(parse_encode_codecs(old).is_empty());
+    }
+}
@@ -0,0 +1,180 @@
+// bridge_probe – Metadaten vieler RAW-Clips mit einem einzigen Bridge-Lauf.
+//
+// Die Clips gehen als Liste (ein Pfad pro Zeile, in einem memfd) an
+// `--probe-only --input-list -`: als probe-Anfrage an den Daemon (die Liste
+// als fd, siehe ffmpeg::bridge_daemon) oder als eigener Prozess (die Liste
+// auf stdin). Die Bridge oeffnet die Clips parallel auf einer SDK-Instanz
+// und meldet jeden mit einer metadata- oder error-Zeile samt "input",
+// sobald er fertig ist (siehe bridge-common/probe_batch.h).
+
+use anyhow::{anyhow, Context, Result};
+use std::collections::HashMap;
+use std::ffi::OsString;
+use std::io::{Seek, SeekFrom, Write};
+use std::os::unix::io::{FromRawFd, OwnedFd};
+use std::path::{Path, PathBuf};
+use tokio::process::Command;
+
+use crate::ffmpeg::bridge_daemon;
+
+/// Probt `inputs` mit `bridge` und ruft `on_clip(index, metadata-Zeile)` fuer
+/// jeden Clip, sobald die Bridge ihn meldet (Reihenfolge: Fertigstellung).
+/// Jeder Index kommt genau einmal, auch wenn die Bridge scheitert.
+pub async fn probe_clips<F>(bridge: &Path, name: &str, inputs: &[PathBuf], mut on_clip: F)
+where
+    F: FnMut(usize, Result<&str>),
+{
+    // Pfad → Indizes (derselbe Clip kann mehrfach in der Queue stehen)
+    let mut pending: HashMap<String, Vec<usize>> = HashMap::new();
+    let mut list = String::new();
+    for (i, input) in inputs.iter().enumerate() {
+        match input.to_str() {
+            Some(path) if !path.contains('\n') => {
+                let indices = pending.entry(path.to_string()).or_default();
+                if indices.is_empty() {
+                    list.push_str(path);
+                    list.push('\n');
+                }
+                indices.push(i);
+            }
+            _ => on_clip(i, Err(anyhow!("{name}: Pfad {:?} laesst sich nicht uebergeben", input))),
+        }
+    }
+    if pending.is_empty() {
+        return;
+    }
+
+    if let Err(e) = run_probe(bridge, name, &list, &mut pending, &mut on_clip).await {
+        for i in pending.drain().flat_map(|(_, indices)| indices) {
+            on_clip(i, Err(anyhow!("{e:#}")));
+        }
+    }
+    for i in pending.drain().flat_map(|(_, indices)| indices) {
+        on_clip(i, Err(anyhow!("{name} hat keine Metadaten ausgegeben")));
+    }
+}
+
+/// Ein Bridge-Lauf ueber `list`; erledigte Clips verschwinden aus `pending`.
+async fn run_probe<F>(
+    bridge: &Path,
+    name: &str,
+    list: &str,
+    pending: &mut HashMap<String, Vec<usize>>,
+    on_clip: &mut F,
+) -> Result<()>
+where
+    F: FnMut(usize, Result<&str>),
+{
+    let list_fd = list_fd(list)?;
+    let args = [OsString::from("--input-list"), OsString::from("-")];
+
+    // Bei nur einem Clip markiert die Bridge ihre Zeilen nicht mit "input"
+    let single = (pending.len() == 1).then(|| pending.keys().next().cloned()).flatten();
+
+    let mut child = None;
+    let mut report = match bridge_daemon::request(bridge, "probe", &args, Some(list_fd.try_clone()?)).await {
+        Ok(report) => report,
+        Err(_) => {
+            let mut spawned = Command::new(bridge)
+                .args(&args)
+                .arg("--probe-only")
+                .stdin(std::process::Stdio::from(list_fd))
+                .stdout(std::process::Stdio::null())
+                .stderr(std::process::Stdio::piped())
+                .spawn()
+                .with_context(|| format!("{name} konnte nicht gestartet werden: {:?}", bridge))?;
+            let stderr = spawned.stderr.take().context("Konnte stderr der Bridge nicht lesen")?;
+            child = Some(spawned);
+            bridge_daemon::report(stderr)
+        }
+    };
+
+    while let Some(line) = report.next_line().await? {
+        let Ok(v) = serde_json::from_str::<serde_json::Value>(&line) else {
+            continue;
+        };
+        let Some(input) = v["input"].as_str().map(str::to_string).or_else(|| single.clone()) else {
+            continue;
+        };
+        let result = match v["type"].as_str() {
+            Some("metadata") => Ok(line.as_str()),
+            Some("error") => Err(anyhow!("{}", v["message"].as_str().unwrap_or("unbekannter Fehler"))),
+            _ => continue,
+        };
+        if let Some(indices) = pending.remove(&input) {
+            for i in indices {
+                on_clip(
+                    i,
+                    match &result {
+                        Ok(line) => Ok(line),
+                        Err(e) => Err(anyhow!("{e}")),
+                    },
+                );
+            }
+        }
+    }
+    if let Some(mut child) = child {
+        let _ = child.wait().await;
+    }
+    Ok(())
+}
+
+/// Die Clip-Liste in einem memfd, Dateiposition am Anfang.
+fn list_fd(list: &str) -> Result<OwnedFd> {
+    let fd = unsafe { libc::memfd_create(c"bridge-inputs".as_ptr(), libc::MFD_CLOEXEC) };
+    if fd < 0 {
+        return Err(std::io::Error::last_os_error()).context("memfd fuer die Clip-Liste");
+    }
+    let mut file = std::fs::File::from(unsafe { OwnedFd::from_raw_fd(fd) });
+    file.write_all(list.as_bytes())?;
+    file.seek(SeekFrom::Start(0))?;
+    Ok(file.into())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::os::unix::fs::PermissionsExt;
+
+    #[tokio::test]
+    async fn every_clip_reported_once() {
+        // Bridge-Attrappe: kein --serve, meldet die Liste von stdin,
+        // "skip"-Clips gar nicht
+        let dir = std::env::temp_dir().join(format!("bridge-probe-test-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let bridge = dir.join("fake-bridge");
+        std::fs::write(
+            &bridge,
+            r#"#!/bin/sh
+[ "$1" = "--serve" ] && exit 1
+while read -r p; do
+  case "$p" in
+    *skip*) ;;
+    *bad*) echo "{\"type\":\"error\",\"input\":\"$p\",\"message\":\"kaputt\"}" >&2 ;;
+    *) echo "{\"type\":\"warning\",\"input\":\"$p\",\"message\":\"w\"}" >&2
+       echo "{\"type\":\"metadata\",\"input\":\"$p\",\"fps_num\":25}" >&2 ;;
+  esac
+done
+"#,
+        )
+        .unwrap();
+        std::fs::set_permissions(&bridge, std::fs::Permissions::from_mode(0o755)).unwrap();
+
+        let inputs: Vec<PathBuf> = ["/card/A001.braw", "/card/bad.braw", "/card/A001.braw", "/card/skip.braw"]
+            .iter()
+            .map(PathBuf::from)
+            .collect();
+        let mut results: Vec<Option<Result<String, String>>> = vec![None; inputs.len()];
+        probe_clips(&bridge, "fake-bridge", &inputs, |i, r| {
+            assert!(results[i].is_none());
+            results[i] = Some(r.map(str::to_string).map_err(|e| e.to_string()));
+        })
+        .await;
+        std::fs::remove_dir_all(&dir).unwrap();
+
+        let ok = |i: usize| results[i].as_ref().unwrap().as_ref().unwrap().contains("\"metadata\"");
+        assert!(ok(0) && ok(2));
+        assert_eq!(results[1].as_ref().unwrap().as_ref().unwrap_err(), "kaputt");
+        assert!(results[3].as_ref().unwrap().as_ref().unwrap_err().contains("keine Metadaten"));
+    }
+}
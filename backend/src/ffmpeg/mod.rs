@@ -1,4 +1,9 @@
 // ffmpeg – FFmpeg-Prozesssteuerung und Fortschrittsauswertung
 
+pub mod bridge_daemon;
+pub mod bridge_encode;
+pub mod bridge_probe;
 pub mod progress;
 pub mod runner;
+pub mod segments;
+pub mod shm;
@@ -11,6 +11,7 @@ use tokio::sync::mpsc;
 use tokio_util::sync::CancellationToken;
 
 use crate::ffmpeg::progress::{calculate_progress, ProgressParser};
+use crate::ffmpeg::shm;
 use crate::ipc::protocol::{JobMode, JobOptions};
 
 /// Events die der FFmpeg-Runner an den Job-Manager sendet.
@@ -41,6 +42,169 @@ fn normalize_resolution(res: &str) -> String {
     res.replace('x', ":")
 }
 
+/// Uebersetzt `proxy_resolution` ("1920x1080", "1280:-2", "iw/2:-2") in
+/// `WxH` fuer `--output-size` der RAW-Bridges, die dann selbst skalieren.
+/// `iw`/`ih` beziehen sich wie bei FFmpeg auf die debayerten Frames
+/// (`frame_width` x `frame_height`). -1/-2 werden durchgereicht: die Bridge
+/// kennt das Pixel-Seitenverhaeltnis (anamorph). None = Ausdruck nicht
+/// unterstuetzt, dann skaliert weiterhin FFmpeg.
+pub fn bridge_output_size(spec: &str, frame_width: u32, frame_height: u32) -> Option<String> {
+    let normalized = normalize_resolution(spec.trim());
+    let (w, h) = normalized.split_once(':')?;
+    let w = scale_term(w, frame_width, frame_height)?;
+    let h = scale_term(h, frame_width, frame_height)?;
+    if w < 0 && h < 0 {
+        return None;
+    }
+    Some(format!("{w}x{h}"))
+}
+
+/// Frames, die eine RAW-Bridge tatsaechlich auf stdout schreibt.
+#[derive(Debug, Clone, PartialEq)]
+pub struct BridgeFrames {
+    pub width: u32,
+    pub height: u32,
+    /// `--pix-fmt` der Bridge: FFmpeg-Name ("rgb24", "gbrp16le", ...) oder "dpx10"
+    pub pix_fmt: String,
+    /// Bei YUV-Frames: "limited" | "full" (BT.709-Matrix)
+    pub yuv_range: Option<String>,
+    /// Frames (und Clip-Audio) kommen als NUT-Stream (`--mux nut`)
+    pub nut: bool,
+}
+
+/// Liest die Frames aus der Metadaten-Zeile eines Bridge-Laufs
+/// (`output_width`/`output_height`/`pix_fmt`/`mux`). Fehlende Felder
+/// (aeltere Bridges) kommen aus `fallback_size` bzw. sind rgb24 ohne NUT.
+pub fn bridge_frames(metadata_line: &str, fallback_size: (u32, u32)) -> BridgeFrames {
+    let v: serde_json::Value = serde_json::from_str(metadata_line).unwrap_or_default();
+    let (width, height) = match (v["output_width"].as_u64(), v["output_height"].as_u64()) {
+        (Some(w), Some(h)) if w > 0 && h > 0 => (w as u32, h as u32),
+        _ => fallback_size,
+    };
+    let pix_fmt = v["pix_fmt"].as_str().unwrap_or("rgb24").to_string();
+    let yuv_range = v["yuv_range"].as_str().map(|r| r.to_string());
+    let nut = v["mux"].as_str() == Some("nut");
+    BridgeFrames { width, height, pix_fmt, yuv_range, nut }
+}
+
+/// Waehlt `--pix-fmt` fuer einen Bridge-Lauf. Eine explizite Angabe in
+/// `bridge_pix_fmt` gewinnt. Sonst liefert die Bridge direkt das
+/// Eingangsformat des Encoders, damit swscale nicht pro Frame von RGB
+/// konvertiert: ProRes bekommt 10-Bit 4:2:2 (aus 16-Bit-SDK-Output, kein
+/// 8-Bit-Zwischenschritt), NVENC/VAAPI nv12 (direkt fuer hwupload), alles
+/// andere yuv420p.
+pub fn bridge_pix_fmt(options: &JobOptions) -> String {
+    if !options.bridge_pix_fmt.is_empty() {
+        return options.bridge_pix_fmt.clone();
+    }
+    if is_prores(&options.proxy_codec) {
+        return "yuv422p10le".to_string();
+    }
+    match options.hw_accel.as_str() {
+        "vaapi" if vaapi_available() => "nv12".to_string(),
+        // AV1-NVENC nimmt yuv420p (siehe push_nvenc_av1)
+        "nvenc" if nvenc_available() && options.proxy_codec != "av1" => "nv12".to_string(),
+        _ => "yuv420p".to_string(),
+    }
+}
+
+/// Ob die Bridge Frames dieses Formats selbst skalieren kann (`--output-size`
+/// arbeitet nur auf 8 Bit: RGB oder 8-Bit-YUV); sonst skaliert FFmpeg.
+pub fn bridge_can_scale(pix_fmt: &str) -> bool {
+    matches!(pix_fmt, "rgb24" | "bgr24" | "yuv420p" | "nv12")
+}
+
+/// Ob die Bridge `--mux nut` schreibt: Frames und Clip-Audio in einem
+/// NUT-Stream auf stdout, ohne separate Audio-Extraktion. Nur ueber die
+/// stdout-Pipe und nur fuer Pixel-Formate mit NUT-Fourcc.
+pub fn wants_bridge_nut(options: &JobOptions, pix_fmt: &str) -> bool {
+    options.bridge_mux == "nut"
+        && !shm::wants_shm(options)
+        && matches!(
+            pix_fmt,
+            "rgb24" | "bgr24" | "bgra" | "rgb48le" | "gbrp16le" | "yuv420p" | "nv12" | "yuv422p10le"
+        )
+}
+
+/// FFmpeg-Input fuer die Bridge-Frames auf stdin (pipe:0): rawvideo im
+/// gemeldeten Pixel-Format; dpx10 kommt als DPX-Bildfolge (ein Header pro
+/// Frame beschreibt Groesse und Packing), ein NUT-Stream beschreibt Frames
+/// und Audio selbst. YUV-Frames werden als BT.709 mit dem gemeldeten Range
+/// getaggt (nur Matrix/Range, Primaries bleiben offen).
+pub fn push_bridge_input_args(args: &mut Vec<String>, frames: &BridgeFrames, fps_num: u32, fps_den: u32) {
+    if frames.nut {
+        args.push("-f".to_string());
+        args.push("nut".to_string());
+    } else if frames.pix_fmt == "dpx10" {
+        args.push("-f".to_string());
+        args.push("image2pipe".to_string());
+        args.push("-c:v".to_string());
+        args.push("dpx".to_string());
+        args.push("-framerate".to_string());
+        args.push(format!("{}/{}", fps_num, fps_den));
+    } else {
+        args.push("-f".to_string());
+        args.push("rawvideo".to_string());
+        args.push("-pix_fmt".to_string());
+        args.push(frames.pix_fmt.clone());
+        args.push("-s".to_string());
+        args.push(format!("{}x{}", frames.width, frames.height));
+        args.push("-r".to_string());
+        args.push(format!("{}/{}", fps_num, fps_den));
+    }
+    if frames.pix_fmt != "dpx10" {
+        if let Some(range) = &frames.yuv_range {
+            args.push("-color_range".to_string());
+            args.push(if range == "full" { "pc" } else { "tv" }.to_string());
+            args.push("-colorspace".to_string());
+            args.push("bt709".to_string());
+        }
+    }
+    args.push("-i".to_string());
+    args.push("pipe:0".to_string());
+}
+
+/// Ein Term einer Scale-Angabe: Zahl, -1/-2, `iw`/`ih`, `iw/N`, `iw*F`.
+fn scale_term(term: &str, frame_width: u32, frame_height: u32) -> Option<i64> {
+    let term = term.trim();
+    if let Ok(v) = term.parse::<i64>() {
+        return match v {
+            -1 | -2 => Some(v),
+            1..=32768 => Some(v),
+            _ => None,
+        };
+    }
+
+    let (base, rest) = if let Some(rest) = term.strip_prefix("iw") {
+        (frame_width as f64, rest)
+    } else if let Some(rest) = term.strip_prefix("ih") {
+        (frame_height as f64, rest)
+    } else {
+        return None;
+    };
+
+    let value = if rest.is_empty() {
+        base
+    } else if let Some(div) = rest.strip_prefix('/') {
+        let d: f64 = div.trim().parse().ok()?;
+        if d <= 0.0 {
+            return None;
+        }
+        base / d
+    } else if let Some(mul) = rest.strip_prefix('*') {
+        let m: f64 = mul.trim().parse().ok()?;
+        if m <= 0.0 {
+            return None;
+        }
+        base * m
+    } else {
+        return None;
+    };
+
+    let v = value.round() as i64;
+    (1..=32768).contains(&v).then_some(v)
+}
+
 /// Baut die FFmpeg-Argumente fuer den gegebenen Modus zusammen.
 ///
 /// Argument-Reihenfolge ist kritisch:
@@ -525,3 +689,93 @@ fn build_error_message(exit_code: i32, log_tail: &[String]) -> String {
         log_tail.join("\n")
     )
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn output_size_from_fixed_resolution() {
+        assert_eq!(bridge_output_size("1920x1080", 6144, 3240).as_deref(), Some("1920x1080"));
+        assert_eq!(bridge_output_size("1280:-2", 6144, 3240).as_deref(), Some("1280x-2"));
+    }
+
+    #[test]
+    fn output_size_from_input_relative_expression() {
+        assert_eq!(bridge_output_size("iw/2:-2", 3072, 1620).as_deref(), Some("1536x-2"));
+        assert_eq!(bridge_output_size("iw*0.5:ih/2", 4096, 2160).as_deref(), Some("2048x1080"));
+    }
+
+    #[test]
+    fn output_size_rejects_unsupported() {
+        assert!(bridge_output_size("-2:-2", 1920, 1080).is_none());
+        assert!(bridge_output_size("trunc(iw/3)*2:-2", 1920, 1080).is_none());
+        assert!(bridge_output_size("1920", 1920, 1080).is_none());
+    }
+
+    #[test]
+    fn frames_from_metadata_line() {
+        let line = r#"{"type":"metadata","width":6144,"height":3240,"output_width":1920,"output_height":1012,"pix_fmt":"nv12","yuv_range":"full"}"#;
+        assert_eq!(
+            bridge_frames(line, (3072, 1620)),
+            BridgeFrames {
+                width: 1920,
+                height: 1012,
+                pix_fmt: "nv12".to_string(),
+                yuv_range: Some("full".to_string()),
+                nut: false,
+            }
+        );
+        let old = r#"{"type":"metadata","width":6144,"height":3240}"#;
+        assert_eq!(
+            bridge_frames(old, (3072, 1620)),
+            BridgeFrames { width: 3072, height: 1620, pix_fmt: "rgb24".to_string(), yuv_range: None, nut: false }
+        );
+    }
+
+    #[test]
+    fn pix_fmt_choice() {
+        let mut options = JobOptions::default();
+        options.hw_accel = "none".to_string();
+        assert_eq!(bridge_pix_fmt(&options), "yuv420p");
+        assert!(bridge_can_scale("yuv420p"));
+        options.proxy_codec = "prores_hq".to_string();
+        assert_eq!(bridge_pix_fmt(&options), "yuv422p10le");
+        assert!(!bridge_can_scale("yuv422p10le"));
+        options.bridge_pix_fmt = "dpx10".to_string();
+        assert_eq!(bridge_pix_fmt(&options), "dpx10");
+        assert!(!bridge_can_scale("dpx10"));
+    }
+
+    #[test]
+    fn yuv_input_is_tagged() {
+        let frames = BridgeFrames {
+            width: 1920,
+            height: 1080,
+            pix_fmt: "yuv420p".to_string(),
+            yuv_range: Some("limited".to_string()),
+            nut: false,
+        };
+        let mut args = Vec::new();
+        push_bridge_input_args(&mut args, &frames, 24000, 1001);
+        let joined = args.join(" ");
+        assert!(joined.contains("-pix_fmt yuv420p -s 1920x1080 -r 24000/1001 -color_range tv -colorspace bt709 -i pipe:0"));
+    }
+
+    #[test]
+    fn nut_input_keeps_color_tags() {
+        let line = r#"{"type":"metadata","output_width":1920,"output_height":1080,"pix_fmt":"yuv422p10le","yuv_range":"limited","mux":"nut"}"#;
+        let frames = bridge_frames(line, (1920, 1080));
+        assert!(frames.nut);
+        let mut args = Vec::new();
+        push_bridge_input_args(&mut args, &frames, 25, 1);
+        assert_eq!(args.join(" "), "-f nut -color_range tv -colorspace bt709 -i pipe:0");
+
+        let options = JobOptions::default();
+        assert!(wants_bridge_nut(&options, "yuv420p"));
+        assert!(!wants_bridge_nut(&options, "dpx10"));
+        assert!(!wants_bridge_nut(&options, "p010le"));
+        let shm = JobOptions { bridge_transport: "shm".to_string(), ..JobOptions::default() };
+        assert!(!wants_bridge_nut(&shm, "yuv420p"));
+    }
+}
@@ -0,0 +1,347 @@
+// segments – ein langer RAW-Clip, in N Segmenten parallel encodiert.
+//
+// Jedes Segment ist ein Frame-Bereich, den die Bridge mit `--start-frame`/
+// `--frame-count` dekodiert, mit Timecode und Audio ab seinem ersten Frame.
+// Die Segmente laufen als eigene BRAW-/R3D-Jobs in temporaere Dateien neben
+// dem Proxy und werden danach vom concat-Demuxer ohne Neu-Encode (-c copy)
+// aneinandergehaengt.
+//
+// Die Grenzen liegen auf Vielfachen der GOP-Laenge, mit der die Segmente
+// encodiert werden (`-g`): der fertige Proxy hat dieselbe Keyframe-Folge wie
+// ein Encode am Stueck. Die Audio-Grenzen rechnet die Bridge aus den Frames
+// (Sample frame * rate / fps, abgerundet); benachbarte Segmente teilen sich
+// also dieselbe Grenze, und es entsteht keine Luecke und kein Versatz.
+//
+// Die Segmente teilen sich den CPU-Anteil des Jobs (bridge_thread_budget):
+// hoechstens ein Segment pro Thread, und jedes bekommt seinen Teil davon
+// fuer die Bridge (`--threads` bzw. `--decompression-threads`) und fuer
+// seinen Encoder (`-threads`).
+
+use anyhow::{anyhow, Context, Result};
+use std::collections::HashMap;
+use std::ffi::OsString;
+use std::future::Future;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::AtomicU32;
+use std::sync::Arc;
+use tokio::process::Command;
+use tokio::sync::mpsc;
+use tokio_util::sync::CancellationToken;
+
+use crate::ffmpeg::runner::{is_prores, FfmpegEvent};
+use crate::ipc::protocol::JobOptions;
+
+/// GOP-Laenge der Long-GOP-Codecs im Segment-Modus (Default von x264/x265)
+const LONG_GOP: u64 = 250;
+
+/// Kuerzeres Segment lohnt den zusaetzlichen Bridge- und Encoder-Start nicht
+const MIN_SEGMENT_FRAMES: u64 = 1000;
+
+/// Frames [start, start + count) eines Clips.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FrameRange {
+    pub start: u64,
+    pub count: u64,
+}
+
+impl FrameRange {
+    /// Bridge-Argumente fuer diesen Bereich (Decode und `--extract-audio`)
+    pub fn bridge_args(&self) -> [OsString; 4] {
+        [
+            "--start-frame".into(),
+            self.start.to_string().into(),
+            "--frame-count".into(),
+            self.count.to_string().into(),
+        ]
+    }
+}
+
+/// GOP-Laenge, auf die die Segmentgrenzen fallen: Intra-Codecs (ProRes)
+/// vertragen jede Grenze.
+pub fn segment_gop(options: &JobOptions) -> u64 {
+    if is_prores(&options.proxy_codec) {
+        1
+    } else {
+        LONG_GOP
+    }
+}
+
+/// Teilt `frame_count` Frames in hoechstens `segments` Bereiche mit Grenzen
+/// auf Vielfachen von `gop`. Segmente unter MIN_SEGMENT_FRAMES entfallen; ein
+/// einziger Bereich heisst: am Stueck encodieren.
+pub fn plan_segments(frame_count: u64, segments: u32, gop: u64) -> Vec<FrameRange> {
+    let gop = gop.max(1);
+    let n = (segments.max(1) as u64).min(frame_count / MIN_SEGMENT_FRAMES).max(1);
+    // Jedes Segment bekommt mindestens eine GOP (n <= frame_count / 1000),
+    // also steigen die Grenzen streng und bleiben unter frame_count
+    let gops = frame_count.div_ceil(gop);
+    let boundary = |k: u64| if k == n { frame_count } else { (k * gops / n * gop).min(frame_count) };
+    (0..n)
+        .map(|k| FrameRange {
+            start: boundary(k),
+            count: boundary(k + 1) - boundary(k),
+        })
+        .collect()
+}
+
+/// Die Bereiche eines Jobs mit `budget` CPU-Threads: hoechstens
+/// `options.segments` und hoechstens einer pro Thread.
+pub fn plan_job_segments(frame_count: u64, options: &JobOptions, budget: u32) -> Vec<FrameRange> {
+    plan_segments(frame_count, options.segments.min(budget), segment_gop(options))
+}
+
+/// CPU-Threads pro Segment, wenn sich `segments` Segmente `budget` teilen
+pub fn segment_threads(budget: u32, segments: usize) -> u32 {
+    (budget / segments.max(1) as u32).max(1)
+}
+
+/// Encoder-Einstellungen eines Segments: GOP-Laenge (siehe segment_gop) und
+/// sein Anteil an den CPU-Threads des Jobs (siehe segment_threads)
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SegmentEncode {
+    pub gop: u64,
+    pub threads: u32,
+}
+
+/// `-g` (nichts bei Intra-Codecs) und `-threads` fuer einen Segment-Encode
+pub fn push_segment_args(args: &mut Vec<String>, segment: &SegmentEncode) {
+    if segment.gop > 1 {
+        args.push("-g".to_string());
+        args.push(segment.gop.to_string());
+    }
+    args.push("-threads".to_string());
+    args.push(segment.threads.to_string());
+}
+
+/// Encodiert `ranges` parallel ueber `run_segment` und haengt die Ergebnisse
+/// zu `output_path` zusammen. Events gehen wie bei einem einzelnen Job unter
+/// `job_id` an `tx`; der Fortschritt zaehlt die Frames aller Segmente.
+///
+/// `run_segment(id, Ausgabe, Bereich, tx, cancel, pid_slot)` ist ein
+/// run_braw_job/run_r3d_job; jedes Segment bekommt einen der `pid_slots`
+/// (Pause/Resume). Scheitert ein Segment, werden die anderen abgebrochen.
+pub async fn run_segmented<F, Fut>(
+    job_id: String,
+    output_path: PathBuf,
+    ranges: Vec<FrameRange>,
+    timecode: String,
+    tx: mpsc::Sender<FfmpegEvent>,
+    cancel: CancellationToken,
+    pid_slots: Vec<Arc<AtomicU32>>,
+    mut run_segment: F,
+) -> Result<()>
+where
+    F: FnMut(String, PathBuf, FrameRange, mpsc::Sender<FfmpegEvent>, CancellationToken, Arc<AtomicU32>) -> Fut,
+    Fut: Future<Output = Result<()>> + Send + 'static,
+{
+    let total_frames: u64 = ranges.iter().map(|r| r.count).sum();
+    let segment_dir = segment_dir(&output_path, &job_id);
+    std::fs::create_dir_all(&segment_dir)
+        .with_context(|| format!("Segment-Ordner {:?} konnte nicht angelegt werden", segment_dir))?;
+    let extension = output_path
+        .extension()
+        .map(|e| e.to_string_lossy().into_owned())
+        .unwrap_or_else(|| "mov".to_string());
+
+    let segments_cancel = cancel.child_token();
+    let (seg_tx, mut seg_rx) = mpsc::channel::<FfmpegEvent>(64);
+    let mut index: HashMap<String, usize> = HashMap::new();
+    let mut parts = Vec::with_capacity(ranges.len());
+    let mut tasks = Vec::with_capacity(ranges.len());
+    for (k, range) in ranges.iter().enumerate() {
+        let id = format!("{job_id}.{k}");
+        let part = segment_dir.join(format!("segment-{k:03}.{extension}"));
+        index.insert(id.clone(), k);
+        parts.push(part.clone());
+        let slot = pid_slots.get(k).cloned().unwrap_or_default();
+        let segment = run_segment(id.clone(), part, *range, seg_tx.clone(), segments_cancel.child_token(), slot);
+        let error_tx = seg_tx.clone();
+        tasks.push(tokio::spawn(async move {
+            if let Err(e) = segment.await {
+                let _ = error_tx.send(FfmpegEvent::Error { id, message: format!("{e:#}") }).await;
+            }
+        }));
+    }
+    drop(seg_tx);
+
+    let mut frames = vec![0u64; ranges.len()];
+    let mut done = 0usize;
+    let mut failure: Option<String> = None;
+    // Bis alle Segment-Tasks beendet sind
+    while let Some(event) = seg_rx.recv().await {
+        match event {
+            FfmpegEvent::Progress { id, frame, .. } => {
+                let Some(&k) = index.get(&id) else { continue };
+                frames[k] = frame;
+                let frame: u64 = frames.iter().sum();
+                let percent = if total_frames > 0 {
+                    (frame as f32 / total_frames as f32 * 100.0).clamp(0.0, 100.0)
+                } else {
+                    0.0
+                };
+                let _ = tx
+                    .send(FfmpegEvent::Progress {
+                        id: job_id.clone(),
+                        percent,
+                        fps: 0.0,
+                        speed: 0.0,
+                        frame,
+                    })
+                    .await;
+            }
+            FfmpegEvent::Done { .. } => done += 1,
+            FfmpegEvent::Error { id, message } => {
+                if failure.is_none() {
+                    let k = index.get(&id).copied().unwrap_or(0);
+                    failure = Some(format!("Segment {} von {}: {message}", k + 1, ranges.len()));
+                    segments_cancel.cancel();
+                }
+            }
+            FfmpegEvent::Cancelled { .. } => {}
+        }
+    }
+    for task in tasks {
+        if let Err(e) = task.await {
+            failure.get_or_insert_with(|| format!("Segment-Task: {e}"));
+        }
+    }
+
+    let result = if cancel.is_cancelled() {
+        FfmpegEvent::Cancelled { id: job_id.clone() }
+    } else if let Some(message) = failure {
+        FfmpegEvent::Error { id: job_id.clone(), message }
+    } else if done != parts.len() {
+        FfmpegEvent::Error {
+            id: job_id.clone(),
+            message: format!("nur {done} von {} Segmenten fertig", parts.len()),
+        }
+    } else {
+        match concat_segments(&parts, &segment_dir, &output_path, &timecode).await {
+            Ok(()) => FfmpegEvent::Done { id: job_id.clone() },
+            Err(e) => FfmpegEvent::Error {
+                id: job_id.clone(),
+                message: format!("Segmente zusammenfuegen: {e:#}"),
+            },
+        }
+    };
+    let _ = std::fs::remove_dir_all(&segment_dir);
+    let _ = tx.send(result).await;
+    Ok(())
+}
+
+/// Temporaerer Ordner fuer die Segmente, neben dem Proxy (dasselbe
+/// Dateisystem, die Segmente sind zusammen so gross wie der Proxy)
+fn segment_dir(output_path: &Path, job_id: &str) -> PathBuf {
+    let parent = output_path.parent().unwrap_or(Path::new("."));
+    parent.join(format!(".proxy-gen-segments-{job_id}"))
+}
+
+/// Zeile fuer die concat-Liste: Pfad in einfachen Anfuehrungszeichen, ein '
+/// darin als '\''
+fn concat_list_line(path: &Path) -> String {
+    format!("file '{}'\n", path.to_string_lossy().replace('\'', r"'\''"))
+}
+
+/// Haengt `parts` mit dem concat-Demuxer verlustfrei zu `output_path`
+/// zusammen. Der Timecode-Track der Segmente entfaellt (-map nur Video und
+/// Audio); der Proxy bekommt den des ersten Frames neu.
+async fn concat_segments(parts: &[PathBuf], segment_dir: &Path, output_path: &Path, timecode: &str) -> Result<()> {
+    let list_path = segment_dir.join("segments.txt");
+    let list: String = parts.iter().map(|p| concat_list_line(p)).collect();
+    std::fs::write(&list_path, list).context("concat-Liste konnte nicht geschrieben werden")?;
+
+    let mut args: Vec<OsString> = ["-y", "-loglevel", "warning", "-f", "concat", "-safe", "0", "-i"]
+        .iter()
+        .map(OsString::from)
+        .collect();
+    args.push(list_path.into_os_string());
+    args.extend(["-map", "0:v", "-map", "0:a?", "-c", "copy"].iter().map(OsString::from));
+    if !timecode.is_empty() {
+        args.push("-metadata".into());
+        args.push(format!("timecode={timecode}").into());
+    }
+    args.push(output_path.as_os_str().to_owned());
+
+    let out = Command::new("ffmpeg")
+        .args(&args)
+        .stdin(std::process::Stdio::null())
+        .stdout(std::process::Stdio::null())
+        .output()
+        .await
+        .context("FFmpeg konnte nicht gestartet werden")?;
+    if !out.status.success() {
+        let stderr = String::from_utf8_lossy(&out.stderr);
+        return Err(anyhow!("FFmpeg {}\n{}", out.status, stderr.trim()));
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn short_clip_stays_whole() {
+        assert_eq!(plan_segments(1500, 4, 250), vec![FrameRange { start: 0, count: 1500 }]);
+        assert_eq!(plan_segments(0, 4, 250), vec![FrameRange { start: 0, count: 0 }]);
+        assert_eq!(plan_segments(100_000, 1, 250).len(), 1);
+    }
+
+    #[test]
+    fn segments_cover_clip_on_gop_boundaries() {
+        for (frames, n, gop) in [(180_000, 4, 250), (4321, 8, 250), (100_001, 7, 250), (5000, 3, 1)] {
+            let plan = plan_segments(frames, n, gop);
+            assert!(plan.len() > 1 && plan.len() <= n as usize);
+            let mut next = 0;
+            for r in &plan {
+                assert_eq!(r.start, next);
+                assert!(r.count > 0);
+                assert_eq!(r.start % gop, 0);
+                next = r.start + r.count;
+            }
+            assert_eq!(next, frames);
+        }
+        // 4321 Frames: hoechstens 4 Segmente zu je mindestens 1000 Frames
+        assert_eq!(plan_segments(4321, 8, 250).len(), 4);
+    }
+
+    fn options(codec: &str, segments: u32) -> JobOptions {
+        JobOptions {
+            proxy_codec: codec.to_string(),
+            segments,
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn segments_stay_within_job_thread_budget() {
+        // 8 Segmente gewuenscht, 4 Threads: 4 Segmente zu je einem Thread
+        let plan = plan_job_segments(180_000, &options("h264", 8), 4);
+        assert_eq!(plan.len(), 4);
+        assert_eq!(segment_threads(4, plan.len()), 1);
+        // 4 Segmente, 16 Threads: je 4
+        let plan = plan_job_segments(180_000, &options("h264", 4), 16);
+        assert_eq!(plan.len(), 4);
+        assert_eq!(segment_threads(16, plan.len()), 4);
+        // Ein Thread: am Stueck
+        assert_eq!(plan_job_segments(180_000, &options("h264", 4), 1).len(), 1);
+        // 3 Segmente, 8 Threads: abgerundet 2, nie 0
+        assert_eq!(segment_threads(8, 3), 2);
+        assert_eq!(segment_threads(1, 0), 1);
+    }
+
+    #[test]
+    fn segment_encoder_gets_gop_and_thread_share() {
+        let mut args = Vec::new();
+        push_segment_args(&mut args, &SegmentEncode { gop: 250, threads: 3 });
+        assert_eq!(args, ["-g", "250", "-threads", "3"]);
+        let mut args = Vec::new();
+        push_segment_args(&mut args, &SegmentEncode { gop: 1, threads: 2 });
+        assert_eq!(args, ["-threads", "2"]);
+    }
+
+    #[test]
+    fn concat_list_quotes_paths() {
+        assert_eq!(concat_list_line(Path::new("/a/it's.mov")), "file '/a/it'\\''s.mov'\n");
+    }
+}
@@ -0,0 +1,373 @@
+// shm – Reader fuer den Shared-Memory-Transport der RAW-Bridges.
+//
+// Mit `--shm-socket FD` schreibt eine Bridge ihre Frames nicht auf stdout,
+// sondern in einen memfd-Ring (Layout siehe bridge-common/shm_ring.h). memfd
+// und zwei eventfds ("ready", "free") kommen per SCM_RIGHTS ueber ein
+// socketpair. Der Reader hier mappt den Ring, schreibt jeden Frame nach
+// FFmpeg stdin und gibt den Slot danach frei. Legt eine Seite ihr Socket-Ende
+// weg, merkt die andere das als Hang-up.
+
+use anyhow::{bail, Context, Result};
+use std::io::Write;
+use std::os::unix::io::{AsRawFd, FromRawFd, OwnedFd, RawFd};
+use std::sync::atomic::{AtomicU32, AtomicU64, Ordering};
+use tokio::process::Command;
+
+use crate::ipc::protocol::JobOptions;
+
+/// fd-Nummer, unter der die Bridge ihr Socket-Ende erbt.
+const BRIDGE_SOCKET_FD: RawFd = 3;
+
+const SHM_MAGIC: &[u8; 8] = b"BRSHM01\0";
+
+// Header-Offsets, siehe shm_ring.h
+const OFF_HEADER_BYTES: usize = 8;
+const OFF_SLOT_COUNT: usize = 12;
+const OFF_SLOT_STRIDE: usize = 16;
+const OFF_FRAME_BYTES: usize = 24;
+const OFF_PRODUCED: usize = 64;
+const OFF_CLOSED: usize = 72;
+const OFF_CONSUMED: usize = 128;
+const OFF_ORDER: usize = 192;
+
+/// Ob der Job den Shared-Memory-Transport statt der stdout-Pipe nutzt.
+pub fn wants_shm(options: &JobOptions) -> bool {
+    options.bridge_transport == "shm"
+}
+
+/// socketpair zwischen Backend und Bridge.
+pub struct ShmChannel {
+    ours: OwnedFd,
+    bridge: OwnedFd,
+}
+
+impl ShmChannel {
+    pub fn new() -> Result<Self> {
+        let mut fds = [0 as RawFd; 2];
+        let rc = unsafe {
+            libc::socketpair(
+                libc::AF_UNIX,
+                libc::SOCK_SEQPACKET | libc::SOCK_CLOEXEC,
+                0,
+                fds.as_mut_ptr(),
+            )
+        };
+        if rc != 0 {
+            return Err(std::io::Error::last_os_error()).context("socketpair fuer Shared-Memory-Transport");
+        }
+        Ok(Self {
+            ours: unsafe { OwnedFd::from_raw_fd(fds[0]) },
+            bridge: unsafe { OwnedFd::from_raw_fd(fds[1]) },
+        })
+    }
+
+    /// Richtet den Bridge-Prozess ein: Socket-Ende als fd 3 (nur im Kind,
+    /// damit parallel gestartete Prozesse es nicht erben), stdout bleibt leer.
+    pub fn attach(&self, cmd: &mut Command) {
+        let fd = self.bridge.as_raw_fd();
+        cmd.arg("--shm-socket")
+            .arg(BRIDGE_SOCKET_FD.to_string())
+            .stdout(std::process::Stdio::null());
+        unsafe {
+            cmd.pre_exec(move || {
+                // dup2 auf sich selbst laesst FD_CLOEXEC stehen
+                let rc = if fd == BRIDGE_SOCKET_FD {
+                    libc::fcntl(fd, libc::F_SETFD, 0)
+                } else {
+                    libc::dup2(fd, BRIDGE_SOCKET_FD)
+                };
+                if rc < 0 {
+                    return Err(std::io::Error::last_os_error());
+                }
+                Ok(())
+            });
+        }
+    }
+
+    /// Startet den Reader-Thread, der die Frames nach `sink` (FFmpeg stdin)
+    /// schreibt. Nach dem Spawn der Bridge aufrufen: das Bridge-Ende wird hier
+    /// im Backend geschlossen. Liefert die Anzahl geschriebener Frames.
+    pub fn spawn_reader(self, sink: OwnedFd) -> std::thread::JoinHandle<Result<u64>> {
+        let ShmChannel { ours, bridge } = self;
+        drop(bridge);
+        std::thread::spawn(move || read_frames(ours, sink))
+    }
+}
+
+/// Wartet auf den Reader-Thread, ohne den Runtime-Thread zu blockieren.
+pub async fn join_reader(reader: Option<std::thread::JoinHandle<Result<u64>>>) -> Result<()> {
+    let Some(handle) = reader else {
+        return Ok(());
+    };
+    match tokio::task::spawn_blocking(move || handle.join()).await {
+        Ok(Ok(result)) => result.map(|_| ()),
+        _ => bail!("Shared-Memory-Reader abgebrochen"),
+    }
+}
+
+/// Gemappter Ring einer Bridge.
+struct ShmMap {
+    base: *mut u8,
+    len: usize,
+}
+
+impl ShmMap {
+    fn new(memfd: &OwnedFd) -> Result<Self> {
+        let mut st: libc::stat = unsafe { std::mem::zeroed() };
+        if unsafe { libc::fstat(memfd.as_raw_fd(), &mut st) } != 0 {
+            return Err(std::io::Error::last_os_error()).context("fstat auf memfd");
+        }
+        let len = st.st_size as usize;
+        if len < OFF_ORDER {
+            bail!("Shared-Memory-Ring zu klein ({len} Bytes)");
+        }
+        let base = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED,
+                memfd.as_raw_fd(),
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            return Err(std::io::Error::last_os_error()).context("mmap des Shared-Memory-Rings");
+        }
+        let map = Self { base: base as *mut u8, len };
+        if map.bytes(0, 8) != SHM_MAGIC {
+            bail!("Shared-Memory-Ring hat unbekanntes Format");
+        }
+        Ok(map)
+    }
+
+    fn bytes(&self, offset: usize, len: usize) -> &[u8] {
+        assert!(offset + len <= self.len);
+        unsafe { std::slice::from_raw_parts(self.base.add(offset), len) }
+    }
+
+    fn u32_at(&self, offset: usize) -> u32 {
+        u32::from_le_bytes(self.bytes(offset, 4).try_into().unwrap())
+    }
+
+    fn u64_at(&self, offset: usize) -> u64 {
+        u64::from_le_bytes(self.bytes(offset, 8).try_into().unwrap())
+    }
+
+    fn atomic_u64(&self, offset: usize) -> &AtomicU64 {
+        unsafe { &*(self.base.add(offset) as *const AtomicU64) }
+    }
+
+    fn atomic_u32(&self, offset: usize) -> &AtomicU32 {
+        unsafe { &*(self.base.add(offset) as *const AtomicU32) }
+    }
+}
+
+impl Drop for ShmMap {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(self.base as *mut libc::c_void, self.len);
+        }
+    }
+}
+
+/// Empfaengt memfd, ready- und free-eventfd. None, wenn die Bridge vorher
+/// beendet wurde (Fehler meldet sie selbst auf stderr).
+fn recv_fds(sock: &OwnedFd) -> Result<Option<[OwnedFd; 3]>> {
+    let mut payload = [0u8; 8];
+    let mut iov = libc::iovec {
+        iov_base: payload.as_mut_ptr() as *mut libc::c_void,
+        iov_len: payload.len(),
+    };
+    let space = unsafe { libc::CMSG_SPACE((3 * std::mem::size_of::<RawFd>()) as u32) } as usize;
+    let mut control = vec![0u64; space.div_ceil(8)];
+    let mut msg: libc::msghdr = unsafe { std::mem::zeroed() };
+    msg.msg_iov = &mut iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.as_mut_ptr() as *mut libc::c_void;
+    msg.msg_controllen = space as _;
+
+    let n = loop {
+        let n = unsafe { libc::recvmsg(sock.as_raw_fd(), &mut msg, libc::MSG_CMSG_CLOEXEC) };
+        if n < 0 && std::io::Error::last_os_error().kind() == std::io::ErrorKind::Interrupted {
+            continue;
+        }
+        break n;
+    };
+    if n < 0 {
+        return Err(std::io::Error::last_os_error()).context("recvmsg vom Bridge-Socket");
+    }
+    if n == 0 {
+        return Ok(None);
+    }
+
+    let cmsg = unsafe { libc::CMSG_FIRSTHDR(&msg) };
+    if cmsg.is_null() || unsafe { (*cmsg).cmsg_type } != libc::SCM_RIGHTS {
+        bail!("Bridge hat keine fds geschickt");
+    }
+    let mut fds = [0 as RawFd; 3];
+    unsafe {
+        std::ptr::copy_nonoverlapping(libc::CMSG_DATA(cmsg) as *const RawFd, fds.as_mut_ptr(), 3);
+    }
+    Ok(Some(fds.map(|fd| unsafe { OwnedFd::from_raw_fd(fd) })))
+}
+
+/// Blockiert, bis "ready" signalisiert ist oder die Bridge auflegt.
+/// false = Bridge weg.
+fn wait_ready(ready: &OwnedFd, sock: &OwnedFd) -> bool {
+    let mut pfds = [
+        libc::pollfd { fd: ready.as_raw_fd(), events: libc::POLLIN, revents: 0 },
+        libc::pollfd { fd: sock.as_raw_fd(), events: 0, revents: 0 },
+    ];
+    loop {
+        let rc = unsafe { libc::poll(pfds.as_mut_ptr(), 2, -1) };
+        if rc < 0 && std::io::Error::last_os_error().kind() == std::io::ErrorKind::Interrupted {
+            continue;
+        }
+        break;
+    }
+    if pfds[0].revents & libc::POLLIN != 0 {
+        let mut count = 0u64;
+        unsafe {
+            libc::read(ready.as_raw_fd(), &mut count as *mut u64 as *mut libc::c_void, 8);
+        }
+        return true;
+    }
+    pfds[1].revents & (libc::POLLHUP | libc::POLLERR) == 0
+}
+
+fn signal(fd: &OwnedFd) {
+    let one = 1u64;
+    unsafe {
+        libc::write(fd.as_raw_fd(), &one as *const u64 as *const libc::c_void, 8);
+    }
+}
+
+fn read_frames(sock: OwnedFd, sink: OwnedFd) -> Result<u64> {
+    let Some([memfd, ready, free]) = recv_fds(&sock)? else {
+        return Ok(0);
+    };
+    let ring = ShmMap::new(&memfd)?;
+    let header_bytes = ring.u32_at(OFF_HEADER_BYTES) as usize;
+    let slot_count = ring.u32_at(OFF_SLOT_COUNT) as u64;
+    let slot_stride = ring.u64_at(OFF_SLOT_STRIDE) as usize;
+    let frame_bytes = ring.u64_at(OFF_FRAME_BYTES) as usize;
+    if slot_count == 0 || header_bytes + slot_stride * slot_count as usize > ring.len {
+        bail!("Shared-Memory-Ring passt nicht zu seinem Header");
+    }
+
+    let produced = ring.atomic_u64(OFF_PRODUCED);
+    let closed = ring.atomic_u32(OFF_CLOSED);
+    let consumed = ring.atomic_u64(OFF_CONSUMED);
+    let mut out = std::fs::File::from(sink);
+    let mut next = 0u64;
+
+    loop {
+        if next < produced.load(Ordering::Acquire) {
+            let slot = ring.u32_at(OFF_ORDER + 4 * (next % slot_count) as usize) as usize;
+            let frame = ring.bytes(header_bytes + slot * slot_stride, frame_bytes);
+            out.write_all(frame).context("Schreiben nach FFmpeg stdin")?;
+            next += 1;
+            consumed.store(next, Ordering::Release);
+            signal(&free);
+            continue;
+        }
+        if closed.load(Ordering::Acquire) != 0 && next == produced.load(Ordering::Acquire) {
+            return Ok(next);
+        }
+        if !wait_ready(&ready, &sock) && next == produced.load(Ordering::Acquire) {
+            // Bridge ohne Abschluss beendet; ihr Exit-Code meldet den Fehler
+            return Ok(next);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Read;
+
+    /// Spielt die Bridge-Seite nach: Ring anlegen, fds schicken, Frames in
+    /// vertauschter Slot-Reihenfolge veroeffentlichen, abschliessen.
+    #[test]
+    fn reader_follows_slot_order() {
+        let channel = ShmChannel::new().unwrap();
+        let bridge_sock = unsafe { libc::dup(channel.bridge.as_raw_fd()) };
+
+        let (slot_count, stride, frame_bytes) = (2usize, 4096usize, 6usize);
+        let header_bytes = 4096usize;
+        let memfd = unsafe { libc::memfd_create(c"test-ring".as_ptr(), libc::MFD_CLOEXEC) };
+        assert!(memfd >= 0);
+        let total = header_bytes + slot_count * stride;
+        assert_eq!(unsafe { libc::ftruncate(memfd, total as libc::off_t) }, 0);
+        let ready = unsafe { libc::eventfd(0, libc::EFD_CLOEXEC) };
+        let free = unsafe { libc::eventfd(0, libc::EFD_CLOEXEC) };
+
+        let map = ShmMap {
+            base: unsafe {
+                libc::mmap(std::ptr::null_mut(), total, libc::PROT_READ | libc::PROT_WRITE,
+                           libc::MAP_SHARED, memfd, 0)
+            } as *mut u8,
+            len: total,
+        };
+        let put = |offset: usize, bytes: &[u8]| unsafe {
+            std::ptr::copy_nonoverlapping(bytes.as_ptr(), map.base.add(offset), bytes.len());
+        };
+        put(0, SHM_MAGIC);
+        put(OFF_HEADER_BYTES, &(header_bytes as u32).to_le_bytes());
+        put(OFF_SLOT_COUNT, &(slot_count as u32).to_le_bytes());
+        put(OFF_SLOT_STRIDE, &(stride as u64).to_le_bytes());
+        put(OFF_FRAME_BYTES, &(frame_bytes as u64).to_le_bytes());
+
+        // Frame 0 in Slot 1, Frame 1 in Slot 0
+        put(header_bytes + stride, b"frame0");
+        put(header_bytes, b"frame1");
+        put(OFF_ORDER, &1u32.to_le_bytes());
+        put(OFF_ORDER + 4, &0u32.to_le_bytes());
+        map.atomic_u64(OFF_PRODUCED).store(2, Ordering::Release);
+        map.atomic_u32(OFF_CLOSED).store(1, Ordering::Release);
+
+        // fds wie die Bridge per SCM_RIGHTS schicken
+        let fds = [memfd, ready, free];
+        let mut payload = *SHM_MAGIC;
+        let mut iov = libc::iovec {
+            iov_base: payload.as_mut_ptr() as *mut libc::c_void,
+            iov_len: payload.len(),
+        };
+        let space = unsafe { libc::CMSG_SPACE(std::mem::size_of_val(&fds) as u32) } as usize;
+        let mut control = vec![0u64; space.div_ceil(8)];
+        let mut msg: libc::msghdr = unsafe { std::mem::zeroed() };
+        msg.msg_iov = &mut iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.as_mut_ptr() as *mut libc::c_void;
+        msg.msg_controllen = space as _;
+        unsafe {
+            let cmsg = libc::CMSG_FIRSTHDR(&msg);
+            (*cmsg).cmsg_level = libc::SOL_SOCKET;
+            (*cmsg).cmsg_type = libc::SCM_RIGHTS;
+            (*cmsg).cmsg_len = libc::CMSG_LEN(std::mem::size_of_val(&fds) as u32) as _;
+            std::ptr::copy_nonoverlapping(fds.as_ptr(), libc::CMSG_DATA(cmsg) as *mut RawFd, 3);
+            assert!(libc::sendmsg(bridge_sock, &msg, 0) > 0);
+        }
+
+        let mut pipe = [0 as RawFd; 2];
+        assert_eq!(unsafe { libc::pipe(pipe.as_mut_ptr()) }, 0);
+        let (mut read_end, write_end) =
+            unsafe { (std::fs::File::from_raw_fd(pipe[0]), OwnedFd::from_raw_fd(pipe[1])) };
+
+        let frames = channel.spawn_reader(write_end).join().unwrap().unwrap();
+        assert_eq!(frames, 2);
+        assert_eq!(map.atomic_u64(OFF_CONSUMED).load(Ordering::Acquire), 2);
+
+        let mut written = String::new();
+        read_end.read_to_string(&mut written).unwrap();
+        assert_eq!(written, "frame0frame1");
+
+        unsafe {
+            libc::close(bridge_sock);
+            for fd in fds {
+                libc::close(fd);
+            }
+        }
+    }
+}
@@ -75,14 +75,49 @@ pub struct JobOptions {
     #[serde(default)]
     pub skip_if_exists: bool,
 
-    /// Debayer-Qualitaet fuer BRAW: "full" | "half" | "quarter"
+    /// Debayer-Qualitaet fuer BRAW: "full" | "half" | "quarter" | "eighth"
     #[serde(default = "default_debayer_quality")]
     pub debayer_quality: String,
 
-    /// Debayer-Qualitaet fuer R3D: "premium" | "half" | "quarter" | "eighth"
+    /// Debayer-Qualitaet fuer R3D: "premium" | "half" | "quarter" | "eighth" | "sixteenth"
     #[serde(default = "default_r3d_debayer_quality")]
     pub r3d_debayer_quality: String,
 
+    /// Pixel-Format der RAW-Bridges (`--pix-fmt`): "rgb24" | "bgr24" | "bgra" |
+    /// "rgb48le" | "gbrp16le" | "dpx10" | "yuv420p" | "nv12" | "yuv422p10le" |
+    /// "p010le". Leer = automatisch je Codec (YUV im Encoder-Format).
+    #[serde(default)]
+    pub bridge_pix_fmt: String,
+
+    /// YUV-Range der RAW-Bridges (`--yuv-range`): "limited" | "full"
+    #[serde(default = "default_bridge_yuv_range")]
+    pub bridge_yuv_range: String,
+
+    /// Transport der Bridge-Frames zu FFmpeg: "" / "pipe" = stdout-Pipe,
+    /// "shm" = memfd-Ring mit Reader im Backend (siehe ffmpeg::shm).
+    #[serde(default)]
+    pub bridge_transport: String,
+
+    /// Format der Bridge-Ausgabe auf stdout: "nut" = NUT-Stream mit Frames
+    /// und Clip-Audio (`--mux nut`, FFmpeg liest nur pipe:0), "raw" =
+    /// nackte Frames plus vorher extrahierte WAV. Pixel-Formate ohne
+    /// NUT-Fourcc (dpx10, p010le) und der Shared-Memory-Transport bleiben raw.
+    #[serde(default = "default_bridge_mux")]
+    pub bridge_mux: String,
+
+    /// Wenn true: die RAW-Bridge encodiert und muxt den Proxy selbst
+    /// (`--encode`, Bridge mit -DBRIDGE_LIBAV=ON gebaut), ohne FFmpeg-Prozess.
+    /// Gilt nur fuer Software-Codecs, siehe ffmpeg::bridge_encode.
+    #[serde(default)]
+    pub bridge_encode: bool,
+
+    /// BRAW/R3D: einen langen Clip in so viele Segmente teilen, parallel
+    /// encodieren und verlustfrei zusammenfuegen (siehe ffmpeg::segments).
+    /// 0/1 = am Stueck; kurze Clips bleiben es immer. Hoechstens ein
+    /// Segment pro CPU-Thread des Jobs.
+    #[serde(default)]
+    pub segments: u32,
+
     /// Relativer Unterordner-Pfad zum Spiegeln der Quellstruktur.
     /// Wird vom Frontend berechnet, z.B. "Day1" oder "Kamera/A". Leer = kein Spiegeln.
     #[serde(default)]
@@ -105,12 +140,26 @@ impl Default for JobOptions {
             skip_if_exists: false,
             debayer_quality: default_debayer_quality(),
             r3d_debayer_quality: default_r3d_debayer_quality(),
+            bridge_pix_fmt: String::new(),
+            bridge_yuv_range: default_bridge_yuv_range(),
+            bridge_transport: String::new(),
+            bridge_mux: default_bridge_mux(),
+            bridge_encode: false,
+            segments: 0,
             mirror_subpath: String::new(),
             adjacent: false,
         }
     }
 }
 
+fn default_bridge_yuv_range() -> String {
+    "limited".to_string()
+}
+
+fn default_bridge_mux() -> String {
+    "nut".to_string()
+}
+
 fn default_audio_codec() -> String {
     "pcm_s24le".to_string()
 }
@@ -13,6 +13,7 @@ use tokio_util::sync::CancellationToken;
 use crate::braw::runner as braw_runner;
 use crate::r3d::runner as r3d_runner;
 use crate::ffmpeg::runner::{self, build_ffmpeg_args, FfmpegEvent};
+use crate::ffmpeg::segments::{self, FrameRange};
 #[allow(unused_imports)]
 use libc;
 use crate::ipc::protocol::{JobMode, JobOptions, JobState, JobStatus, Response};
@@ -194,12 +195,52 @@ pub async fn run_queue(
     let running = Arc::new(AtomicUsize::new(0));
     let slot_free = Arc::new(Notify::new());
     let is_paused = Arc::new(AtomicBool::new(false));
-    // job_id → PID des laufenden FFmpeg-Prozesses (0 = noch nicht gestartet)
-    let ffmpeg_pids: Arc<RwLock<HashMap<String, Arc<AtomicU32>>>> =
+    // job_id → PID des laufenden FFmpeg-Prozesses (0 = noch nicht gestartet),
+    // bei Segment-Encodes einer je Segment
+    let ffmpeg_pids: Arc<RwLock<HashMap<String, Vec<Arc<AtomicU32>>>>> =
         Arc::new(RwLock::new(HashMap::new()));
     let jobs: Arc<RwLock<HashMap<String, Job>>> = Arc::new(RwLock::new(HashMap::new()));
+    let state = QueueState {
+        limit: limit.clone(),
+        running,
+        slot_free: slot_free.clone(),
+        is_paused: is_paused.clone(),
+        ffmpeg_pids: ffmpeg_pids.clone(),
+        jobs: jobs.clone(),
+        response_tx: response_tx.clone(),
+        shutdown_token,
+    };
 
-    while let Some(cmd) = cmd_rx.recv().await {
+    // Probe-Batcher je Bridge; ein Job wartet dort schon als Queued in `jobs`
+    let (probed_tx, mut probed_rx) = mpsc::unbounded_channel::<ProbedJob>();
+    let (braw_probe_tx, braw_probe_rx) = mpsc::unbounded_channel::<Job>();
+    let (r3d_probe_tx, r3d_probe_rx) = mpsc::unbounded_channel::<Job>();
+    tokio::spawn(run_probe_batcher(JobMode::BrawProxy, braw_probe_rx, probed_tx.clone()));
+    tokio::spawn(run_probe_batcher(JobMode::R3dProxy, r3d_probe_rx, probed_tx));
+
+    loop {
+        let cmd = tokio::select! {
+            cmd = cmd_rx.recv() => match cmd {
+                Some(cmd) => cmd,
+                None => break,
+            },
+            Some(ProbedJob { job, info }) = probed_rx.recv() => {
+                // Waehrend des Probes gecancelt: wird nicht mehr gestartet
+                if job.cancel_token.is_cancelled() {
+                    jobs.write().await.remove(&job.id);
+                    let _ = response_tx.send(Response::JobCancelled { id: job.id }).await;
+                } else {
+                    match info {
+                        Ok(info) => state.enqueue(job, info).await,
+                        Err(message) => {
+                            jobs.write().await.remove(&job.id);
+                            let _ = response_tx.send(Response::JobError { id: job.id, message }).await;
+                        }
+                    }
+                }
+                continue;
+            }
+        };
         match cmd {
             JobCommand::Add(mut job) => {
                 let job_id = job.id.clone();
@@ -250,106 +291,9 @@ pub async fn run_queue(
                 };
                 job.output_dir = output_dir;
 
-                // --- Probing: BRAW / R3D vs. normale Dateien ---
-                let is_braw = matches!(job.mode, JobMode::BrawProxy);
-                let is_r3d  = matches!(job.mode, JobMode::R3dProxy);
-                let input_path_clone = job.input_path.clone();
-
-                // BRAW/R3D: Metadaten via Bridge, sonst ffprobe
-                let braw_meta: Option<braw_runner::BrawMetadata>;
-                let r3d_meta:  Option<r3d_runner::R3dMetadata>;
-                let total_duration_us: i64;
-                let nvenc_full_gpu: bool;
-                let decodable_audio: Vec<usize>;
-
-                if is_braw {
-                    match braw_runner::probe_braw_metadata(&input_path_clone).await {
-                        Ok(meta) => {
-                            total_duration_us = if meta.fps_num > 0 {
-                                (meta.frame_count as i64) * (meta.fps_den as i64) * 1_000_000
-                                    / (meta.fps_num as i64)
-                            } else {
-                                0
-                            };
-                            nvenc_full_gpu = false;
-                            decodable_audio = Vec::new();
-                            braw_meta = Some(meta);
-                            r3d_meta  = None;
-                        }
-                        Err(e) => {
-                            let _ = response_tx
-                                .send(Response::JobError {
-                                    id: job_id.clone(),
-                                    message: format!(
-                                        "BRAW-Metadaten konnten nicht gelesen werden: {e}"
-                                    ),
-                                })
-                                .await;
-                            continue;
-                        }
-                    }
-                } else if is_r3d {
-                    match r3d_runner::probe_r3d_metadata(&input_path_clone).await {
-                        Ok(meta) => {
-                            total_duration_us = if meta.fps_num > 0 {
-                                (meta.frame_count as i64) * (meta.fps_den as i64) * 1_000_000
-                                    / (meta.fps_num as i64)
-                            } else {
-                                0
-                            };
-                            nvenc_full_gpu = false;
-                            decodable_audio = Vec::new();
-                            r3d_meta  = Some(meta);
-                            braw_meta = None;
-                        }
-                        Err(e) => {
-                            let _ = response_tx
-                                .send(Response::JobError {
-                                    id: job_id.clone(),
-                                    message: format!(
-                                        "R3D-Metadaten konnten nicht gelesen werden: {e}"
-                                    ),
-                                })
-                                .await;
-                            continue;
-                        }
-                    }
-                } else {
-                    braw_meta = None;
-                    r3d_meta  = None;
-                    // Dauer, Pixel-Format und dekodierbare Audio-Streams ermitteln (parallel via ffprobe).
-                    let needs_pix_fmt = matches!(job.mode, JobMode::Proxy)
-                        && job.options.hw_accel == "nvenc";
-                    let (duration_result, pix_fmt, audio_probe) = tokio::join!(
-                        probe_duration(&input_path_clone),
-                        async {
-                            if needs_pix_fmt {
-                                probe_pix_fmt(&input_path_clone).await
-                            } else {
-                                String::new()
-                            }
-                        },
-                        probe_audio_streams(&input_path_clone),
-                    );
-                    decodable_audio = audio_probe;
-                    total_duration_us = match duration_result {
-                        Ok(d) if d > 0 => d,
-                        Ok(_) | Err(_) => {
-                            let _ = response_tx
-                                .send(Response::JobError {
-                                    id: job_id.clone(),
-                                    message: "Quelldatei konnte nicht gelesen werden (ffprobe fehlgeschlagen)".to_string(),
-                                })
-                                .await;
-                            continue;
-                        }
-                    };
-                    nvenc_full_gpu = nvenc_full_gpu_supported(&pix_fmt);
-                }
-
-                // Ausgabedatei bereits vorhanden und Skip aktiviert?
-                let output_path = job.output_path();
-                if job.options.skip_if_exists && output_path.exists() {
+                // Ausgabedatei bereits vorhanden und Skip aktiviert? Vor dem
+                // Probe pruefen, damit dafuer kein Probe anfaellt
+                if job.options.skip_if_exists && job.output_path().exists() {
                     let _ = response_tx
                         .send(Response::JobQueued { id: job_id.clone() })
                         .await;
@@ -359,243 +303,57 @@ pub async fn run_queue(
                     continue;
                 }
 
-                // Job an globales Shutdown-Token haengen
-                job.attach_to_parent_token(&shutdown_token);
-                let cancel_token = job.cancel_token.clone();
-
-                // FFmpeg-Args nur fuer normale (nicht-Bridge) Jobs aufbauen
-                let args = if is_braw || is_r3d {
-                    Vec::new() // wird nicht benutzt
-                } else {
-                    build_ffmpeg_args(
-                        &job.input_path,
-                        &output_path,
-                        &job.mode,
-                        &job.options,
-                        nvenc_full_gpu,
-                        &decodable_audio,
-                    )
-                };
-
-                let job_input_path = job.input_path.clone();
-                let job_options = job.options.clone();
-
-                job.status = JobState::Queued;
-                {
-                    let mut map = jobs.write().await;
-                    map.insert(job_id.clone(), job);
+                // --- Probing: BRAW / R3D vs. normale Dateien ---
+                // BRAW/R3D: Metadaten kommen gesammelt vom Probe-Batcher
+                // (ein Bridge-Lauf fuer alle wartenden Clips), die Schleife
+                // nimmt derweil weitere Kommandos an. Der Job steht solange
+                // schon als Queued in `jobs`, fuer GetStatus und Cancel.
+                match job.mode {
+                    JobMode::BrawProxy | JobMode::R3dProxy => {
+                        let batcher = if job.mode == JobMode::BrawProxy { &braw_probe_tx } else { &r3d_probe_tx };
+                        job.status = JobState::Queued;
+                        jobs.write().await.insert(job_id, job.clone());
+                        let _ = batcher.send(job);
+                        continue;
+                    }
+                    JobMode::ReWrap | JobMode::Proxy => {}
                 }
 
-                // JobQueued senden
-                let _ = response_tx
-                    .send(Response::JobQueued { id: job_id.clone() })
-                    .await;
-
-                let limit_ref = limit.clone();
-                let running_ref = running.clone();
-                let slot_free_ref = slot_free.clone();
-                let is_paused_ref = is_paused.clone();
-                let pid_slot = Arc::new(AtomicU32::new(0));
-                {
-                    ffmpeg_pids.write().await.insert(job_id.clone(), pid_slot.clone());
-                }
-                let ffmpeg_pids_ref = ffmpeg_pids.clone();
-                let resp_tx = response_tx.clone();
-                let jobs_ref = jobs.clone();
-                let job_id_for_monitor = job_id.clone();
-
-                let handle = tokio::spawn(async move {
-                    // Warten bis ein Slot frei ist UND nicht pausiert – oder Job wird gecancelt
-                    loop {
-                        if is_paused_ref.load(Ordering::Acquire) {
-                            tokio::select! {
-                                _ = slot_free_ref.notified() => continue,
-                                _ = cancel_token.cancelled() => {
-                                    ffmpeg_pids_ref.write().await.remove(&job_id);
-                                    jobs_ref.write().await.remove(&job_id);
-                                    let _ = resp_tx.send(Response::JobCancelled { id: job_id.clone() }).await;
-                                    return;
-                                }
-                            }
-                        }
-                        let cur = running_ref.load(Ordering::Acquire);
-                        let lim = limit_ref.load(Ordering::Acquire);
-                        if cur < lim {
-                            if running_ref
-                                .compare_exchange(cur, cur + 1, Ordering::AcqRel, Ordering::Acquire)
-                                .is_ok()
-                            {
-                                break;
-                            }
+                // Dauer, Pixel-Format und dekodierbare Audio-Streams ermitteln (parallel via ffprobe).
+                let input_path_clone = job.input_path.clone();
+                let needs_pix_fmt = matches!(job.mode, JobMode::Proxy)
+                    && job.options.hw_accel == "nvenc";
+                let (duration_result, pix_fmt, audio_probe) = tokio::join!(
+                    probe_duration(&input_path_clone),
+                    async {
+                        if needs_pix_fmt {
+                            probe_pix_fmt(&input_path_clone).await
                         } else {
-                            tokio::select! {
-                                _ = slot_free_ref.notified() => {}
-                                _ = cancel_token.cancelled() => {
-                                    ffmpeg_pids_ref.write().await.remove(&job_id);
-                                    jobs_ref.write().await.remove(&job_id);
-                                    let _ = resp_tx.send(Response::JobCancelled { id: job_id.clone() }).await;
-                                    return;
-                                }
-                            }
-                        }
-                    }
-
-                    // Status auf Running setzen
-                    {
-                        let mut map = jobs_ref.write().await;
-                        if let Some(j) = map.get_mut(&job_id) {
-                            j.status = JobState::Running;
-                        }
-                    }
-
-                    // Event-Channel fuer diesen Job-Lauf
-                    let (event_tx, mut event_rx) = mpsc::channel::<FfmpegEvent>(64);
-
-                    // Job in eigenem Task starten (BRAW, R3D oder FFmpeg)
-                    let task_id = job_id.clone();
-                    let task_handle = if is_braw {
-                        let meta = braw_meta.unwrap(); // sicher: is_braw → braw_meta = Some
-                        tokio::spawn(async move {
-                            braw_runner::run_braw_job(
-                                task_id,
-                                job_input_path,
-                                output_path,
-                                &job_options,
-                                meta,
-                                event_tx,
-                                cancel_token,
-                                pid_slot,
-                            )
-                            .await
-                        })
-                    } else if is_r3d {
-                        let meta = r3d_meta.unwrap(); // sicher: is_r3d → r3d_meta = Some
-                        tokio::spawn(async move {
-                            r3d_runner::run_r3d_job(
-                                task_id,
-                                job_input_path,
-                                output_path,
-                                &job_options,
-                                meta,
-                                event_tx,
-                                cancel_token,
-                                pid_slot,
-                            )
-                            .await
-                        })
-                    } else {
-                        tokio::spawn(async move {
-                            runner::run_ffmpeg(
-                                task_id,
-                                args,
-                                &output_path,
-                                total_duration_us,
-                                event_tx,
-                                cancel_token,
-                                pid_slot,
-                            )
-                            .await
-                        })
-                    };
-
-                    // Events weiterleiten an IPC
-                    while let Some(event) = event_rx.recv().await {
-                        match event {
-                            FfmpegEvent::Progress {
-                                id,
-                                percent,
-                                fps,
-                                speed,
-                                frame,
-                            } => {
-                                {
-                                    let mut map = jobs_ref.write().await;
-                                    if let Some(j) = map.get_mut(&id) {
-                                        j.percent = percent;
-                                    }
-                                }
-                                let _ = resp_tx
-                                    .send(Response::JobProgress {
-                                        id,
-                                        percent,
-                                        fps,
-                                        speed,
-                                        frame,
-                                    })
-                                    .await;
-                            }
-                            FfmpegEvent::Done { id } => {
-                                {
-                                    let mut map = jobs_ref.write().await;
-                                    if let Some(j) = map.get_mut(&id) {
-                                        j.status = JobState::Done;
-                                        j.percent = 100.0;
-                                    }
-                                }
-                                let _ = resp_tx.send(Response::JobDone { id }).await;
-                            }
-                            FfmpegEvent::Error { id, message } => {
-                                {
-                                    let mut map = jobs_ref.write().await;
-                                    if let Some(j) = map.get_mut(&id) {
-                                        j.status = JobState::Error;
-                                    }
-                                }
-                                let _ = resp_tx
-                                    .send(Response::JobError { id, message })
-                                    .await;
-                            }
-                            FfmpegEvent::Cancelled { id } => {
-                                {
-                                    let mut map = jobs_ref.write().await;
-                                    if let Some(j) = map.get_mut(&id) {
-                                        j.status = JobState::Cancelled;
-                                    }
-                                }
-                                let _ = resp_tx
-                                    .send(Response::JobCancelled { id })
-                                    .await;
-                            }
-                        }
-                    }
-
-                    let task_label = if is_braw { "braw-bridge" } else if is_r3d { "r3d-bridge" } else { "FFmpeg" };
-                    match task_handle.await {
-                        Ok(Ok(())) => {}  // Normale Beendigung: terminales Event wurde bereits gesendet
-                        Ok(Err(e)) => {
-                            let _ = resp_tx.send(Response::JobError {
-                                id: job_id.clone(),
-                                message: format!("{task_label} konnte nicht ausgefuehrt werden: {e}"),
-                            }).await;
+                            String::new()
                         }
-                        Err(e) => {
-                            let _ = resp_tx.send(Response::JobError {
+                    },
+                    probe_audio_streams(&input_path_clone),
+                );
+                let total_duration_us = match duration_result {
+                    Ok(d) if d > 0 => d,
+                    Ok(_) | Err(_) => {
+                        let _ = response_tx
+                            .send(Response::JobError {
                                 id: job_id.clone(),
-                                message: format!("{task_label}-Task Panik: {e}"),
-                            }).await;
-                        }
-                    }
-
-                    // Slot freigeben und wartende Jobs benachrichtigen
-                    running_ref.fetch_sub(1, Ordering::AcqRel);
-                    slot_free_ref.notify_waiters();
-
-                    // PID-Eintrag und Job aus HashMaps entfernen
-                    ffmpeg_pids_ref.write().await.remove(&job_id);
-                    jobs_ref.write().await.remove(&job_id);
-                });
-
-                // Monitor: wenn der Job-Task panikt → JobError an Python senden
-                let monitor_tx = response_tx.clone();
-                let monitor_id = job_id_for_monitor;
-                tokio::spawn(async move {
-                    if let Err(e) = handle.await {
-                        let _ = monitor_tx.send(Response::JobError {
-                            id: monitor_id,
-                            message: format!("Job-Task-Panik: {e}"),
-                        }).await;
+                                message: "Quelldatei konnte nicht gelesen werden (ffprobe fehlgeschlagen)".to_string(),
+                            })
+                            .await;
+                        continue;
                     }
-                });
+                };
+                let info = SourceInfo {
+                    braw_meta: None,
+                    r3d_meta: None,
+                    total_duration_us,
+                    nvenc_full_gpu: nvenc_full_gpu_supported(&pix_fmt),
+                    decodable_audio: audio_probe,
+                };
+                state.enqueue(job, info).await;
             }
             JobCommand::SetMaxParallel(n) => {
                 limit.store(n.max(1), Ordering::Release);
@@ -604,7 +362,7 @@ pub async fn run_queue(
             JobCommand::PauseAll => {
                 is_paused.store(true, Ordering::Release);
                 let pids = ffmpeg_pids.read().await;
-                for pid_slot in pids.values() {
+                for pid_slot in pids.values().flatten() {
                     let pid = pid_slot.load(Ordering::Acquire);
                     if pid != 0 {
                         unsafe { libc::kill(pid as libc::pid_t, libc::SIGSTOP); }
@@ -614,7 +372,7 @@ pub async fn run_queue(
             JobCommand::ResumeAll => {
                 is_paused.store(false, Ordering::Release);
                 let pids = ffmpeg_pids.read().await;
-                for pid_slot in pids.values() {
+                for pid_slot in pids.values().flatten() {
                     let pid = pid_slot.load(Ordering::Acquire);
                     if pid != 0 {
                         unsafe { libc::kill(pid as libc::pid_t, libc::SIGCONT); }
@@ -629,13 +387,15 @@ pub async fn run_queue(
                 // child.wait() blockiert endlos.
                 {
                     let pids = ffmpeg_pids.read().await;
-                    if let Some(pid_slot) = pids.get(&id) {
+                    for pid_slot in pids.get(&id).into_iter().flatten() {
                         let pid = pid_slot.load(Ordering::Acquire);
                         if pid != 0 {
                             unsafe { libc::kill(pid as libc::pid_t, libc::SIGCONT); }
                         }
                     }
                 }
+                // Auch ein Job, der noch im Probe wartet: er wird danach
+                // nicht mehr gestartet
                 let map = jobs.read().await;
                 if let Some(job) = map.get(&id) {
                     job.cancel_token.cancel();
@@ -654,6 +414,434 @@ pub async fn run_queue(
     }
 }
 
+/// Was die Quell-Analyse (Bridge-Probe bzw. ffprobe) ueber einen Job liefert.
+struct SourceInfo {
+    braw_meta: Option<braw_runner::BrawMetadata>,
+    r3d_meta: Option<r3d_runner::R3dMetadata>,
+    total_duration_us: i64,
+    nvenc_full_gpu: bool,
+    decodable_audio: Vec<usize>,
+}
+
+impl SourceInfo {
+    /// Fuer einen Bridge-Job; die Dauer folgt aus Frame-Anzahl und Framerate.
+    fn from_bridge(
+        frame_count: u64,
+        fps_num: u32,
+        fps_den: u32,
+        braw_meta: Option<braw_runner::BrawMetadata>,
+        r3d_meta: Option<r3d_runner::R3dMetadata>,
+    ) -> Self {
+        let total_duration_us = if fps_num > 0 {
+            (frame_count as i64) * (fps_den as i64) * 1_000_000 / (fps_num as i64)
+        } else {
+            0
+        };
+        Self {
+            braw_meta,
+            r3d_meta,
+            total_duration_us,
+            nvenc_full_gpu: false,
+            decodable_audio: Vec::new(),
+        }
+    }
+}
+
+/// BRAW/R3D-Job, fuer den der Probe-Batcher fertig ist (Err: Meldung fuer JobError).
+struct ProbedJob {
+    job: Job,
+    info: Result<SourceInfo, String>,
+}
+
+/// Sammelt die Jobs einer Bridge, deren Metadaten noch fehlen, und probt
+/// alle wartenden mit einem Bridge-Lauf (siehe ffmpeg::bridge_probe): der
+/// erste Clip einer Karte sofort, alle waehrenddessen eingegangenen im
+/// naechsten Lauf. Jeder Job geht ueber `probed_tx` zurueck, sobald sein
+/// Clip gemeldet ist.
+async fn run_probe_batcher(
+    mode: JobMode,
+    mut rx: mpsc::UnboundedReceiver<Job>,
+    probed_tx: mpsc::UnboundedSender<ProbedJob>,
+) {
+    while let Some(first) = rx.recv().await {
+        let mut batch = vec![Some(first)];
+        while let Ok(job) = rx.try_recv() {
+            batch.push(Some(job));
+        }
+        let inputs: Vec<PathBuf> = batch
+            .iter()
+            .map(|job| job.as_ref().unwrap().input_path.clone())
+            .collect();
+
+        let mut deliver = |i: usize, info: Result<SourceInfo, String>| {
+            if let Some(job) = batch[i].take() {
+                let _ = probed_tx.send(ProbedJob { job, info });
+            }
+        };
+        if mode == JobMode::BrawProxy {
+            braw_runner::probe_braw_clips(&inputs, |i, meta| {
+                deliver(
+                    i,
+                    meta.map(|m| SourceInfo::from_bridge(m.frame_count, m.fps_num, m.fps_den, Some(m), None))
+                        .map_err(|e| format!("BRAW-Metadaten konnten nicht gelesen werden: {e}")),
+                )
+            })
+            .await;
+        } else {
+            r3d_runner::probe_r3d_clips(&inputs, |i, meta| {
+                deliver(
+                    i,
+                    meta.map(|m| SourceInfo::from_bridge(m.frame_count, m.fps_num, m.fps_den, None, Some(m)))
+                        .map_err(|e| format!("R3D-Metadaten konnten nicht gelesen werden: {e}")),
+                )
+            })
+            .await;
+        }
+    }
+}
+
+/// Gemeinsamer Zustand der Queue, den das Einreihen eines Jobs braucht.
+struct QueueState {
+    limit: Arc<AtomicUsize>,
+    running: Arc<AtomicUsize>,
+    slot_free: Arc<Notify>,
+    is_paused: Arc<AtomicBool>,
+    ffmpeg_pids: Arc<RwLock<HashMap<String, Vec<Arc<AtomicU32>>>>>,
+    jobs: Arc<RwLock<HashMap<String, Job>>>,
+    response_tx: mpsc::Sender<Response>,
+    shutdown_token: CancellationToken,
+}
+
+impl QueueState {
+    /// Reiht einen analysierten Job ein: JobQueued, dann startet er, sobald
+    /// ein Slot frei ist.
+    async fn enqueue(&self, mut job: Job, info: SourceInfo) {
+        let QueueState {
+            limit,
+            running,
+            slot_free,
+            is_paused,
+            ffmpeg_pids,
+            jobs,
+            response_tx,
+            shutdown_token,
+        } = self;
+        let SourceInfo {
+            braw_meta,
+            r3d_meta,
+            total_duration_us,
+            nvenc_full_gpu,
+            decodable_audio,
+        } = info;
+        let job_id = job.id.clone();
+        let is_braw = matches!(job.mode, JobMode::BrawProxy);
+        let is_r3d = matches!(job.mode, JobMode::R3dProxy);
+
+        // skip_if_exists hat JobCommand::Add schon vor dem Probe geprueft
+        let output_path = job.output_path();
+
+        // Job an globales Shutdown-Token haengen
+        job.attach_to_parent_token(&shutdown_token);
+        let cancel_token = job.cancel_token.clone();
+
+        // FFmpeg-Args nur fuer normale (nicht-Bridge) Jobs aufbauen
+        let args = if is_braw || is_r3d {
+            Vec::new() // wird nicht benutzt
+        } else {
+            build_ffmpeg_args(
+                &job.input_path,
+                &output_path,
+                &job.mode,
+                &job.options,
+                nvenc_full_gpu,
+                &decodable_audio,
+            )
+        };
+
+        let job_input_path = job.input_path.clone();
+        let job_options = job.options.clone();
+
+        // Langer BRAW-/R3D-Clip mit `segments`: bis zu so vielen parallelen
+        // Segment-Encodes; wie viele es werden, entscheidet der CPU-Anteil
+        // des Jobs beim Start (ein Bereich = am Stueck)
+        let segment_frames = braw_meta.as_ref().map(|m| m.frame_count).or(r3d_meta.as_ref().map(|m| m.frame_count));
+        let max_segments = match segment_frames {
+            Some(frames) => segments::plan_segments(frames, job_options.segments, segments::segment_gop(&job_options)).len(),
+            None => 1,
+        };
+
+        job.status = JobState::Queued;
+        {
+            let mut map = jobs.write().await;
+            map.insert(job_id.clone(), job);
+        }
+
+        // JobQueued senden
+        let _ = response_tx
+            .send(Response::JobQueued { id: job_id.clone() })
+            .await;
+
+        let limit_ref = limit.clone();
+        let running_ref = running.clone();
+        let slot_free_ref = slot_free.clone();
+        let is_paused_ref = is_paused.clone();
+        let pid_slots: Vec<Arc<AtomicU32>> = (0..max_segments).map(|_| Arc::default()).collect();
+        let pid_slot = pid_slots[0].clone();
+        {
+            ffmpeg_pids.write().await.insert(job_id.clone(), pid_slots.clone());
+        }
+        let ffmpeg_pids_ref = ffmpeg_pids.clone();
+        let resp_tx = response_tx.clone();
+        let jobs_ref = jobs.clone();
+        let job_id_for_monitor = job_id.clone();
+
+        let handle = tokio::spawn(async move {
+            // Warten bis ein Slot frei ist UND nicht pausiert – oder Job wird gecancelt.
+            // Das Limit zum Startzeitpunkt bestimmt den CPU-Anteil des Jobs.
+            let parallel = loop {
+                if is_paused_ref.load(Ordering::Acquire) {
+                    tokio::select! {
+                        _ = slot_free_ref.notified() => continue,
+                        _ = cancel_token.cancelled() => {
+                            ffmpeg_pids_ref.write().await.remove(&job_id);
+                            jobs_ref.write().await.remove(&job_id);
+                            let _ = resp_tx.send(Response::JobCancelled { id: job_id.clone() }).await;
+                            return;
+                        }
+                    }
+                }
+                let cur = running_ref.load(Ordering::Acquire);
+                let lim = limit_ref.load(Ordering::Acquire);
+                if cur < lim {
+                    if running_ref
+                        .compare_exchange(cur, cur + 1, Ordering::AcqRel, Ordering::Acquire)
+                        .is_ok()
+                    {
+                        break lim;
+                    }
+                } else {
+                    tokio::select! {
+                        _ = slot_free_ref.notified() => {}
+                        _ = cancel_token.cancelled() => {
+                            ffmpeg_pids_ref.write().await.remove(&job_id);
+                            jobs_ref.write().await.remove(&job_id);
+                            let _ = resp_tx.send(Response::JobCancelled { id: job_id.clone() }).await;
+                            return;
+                        }
+                    }
+                }
+            };
+
+            // Status auf Running setzen
+            {
+                let mut map = jobs_ref.write().await;
+                if let Some(j) = map.get_mut(&job_id) {
+                    j.status = JobState::Running;
+                }
+            }
+
+            // Event-Channel fuer diesen Job-Lauf
+            let (event_tx, mut event_rx) = mpsc::channel::<FfmpegEvent>(64);
+
+            // CPU-Anteil der Bridge; Segmente teilen ihn sich, hoechstens
+            // eines pro Thread
+            let budget = braw_runner::bridge_thread_budget(parallel);
+            let ranges: Vec<FrameRange> = segment_frames
+                .map(|frames| segments::plan_job_segments(frames, &job_options, budget))
+                .unwrap_or_default();
+            let segmented = ranges.len() > 1;
+            let threads = segments::segment_threads(budget, ranges.len());
+
+            // Job in eigenem Task starten (BRAW, R3D oder FFmpeg)
+            let task_id = job_id.clone();
+            let task_handle = if is_braw && segmented {
+                let meta = braw_meta.unwrap(); // sicher: is_braw → braw_meta = Some
+                let timecode = meta.timecode.clone();
+                tokio::spawn(segments::run_segmented(
+                    task_id,
+                    output_path,
+                    ranges,
+                    timecode,
+                    event_tx,
+                    cancel_token,
+                    pid_slots,
+                    move |id, part, range, tx, cancel, pid_slot| {
+                        let (input, options, meta) = (job_input_path.clone(), job_options.clone(), meta.clone());
+                        async move {
+                            braw_runner::run_braw_job(id, input, part, &options, meta, Some(range), threads, tx, cancel, pid_slot)
+                                .await
+                        }
+                    },
+                ))
+            } else if is_braw {
+                let meta = braw_meta.unwrap(); // sicher: is_braw → braw_meta = Some
+                tokio::spawn(async move {
+                    braw_runner::run_braw_job(
+                        task_id,
+                        job_input_path,
+                        output_path,
+                        &job_options,
+                        meta,
+                        None,
+                        budget,
+                        event_tx,
+                        cancel_token,
+                        pid_slot,
+                    )
+                    .await
+                })
+            } else if is_r3d && segmented {
+                let meta = r3d_meta.unwrap(); // sicher: is_r3d → r3d_meta = Some
+                let timecode = meta.timecode.clone();
+                tokio::spawn(segments::run_segmented(
+                    task_id,
+                    output_path,
+                    ranges,
+                    timecode,
+                    event_tx,
+                    cancel_token,
+                    pid_slots,
+                    move |id, part, range, tx, cancel, pid_slot| {
+                        let (input, options, meta) = (job_input_path.clone(), job_options.clone(), meta.clone());
+                        async move {
+                            r3d_runner::run_r3d_job(id, input, part, &options, meta, Some(range), threads, tx, cancel, pid_slot)
+                                .await
+                        }
+                    },
+                ))
+            } else if is_r3d {
+                let meta = r3d_meta.unwrap(); // sicher: is_r3d → r3d_meta = Some
+                tokio::spawn(async move {
+                    r3d_runner::run_r3d_job(
+                        task_id,
+                        job_input_path,
+                        output_path,
+                        &job_options,
+                        meta,
+                        None,
+                        budget,
+                        event_tx,
+                        cancel_token,
+                        pid_slot,
+                    )
+                    .await
+                })
+            } else {
+                tokio::spawn(async move {
+                    runner::run_ffmpeg(
+                        task_id,
+                        args,
+                        &output_path,
+                        total_duration_us,
+                        event_tx,
+                        cancel_token,
+                        pid_slot,
+                    )
+                    .await
+                })
+            };
+
+            // Events weiterleiten an IPC
+            while let Some(event) = event_rx.recv().await {
+                match event {
+                    FfmpegEvent::Progress {
+                        id,
+                        percent,
+                        fps,
+                        speed,
+                        frame,
+                    } => {
+                        {
+                            let mut map = jobs_ref.write().await;
+                            if let Some(j) = map.get_mut(&id) {
+                                j.percent = percent;
+                            }
+                        }
+                        let _ = resp_tx
+                            .send(Response::JobProgress {
+                                id,
+                                percent,
+                                fps,
+                                speed,
+                                frame,
+                            })
+                            .await;
+                    }
+                    FfmpegEvent::Done { id } => {
+                        {
+                            let mut map = jobs_ref.write().await;
+                            if let Some(j) = map.get_mut(&id) {
+                                j.status = JobState::Done;
+                                j.percent = 100.0;
+                            }
+                        }
+                        let _ = resp_tx.send(Response::JobDone { id }).await;
+                    }
+                    FfmpegEvent::Error { id, message } => {
+                        {
+                            let mut map = jobs_ref.write().await;
+                            if let Some(j) = map.get_mut(&id) {
+                                j.status = JobState::Error;
+                            }
+                        }
+                        let _ = resp_tx
+                            .send(Response::JobError { id, message })
+                            .await;
+                    }
+                    FfmpegEvent::Cancelled { id } => {
+                        {
+                            let mut map = jobs_ref.write().await;
+                            if let Some(j) = map.get_mut(&id) {
+                                j.status = JobState::Cancelled;
+                            }
+                        }
+                        let _ = resp_tx
+                            .send(Response::JobCancelled { id })
+                            .await;
+                    }
+                }
+            }
+
+            let task_label = if is_braw { "braw-bridge" } else if is_r3d { "r3d-bridge" } else { "FFmpeg" };
+            match task_handle.await {
+                Ok(Ok(())) => {}  // Normale Beendigung: terminales Event wurde bereits gesendet
+                Ok(Err(e)) => {
+                    let _ = resp_tx.send(Response::JobError {
+                        id: job_id.clone(),
+                        message: format!("{task_label} konnte nicht ausgefuehrt werden: {e}"),
+                    }).await;
+                }
+                Err(e) => {
+                    let _ = resp_tx.send(Response::JobError {
+                        id: job_id.clone(),
+                        message: format!("{task_label}-Task Panik: {e}"),
+                    }).await;
+                }
+            }
+
+            // Slot freigeben und wartende Jobs benachrichtigen
+            running_ref.fetch_sub(1, Ordering::AcqRel);
+            slot_free_ref.notify_waiters();
+
+            // PID-Eintrag und Job aus HashMaps entfernen
+            ffmpeg_pids_ref.write().await.remove(&job_id);
+            jobs_ref.write().await.remove(&job_id);
+        });
+
+        // Monitor: wenn der Job-Task panikt → JobError an Python senden
+        let monitor_tx = response_tx.clone();
+        let monitor_id = job_id_for_monitor;
+        tokio::spawn(async move {
+            if let Err(e) = handle.await {
+                let _ = monitor_tx.send(Response::JobError {
+                    id: monitor_id,
+                    message: format!("Job-Task-Panik: {e}"),
+                }).await;
+            }
+        });
+    }
+}
+
 /// Ermittelt das Pixel-Format des ersten Video-Streams via ffprobe.
 /// Gibt einen leeren String zurueck wenn das Format nicht ermittelt werden kann
 /// (fuehrt dann zur sicheren Hybrid-Pipeline).
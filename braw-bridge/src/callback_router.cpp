@@ -0,0 +1,90 @@
+#include "callback_router.h"
+
+#include "report.h"
+
+JobTag* job_tag(IBlackmagicRawJob* job)
+{
+    void* user_data = nullptr;
+    if (job) job->GetUserData(&user_data);
+    return (JobTag*)user_data;
+}
+
+// ---------------------------------------------------------------------------
+// JobGroup
+// ---------------------------------------------------------------------------
+
+HRESULT JobGroup::submit(IBlackmagicRawJob* job, JobTag* tag)
+{
+    tag->group = this;
+    job->SetUserData(tag);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending++;
+    }
+
+    HRESULT hr = job->Submit();
+    if (FAILED(hr))
+        job_done();
+    return hr;
+}
+
+void JobGroup::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]{ return m_pending == 0; });
+}
+
+void JobGroup::job_done()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_pending == 0)
+        m_idle.notify_all();
+}
+
+// ---------------------------------------------------------------------------
+// CallbackRouter
+// ---------------------------------------------------------------------------
+
+ULONG STDMETHODCALLTYPE CallbackRouter::Release()
+{
+    ULONG ref = --m_ref;
+    if (ref == 0) delete this;
+    return ref;
+}
+
+// The owner may release the job (and reuse its tag) inside its callback, so
+// the group is read first
+void STDMETHODCALLTYPE CallbackRouter::ReadComplete(
+    IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawFrame* frame)
+{
+    JobGroup* group = job_tag(job)->group;
+    {
+        ReportScope scope(group->m_report);
+        ReportInputScope input(group->m_input);
+        group->m_owner->ReadComplete(job, result, frame);
+    }
+    group->job_done();
+}
+
+void STDMETHODCALLTYPE CallbackRouter::DecodeComplete(IBlackmagicRawJob* job, HRESULT result)
+{
+    JobGroup* group = job_tag(job)->group;
+    {
+        ReportScope scope(group->m_report);
+        ReportInputScope input(group->m_input);
+        group->m_owner->DecodeComplete(job, result);
+    }
+    group->job_done();
+}
+
+void STDMETHODCALLTYPE CallbackRouter::ProcessComplete(
+    IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawProcessedImage* processed_image)
+{
+    JobGroup* group = job_tag(job)->group;
+    {
+        ReportScope scope(group->m_report);
+        ReportInputScope input(group->m_input);
+        group->m_owner->ProcessComplete(job, result, processed_image);
+    }
+    group->job_done();
+}
@@ -0,0 +1,106 @@
+// CallbackRouter: lets several clips decode on one codec at once.
+//
+// An IBlackmagicRaw codec has a single callback and a single worker pool.
+// To share both between the requests of --serve, the bridge installs one
+// CallbackRouter on its codec, and each clip's engine submits its jobs
+// through a JobGroup of its own. A job's user data is a JobTag naming the
+// group (as in sdk/Samples/ExtractFrameMultiVideo); the router hands each
+// completion to the group's callback with the group's report stream and
+// input tag active on the SDK thread (see report.h), and counts the job as
+// done once that callback has returned.
+//
+// A clip that is finished waits for its own group to drain. FlushJobs()
+// would also wait for every other clip on the codec.
+//
+// A command-line run goes through the same path: a single group, or one per
+// clip of a playlist.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+#include "LinuxCOM.h"
+#include "BlackmagicRawAPI.h"
+
+class JobGroup;
+
+// User data of every job submitted through a JobGroup. The owner keeps it
+// alive until the job's completion callback has run.
+struct JobTag
+{
+    JobGroup* group = nullptr;
+    uint64_t frame_idx = 0;
+    void* context = nullptr; // owner's per-job state, if any
+};
+
+// The JobTag a job was submitted with
+JobTag* job_tag(IBlackmagicRawJob* job);
+
+class JobGroup
+{
+public:
+    // Completions go to `owner`, with reports on `report` tagged with
+    // `input` (nullptr: untagged)
+    JobGroup(IBlackmagicRawCallback* owner, FILE* report, const char* input)
+        : m_owner(owner)
+        , m_report(report)
+        , m_input(input)
+    {}
+
+    JobGroup(const JobGroup&) = delete;
+    JobGroup& operator=(const JobGroup&) = delete;
+
+    // Tags `job` with `tag` (its group set to this one) and submits it. On
+    // failure the job is not counted and still belongs to the caller.
+    HRESULT submit(IBlackmagicRawJob* job, JobTag* tag);
+
+    // Blocks until the completion callback of every job submitted through
+    // this group has returned
+    void wait_idle();
+
+private:
+    friend class CallbackRouter;
+
+    void job_done();
+
+    IBlackmagicRawCallback* m_owner;
+    FILE* m_report;
+    const char* m_input;
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    uint64_t m_pending = 0;
+};
+
+class CallbackRouter : public IBlackmagicRawCallback
+{
+public:
+    CallbackRouter() : m_ref(1) {}
+
+    // IUnknown
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, LPVOID*) override { return E_NOINTERFACE; }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_ref; }
+    ULONG STDMETHODCALLTYPE Release() override;
+
+    // IBlackmagicRawCallback
+    void STDMETHODCALLTYPE ReadComplete(IBlackmagicRawJob* job, HRESULT result,
+                                        IBlackmagicRawFrame* frame) override;
+    void STDMETHODCALLTYPE DecodeComplete(IBlackmagicRawJob* job, HRESULT result) override;
+    void STDMETHODCALLTYPE ProcessComplete(IBlackmagicRawJob* job, HRESULT result,
+                                           IBlackmagicRawProcessedImage* processed_image) override;
+    void STDMETHODCALLTYPE TrimProgress(IBlackmagicRawJob*, float) override {}
+    void STDMETHODCALLTYPE TrimComplete(IBlackmagicRawJob*, HRESULT) override {}
+    void STDMETHODCALLTYPE SidecarMetadataParseWarning(
+        IBlackmagicRawClip*, const char*, uint32_t, const char*) override {}
+    void STDMETHODCALLTYPE SidecarMetadataParseError(
+        IBlackmagicRawClip*, const char*, uint32_t, const char*) override {}
+    void STDMETHODCALLTYPE PreparePipelineComplete(void*, HRESULT) override {}
+
+private:
+    ~CallbackRouter() = default;
+
+    std::atomic<ULONG> m_ref;
+};
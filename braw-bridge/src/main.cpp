@@ -1,20 +1,32 @@
-// braw-bridge: Decode Blackmagic RAW files, output raw rgb24 video on stdout
-// and NDJSON metadata/progress on stderr.
+// braw-bridge: Decode Blackmagic RAW files, output raw video (rgb24 unless
+// --pix-fmt says otherwise) on stdout and NDJSON metadata/progress on stderr.
 //
-// Usage:
-//   braw-bridge --input <file.braw> [--debayer full|half|quarter]
-//   braw-bridge --input <file.braw> --extract-audio /path/to/output.wav
+// Usage (the options: Options and parse_args() below):
+//   braw-bridge --input <file.braw> [decode options]
+//   braw-bridge --input <file.braw> --extract-audio <out.wav>
+//   braw-bridge --input <a.braw> --output <spec> [--input <b.braw> --output <spec> ...]
+//   braw-bridge --input <file.braw> [--input ...] --probe-only
+//   braw-bridge --input <file.braw> [--input ...] --thumbnails <dir>
+//   braw-bridge --serve <socket>
+//   braw-bridge --self-check | --capabilities | --bench-transport
 //
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <cstdint>
 #include <cmath>
 #include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <csignal>
+#include <thread>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 #ifdef _WIN32
 #include <io.h>
@@ -26,8 +38,35 @@
 #include "LinuxCOM.h"
 #include "BlackmagicRawAPI.h"
 
+#include "callback_router.h"
+#include "manual_engine.h"
+#include "reorder_buffer.h"
+#include "resize.h"
+#include "resource_manager.h"
+
+#include "av_encoder.h"
+#include "frame_pool.h"
+#include "frame_writer.h"
+#include "nut_muxer.h"
+#include "pixel_convert.h"
+#include "pixel_format.h"
+#include "post_process.h"
+#include "frame_select.h"
+#include "frame_server.h"
+#include "playlist.h"
+#include "thumbnails.h"
+#include "probe_batch.h"
+#include "clip_cache.h"
+#include "report.h"
+#include "serve.h"
+#include "shm_ring.h"
+#include "stripe_pool.h"
+#include "transport_bench.h"
+#include "wav_writer.h"
+#include "yuv_convert.h"
+
 // ---------------------------------------------------------------------------
-// Utility: write NDJSON to stderr
+// Utility: write NDJSON to the report stream (stderr, see report.h)
 // ---------------------------------------------------------------------------
 
 static std::string json_escape(const char* s)
@@ -48,103 +87,212 @@ static std::string json_escape(const char* s)
     return out;
 }
 
+// ,"input":"<clip>" while a batch probe worker reports (see report.h)
+static std::string json_input_field()
+{
+    const char* input = report_input();
+    return input ? ",\"input\":\"" + json_escape(input) + "\"" : std::string();
+}
+
 static void json_error(const char* msg)
 {
     std::string escaped = json_escape(msg);
-    fprintf(stderr, "{\"type\":\"error\",\"message\":\"%s\"}\n", escaped.c_str());
+    fprintf(report_stream(), "{\"type\":\"error\"%s,\"message\":\"%s\"}\n",
+            json_input_field().c_str(), escaped.c_str());
+}
+
+static void json_warning(const char* msg)
+{
+    std::string escaped = json_escape(msg);
+    fprintf(report_stream(), "{\"type\":\"warning\"%s,\"message\":\"%s\"}\n",
+            json_input_field().c_str(), escaped.c_str());
 }
 
 static void json_metadata(const char* timecode, uint32_t fps_num, uint32_t fps_den,
-                           uint32_t width, uint32_t height, uint64_t frame_count)
+                           uint32_t width, uint32_t height, uint64_t frame_count,
+                           uint32_t threads, const char* isa,
+                           uint32_t output_width, uint32_t output_height,
+                           const char* pix_fmt, const char* yuv_range, bool nut,
+                           const std::string& extra_fields)
 {
-    fprintf(stderr,
-        "{\"type\":\"metadata\","
+    // yuv_range only for YUV output, mux only for a NUT stream; a probe adds
+    // audio layout and camera metadata (see clip_cache.h), a range decode
+    // its range and start timecode
+    std::string range_field = yuv_range
+        ? std::string(",\"yuv_range\":\"") + yuv_range + "\"" : std::string();
+    if (nut)
+        range_field += ",\"mux\":\"nut\"";
+    range_field += extra_fields;
+    fprintf(report_stream(),
+        "{\"type\":\"metadata\"%s,"
         "\"timecode\":\"%s\","
         "\"fps_num\":%u,"
         "\"fps_den\":%u,"
         "\"width\":%u,"
         "\"height\":%u,"
-        "\"frame_count\":%llu}\n",
-        timecode, fps_num, fps_den, width, height,
-        (unsigned long long)frame_count);
+        "\"frame_count\":%llu,"
+        "\"threads\":%u,"
+        "\"isa\":\"%s\","
+        "\"output_width\":%u,"
+        "\"output_height\":%u,"
+        "\"pix_fmt\":\"%s\"%s}\n",
+        json_input_field().c_str(), timecode, fps_num, fps_den, width, height,
+        (unsigned long long)frame_count, threads, isa,
+        output_width, output_height, pix_fmt, range_field.c_str());
+}
+
+// ,"start_frame":..,"end_frame":..,"start_timecode":".." for a range decode
+static std::string range_json_fields(uint64_t first_frame, uint64_t end_frame,
+                                     const std::string& start_timecode)
+{
+    char buf[96];
+    snprintf(buf, sizeof(buf), ",\"start_frame\":%llu,\"end_frame\":%llu,",
+             (unsigned long long)first_frame, (unsigned long long)end_frame);
+    return buf + ("\"start_timecode\":\"" + json_escape(start_timecode.c_str()) + "\"");
 }
 
 static void json_progress(uint64_t frame, uint64_t total)
 {
-    fprintf(stderr, "{\"type\":\"progress\",\"frame\":%llu,\"total\":%llu}\n",
+    fprintf(report_stream(), "{\"type\":\"progress\",\"frame\":%llu,\"total\":%llu}\n",
         (unsigned long long)frame, (unsigned long long)total);
 }
 
+static void json_thumbnail(uint64_t frame, double time, const std::string& path)
+{
+    fprintf(report_stream(), "{\"type\":\"thumbnail\"%s,\"frame\":%llu,\"time\":%.3f,\"path\":\"%s\"}\n",
+            json_input_field().c_str(), (unsigned long long)frame, time,
+            json_escape(path.c_str()).c_str());
+}
+
+static void json_sprite(const ThumbnailSink& sink, size_t tiles, uint32_t tile_width,
+                        uint32_t tile_height)
+{
+    fprintf(report_stream(),
+            "{\"type\":\"sprite\"%s,\"path\":\"%s\",\"vtt\":\"%s\",\"tiles\":%zu,"
+            "\"columns\":%u,\"rows\":%u,\"tile_width\":%u,\"tile_height\":%u}\n",
+            json_input_field().c_str(), json_escape(sink.sprite_path().c_str()).c_str(),
+            json_escape(sink.vtt_path().c_str()).c_str(), tiles, sink.columns(), sink.rows(),
+            tile_width, tile_height);
+}
+
 static void json_done()
 {
-    fprintf(stderr, "{\"type\":\"done\"}\n");
+    fprintf(report_stream(), "{\"type\":\"done\"}\n");
 }
 
-// ---------------------------------------------------------------------------
-// WAV writer (for --extract-audio)
-// ---------------------------------------------------------------------------
+// --capabilities: what this build can do beyond raw frames, the
+// --encode-codec values it encodes in process (none without
+// -DBRIDGE_LIBAV=ON), as one
+// {"type":"capabilities","encode":..,"encode_codecs":[..]} line
+static void json_capabilities()
+{
+    std::string codecs;
+    for (const std::string& codec : AvEncoder::codecs())
+    {
+        if (AvEncoder::codec_available(codec))
+            codecs += (codecs.empty() ? "\"" : ",\"") + codec + "\"";
+    }
+    fprintf(report_stream(), "{\"type\":\"capabilities\",\"encode\":%s,\"encode_codecs\":[%s]}\n",
+            codecs.empty() ? "false" : "true", codecs.c_str());
+}
+
+static void json_resource_pool(const PooledResourceManager::Stats& st)
+{
+    fprintf(report_stream(),
+        "{\"type\":\"resource_pool\",\"hits\":%llu,\"misses\":%llu,"
+        "\"evictions\":%llu,\"peak_bytes\":%llu,\"idle_bytes\":%llu}\n",
+        (unsigned long long)st.hits, (unsigned long long)st.misses,
+        (unsigned long long)st.evictions, (unsigned long long)st.peak_bytes,
+        (unsigned long long)st.idle_bytes);
+}
+
+static void json_writer(const FrameWriter::Stats& st)
+{
+    // More time blocked in write than waiting for frames: FFmpeg is the limit
+    fprintf(report_stream(),
+        "{\"type\":\"writer\",\"frames\":%llu,\"bytes\":%llu,"
+        "\"spliced_bytes\":%llu,\"write_calls\":%llu,\"pipe_bytes\":%zu,"
+        "\"write_s\":%.3f,\"wait_s\":%.3f,\"bound\":\"%s\"}\n",
+        (unsigned long long)st.frames, (unsigned long long)st.bytes,
+        (unsigned long long)st.spliced_bytes, (unsigned long long)st.write_calls,
+        st.pipe_bytes, st.write_seconds, st.wait_seconds,
+        st.write_seconds > st.wait_seconds ? "encoder" : "decoder");
+}
 
-static bool write_wav(const char* path, const void* samples, uint64_t sample_count,
-                      uint32_t sample_rate, uint32_t channels, uint32_t bits_per_sample)
+static void json_pipeline(uint64_t frame, const ManualEngine::StageDepths& d)
 {
-    FILE* f = fopen(path, "wb");
-    if (!f) return false;
+    fprintf(report_stream(),
+        "{\"type\":\"pipeline\",\"frame\":%llu,\"read_inflight\":%u,"
+        "\"decode_queued\":%u,\"decode_inflight\":%u,"
+        "\"process_queued\":%u,\"process_inflight\":%u}\n",
+        (unsigned long long)frame, d.read_inflight,
+        d.decode_queued, d.decode_inflight,
+        d.process_queued, d.process_inflight);
+}
 
-    uint32_t byte_rate = sample_rate * channels * (bits_per_sample / 8);
-    uint32_t block_align = channels * (bits_per_sample / 8);
-    uint64_t data_size_64 = (uint64_t)sample_count * channels * (bits_per_sample / 8);
-    if (data_size_64 > 0xFFFFFFFFULL)
+// SDK resource format each --pix-fmt is processed to. rgb24 and 8-bit YUV
+// come from RGBAU8, 10-bit YUV from RGBU16 (converted in the callback); the
+// others are written in the SDK's own layout (gbrp16le planes reordered on
+// write).
+static BlackmagicRawResourceFormat resource_format_for(PixFmt fmt)
+{
+    switch (fmt)
     {
-        json_error("Audio data too large for WAV format (exceeds 4 GiB)");
-        fclose(f);
-        return false;
+        case PixFmt::BGRA:        return blackmagicRawResourceFormatBGRAU8;
+        case PixFmt::RGB48LE:
+        case PixFmt::YUV422P10LE:
+        case PixFmt::P010LE:      return blackmagicRawResourceFormatRGBU16;
+        case PixFmt::GBRP16LE:    return blackmagicRawResourceFormatRGBU16Planar;
+        default:                  return blackmagicRawResourceFormatRGBAU8;
     }
-    uint32_t data_size = (uint32_t)data_size_64;
-    uint32_t riff_size = 36 + data_size;
-
-    // RIFF header
-    fwrite("RIFF", 1, 4, f);
-    fwrite(&riff_size, 4, 1, f);
-    fwrite("WAVE", 1, 4, f);
-
-    // fmt chunk
-    fwrite("fmt ", 1, 4, f);
-    uint32_t fmt_size = 16;
-    uint16_t audio_format = 1; // PCM
-    uint16_t ch = (uint16_t)channels;
-    uint16_t bps = (uint16_t)bits_per_sample;
-    fwrite(&fmt_size, 4, 1, f);
-    fwrite(&audio_format, 2, 1, f);
-    fwrite(&ch, 2, 1, f);
-    fwrite(&sample_rate, 4, 1, f);
-    fwrite(&byte_rate, 4, 1, f);
-    fwrite(&block_align, 2, 1, f);
-    fwrite(&bps, 2, 1, f);
-
-    // data chunk
-    fwrite("data", 1, 4, f);
-    fwrite(&data_size, 4, 1, f);
-    fwrite(samples, 1, data_size, f);
-
-    fclose(f);
-    return true;
+}
+
+static uint64_t resource_frame_bytes(PixFmt fmt, uint32_t width, uint32_t height)
+{
+    if (pix_fmt_is_yuv(fmt))
+        fmt = pix_fmt_bit_depth(fmt) > 8 ? PixFmt::RGB48LE : PixFmt::RGB24;
+    if (fmt == PixFmt::RGB24)
+        return (uint64_t)width * height * 4;
+    return pix_fmt_frame_bytes(fmt, width, height);
 }
 
 // ---------------------------------------------------------------------------
 // BRAW Callback: processes frames asynchronously
 // ---------------------------------------------------------------------------
+//
+// The frame index travels through the SDK in the jobs' JobTag, one per
+// reorder slot, shared by a frame's read and decode job.
 
 class BrawCallback : public IBlackmagicRawCallback
 {
 public:
-    BrawCallback(uint64_t total_frames, BlackmagicRawResolutionScale resolution_scale)
+    BrawCallback(ReorderBuffer* reorder, FramePool* frame_pool, StripePool* convert_pool,
+                 BlackmagicRawResolutionScale resolution_scale, PixFmt pix_fmt,
+                 const PostProcessor* post)
         : m_ref(1)
-        , m_total_frames(total_frames)
-        , m_completed_frames(0)
-        , m_error(false)
         , m_resolution_scale(resolution_scale)
+        , m_reorder(reorder)
+        , m_frame_pool(frame_pool)
+        , m_convert_pool(convert_pool)
+        , m_pix_fmt(pix_fmt)
+        , m_post(post)
+        , m_error(false)
+        , m_jobs(this, report_stream(), report_input())
+        , m_tags(reorder->slot_count())
     {}
 
+    // Submits the read job of `frame_idx`; ReadComplete submits its decode.
+    // On failure the job still belongs to the caller.
+    HRESULT submit_read(IBlackmagicRawJob* read_job, uint64_t frame_idx)
+    {
+        JobTag& tag = m_tags[frame_idx % m_tags.size()];
+        tag.frame_idx = frame_idx;
+        return m_jobs.submit(read_job, &tag);
+    }
+
+    // Blocks until every job of this clip has completed
+    void wait_idle() { m_jobs.wait_idle(); }
+
     // IUnknown
     virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void**) override
     {
@@ -167,17 +315,19 @@ public:
     virtual void STDMETHODCALLTYPE ReadComplete(
         IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawFrame* frame) override
     {
+        JobTag* tag = job_tag(job);
+        uint64_t frame_idx = tag->frame_idx;
+
         if (FAILED(result))
         {
             json_error("ReadComplete failed");
-            m_error = true;
-            signal_frame_done();
+            fail_frame(frame_idx);
             if (job) job->Release();
             return;
         }
 
         // Set pixel format and resolution scale before decoding
-        frame->SetResourceFormat(blackmagicRawResourceFormatRGBAU8);
+        frame->SetResourceFormat(resource_format_for(m_pix_fmt));
         if (m_resolution_scale != blackmagicRawResolutionScaleFull)
             frame->SetResolutionScale(m_resolution_scale);
 
@@ -187,28 +337,27 @@ public:
         if (FAILED(hr) || !decode_job)
         {
             json_error("CreateJobDecodeAndProcessFrame failed");
-            m_error = true;
-            signal_frame_done();
+            fail_frame(frame_idx);
             if (job) job->Release();
             return;
         }
 
-        hr = decode_job->Submit();
+        hr = m_jobs.submit(decode_job, tag);
         if (FAILED(hr))
         {
             json_error("Decode job submit failed");
-            m_error = true;
             decode_job->Release();
-            signal_frame_done();
+            fail_frame(frame_idx);
         }
 
         if (job) job->Release();
     }
 
     virtual void STDMETHODCALLTYPE DecodeComplete(
-        IBlackmagicRawJob* job, HRESULT result) override
+        IBlackmagicRawJob* job, HRESULT) override
     {
-        // Stub — we use ProcessComplete for final output
+        // Stub — we use ProcessComplete for final output, which also
+        // reports a failed decode
         if (job) job->Release();
     }
 
@@ -216,11 +365,12 @@ public:
         IBlackmagicRawJob* job, HRESULT result,
         IBlackmagicRawProcessedImage* processed_image) override
     {
+        uint64_t frame_idx = job_tag(job)->frame_idx;
+
         if (FAILED(result) || !processed_image)
         {
             json_error("ProcessComplete failed");
-            m_error = true;
-            signal_frame_done();
+            fail_frame(frame_idx);
             if (job) job->Release();
             return;
         }
@@ -233,40 +383,46 @@ public:
         void* pixel_data = nullptr;
         processed_image->GetResource(&pixel_data);
 
-        // We set RGBAU8 in ReadComplete, so layout is R, G, B, A per pixel.
-        // Convert RGBA -> RGB24: drop alpha channel.
-        size_t rgb_size = (size_t)width * height * 3;
-        uint8_t* rgb_buf = (uint8_t*)malloc(rgb_size);
-        if (rgb_buf && pixel_data)
+        if (!pixel_data)
         {
-            const uint8_t* src = (const uint8_t*)pixel_data;
-            uint8_t* dst = rgb_buf;
-            size_t pixel_count = (size_t)width * height;
-            for (size_t i = 0; i < pixel_count; i++)
-            {
-                dst[0] = src[0]; // R
-                dst[1] = src[1]; // G
-                dst[2] = src[2]; // B
-                dst += 3;
-                src += 4; // skip A
-            }
-
-            // Write raw rgb24 frame data to stdout
-            fwrite(rgb_buf, 1, rgb_size, stdout);
-            fflush(stdout);
+            json_error("Null pixel data in processed image");
+            fail_frame(frame_idx);
+            if (job) job->Release();
+            return;
         }
-        else
+
+        if (m_post && (width != m_post->src_width() || height != m_post->src_height()))
         {
-            json_error("Failed to allocate RGB buffer or null pixel data");
-            m_error = true;
+            json_error("Processed image size differs from the planned decode size");
+            fail_frame(frame_idx);
+            if (job) job->Release();
+            return;
         }
 
-        free(rgb_buf);
+        size_t out_bytes = m_post ? m_post->dst_bytes()
+                         : pix_fmt_frame_bytes(m_pix_fmt, width, height);
+        if (out_bytes > m_frame_pool->buffer_bytes())
+        {
+            json_error("Processed image larger than the frame pool buffers");
+            fail_frame(frame_idx);
+            if (job) job->Release();
+            return;
+        }
 
-        m_completed_frames++;
-        json_progress(m_completed_frames, m_total_frames);
+        // For rgb24 and YUV the post stage turns the SDK's RGBA (or RGB16)
+        // into the output format, resampled to --output-size in the same
+        // pass. The rest are already in their output layout and only copied
+        // out of the SDK's buffer. The pool holds one buffer per reorder
+        // slot plus one per queued write, so checkout never has to wait; the
+        // writer thread gives it back once the frame is on stdout.
+        const uint8_t* src = (const uint8_t*)pixel_data;
+        uint8_t* out_buf = m_frame_pool->checkout();
+        if (m_post)
+            m_post->run(src, out_buf, m_convert_pool);
+        else
+            copy_frame(src, out_buf, out_bytes, m_convert_pool);
 
-        signal_frame_done();
+        m_reorder->publish(frame_idx, out_buf, out_bytes);
         if (job) job->Release();
     }
 
@@ -280,278 +436,205 @@ public:
 
     bool had_error() const { return m_error; }
 
-    // Synchronization: wait for one frame to complete
-    void wait_frame_done()
-    {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_cv.wait(lock, [this]{ return m_frame_done; });
-        m_frame_done = false;
-    }
-
 private:
-    void signal_frame_done()
+    void fail_frame(uint64_t frame_idx)
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_frame_done = true;
-        m_cv.notify_one();
+        m_error = true;
+        m_reorder->publish(frame_idx, nullptr, 0);
     }
 
     std::atomic<ULONG> m_ref;
     BlackmagicRawResolutionScale m_resolution_scale;
-    uint64_t m_total_frames;
-    uint64_t m_completed_frames;
+    ReorderBuffer* m_reorder;
+    FramePool* m_frame_pool;
+    StripePool* m_convert_pool;
+    PixFmt m_pix_fmt;
+    const PostProcessor* m_post;
     std::atomic<bool> m_error;
-
-    std::mutex m_mutex;
-    std::condition_variable m_cv;
-    bool m_frame_done = false;
+    JobGroup m_jobs;
+    std::vector<JobTag> m_tags; // indexed by frame % reorder slots
 };
 
-// ---------------------------------------------------------------------------
-// Timecode extraction helper
-// ---------------------------------------------------------------------------
-
-static std::string get_timecode(IBlackmagicRawClip* clip)
+// Default number of frames in flight: enough to keep the SDK's worker pool
+// busy on many-core machines, capped so that the SDK's per-frame RGBA buffers
+// plus our RGB slots stay within a fixed memory budget. The `clips` of a
+// playlist decoding side by side share both.
+static uint32_t default_inflight(uint32_t width, uint32_t height, uint32_t clips)
 {
-    const char* tc_str = nullptr;
-    HRESULT hr = clip->GetTimecodeForFrame(0, &tc_str);
-    if (SUCCEEDED(hr) && tc_str && tc_str[0] != '\0')
-        return std::string(tc_str);
-    return "00:00:00:00";
+    static constexpr uint64_t kInflightMemoryBudget = 2ULL << 30; // 2 GiB
+
+    clips = std::max(1u, clips);
+    uint32_t cores = std::thread::hardware_concurrency();
+    uint32_t n = std::max(2u, std::min(8u, cores / 4 / clips));
+
+    uint64_t per_frame = (uint64_t)width * height * (4 + 3);
+    if (per_frame > 0)
+        n = (uint32_t)std::min<uint64_t>(n, std::max<uint64_t>(2, kInflightMemoryBudget / clips / per_frame));
+
+    return n;
 }
 
 // ---------------------------------------------------------------------------
-// Audio extraction (Phase 3)
+// Resource manager: recycle the SDK's CPU buffers across frames
 // ---------------------------------------------------------------------------
 
-static bool extract_audio(IBlackmagicRawClip* clip, const char* output_path)
+// Released SDK buffers kept for reuse beyond this are freed instead.
+static constexpr size_t kResourcePoolMaxIdleBytes = 2ULL << 30; // 2 GiB
+
+// Installs a PooledResourceManager on the codec. Must run before the clip is
+// opened. Returns null (SDK default manager stays active) if the codec does
+// not expose IBlackmagicRawConfigurationEx.
+static PooledResourceManager* install_resource_manager(IBlackmagicRaw* codec)
 {
-    IBlackmagicRawClipAudio* audio = nullptr;
-    HRESULT hr = clip->QueryInterface(IID_IBlackmagicRawClipAudio, (void**)&audio);
-    if (FAILED(hr) || !audio)
-    {
-        json_error("No audio in BRAW clip");
-        return false;
-    }
+    IBlackmagicRawConfigurationEx* config_ex = nullptr;
+    HRESULT hr = codec->QueryInterface(IID_IBlackmagicRawConfigurationEx, (void**)&config_ex);
+    if (FAILED(hr) || !config_ex)
+        return nullptr;
 
-    uint64_t sample_count = 0;
-    uint32_t bits_per_sample = 0;
-    uint32_t channel_count = 0;
-    uint32_t sample_rate = 0;
+    IBlackmagicRawResourceManager* default_manager = nullptr;
+    config_ex->GetResourceManager(&default_manager);
 
-    hr = audio->GetAudioSampleCount(&sample_count);
-    if (FAILED(hr) || sample_count == 0)
+    PooledResourceManager* manager = new PooledResourceManager(default_manager, kResourcePoolMaxIdleBytes);
+    if (default_manager)
+        default_manager->Release();
+
+    if (FAILED(config_ex->SetResourceManager(manager)))
     {
-        json_error("No audio samples in BRAW clip");
-        audio->Release();
-        return false;
+        manager->Release();
+        manager = nullptr;
     }
-    hr = audio->GetAudioBitDepth(&bits_per_sample);
-    if (FAILED(hr)) { json_error("GetAudioBitDepth failed"); audio->Release(); return false; }
-    hr = audio->GetAudioChannelCount(&channel_count);
-    if (FAILED(hr)) { json_error("GetAudioChannelCount failed"); audio->Release(); return false; }
-    hr = audio->GetAudioSampleRate(&sample_rate);
-    if (FAILED(hr)) { json_error("GetAudioSampleRate failed"); audio->Release(); return false; }
 
-    // Read in chunks of 48000 samples (as recommended by SDK samples)
-    static constexpr uint32_t kChunkSamples = 48000;
-    uint32_t chunk_buf_bytes = (kChunkSamples * channel_count * bits_per_sample) / 8;
-    size_t total_data_bytes = (size_t)((sample_count * channel_count * bits_per_sample) / 8);
+    config_ex->Release();
+    return manager;
+}
 
-    uint8_t* audio_buffer = (uint8_t*)malloc(total_data_bytes);
-    if (!audio_buffer)
-    {
-        json_error("Failed to allocate audio buffer");
-        audio->Release();
-        return false;
-    }
+// ---------------------------------------------------------------------------
+// Codec configuration: CPU thread pool size and instruction set
+// ---------------------------------------------------------------------------
 
-    uint8_t* chunk_buf = (uint8_t*)malloc(chunk_buf_bytes);
-    if (!chunk_buf)
+static const char* instruction_set_name(BlackmagicRawInstructionSet isa)
+{
+    switch (isa)
     {
-        json_error("Failed to allocate chunk buffer");
-        free(audio_buffer);
-        audio->Release();
-        return false;
+        case blackmagicRawInstructionSetSSE41: return "sse41";
+        case blackmagicRawInstructionSetAVX:   return "avx";
+        case blackmagicRawInstructionSetAVX2:  return "avx2";
+        case blackmagicRawInstructionSetNEON:  return "neon";
+        default:                               return "unknown";
     }
+}
 
-    uint64_t sample_idx = 0;
-    size_t buf_offset = 0;
-    while (sample_idx < sample_count)
+// Applies --threads / --isa to the codec (before OpenClip) and reads back the
+// values the SDK actually uses for the metadata line.
+static bool configure_codec(IBlackmagicRaw* codec, uint32_t threads,
+                            bool set_isa, BlackmagicRawInstructionSet isa,
+                            uint32_t& threads_out, std::string& isa_out)
+{
+    IBlackmagicRawConfiguration* config = nullptr;
+    HRESULT hr = codec->QueryInterface(IID_IBlackmagicRawConfiguration, (void**)&config);
+    if (FAILED(hr) || !config)
     {
-        uint32_t samples_read = 0;
-        uint32_t bytes_read = 0;
-        if (sample_idx > UINT32_MAX)
-        {
-            fprintf(stderr, "{\"type\":\"warning\",\"message\":\"Audio sample index exceeds UINT32_MAX; truncating audio output\"}\n");
-            break;
-        }
-        hr = audio->GetAudioSamples((uint32_t)sample_idx, chunk_buf, chunk_buf_bytes,
-                                     kChunkSamples, &samples_read, &bytes_read);
-        if (FAILED(hr) || samples_read == 0)
-            break;
-        if (buf_offset + bytes_read <= total_data_bytes)
-        {
-            memcpy(audio_buffer + buf_offset, chunk_buf, bytes_read);
-            buf_offset += bytes_read;
-        }
-        sample_idx += samples_read;
+        json_error("IBlackmagicRawConfiguration not available");
+        return false;
     }
 
-    free(chunk_buf);
-    audio->Release();
-
-    bool ok = write_wav(output_path, audio_buffer, sample_idx,
-                        sample_rate, channel_count, bits_per_sample);
-    free(audio_buffer);
-
-    if (!ok)
+    if (threads > 0 && FAILED(config->SetCPUThreads(threads)))
     {
-        json_error("Failed to write WAV file");
+        json_error("SetCPUThreads failed");
+        config->Release();
         return false;
     }
 
-    return true;
-}
-
-// ---------------------------------------------------------------------------
-// CLI parsing
-// ---------------------------------------------------------------------------
-
-struct Options
-{
-    std::string input_file;
-    std::string extract_audio_path;
-    BlackmagicRawResolutionScale resolution_scale = blackmagicRawResolutionScaleFull;
-    bool probe_only = false;
-};
+    // 0 means "SDK default", which is the maximum thread count
+    threads_out = 0;
+    config->GetCPUThreads(&threads_out);
+    if (threads_out == 0)
+        config->GetMaxCPUThreadCount(&threads_out);
+    config->Release();
 
-static bool parse_args(int argc, char* argv[], Options& opts)
-{
-    for (int i = 1; i < argc; i++)
+    IBlackmagicRawConfigurationEx* config_ex = nullptr;
+    hr = codec->QueryInterface(IID_IBlackmagicRawConfigurationEx, (void**)&config_ex);
+    if (FAILED(hr) || !config_ex)
     {
-        if ((strcmp(argv[i], "--input") == 0 || strcmp(argv[i], "-i") == 0) && i + 1 < argc)
-        {
-            opts.input_file = argv[++i];
-        }
-        else if (strcmp(argv[i], "--debayer") == 0 && i + 1 < argc)
-        {
-            i++;
-            if (strcmp(argv[i], "full") == 0)
-                opts.resolution_scale = blackmagicRawResolutionScaleFull;
-            else if (strcmp(argv[i], "half") == 0)
-                opts.resolution_scale = blackmagicRawResolutionScaleHalf;
-            else if (strcmp(argv[i], "quarter") == 0)
-                opts.resolution_scale = blackmagicRawResolutionScaleQuarter;
-            else
-            {
-                json_error("Invalid debayer option. Use: full, half, quarter");
-                return false;
-            }
-        }
-        else if (strcmp(argv[i], "--extract-audio") == 0 && i + 1 < argc)
-        {
-            opts.extract_audio_path = argv[++i];
-        }
-        else if (strcmp(argv[i], "--probe-only") == 0)
-        {
-            opts.probe_only = true;
-        }
-        else
+        if (set_isa)
         {
-            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
-            json_error("Invalid arguments");
+            json_error("IBlackmagicRawConfigurationEx not available for --isa");
             return false;
         }
+        isa_out = "auto";
+        return true;
     }
 
-    if (opts.input_file.empty())
+    if (set_isa && FAILED(config_ex->SetInstructionSet(isa)))
     {
-        json_error("Missing --input <file.braw>");
+        json_error("SetInstructionSet failed (not supported by this CPU?)");
+        config_ex->Release();
         return false;
     }
 
+    BlackmagicRawInstructionSet active = 0;
+    if (SUCCEEDED(config_ex->GetInstructionSet(&active)))
+        isa_out = instruction_set_name(active);
+    else
+        isa_out = "auto";
+    config_ex->Release();
     return true;
 }
 
 // ---------------------------------------------------------------------------
-// Main
+// Timecode extraction helper
 // ---------------------------------------------------------------------------
 
-int main(int argc, char* argv[])
+static std::string get_timecode(IBlackmagicRawClip* clip, uint64_t frame = 0)
 {
-#ifdef _WIN32
-    // Set stdout to binary mode on Windows
-    _setmode(_fileno(stdout), _O_BINARY);
-#endif
-
-    Options opts;
-    if (!parse_args(argc, argv, opts))
-        return 1;
-
-    // --- Initialize BRAW SDK ---
+    const char* tc_str = nullptr;
+    HRESULT hr = clip->GetTimecodeForFrame(frame, &tc_str);
+    if (SUCCEEDED(hr) && tc_str && tc_str[0] != '\0')
+        return std::string(tc_str);
+    return "00:00:00:00";
+}
 
-    // Resolve SDK library directory relative to executable via /proc/self/exe
-    std::string lib_dir;
-    {
-        char exe_path[4096] = {};
-        ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
-        if (len > 0)
-        {
-            exe_path[len] = '\0';
-            std::string exe(exe_path);
-            auto pos = exe.rfind('/');
-            if (pos != std::string::npos)
-                lib_dir = exe.substr(0, pos) + "/../sdk/Libraries/Linux";
-            else
-                lib_dir = "../sdk/Libraries/Linux";
-        }
-        else
-        {
-            lib_dir = "../sdk/Libraries/Linux";
-        }
-    }
+// Anamorphic squeeze from the clip metadata ("anamorphic" = "2.0x" etc.);
+// 1.0 when the camera recorded none.
+static double get_pixel_aspect(IBlackmagicRawClip* clip)
+{
+    double aspect = 1.0;
+    Variant value;
+    VariantInit(&value);
 
-    // CreateBlackmagicRawFactoryInstanceFromPath returns the factory directly
-    IBlackmagicRawFactory* factory = CreateBlackmagicRawFactoryInstanceFromPath(lib_dir.c_str());
-    if (!factory)
+    if (SUCCEEDED(clip->GetMetadata("anamorphic_enable", &value))
+        && value.vt == blackmagicRawVariantTypeU8 && (value.uiVal & 0xFF) == 0)
     {
-        json_error("Failed to create BRAW factory. Is the SDK installed under braw-bridge/sdk/?");
-        return 1;
+        VariantClear(&value);
+        return aspect;
     }
+    VariantClear(&value);
 
-    IBlackmagicRaw* codec = nullptr;
-    HRESULT hr = factory->CreateCodec(&codec);
-    if (FAILED(hr) || !codec)
+    if (SUCCEEDED(clip->GetMetadata("anamorphic", &value)))
     {
-        json_error("Failed to create BRAW codec");
-        factory->Release();
-        return 1;
+        if (value.vt == blackmagicRawVariantTypeString && value.bstrVal)
+            aspect = strtod(value.bstrVal, nullptr);
+        else if (value.vt == blackmagicRawVariantTypeFloat32)
+            aspect = value.fltVal;
     }
+    VariantClear(&value);
 
-    // --- Open clip ---
-
-    IBlackmagicRawClip* clip = nullptr;
-    hr = codec->OpenClip(opts.input_file.c_str(), &clip);
-    if (FAILED(hr) || !clip)
-    {
-        json_error("Failed to open BRAW clip");
-        codec->Release();
-        factory->Release();
-        return 1;
-    }
+    return (aspect >= 1.0 && aspect <= 4.0) ? aspect : 1.0;
+}
 
-    // --- Get clip properties ---
+// ---------------------------------------------------------------------------
+// Clip properties (what a probe reports and the clip cache keeps)
+// ---------------------------------------------------------------------------
 
-    uint64_t frame_count = 0;
-    hr = clip->GetFrameCount(&frame_count);
+// Frame count, frame rate, size, timecode and pixel aspect. Reports and
+// returns false on failure.
+static bool read_clip_info(IBlackmagicRawClip* clip, ClipInfo& info)
+{
+    HRESULT hr = clip->GetFrameCount(&info.frame_count);
     if (FAILED(hr))
     {
         json_error("GetFrameCount failed");
-        clip->Release();
-        codec->Release();
-        factory->Release();
-        return 1;
+        return false;
     }
 
     float frame_rate = 0.0f;
@@ -559,10 +642,7 @@ int main(int argc, char* argv[])
     if (FAILED(hr))
     {
         json_error("GetFrameRate failed");
-        clip->Release();
-        codec->Release();
-        factory->Release();
-        return 1;
+        return false;
     }
 
     // GetFrameRate returns float; convert to rational num/den
@@ -602,114 +682,1809 @@ int main(int argc, char* argv[])
         }
     }
 
-    uint32_t width = 0, height = 0;
-    hr = clip->GetWidth(&width);
+    info.fps_num = fps_num;
+    info.fps_den = fps_den;
+
+    hr = clip->GetWidth(&info.width);
     if (FAILED(hr))
     {
         json_error("GetWidth failed");
-        clip->Release();
-        codec->Release();
-        factory->Release();
-        return 1;
+        return false;
     }
-    hr = clip->GetHeight(&height);
+    hr = clip->GetHeight(&info.height);
     if (FAILED(hr))
     {
         json_error("GetHeight failed");
-        clip->Release();
-        codec->Release();
-        factory->Release();
-        return 1;
+        return false;
     }
 
-    // Adjust dimensions for debayer resolution scale
-    if (opts.resolution_scale == blackmagicRawResolutionScaleHalf)
+    info.timecode = get_timecode(clip);
+    info.pixel_aspect = get_pixel_aspect(clip);
+    return true;
+}
+
+static void append_variant_json(std::string& out, const Variant& value)
+{
+    char buf[64];
+    switch (value.vt)
     {
-        width /= 2;
-        height /= 2;
+        case blackmagicRawVariantTypeU8:
+            snprintf(buf, sizeof(buf), "%u", (unsigned)(value.uiVal & 0xFF));
+            break;
+        case blackmagicRawVariantTypeS16:
+            snprintf(buf, sizeof(buf), "%d", (int)value.iVal);
+            break;
+        case blackmagicRawVariantTypeU16:
+            snprintf(buf, sizeof(buf), "%u", (unsigned)value.uiVal);
+            break;
+        case blackmagicRawVariantTypeS32:
+            snprintf(buf, sizeof(buf), "%d", value.intVal);
+            break;
+        case blackmagicRawVariantTypeU32:
+            snprintf(buf, sizeof(buf), "%u", value.uintVal);
+            break;
+        case blackmagicRawVariantTypeFloat32:
+            snprintf(buf, sizeof(buf), "%.9g", value.fltVal);
+            break;
+        case blackmagicRawVariantTypeFloat64:
+            snprintf(buf, sizeof(buf), "%.17g", value.dblVal);
+            break;
+        case blackmagicRawVariantTypeString:
+            out += "\"" + json_escape(value.bstrVal ? value.bstrVal : "") + "\"";
+            return;
+        default: // arrays (lens shading tables and the like) are left out
+            snprintf(buf, sizeof(buf), "null");
+            break;
     }
-    else if (opts.resolution_scale == blackmagicRawResolutionScaleQuarter)
+    // NaN and infinities are not JSON
+    out += (strstr(buf, "nan") || strstr(buf, "inf")) ? "null" : buf;
+}
+
+// Audio layout and the clip's metadata (camera, lens, exposure, ...) from
+// its metadata iterator
+static void read_clip_extras(IBlackmagicRawClip* clip, ClipInfo& info)
+{
+    IBlackmagicRawClipAudio* audio = nullptr;
+    if (SUCCEEDED(clip->QueryInterface(IID_IBlackmagicRawClipAudio, (void**)&audio)) && audio)
     {
-        width /= 4;
-        height /= 4;
+        uint32_t channels = 0, sample_rate = 0, bits = 0;
+        uint64_t samples = 0;
+        if (SUCCEEDED(audio->GetAudioChannelCount(&channels))
+            && SUCCEEDED(audio->GetAudioSampleRate(&sample_rate))
+            && SUCCEEDED(audio->GetAudioBitDepth(&bits))
+            && SUCCEEDED(audio->GetAudioSampleCount(&samples)) && samples > 0)
+        {
+            info.audio_channels = channels;
+            info.audio_sample_rate = sample_rate;
+            info.audio_bits = bits;
+            info.audio_samples = samples;
+        }
+        audio->Release();
     }
 
-    // Timecode
-    std::string timecode = get_timecode(clip);
-
-    // --- Handle --extract-audio ---
-
-    if (!opts.extract_audio_path.empty())
+    info.camera = "{";
+    IBlackmagicRawMetadataIterator* it = nullptr;
+    if (SUCCEEDED(clip->GetMetadataIterator(&it)) && it)
     {
-        bool ok = extract_audio(clip, opts.extract_audio_path.c_str());
-
-        clip->Release();
-        codec->Release();
-        factory->Release();
-
-        if (ok)
+        bool first = true;
+        do
         {
-            json_done();
-            return 0;
-        }
-        return 1;
+            const char* key = nullptr;
+            Variant value;
+            VariantInit(&value);
+            if (SUCCEEDED(it->GetKey(&key)) && key && SUCCEEDED(it->GetData(&value)))
+            {
+                if (!first)
+                    info.camera += ",";
+                info.camera += "\"" + json_escape(key) + "\":";
+                append_variant_json(info.camera, value);
+                first = false;
+            }
+            VariantClear(&value);
+        } while (it->Next() == S_OK);
+        it->Release();
     }
+    info.camera += "}";
+}
 
-    // --- Emit metadata JSON (FIRST line on stderr) ---
+// SDK decode scales from largest to smallest
+static const struct
+{
+    BlackmagicRawResolutionScale scale;
+    uint32_t divisor;
+} kResolutionScales[] = {
+    { blackmagicRawResolutionScaleFull,    1 },
+    { blackmagicRawResolutionScaleHalf,    2 },
+    { blackmagicRawResolutionScaleQuarter, 4 },
+    { blackmagicRawResolutionScaleEighth,  8 },
+};
 
-    json_metadata(timecode.c_str(), fps_num, fps_den, width, height, frame_count);
-    fflush(stderr);
+static uint32_t resolution_scale_divisor(BlackmagicRawResolutionScale scale)
+{
+    for (const auto& s : kResolutionScales)
+        if (s.scale == scale)
+            return s.divisor;
+    return 1;
+}
+
+// Smallest decode scale, no larger than `requested`, whose frames still
+// cover target_width x target_height; the resizer does the rest.
+static BlackmagicRawResolutionScale pick_resolution_scale(
+    BlackmagicRawResolutionScale requested, uint32_t width, uint32_t height,
+    uint32_t target_width, uint32_t target_height)
+{
+    BlackmagicRawResolutionScale best = requested;
+    uint32_t min_divisor = resolution_scale_divisor(requested);
+    for (const auto& s : kResolutionScales)
+    {
+        if (s.divisor < min_divisor)
+            continue;
+        if (width / s.divisor < target_width || height / s.divisor < target_height)
+            break;
+        best = s.scale;
+    }
+    return best;
+}
+
+// ---------------------------------------------------------------------------
+// --serve scrub: single frames at any scale (see frame_server.h)
+// ---------------------------------------------------------------------------
+//
+// A frame is a read job and its decode-and-process job, as in a clip's
+// decode, carried through the SDK with the asking worker's ScrubJob as the
+// JobTag's context; the worker waits for ProcessComplete. rgb24 and YUV
+// leave through a post stage per scale, the other formats are copied out.
+
+class ScrubDecoder : public IBlackmagicRawCallback, public ScrubSource
+{
+public:
+    // `width` x `height`: the clip's full resolution
+    ScrubDecoder(IBlackmagicRawClip* clip, uint32_t width, uint32_t height, PixFmt pix_fmt)
+        : m_ref(1)
+        , m_clip(clip)
+        , m_width(width)
+        , m_height(height)
+        , m_pix_fmt(pix_fmt)
+        , m_jobs(this, report_stream(), report_input())
+    {}
+
+    // Sets up the post stage of every scale. On failure returns false and
+    // sets `error`.
+    bool init(YuvRange range, std::string& error)
+    {
+        if (!PostProcessor::supports(m_pix_fmt))
+            return true;
+        RgbSource source = pix_fmt_bit_depth(m_pix_fmt) > 8 ? RgbSource::RGB16 : RgbSource::RGBA8;
+        for (size_t i = 0; i < kScaleCount; i++)
+        {
+            uint32_t divisor = kResolutionScales[i].divisor;
+            m_post[i].reset(new PostProcessor());
+            if (!m_post[i]->init(source, m_width / divisor, m_height / divisor, m_pix_fmt, range,
+                                 nullptr, error))
+                return false;
+        }
+        return true;
+    }
+
+    // Blocks until every job has completed
+    void wait_idle() { m_jobs.wait_idle(); }
+
+    // ScrubSource
+    bool frame_size(uint32_t scale, uint32_t& width, uint32_t& height, size_t& bytes) override
+    {
+        if (scale_index(scale) < 0)
+            return false;
+        width = m_width / scale;
+        height = m_height / scale;
+        bytes = pix_fmt_frame_bytes(m_pix_fmt, width, height);
+        return width != 0 && height != 0;
+    }
+
+    bool decode(uint64_t frame, uint32_t scale, uint8_t* out, std::string& error) override
+    {
+        ScrubJob job;
+        job.tag.frame_idx = frame;
+        job.tag.context = &job;
+        job.index = scale_index(scale);
+        job.out = out;
+        if (job.index < 0)
+        {
+            error = "No decode scale 1/" + std::to_string(scale);
+            return false;
+        }
+
+        IBlackmagicRawJob* read_job = nullptr;
+        HRESULT hr = m_clip->CreateJobReadFrame(frame, &read_job);
+        if (FAILED(hr) || !read_job)
+        {
+            error = "CreateJobReadFrame failed at frame " + std::to_string(frame);
+            return false;
+        }
+        hr = m_jobs.submit(read_job, &job.tag);
+        if (FAILED(hr))
+        {
+            read_job->Release();
+            error = "Read job submit failed at frame " + std::to_string(frame);
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.finished.wait(lock, [&]{ return job.done; });
+        error = job.error;
+        return error.empty();
+    }
+
+    // IUnknown
+    virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void**) override
+    {
+        return E_NOINTERFACE;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE AddRef() override
+    {
+        return ++m_ref;
+    }
+
+    virtual ULONG STDMETHODCALLTYPE Release() override
+    {
+        ULONG ref = --m_ref;
+        if (ref == 0) delete this;
+        return ref;
+    }
+
+    // IBlackmagicRawCallback
+    virtual void STDMETHODCALLTYPE ReadComplete(
+        IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawFrame* frame) override
+    {
+        JobTag* tag = job_tag(job);
+        ScrubJob* scrub = (ScrubJob*)tag->context;
+
+        IBlackmagicRawJob* decode_job = nullptr;
+        if (FAILED(result))
+            finish(scrub, "ReadComplete failed");
+        else
+        {
+            frame->SetResourceFormat(resource_format_for(m_pix_fmt));
+            if (kResolutionScales[scrub->index].scale != blackmagicRawResolutionScaleFull)
+                frame->SetResolutionScale(kResolutionScales[scrub->index].scale);
+            HRESULT hr = frame->CreateJobDecodeAndProcessFrame(nullptr, nullptr, &decode_job);
+            if (FAILED(hr) || !decode_job)
+                finish(scrub, "CreateJobDecodeAndProcessFrame failed");
+            else if (FAILED(m_jobs.submit(decode_job, tag)))
+            {
+                decode_job->Release();
+                finish(scrub, "Decode job submit failed");
+            }
+        }
+        if (job) job->Release();
+    }
+
+    virtual void STDMETHODCALLTYPE DecodeComplete(
+        IBlackmagicRawJob* job, HRESULT) override
+    {
+        if (job) job->Release();
+    }
+
+    virtual void STDMETHODCALLTYPE ProcessComplete(
+        IBlackmagicRawJob* job, HRESULT result,
+        IBlackmagicRawProcessedImage* processed_image) override
+    {
+        ScrubJob* scrub = (ScrubJob*)job_tag(job)->context;
+        uint32_t divisor = kResolutionScales[scrub->index].divisor;
+
+        uint32_t width = 0, height = 0;
+        void* pixel_data = nullptr;
+        if (SUCCEEDED(result) && processed_image)
+        {
+            processed_image->GetWidth(&width);
+            processed_image->GetHeight(&height);
+            processed_image->GetResource(&pixel_data);
+        }
+
+        if (!pixel_data)
+            finish(scrub, "ProcessComplete failed");
+        else if (width != m_width / divisor || height != m_height / divisor)
+            finish(scrub, "Processed image size differs from the planned decode size");
+        else
+        {
+            // Several frames decode at once, so each post-processes
+            // single-threaded
+            const PostProcessor* post = m_post[scrub->index].get();
+            if (post)
+                post->run((const uint8_t*)pixel_data, scrub->out, nullptr);
+            else
+                copy_frame((const uint8_t*)pixel_data, scrub->out,
+                           pix_fmt_frame_bytes(m_pix_fmt, width, height), nullptr);
+            finish(scrub, nullptr);
+        }
+        if (job) job->Release();
+    }
+
+    virtual void STDMETHODCALLTYPE TrimProgress(IBlackmagicRawJob*, float) override {}
+    virtual void STDMETHODCALLTYPE TrimComplete(IBlackmagicRawJob*, HRESULT) override {}
+    virtual void STDMETHODCALLTYPE SidecarMetadataParseWarning(
+        IBlackmagicRawClip*, const char*, uint32_t, const char*) override {}
+    virtual void STDMETHODCALLTYPE SidecarMetadataParseError(
+        IBlackmagicRawClip*, const char*, uint32_t, const char*) override {}
+    virtual void STDMETHODCALLTYPE PreparePipelineComplete(void*, HRESULT) override {}
+
+private:
+    static constexpr size_t kScaleCount = sizeof(kResolutionScales) / sizeof(kResolutionScales[0]);
+
+    // One decode, on the stack of the worker waiting for it
+    struct ScrubJob
+    {
+        JobTag tag;
+        int index = -1; // into kResolutionScales
+        uint8_t* out = nullptr;
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+        std::string error;
+    };
+
+    static int scale_index(uint32_t scale)
+    {
+        for (size_t i = 0; i < kScaleCount; i++)
+            if (kResolutionScales[i].divisor == scale)
+                return (int)i;
+        return -1;
+    }
+
+    static void finish(ScrubJob* scrub, const char* error)
+    {
+        std::lock_guard<std::mutex> lock(scrub->mutex);
+        if (error)
+            scrub->error = error;
+        scrub->done = true;
+        scrub->finished.notify_all();
+    }
+
+    ~ScrubDecoder() = default;
+
+    std::atomic<ULONG> m_ref;
+    IBlackmagicRawClip* m_clip;
+    uint32_t m_width;
+    uint32_t m_height;
+    PixFmt m_pix_fmt;
+    JobGroup m_jobs;
+    std::unique_ptr<PostProcessor> m_post[kScaleCount];
+};
+
+// ---------------------------------------------------------------------------
+// Audio extraction (Phase 3)
+// ---------------------------------------------------------------------------
+
+// A clip's audio, read front to back a piece at a time as interleaved
+// little-endian PCM
+class AudioStream
+{
+public:
+    AudioStream() = default;
+    ~AudioStream()
+    {
+        if (m_audio)
+            m_audio->Release();
+    }
+
+    AudioStream(const AudioStream&) = delete;
+    AudioStream& operator=(const AudioStream&) = delete;
+
+    // On failure (also for a clip without audio) returns false and sets `error`
+    bool open(IBlackmagicRawClip* clip, std::string& error)
+    {
+        HRESULT hr = clip->QueryInterface(IID_IBlackmagicRawClipAudio, (void**)&m_audio);
+        if (FAILED(hr) || !m_audio)
+        {
+            m_audio = nullptr;
+            error = "No audio in BRAW clip";
+            return false;
+        }
+
+        hr = m_audio->GetAudioSampleCount(&m_sample_count);
+        if (FAILED(hr) || m_sample_count == 0) { error = "No audio samples in BRAW clip"; return false; }
+        hr = m_audio->GetAudioBitDepth(&m_bits_per_sample);
+        if (FAILED(hr)) { error = "GetAudioBitDepth failed"; return false; }
+        hr = m_audio->GetAudioChannelCount(&m_channels);
+        if (FAILED(hr)) { error = "GetAudioChannelCount failed"; return false; }
+        hr = m_audio->GetAudioSampleRate(&m_sample_rate);
+        if (FAILED(hr)) { error = "GetAudioSampleRate failed"; return false; }
+        return true;
+    }
+
+    // Appends the samples up to `end` (per channel, capped at the end of the
+    // clip) to `out`. Returns false once the SDK fails to deliver; later
+    // calls then add nothing.
+    bool read_until(uint64_t end, std::vector<uint8_t>& out)
+    {
+        // Chunks of at most 48000 samples (as recommended by SDK samples)
+        static constexpr uint32_t kChunkSamples = 48000;
+        const size_t block = (size_t)m_channels * m_bits_per_sample / 8;
+
+        end = std::min(end, m_sample_count);
+        while (!m_failed && m_position < end)
+        {
+            uint32_t want = (uint32_t)std::min<uint64_t>(kChunkSamples, end - m_position);
+            size_t at = out.size();
+            out.resize(at + want * block);
+            uint32_t samples_read = 0;
+            uint32_t bytes_read = 0;
+            HRESULT hr = m_audio->GetAudioSamples((int64_t)m_position, out.data() + at,
+                                                  (uint32_t)(want * block), want,
+                                                  &samples_read, &bytes_read);
+            m_failed = FAILED(hr) || samples_read == 0;
+            out.resize(at + (m_failed ? 0 : std::min<size_t>(bytes_read, want * block)));
+            m_position += m_failed ? 0 : samples_read;
+        }
+        return !m_failed;
+    }
+
+    // Continues reading at `position` (capped at the end of the clip)
+    void skip_to(uint64_t position) { m_position = std::min(position, m_sample_count); }
+
+    uint64_t sample_count() const { return m_sample_count; }
+    uint64_t position() const { return m_position; }
+    uint32_t sample_rate() const { return m_sample_rate; }
+    uint32_t channels() const { return m_channels; }
+    uint32_t bits_per_sample() const { return m_bits_per_sample; }
+
+private:
+    IBlackmagicRawClipAudio* m_audio = nullptr;
+    uint64_t m_sample_count = 0; // per channel
+    uint64_t m_position = 0;     // next sample to read
+    uint32_t m_sample_rate = 0;
+    uint32_t m_channels = 0;
+    uint32_t m_bits_per_sample = 0;
+    bool m_failed = false;
+};
+
+// The first audio sample of `frame`, so that a frame range's audio starts
+// where the previous range's ended
+static uint64_t frame_audio_start(uint64_t frame, uint32_t sample_rate,
+                                  uint32_t fps_num, uint32_t fps_den)
+{
+    return fps_num ? frame * sample_rate * fps_den / fps_num : 0;
+}
+
+// Audio of frames [first_frame, end_frame) of a clip with `frame_count`
+// frames, as samples [start, end); a range that ends with the clip takes
+// whatever audio is left
+struct AudioRange
+{
+    uint64_t start = 0;
+    uint64_t end = UINT64_MAX;
+};
+
+static AudioRange frame_audio_range(uint64_t first_frame, uint64_t end_frame, uint64_t frame_count,
+                                    uint32_t sample_rate, uint32_t fps_num, uint32_t fps_den)
+{
+    AudioRange range;
+    range.start = frame_audio_start(first_frame, sample_rate, fps_num, fps_den);
+    if (end_frame < frame_count)
+        range.end = frame_audio_start(end_frame, sample_rate, fps_num, fps_den);
+    return range;
+}
+
+// Streams the audio of frames [first_frame, end_frame) into a WAV (RF64
+// past 4 GiB) one chunk at a time, so memory stays at one chunk whatever
+// the clip length. Audio the SDK stops delivering partway is cut off there.
+static bool extract_audio(IBlackmagicRawClip* clip, const char* output_path,
+                          uint64_t first_frame, uint64_t end_frame, uint64_t frame_count,
+                          uint32_t fps_num, uint32_t fps_den)
+{
+    static constexpr uint64_t kChunkSamples = 48000;
+
+    AudioStream audio;
+    WavWriter wav;
+    std::string error;
+    if (!audio.open(clip, error)
+        || !wav.open(output_path, audio.sample_rate(), audio.channels(), audio.bits_per_sample(), error))
+    {
+        json_error(error.c_str());
+        return false;
+    }
+
+    AudioRange range = frame_audio_range(first_frame, end_frame, frame_count,
+                                         audio.sample_rate(), fps_num, fps_den);
+    audio.skip_to(range.start);
+    uint64_t end = std::min(range.end, audio.sample_count());
+
+    std::vector<uint8_t> chunk;
+    bool delivering = true;
+    while (delivering && audio.position() < end)
+    {
+        chunk.clear();
+        delivering = audio.read_until(std::min(audio.position() + kChunkSamples, end), chunk);
+        if (!wav.write(chunk.data(), chunk.size()))
+        {
+            json_error("Failed to write WAV file");
+            return false;
+        }
+    }
+
+    if (!wav.finish(error))
+    {
+        json_error(error.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// CLI parsing
+// ---------------------------------------------------------------------------
+
+enum class Engine
+{
+    Callback, // CreateJobDecodeAndProcessFrame, SDK-managed buffers
+    Manual,   // ManualEngine on IBlackmagicRawManualDecoderFlow1
+};
+
+struct Options
+{
+    std::string input_file;    // the clip; the first of `inputs`
+    std::vector<std::string> inputs; // --probe-only and a playlist take several
+    std::string input_list;    // --input-list, "-" = stdin
+    std::vector<std::string> outputs; // a playlist's, one per clip (see playlist.h)
+    uint32_t max_clips = 4;    // playlist clips decoding at once
+    uint32_t clips_at_once = 1; // a playlist's, for the per-clip defaults
+    std::string clip_cache = clip_cache_default_path("braw-bridge"); // empty = off
+    std::string extract_audio_path;
+    BlackmagicRawResolutionScale resolution_scale = blackmagicRawResolutionScaleFull;
+    uint32_t inflight = 0; // 0 = adaptive default
+    uint32_t write_queue = 0; // 0 = adaptive default
+    int convert_threads = -1; // -1 = default (min(4, cores))
+    HugePageMode huge_pages = HugePageMode::Advise;
+    bool prefault = true;
+    bool resource_pool = true;
+    Engine engine = Engine::Callback;
+    uint32_t read_ahead = 0;   // manual engine; 0 = 2 x inflight
+    uint32_t process_jobs = 0; // manual engine; 0 = inflight
+    uint32_t threads = 0;      // SDK CPU threads; 0 = SDK default
+    bool set_isa = false;      // false = let the SDK pick
+    BlackmagicRawInstructionSet isa = blackmagicRawInstructionSetAVX2;
+    int32_t output_width = 0;  // 0 = decode size; -1/-2 = follow aspect
+    int32_t output_height = 0;
+    ResizeFilter resize_filter = ResizeFilter::Lanczos;
+    PixFmt pix_fmt = PixFmt::RGB24;
+    YuvRange yuv_range = YuvRange::Limited;
+    int shm_socket = -1;       // -1 = frames on stdout
+    std::string encode_path;   // empty = frames on stdout
+    std::string encode_codec = "h264";
+    bool mux_nut = false;      // stdout: NUT stream with audio instead of bare frames
+    int output_fd = STDOUT_FILENO; // a --serve request's fd otherwise
+    uint64_t first_frame = 0;  // --start-frame; a thumbnail request's one frame
+    uint64_t frame_limit = 0;  // --frame-count; 0 = to the end of the clip
+    uint32_t frame_step = 1;   // --frame-step; 1 = every frame
+    uint32_t conform_num = 0;  // --conform-fps; 0 = the clip's rate
+    uint32_t conform_den = 1;
+    std::string thumbnails_dir; // --thumbnails
+    std::vector<ThumbnailPick> thumbnail_picks; // --thumbnail-at
+    ImageFormat thumbnail_format = ImageFormat::Jpeg;
+    int thumbnail_quality = 85;
+    uint32_t sprite_columns = 0; // --sprite; 0 = one file per thumbnail
+    std::string serve_socket;  // --serve
+    uint32_t max_requests = 4;
+    uint32_t frame_cache_mb = 512; // scrub: decoded frames kept
+    uint32_t prefetch = 8;     // scrub: frames decoded ahead during playback
+    bool pix_fmt_given = false;
+    bool probe_only = false;
+    bool self_check = false;
+    bool bench_transport = false;
+    bool capabilities = false;
+};
+
+static bool parse_args(int argc, char* argv[], Options& opts)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--input") == 0 || strcmp(argv[i], "-i") == 0) && i + 1 < argc)
+        {
+            opts.inputs.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--input-list") == 0 && i + 1 < argc)
+        {
+            opts.input_list = argv[++i];
+        }
+        else if (strcmp(argv[i], "--clip-cache") == 0 && i + 1 < argc)
+        {
+            i++;
+            opts.clip_cache = strcmp(argv[i], "off") == 0 ? std::string() : std::string(argv[i]);
+        }
+        else if (strcmp(argv[i], "--debayer") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "full") == 0)
+                opts.resolution_scale = blackmagicRawResolutionScaleFull;
+            else if (strcmp(argv[i], "half") == 0)
+                opts.resolution_scale = blackmagicRawResolutionScaleHalf;
+            else if (strcmp(argv[i], "quarter") == 0)
+                opts.resolution_scale = blackmagicRawResolutionScaleQuarter;
+            else if (strcmp(argv[i], "eighth") == 0)
+                opts.resolution_scale = blackmagicRawResolutionScaleEighth;
+            else
+            {
+                json_error("Invalid debayer option. Use: full, half, quarter, eighth");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--extract-audio") == 0 && i + 1 < argc)
+        {
+            opts.extract_audio_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--inflight") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --inflight value. Use: 1..64");
+                return false;
+            }
+            opts.inflight = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--write-queue") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --write-queue value. Use: 1..64");
+                return false;
+            }
+            opts.write_queue = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--convert-threads") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 0 || n > 64 || (n == 0 && strcmp(argv[i], "0") != 0))
+            {
+                json_error("Invalid --convert-threads value. Use: 0..64");
+                return false;
+            }
+            opts.convert_threads = n;
+        }
+        else if (strcmp(argv[i], "--hugepages") == 0 && i + 1 < argc)
+        {
+            if (!parse_huge_page_mode(argv[++i], opts.huge_pages))
+            {
+                json_error("Invalid --hugepages value. Use: off, thp, hugetlb");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--no-prefault") == 0)
+        {
+            opts.prefault = false;
+        }
+        else if (strcmp(argv[i], "--no-resource-pool") == 0)
+        {
+            opts.resource_pool = false;
+        }
+        else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "callback") == 0)
+                opts.engine = Engine::Callback;
+            else if (strcmp(argv[i], "manual") == 0)
+                opts.engine = Engine::Manual;
+            else
+            {
+                json_error("Invalid --engine value. Use: callback, manual");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 0 || n > 1024 || (n == 0 && strcmp(argv[i], "0") != 0))
+            {
+                json_error("Invalid --threads value. Use: 0..1024 (0 = SDK default)");
+                return false;
+            }
+            opts.threads = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc)
+        {
+            i++;
+            opts.set_isa = true;
+            if (strcmp(argv[i], "auto") == 0)
+                opts.set_isa = false;
+            else if (strcmp(argv[i], "sse41") == 0)
+                opts.isa = blackmagicRawInstructionSetSSE41;
+            else if (strcmp(argv[i], "avx") == 0)
+                opts.isa = blackmagicRawInstructionSetAVX;
+            else if (strcmp(argv[i], "avx2") == 0)
+                opts.isa = blackmagicRawInstructionSetAVX2;
+            else
+            {
+                json_error("Invalid --isa value. Use: auto, sse41, avx, avx2");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--output-size") == 0 && i + 1 < argc)
+        {
+            if (!parse_output_size(argv[++i], opts.output_width, opts.output_height))
+            {
+                json_error("Invalid --output-size value. Use: WxH (one side may be -1 or -2)");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--resize-filter") == 0 && i + 1 < argc)
+        {
+            if (!parse_resize_filter(argv[++i], opts.resize_filter))
+            {
+                json_error("Invalid --resize-filter value. Use: area, bilinear, lanczos");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--pix-fmt") == 0 && i + 1 < argc)
+        {
+            if (!parse_pix_fmt(argv[++i], opts.pix_fmt)
+                || opts.pix_fmt == PixFmt::BGR24 || opts.pix_fmt == PixFmt::DPX10)
+            {
+                json_error("Invalid --pix-fmt value. Use: rgb24, bgra, rgb48le, gbrp16le, "
+                           "yuv420p, nv12, yuv422p10le, p010le");
+                return false;
+            }
+            opts.pix_fmt_given = true;
+        }
+        else if (strcmp(argv[i], "--yuv-range") == 0 && i + 1 < argc)
+        {
+            if (!parse_yuv_range(argv[++i], opts.yuv_range))
+            {
+                json_error("Invalid --yuv-range value. Use: limited, full");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--read-ahead") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 256)
+            {
+                json_error("Invalid --read-ahead value. Use: 1..256");
+                return false;
+            }
+            opts.read_ahead = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--process-jobs") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --process-jobs value. Use: 1..64");
+                return false;
+            }
+            opts.process_jobs = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--shm-socket") == 0 && i + 1 < argc)
+        {
+            int fd = atoi(argv[++i]);
+            if (fd < 3)
+            {
+                json_error("Invalid --shm-socket value. Use an inherited fd >= 3");
+                return false;
+            }
+            opts.shm_socket = fd;
+        }
+        else if (strcmp(argv[i], "--mux") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "raw") == 0)
+                opts.mux_nut = false;
+            else if (strcmp(argv[i], "nut") == 0)
+                opts.mux_nut = true;
+            else
+            {
+                json_error("Invalid --mux value. Use: raw, nut");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--encode") == 0 && i + 1 < argc)
+        {
+            opts.encode_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--encode-codec") == 0 && i + 1 < argc)
+        {
+            PixFmt unused;
+            opts.encode_codec = argv[++i];
+            if (!AvEncoder::codec_pix_fmt(opts.encode_codec, unused))
+            {
+                json_error("Invalid --encode-codec value. Use: h264, h265, prores_proxy, "
+                           "prores_lt, prores_422, prores_hq");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            opts.serve_socket = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--start-frame") == 0 || strcmp(argv[i], "--frame-count") == 0)
+                 && i + 1 < argc)
+        {
+            bool start = strcmp(argv[i], "--start-frame") == 0;
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long n = strtoull(argv[++i], &end, 10);
+            if (errno != 0 || end == argv[i] || *end != '\0' || argv[i][0] == '-' || (!start && n == 0))
+            {
+                json_error(start ? "Invalid --start-frame value. Use: >= 0"
+                                 : "Invalid --frame-count value. Use: >= 1");
+                return false;
+            }
+            (start ? opts.first_frame : opts.frame_limit) = (uint64_t)n;
+        }
+        else if (strcmp(argv[i], "--frame-step") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 1000)
+            {
+                json_error("Invalid --frame-step value. Use: 1..1000");
+                return false;
+            }
+            opts.frame_step = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--conform-fps") == 0 && i + 1 < argc)
+        {
+            if (!parse_fps(argv[++i], opts.conform_num, opts.conform_den))
+            {
+                json_error("Invalid --conform-fps value. Use: num/den or num, e.g. 24000/1001");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--thumbnails") == 0 && i + 1 < argc)
+        {
+            opts.thumbnails_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--thumbnail-at") == 0 && i + 1 < argc)
+        {
+            if (!parse_thumbnail_picks(argv[++i], opts.thumbnail_picks))
+            {
+                json_error("Invalid --thumbnail-at value. Use: first, last, a frame, P% or "
+                           "every:S, comma separated");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--thumbnail-format") == 0 && i + 1 < argc)
+        {
+            if (!parse_image_format(argv[++i], opts.thumbnail_format))
+            {
+                json_error("Invalid --thumbnail-format value. Use: jpeg, png");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--thumbnail-quality") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 100)
+            {
+                json_error("Invalid --thumbnail-quality value. Use: 1..100");
+                return false;
+            }
+            opts.thumbnail_quality = n;
+        }
+        else if (strcmp(argv[i], "--sprite") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 100)
+            {
+                json_error("Invalid --sprite value. Use: 1..100 columns");
+                return false;
+            }
+            opts.sprite_columns = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            opts.outputs.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-clips") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --max-clips value. Use: 1..64");
+                return false;
+            }
+            opts.max_clips = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--frame-cache-mb") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 16 || n > 65536)
+            {
+                json_error("Invalid --frame-cache-mb value. Use: 16..65536");
+                return false;
+            }
+            opts.frame_cache_mb = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            long n = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || n < 0 || n > 64)
+            {
+                json_error("Invalid --prefetch value. Use: 0..64");
+                return false;
+            }
+            opts.prefetch = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--max-requests") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --max-requests value. Use: 1..64");
+                return false;
+            }
+            opts.max_requests = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--probe-only") == 0)
+        {
+            opts.probe_only = true;
+        }
+        else if (strcmp(argv[i], "--self-check") == 0)
+        {
+            opts.self_check = true;
+        }
+        else if (strcmp(argv[i], "--bench-transport") == 0)
+        {
+            opts.bench_transport = true;
+        }
+        else if (strcmp(argv[i], "--capabilities") == 0)
+        {
+            opts.capabilities = true;
+        }
+        else
+        {
+            fprintf(report_stream(), "Unknown argument: %s\n", argv[i]);
+            json_error("Invalid arguments");
+            return false;
+        }
+    }
+
+    if (opts.inputs.empty() && opts.input_list.empty() && !opts.self_check
+        && !opts.bench_transport && !opts.capabilities && opts.serve_socket.empty())
+    {
+        json_error("Missing --input <file.braw>");
+        return false;
+    }
+
+    if (!opts.thumbnails_dir.empty())
+    {
+        if (!opts.encode_path.empty() || opts.mux_nut || opts.shm_socket >= 0
+            || !opts.extract_audio_path.empty() || opts.probe_only || !opts.outputs.empty()
+            || opts.first_frame || opts.frame_limit || opts.frame_step > 1 || opts.conform_num)
+        {
+            json_error("--thumbnails writes images only; drop --encode, --mux, --shm-socket, "
+                       "--extract-audio, --probe-only, --output and the frame range and step");
+            return false;
+        }
+        if (opts.pix_fmt_given && opts.pix_fmt != PixFmt::RGB24)
+        {
+            json_error("--thumbnails needs --pix-fmt rgb24");
+            return false;
+        }
+        opts.pix_fmt = PixFmt::RGB24;
+        if (opts.output_width == 0)
+        {
+            opts.output_width = 320;
+            opts.output_height = -2;
+        }
+        if (opts.thumbnail_picks.empty())
+            parse_thumbnail_picks(opts.sprite_columns ? "every:10" : "first", opts.thumbnail_picks);
+    }
+    else if (!opts.thumbnail_picks.empty() || opts.sprite_columns)
+    {
+        json_error("--thumbnail-at and --sprite need --thumbnails <dir>");
+        return false;
+    }
+
+    if (!opts.encode_path.empty())
+    {
+        if (opts.shm_socket >= 0)
+        {
+            json_error("--encode writes the output itself; drop --shm-socket");
+            return false;
+        }
+        // The encoder's input format unless one was asked for
+        if (!opts.pix_fmt_given)
+            AvEncoder::codec_pix_fmt(opts.encode_codec, opts.pix_fmt);
+    }
+
+    if (opts.frame_step > 1 && opts.conform_num)
+    {
+        json_error("--frame-step and --conform-fps both pick the frames; use one");
+        return false;
+    }
+
+    if (opts.mux_nut)
+    {
+        if (opts.shm_socket >= 0 || !opts.encode_path.empty())
+        {
+            json_error("--mux nut is for frames on stdout; drop --shm-socket and --encode");
+            return false;
+        }
+        if (!NutMuxer::supports(opts.pix_fmt))
+        {
+            json_error("--mux nut needs --pix-fmt rgb24, bgra, rgb48le, gbrp16le, "
+                       "yuv420p, nv12 or yuv422p10le");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Adds the --input-list clips ("-" reads `list_fd`) and picks the clip of a
+// single-clip run. Several clips to decode make a playlist, each clip with
+// its output from --output or its list line. Reports and returns false on
+// failure.
+static bool load_inputs(Options& opts, int list_fd)
+{
+    std::string error;
+    size_t listed = opts.inputs.size();
+    if (!opts.input_list.empty() && !load_input_list(opts.input_list, list_fd, opts.inputs, error))
+    {
+        json_error(error.c_str());
+        return false;
+    }
+    if (opts.inputs.empty())
+    {
+        json_error("Missing --input <file.braw>");
+        return false;
+    }
+    opts.input_file = opts.inputs[0];
+    if (opts.probe_only || !opts.thumbnails_dir.empty()
+        || (opts.inputs.size() == 1 && opts.outputs.empty()))
+    {
+        if (!opts.outputs.empty())
+        {
+            json_error("--output is for decoding; drop it with --probe-only and --thumbnails");
+            return false;
+        }
+        return true;
+    }
+
+    // --- A playlist ---
+
+    split_output_specs(opts.inputs, listed, opts.outputs);
+    if (opts.outputs.size() != opts.inputs.size()
+        || std::find(opts.outputs.begin(), opts.outputs.end(), std::string()) != opts.outputs.end())
+    {
+        json_error("Each clip of a playlist needs its own --output (or a \"clip<TAB>output\" "
+                   "--input-list line)");
+        return false;
+    }
+    if (!opts.extract_audio_path.empty() || opts.shm_socket >= 0 || !opts.encode_path.empty())
+    {
+        json_error("--extract-audio, --shm-socket and --encode take a single clip; a playlist "
+                   "clip encodes to an encode:PATH output");
+        return false;
+    }
+    for (const std::string& spec : opts.outputs)
+    {
+        OutputSpec output;
+        if (!parse_output_spec(spec, output, error))
+        {
+            json_error(error.c_str());
+            return false;
+        }
+        if (output.kind == OutputSpec::Kind::Encode && opts.mux_nut)
+        {
+            json_error("--mux nut is for frames; drop it for encode:PATH outputs");
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// SDK setup, once per process
+// ---------------------------------------------------------------------------
+
+// The codec and what is installed on it. A command-line run decodes its one
+// clip on it; --serve decodes the clips of all running requests on it side
+// by side.
+struct Sdk
+{
+    IBlackmagicRawFactory* factory = nullptr;
+    IBlackmagicRaw* codec = nullptr;
+    PooledResourceManager* resource_manager = nullptr;
+    CallbackRouter* router = nullptr;
+    uint32_t threads = 0; // SDK worker threads, for the metadata line
+    std::string isa;      // SDK instruction set, likewise
+};
+
+static void close_sdk(Sdk& sdk)
+{
+    if (sdk.codec)
+    {
+        sdk.codec->SetCallback(nullptr);
+        sdk.codec->Release();
+    }
+    if (sdk.router) sdk.router->Release();
+    if (sdk.resource_manager) sdk.resource_manager->Release();
+    if (sdk.factory) sdk.factory->Release();
+    sdk = Sdk();
+}
+
+// Loads the SDK, creates the codec with `decode_threads` workers (0 = SDK
+// default) and installs the resource pool and callback router. Reports
+// and returns false on failure.
+static bool open_sdk(const Options& opts, uint32_t decode_threads, Sdk& sdk)
+{
+    // Resolve SDK library directory relative to executable via /proc/self/exe
+    std::string lib_dir;
+    {
+        char exe_path[4096] = {};
+        ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+        if (len > 0)
+        {
+            exe_path[len] = '\0';
+            std::string exe(exe_path);
+            auto pos = exe.rfind('/');
+            if (pos != std::string::npos)
+                lib_dir = exe.substr(0, pos) + "/../sdk/Libraries/Linux";
+            else
+                lib_dir = "../sdk/Libraries/Linux";
+        }
+        else
+        {
+            lib_dir = "../sdk/Libraries/Linux";
+        }
+    }
+
+    // CreateBlackmagicRawFactoryInstanceFromPath returns the factory directly
+    sdk.factory = CreateBlackmagicRawFactoryInstanceFromPath(lib_dir.c_str());
+    if (!sdk.factory)
+    {
+        json_error("Failed to create BRAW factory. Is the SDK installed under braw-bridge/sdk/?");
+        return false;
+    }
+
+    HRESULT hr = sdk.factory->CreateCodec(&sdk.codec);
+    if (FAILED(hr) || !sdk.codec)
+    {
+        json_error("Failed to create BRAW codec");
+        sdk.codec = nullptr;
+        close_sdk(sdk);
+        return false;
+    }
+
+    // Pool the SDK's CPU buffers (set before OpenClip so every allocation
+    // goes through it)
+    if (opts.resource_pool)
+        sdk.resource_manager = install_resource_manager(sdk.codec);
+
+    // Size the SDK's worker pool and pick its instruction set before any
+    // clip is opened
+    if (!configure_codec(sdk.codec, decode_threads, opts.set_isa, opts.isa, sdk.threads, sdk.isa))
+    {
+        close_sdk(sdk);
+        return false;
+    }
+
+    // Every clip's jobs complete through the router (see callback_router.h)
+    sdk.router = new CallbackRouter();
+    sdk.codec->SetCallback(sdk.router);
+    return true;
+}
+
+// With --encode the encoder shares the --threads budget (or the cores)
+// with the SDK: half each, since both are busy for the whole clip. The
+// encoders of a playlist's clips split their half.
+static unsigned encoder_threads_for(const Options& opts)
+{
+    unsigned budget = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+    return std::max(1u, budget / 2 / opts.clips_at_once);
+}
+
+// Whether the run encodes: --encode, or a playlist clip with encode:PATH
+static bool encodes(const Options& opts)
+{
+    return !opts.encode_path.empty()
+        || std::any_of(opts.outputs.begin(), opts.outputs.end(), [](const std::string& spec)
+           {
+               OutputSpec output;
+               std::string unused;
+               return parse_output_spec(spec, output, unused)
+                   && output.kind == OutputSpec::Kind::Encode;
+           });
+}
+
+// ---------------------------------------------------------------------------
+// One clip: probe, audio extraction or decode
+// ---------------------------------------------------------------------------
+
+// Does what `opts` asks for with one clip on the shared codec and returns
+// the exit code of the run. Everything goes to report_stream().
+static int run_clip(Sdk& sdk, Options& opts)
+{
+    IBlackmagicRaw* codec = sdk.codec;
+    HRESULT hr;
+
+    bool encoding = !opts.encode_path.empty();
+    unsigned encoder_threads = encoding ? encoder_threads_for(opts) : 0;
+
+    // --- Clip properties ---
+    //
+    // A probe of an unchanged file is answered from the clip cache without
+    // opening it; one that opens the clip adds it to the cache. --thumbnails
+    // probes too, but needs the clip open.
+
+    bool thumbnailing = !opts.thumbnails_dir.empty();
+    bool probing = opts.probe_only || thumbnailing;
+    ClipInfo info;
+    ClipFingerprint fingerprint;
+    bool cacheable = probing && !opts.clip_cache.empty()
+        && clip_fingerprint(opts.input_file, fingerprint);
+    bool cached = cacheable && !thumbnailing
+        && clip_cache_lookup(opts.clip_cache, opts.input_file, fingerprint, info);
+
+    IBlackmagicRawClip* clip = nullptr;
+    if (!cached)
+    {
+        hr = codec->OpenClip(opts.input_file.c_str(), &clip);
+        if (FAILED(hr) || !clip)
+        {
+            json_error("Failed to open BRAW clip");
+            return 1;
+        }
+        if (!read_clip_info(clip, info))
+        {
+            clip->Release();
+            return 1;
+        }
+        if (probing)
+            read_clip_extras(clip, info);
+        if (cacheable)
+        {
+            std::string error;
+            if (!clip_cache_store(opts.clip_cache, opts.input_file, fingerprint, info, error))
+                json_warning(error.c_str());
+        }
+    }
+
+    uint64_t frame_count = info.frame_count;
+    uint32_t fps_num = info.fps_num, fps_den = info.fps_den;
+    uint32_t width = info.width, height = info.height;
+
+    // --output-size: decode at the smallest SDK scale that still covers the
+    // target, resample the rest
+    uint32_t output_width = 0, output_height = 0;
+    if (opts.output_width != 0)
+    {
+        int32_t w = opts.output_width, h = opts.output_height;
+        resolve_output_size(w, h, width, height, info.pixel_aspect);
+        output_width = (uint32_t)w;
+        output_height = (uint32_t)h;
+        opts.resolution_scale = pick_resolution_scale(opts.resolution_scale, width, height,
+                                                      output_width, output_height);
+    }
+
+    // Adjust dimensions for debayer resolution scale
+    uint32_t divisor = resolution_scale_divisor(opts.resolution_scale);
+    width /= divisor;
+    height /= divisor;
+
+    if (output_width == 0)
+    {
+        output_width = width;
+        output_height = height;
+    }
+
+    // Frames [first_frame, end_frame) are decoded: --start-frame and
+    // --frame-count, a thumbnail request's one frame, otherwise all of them.
+    // A range is e.g. one segment of a long clip encoded in parallel; with
+    // the audio of frame_audio_range() and the first frame's timecode, the
+    // segments of a clip concatenate to the whole of it.
+    uint64_t first_frame = opts.first_frame;
+    uint64_t end_frame = opts.frame_limit
+        ? std::min(frame_count, first_frame + opts.frame_limit) : frame_count;
+    bool ranged = first_frame != 0 || end_frame != frame_count;
+    if (ranged && !opts.probe_only && first_frame >= frame_count)
+    {
+        json_error("Frame is past the end of the clip");
+        clip->Release();
+        return 1;
+    }
+
+    // --frame-step/--conform-fps: of those, only the frames the output
+    // keeps (every Nth, or e.g. 119.88 fps material as a 23.976 review
+    // proxy). From here on frames count at the output rate: output frames
+    // [out_first, out_end) of out_count, the metadata line adding the
+    // clip's own rate and frame count as "source_*" (see frame_select.h).
+    FrameSelect select;
+    std::string select_error;
+    if (!frame_select_init(select, fps_num, fps_den, opts.probe_only ? 1 : opts.frame_step,
+                           opts.probe_only ? 0 : opts.conform_num, opts.conform_den, select_error))
+    {
+        json_error(select_error.c_str());
+        if (clip)
+            clip->Release();
+        return 1;
+    }
+    uint64_t out_first = select.output_frame(first_frame);
+    uint64_t out_end = select.output_frame(end_frame);
+    uint64_t out_count = select.output_frame(frame_count);
+    if (!opts.probe_only && out_first >= out_end && first_frame < frame_count)
+    {
+        json_error("No frame of the --start-frame/--frame-count range is kept at this frame step");
+        clip->Release();
+        return 1;
+    }
+
+    // --- Handle --extract-audio ---
+
+    if (!opts.extract_audio_path.empty())
+    {
+        bool ok = extract_audio(clip, opts.extract_audio_path.c_str(), out_first, out_end,
+                                out_count, select.fps_num, select.fps_den);
+
+        clip->Release();
+
+        if (ok)
+        {
+            json_done();
+            return 0;
+        }
+        return 1;
+    }
+
+    // The resizer works on 8-bit RGB only
+    if ((output_width != width || output_height != height) && !pix_fmt_resizable(opts.pix_fmt))
+    {
+        json_error("--output-size needs --pix-fmt rgb24, yuv420p or nv12");
+        if (clip)
+            clip->Release();
+        return 1;
+    }
 
+    // The timecode of the first frame emitted
+    uint64_t start_frame = select.clip_frame(out_first);
+    std::string start_timecode = select_timecode(
+        start_frame != 0 && clip ? get_timecode(clip, start_frame) : info.timecode,
+        fps_num, fps_den, select);
+
+    // --- Emit metadata JSON (FIRST line of the report) ---
+
+    std::string extra_fields = probing ? clip_info_json_fields(info, cached)
+                             : ranged ? range_json_fields(first_frame, end_frame, start_timecode)
+                                      : std::string();
+    if (select.sparse())
+        extra_fields += select_json_fields(fps_num, fps_den, frame_count);
+    json_metadata(select_timecode(info.timecode, fps_num, fps_den, select).c_str(),
+                  select.fps_num, select.fps_den, width, height, out_count,
+                  sdk.threads, sdk.isa.c_str(), output_width, output_height,
+                  pix_fmt_name(opts.pix_fmt),
+                  pix_fmt_is_yuv(opts.pix_fmt) ? yuv_range_name(opts.yuv_range) : nullptr,
+                  opts.mux_nut, extra_fields);
+    fflush(report_stream());
+
+    // --probe-only ends with the metadata line, which adds the audio layout
+    // and camera metadata (see probe_batch.h)
     if (opts.probe_only)
     {
-        clip->Release();
-        codec->Release();
-        factory->Release();
+        if (clip)
+            clip->Release();
         return 0;
     }
 
+    if (first_frame >= frame_count)
+    {
+        json_error("Frame is past the end of the clip");
+        clip->Release();
+        return 1;
+    }
+
+    // --thumbnails: output frame k is the k-th picked frame (default: the
+    // first; every 10 s for a sprite), decoded at the smallest scale that
+    // covers --output-size (default 320 wide) into a file of its own or a
+    // tile of the --sprite sheet. A "thumbnail" line follows per file, a
+    // "sprite" line for the sheet (see thumbnails.h).
+    std::vector<uint64_t> thumbnail_frames;
+    ThumbnailSink thumbnails;
+    if (thumbnailing)
+    {
+        ThumbnailConfig thumbnail_config;
+        thumbnail_config.dir = opts.thumbnails_dir;
+        thumbnail_config.clip_name = thumbnail_clip_name(opts.input_file);
+        thumbnail_config.format = opts.thumbnail_format;
+        thumbnail_config.quality = opts.thumbnail_quality;
+        thumbnail_config.columns = opts.sprite_columns;
+        thumbnail_config.tile_width = output_width;
+        thumbnail_config.tile_height = output_height;
+        thumbnail_config.fps_num = fps_num;
+        thumbnail_config.fps_den = fps_den;
+        thumbnail_config.frame_count = frame_count;
+        std::string thumbnail_error;
+        if (!resolve_thumbnail_frames(opts.thumbnail_picks, frame_count, fps_num, fps_den,
+                                      thumbnail_frames, thumbnail_error)
+            || !thumbnails.open(thumbnail_config, thumbnail_frames, thumbnail_error))
+        {
+            json_error(thumbnail_error.c_str());
+            clip->Release();
+            return 1;
+        }
+        out_first = 0;
+        out_end = thumbnail_frames.size();
+    }
+    auto clip_frame_of = [&](uint64_t k)
+    {
+        return thumbnailing ? thumbnail_frames[k] : select.clip_frame(k);
+    };
+
     // --- Process frames ---
+    //
+    // Keep up to `inflight` frames in the SDK at once. Completions arrive out
+    // of order on the callback threads; the main thread drains the reorder
+    // buffer in frame order and tops the pipeline up as slots free.
+    //
+    // The manual engine decodes `inflight` frames at a time but lets reads run
+    // further ahead, so its reorder window is the read-ahead depth.
+
+    uint32_t inflight = opts.inflight ? opts.inflight
+                                      : default_inflight(width, height, opts.clips_at_once);
+    uint32_t window = inflight;
+    if (opts.engine == Engine::Manual)
+        window = opts.read_ahead ? std::max(opts.read_ahead, inflight) : inflight * 2;
+    ReorderBuffer reorder(window);
+
+    // Decode size → --output-size, applied by the post stage below
+    std::unique_ptr<Resizer> resizer;
+    if (output_width != width || output_height != height)
+    {
+        resizer.reset(new Resizer());
+        std::string resize_error;
+        if (!resizer->init(width, height, 4, output_width, output_height,
+                           opts.resize_filter, resize_error))
+        {
+            json_error(resize_error.c_str());
+            clip->Release();
+            return 1;
+        }
+    }
 
-    BrawCallback* callback = new BrawCallback(frame_count, opts.resolution_scale);
-    codec->SetCallback(callback);
+    // rgb24 and YUV (BT.709) leave through the fused post stage: RGBA, or
+    // RGB16 for 10-bit YUV, resized and packed in one pass over row tiles
+    std::unique_ptr<PostProcessor> post;
+    if (PostProcessor::supports(opts.pix_fmt))
+    {
+        post.reset(new PostProcessor());
+        RgbSource source = pix_fmt_bit_depth(opts.pix_fmt) > 8 ? RgbSource::RGB16 : RgbSource::RGBA8;
+        std::string post_error;
+        if (!post->init(source, width, height, opts.pix_fmt, opts.yuv_range, resizer.get(), post_error))
+        {
+            json_error(post_error.c_str());
+            clip->Release();
+            return 1;
+        }
+    }
 
-    for (uint64_t frame_idx = 0; frame_idx < frame_count; frame_idx++)
+    // One output buffer per slot and per queued write, sized for the output
+    // and mapped once for the whole clip. Whole pages, so the writer can
+    // vmsplice them into the pipe.
+    size_t output_frame_bytes = pix_fmt_frame_bytes(opts.pix_fmt, output_width, output_height);
+    uint32_t write_queue = opts.write_queue ? opts.write_queue : default_write_queue(output_frame_bytes);
+    FramePoolConfig pool_config;
+    pool_config.buffer_bytes = output_frame_bytes;
+    pool_config.count = window + write_queue;
+    pool_config.alignment = kFrameWriterAlignment;
+    pool_config.huge_pages = opts.huge_pages;
+    pool_config.prefault = opts.prefault;
+
+    // With --shm-socket the pool lives in the slots of a shared-memory ring
+    // whose fds go over the inherited Unix socket, not stdout (see shm_ring.h)
+    ShmRing ring;
+    std::string pool_error;
+    if (opts.shm_socket >= 0)
     {
-        IBlackmagicRawJob* read_job = nullptr;
-        hr = clip->CreateJobReadFrame(frame_idx, &read_job);
-        if (FAILED(hr) || !read_job)
+        if (!ring.init(opts.pix_fmt, output_width, output_height, output_frame_bytes,
+                       pool_config.count, pool_error)
+            || !ring.send_fds(opts.shm_socket, pool_error))
         {
-            json_error("CreateJobReadFrame failed");
-            break;
+            json_error(pool_error.c_str());
+            clip->Release();
+            return 1;
         }
+        pool_config.external = ring.slots();
+    }
 
-        hr = read_job->Submit();
-        if (FAILED(hr))
+    FramePool frame_pool;
+    if (!frame_pool.init(pool_config, pool_error))
+    {
+        json_error(pool_error.c_str());
+        clip->Release();
+        return 1;
+    }
+
+    // With --mux nut or --encode the clip's audio is read frame by frame and
+    // goes out behind each frame, so memory stays at a frame's worth of
+    // samples whatever the clip length; a clip without audio gets a
+    // video-only stream or file
+    AudioStream audio_stream;
+    bool has_audio = false;
+    if (opts.mux_nut || encoding)
+    {
+        std::string audio_error;
+        has_audio = audio_stream.open(clip, audio_error);
+        if (has_audio)
+            audio_stream.skip_to(frame_audio_start(out_first, audio_stream.sample_rate(),
+                                                   select.fps_num, select.fps_den));
+    }
+
+    // With --encode the writer thread feeds the encoder instead of stdout,
+    // which muxes the proxy with the clip's audio and timecode itself (see
+    // av_encoder.h)
+    AvEncoder encoder;
+    if (encoding)
+    {
+        AvEncoderConfig encoder_config;
+        encoder_config.output_path = opts.encode_path;
+        encoder_config.codec = opts.encode_codec;
+        encoder_config.pix_fmt = opts.pix_fmt;
+        encoder_config.width = output_width;
+        encoder_config.height = output_height;
+        encoder_config.fps_num = select.fps_num;
+        encoder_config.fps_den = select.fps_den;
+        encoder_config.yuv_range = opts.yuv_range;
+        encoder_config.timecode = start_timecode;
+        encoder_config.threads = encoder_threads;
+        if (has_audio)
         {
-            json_error("ReadJob submit failed");
-            read_job->Release();
+            encoder_config.sample_rate = audio_stream.sample_rate();
+            encoder_config.channels = audio_stream.channels();
+            encoder_config.bits_per_sample = audio_stream.bits_per_sample();
+        }
+
+        std::string encoder_error;
+        if (!encoder.open(encoder_config, encoder_error))
+        {
+            json_error(encoder_error.c_str());
+            clip->Release();
+            return 1;
+        }
+    }
+
+    NutMuxer nut;
+    if (opts.mux_nut)
+    {
+        NutAudioFormat audio_format;
+        if (has_audio)
+        {
+            audio_format.sample_rate = audio_stream.sample_rate();
+            audio_format.channels = audio_stream.channels();
+            audio_format.bits_per_sample = audio_stream.bits_per_sample();
+        }
+
+        std::string nut_error;
+        if (!nut.init(opts.pix_fmt, output_width, output_height, select.fps_num, select.fps_den,
+                      has_audio ? &audio_format : nullptr, nut_error))
+        {
+            json_error(nut_error.c_str());
+            clip->Release();
+            return 1;
+        }
+    }
+    bool audio_warned = false;
+
+    // Extra threads for the RGBA -> RGB24 or YUV conversion, resize or
+    // copy-out of large frames; the SDK callback thread works on its own frame alongside
+    // them. Stays within the --threads budget when one is given, which the
+    // clips of a playlist split.
+    unsigned thread_budget = (opts.threads ? opts.threads : std::thread::hardware_concurrency())
+                             / opts.clips_at_once;
+    unsigned convert_threads = opts.convert_threads >= 0
+        ? (unsigned)opts.convert_threads
+        : std::min(4u, std::max(1u, thread_budget));
+    StripePool convert_pool(convert_threads);
+
+    // Frames leave through the writer thread: decoding continues while
+    // FFmpeg (or the encoder) drains up to `write_queue` finished frames
+    FrameWriter writer(opts.output_fd, opts.pix_fmt, output_width, output_height, write_queue,
+                       opts.shm_socket >= 0 ? &ring : nullptr, encoding ? &encoder : nullptr,
+                       opts.mux_nut ? &nut : nullptr);
+
+    BrawCallback* callback = nullptr;
+    ManualEngine* engine = nullptr;
+
+    if (opts.engine == Engine::Manual)
+    {
+        ManualEngine::Config engine_config;
+        engine_config.read_slots = window;
+        engine_config.decode_slots = inflight;
+        engine_config.process_jobs = opts.process_jobs ? opts.process_jobs : inflight;
+        engine_config.out_width = width;
+        engine_config.out_height = height;
+        engine_config.resolution_scale = opts.resolution_scale;
+        engine_config.pix_fmt = opts.pix_fmt;
+        engine_config.post = post.get();
+        engine_config.resource_format = resource_format_for(opts.pix_fmt);
+        engine_config.resource_bytes = resource_frame_bytes(opts.pix_fmt, width, height);
+        engine_config.report_error = json_error;
+
+        engine = new ManualEngine(engine_config, &reorder, &frame_pool, &convert_pool);
+        std::string engine_error;
+        if (!engine->init(codec, clip, engine_error))
+        {
+            json_error(engine_error.c_str());
+            engine->Release();
+            clip->Release();
+            return 1;
+        }
+    }
+    else
+    {
+        callback = new BrawCallback(&reorder, &frame_pool, &convert_pool, opts.resolution_scale,
+                                    opts.pix_fmt, post.get());
+    }
+
+    // Reorder slots, jobs and the writer count output frames; the reads
+    // go to the clip frames they show
+    bool had_error = false;
+    uint64_t next_submit = out_first;
+
+    // Manual engine: stage queue depths, at most once per second
+    static constexpr auto kTelemetryInterval = std::chrono::seconds(1);
+    auto last_telemetry = std::chrono::steady_clock::now();
+
+    for (uint64_t next_write = out_first; next_write < out_end; next_write++)
+    {
+        while (!had_error && next_submit < out_end
+               && next_submit - next_write < reorder.slot_count())
+        {
+            if (engine)
+            {
+                if (!engine->submit_read(next_submit, clip_frame_of(next_submit)))
+                {
+                    had_error = true;
+                    break;
+                }
+                next_submit++;
+                continue;
+            }
+
+            IBlackmagicRawJob* read_job = nullptr;
+            hr = clip->CreateJobReadFrame(clip_frame_of(next_submit), &read_job);
+            if (FAILED(hr) || !read_job)
+            {
+                json_error("CreateJobReadFrame failed");
+                had_error = true;
+                break;
+            }
+
+            hr = callback->submit_read(read_job, next_submit);
+            if (FAILED(hr))
+            {
+                json_error("ReadJob submit failed");
+                read_job->Release();
+                had_error = true;
+                break;
+            }
+            next_submit++;
+        }
+
+        // Nothing in flight for this frame (submission failed) → stop
+        if (next_write >= next_submit)
             break;
+
+        uint8_t* frame = nullptr;
+        size_t frame_bytes = 0;
+        if (!reorder.wait(next_write, frame, frame_bytes))
+        {
+            had_error = true;
+            break;
+        }
+
+        if (thumbnailing)
+        {
+            // A thumbnail goes into its file or the sprite sheet right away
+            std::string path, thumbnail_error;
+            bool added = thumbnails.add(next_write, frame, path, thumbnail_error);
+            frame_pool.give_back(frame);
+            reorder.release(next_write);
+            if (!added)
+            {
+                json_error(thumbnail_error.c_str());
+                had_error = true;
+                break;
+            }
+            if (!path.empty())
+                json_thumbnail(thumbnail_frames[next_write],
+                               thumbnails.frame_time(thumbnail_frames[next_write]), path);
+        }
+        else
+        {
+            // Hand the frame to the writer thread (it goes to stdout in the
+            // --pix-fmt layout); waits only while the write queue is full.
+            // The slot stays taken until then, so at most window +
+            // write_queue buffers are ever out. A NUT stream or the encoder
+            // gets the audio up to the end of the frame with it, the clip's
+            // last frame whatever is left.
+            std::vector<uint8_t> frame_audio;
+            if (has_audio)
+            {
+                uint64_t end = next_write + 1 == out_count
+                    ? UINT64_MAX
+                    : frame_audio_start(next_write + 1, audio_stream.sample_rate(),
+                                        select.fps_num, select.fps_den);
+                if (!audio_stream.read_until(end, frame_audio) && !audio_warned)
+                {
+                    json_warning("Reading clip audio failed; the rest of the stream has none");
+                    audio_warned = true;
+                }
+            }
+            bool queued = writer.push(frame, &frame_pool, std::move(frame_audio));
+            reorder.release(next_write);
+            if (!queued)
+            {
+                json_error(encoding ? encoder.error().c_str()
+                           : opts.shm_socket >= 0 ? "Shared-memory consumer went away"
+                                                  : "Writing frames to stdout failed");
+                had_error = true;
+                break;
+            }
         }
 
-        // Wait for this frame to be fully processed before submitting next
-        // This ensures frames are output in order on stdout
-        callback->wait_frame_done();
+        json_progress(next_write + 1 - out_first, out_end - out_first);
 
-        if (callback->had_error())
+        // A --serve client that went away cancels the request
+        if (ferror(report_stream()))
+        {
+            had_error = true;
             break;
+        }
+
+        if (engine && std::chrono::steady_clock::now() - last_telemetry >= kTelemetryInterval)
+        {
+            json_pipeline(next_write + 1, engine->depths());
+            last_telemetry = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Everything queued goes out before the job counts as done
+    if (!writer.finish())
+        had_error = true;
+    if (encoding && !encoder.finish())
+    {
+        if (!had_error)
+            json_error(encoder.error().c_str());
+        had_error = true;
+    }
+    if (thumbnailing)
+    {
+        std::string thumbnail_error;
+        if (!had_error && !thumbnails.finish(thumbnail_error))
+        {
+            json_error(thumbnail_error.c_str());
+            had_error = true;
+        }
+        if (!had_error && thumbnails.sprite())
+            json_sprite(thumbnails, thumbnail_frames.size(), output_width, output_height);
+    }
+    else
+    {
+        json_writer(writer.stats());
     }
 
     // --- Cleanup ---
 
-    bool had_error = callback->had_error();
+    // Drain every job of this clip still in flight before the reorder buffer
+    // and frame pool go away; other clips on the codec keep going
+    if (engine)
+        engine->wait_idle();
+    else
+        callback->wait_idle();
+
+    had_error = had_error || (engine ? engine->had_error() : callback->had_error());
 
-    codec->FlushJobs();
+    // Hand the manual engine's buffers back before reading the pool stats
+    if (engine)
+        engine->shutdown();
 
-    codec->SetCallback(nullptr);
-    callback->Release();
+    if (sdk.resource_manager)
+        json_resource_pool(sdk.resource_manager->stats());
+
+    if (callback) callback->Release();
+    if (engine) engine->Release();
     clip->Release();
-    codec->Release();
-    factory->Release();
 
     if (!had_error)
     {
@@ -719,3 +2494,345 @@ int main(int argc, char* argv[])
 
     return 1;
 }
+
+// A playlist: up to --max-clips clips decode side by side on the shared
+// codec and its worker pool, as in sdk/Samples/ExtractFrameMultiVideo, each
+// into its own --output (fd:N, unix:PATH, a file or FIFO, or encode:PATH),
+// every report line tagged with the clip's "input" (see playlist.h)
+static int run_playlist(Sdk& sdk, Options& opts)
+{
+    // An output whose reader went away fails its clip, not the process
+    signal(SIGPIPE, SIG_IGN);
+
+    uint32_t at_once = (uint32_t)std::min<size_t>(opts.max_clips, opts.inputs.size());
+    size_t failed = run_each(opts.inputs, at_once, [&sdk, &opts, at_once](size_t i)
+    {
+        Options clip_opts = opts;
+        clip_opts.input_file = opts.inputs[i];
+        clip_opts.clips_at_once = at_once;
+
+        OutputSpec output;
+        std::string error;
+        if (!parse_output_spec(opts.outputs[i], output, error) || !open_output(output, error))
+        {
+            json_error(error.c_str());
+            return false;
+        }
+        if (output.kind == OutputSpec::Kind::Encode)
+        {
+            clip_opts.encode_path = output.path;
+            if (!clip_opts.pix_fmt_given)
+                AvEncoder::codec_pix_fmt(clip_opts.encode_codec, clip_opts.pix_fmt);
+        }
+        else
+        {
+            clip_opts.output_fd = output.fd;
+        }
+        bool ok = run_clip(sdk, clip_opts) == 0;
+        close_output(output);
+        return ok;
+    });
+    return failed ? 1 : 0;
+}
+
+// run_clip() for one clip, a playlist, or a batch --probe-only or
+// --thumbnails over all of them with the clips opened side by side
+// on the shared codec
+static int run_clips(Sdk& sdk, Options& opts)
+{
+    if (!opts.outputs.empty())
+        return run_playlist(sdk, opts);
+    if (opts.inputs.size() <= 1)
+        return run_clip(sdk, opts);
+
+    // Thumbnails of several clips: up to --max-clips of them side by side
+    if (!opts.thumbnails_dir.empty())
+    {
+        uint32_t at_once = (uint32_t)std::min<size_t>(opts.max_clips, opts.inputs.size());
+        size_t failed = run_each(opts.inputs, at_once, [&sdk, &opts, at_once](size_t i)
+        {
+            Options clip_opts = opts;
+            clip_opts.input_file = opts.inputs[i];
+            clip_opts.clips_at_once = at_once;
+            return run_clip(sdk, clip_opts) == 0;
+        });
+        return failed ? 1 : 0;
+    }
+
+    size_t failed = probe_each(opts.inputs, 0, [&sdk, &opts](const std::string& input)
+    {
+        Options clip_opts = opts;
+        clip_opts.input_file = input;
+        return run_clip(sdk, clip_opts) == 0;
+    });
+    return failed ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// --serve: requests on a Unix socket, one shared codec
+// ---------------------------------------------------------------------------
+//
+// The SDK is set up once; probe, extract-audio, decode, thumbnail and scrub
+// requests run up to --max-requests at a time, all clips on one codec and
+// its worker pool (see serve.h and callback_router.h). --threads, --isa and
+// --no-resource-pool configure that codec and are ignored in a request.
+
+// A scrub request: opens the clip, reports its metadata line (output size
+// at the session's scale) and serves frame requests until the client
+// closes the connection (see frame_server.h)
+static int run_scrub(Sdk& sdk, const Options& opts, const ServeRequest& request)
+{
+    IBlackmagicRawClip* clip = nullptr;
+    HRESULT hr = sdk.codec->OpenClip(opts.input_file.c_str(), &clip);
+    if (FAILED(hr) || !clip)
+    {
+        json_error("Failed to open BRAW clip");
+        return 1;
+    }
+    ClipInfo info;
+    if (!read_clip_info(clip, info))
+    {
+        clip->Release();
+        return 1;
+    }
+
+    ScrubDecoder* decoder = new ScrubDecoder(clip, info.width, info.height, opts.pix_fmt);
+    uint32_t scale = request.scale ? request.scale : 2;
+    uint32_t width = 0, height = 0;
+    size_t frame_bytes = 0;
+    std::string error;
+    if (!decoder->init(opts.yuv_range, error))
+    {
+        json_error(error.c_str());
+        decoder->Release();
+        clip->Release();
+        return 1;
+    }
+    if (!decoder->frame_size(scale, width, height, frame_bytes))
+    {
+        json_error("Invalid scrub scale. Use: 1, 2, 4, 8");
+        decoder->Release();
+        clip->Release();
+        return 1;
+    }
+
+    json_metadata(info.timecode.c_str(), info.fps_num, info.fps_den, info.width, info.height,
+                  info.frame_count, sdk.threads, sdk.isa.c_str(), width, height,
+                  pix_fmt_name(opts.pix_fmt),
+                  pix_fmt_is_yuv(opts.pix_fmt) ? yuv_range_name(opts.yuv_range) : nullptr,
+                  false, ",\"scale\":" + std::to_string(scale) + ",\"scales\":[1,2,4,8]");
+    fflush(report_stream());
+
+    FrameServerConfig config;
+    config.frame_count = info.frame_count;
+    config.scale = scale;
+    config.cache_bytes = (size_t)opts.frame_cache_mb << 20;
+    config.prefetch = opts.prefetch;
+    config.decodes = opts.inflight ? opts.inflight : 4;
+    int code = run_frame_server(request.conn, request.pending, opts.output_fd, *decoder, config);
+
+    decoder->wait_idle();
+    decoder->Release();
+    clip->Release();
+    return code;
+}
+
+// The options of one request: its args parsed like a command line, then
+// the op applied. Reports and returns false if the request is invalid.
+static bool request_options(const ServeRequest& request, Options& opts)
+{
+    std::vector<char*> argv;
+    argv.push_back((char*)"braw-bridge");
+    for (const std::string& arg : request.args)
+        argv.push_back((char*)arg.c_str());
+    if (!parse_args((int)argv.size(), argv.data(), opts))
+        return false;
+
+    // Process-wide modes, and fds that would name the daemon's own
+    if (opts.self_check || opts.bench_transport || opts.capabilities
+        || !opts.serve_socket.empty() || opts.shm_socket >= 0 || !opts.outputs.empty())
+    {
+        json_error("--self-check, --bench-transport, --capabilities, --serve, --shm-socket and "
+                   "--output are not request options");
+        return false;
+    }
+
+    if (request.op == "extract-audio")
+    {
+        if (opts.extract_audio_path.empty())
+        {
+            json_error("extract-audio needs --extract-audio <file.wav>");
+            return false;
+        }
+        return load_inputs(opts, -1);
+    }
+    if (!opts.extract_audio_path.empty())
+    {
+        json_error("--extract-audio belongs to the extract-audio op");
+        return false;
+    }
+
+    // A probe's --input-list - comes as its fd
+    if (request.op == "probe")
+    {
+        opts.probe_only = true;
+        return load_inputs(opts, request.fds.empty() ? -1 : request.fds[0]);
+    }
+    if (request.op == "decode")
+    {
+        if (!request.fds.empty())
+            opts.output_fd = request.fds[0];
+        else if (opts.encode_path.empty())
+        {
+            json_error("decode needs an fd for the frames (or --encode)");
+            return false;
+        }
+        return load_inputs(opts, -1);
+    }
+    if (request.op == "thumbnail")
+    {
+        if (request.fds.empty())
+        {
+            json_error("thumbnail needs an fd for the frame");
+            return false;
+        }
+        if (!opts.encode_path.empty() || opts.mux_nut)
+        {
+            json_error("thumbnail writes a bare frame; drop --encode and --mux");
+            return false;
+        }
+        opts.output_fd = request.fds[0];
+        opts.first_frame = request.frame;
+        opts.frame_limit = 1;
+        opts.frame_step = 1;
+        opts.conform_num = 0;
+        opts.probe_only = false;
+        return load_inputs(opts, -1);
+    }
+    if (request.op == "scrub")
+    {
+        if (request.fds.empty())
+        {
+            json_error("scrub needs an fd for the frames");
+            return false;
+        }
+        if (!opts.encode_path.empty() || opts.mux_nut || opts.output_width != 0
+            || !opts.thumbnails_dir.empty() || opts.probe_only || opts.first_frame
+            || opts.frame_limit || opts.frame_step > 1 || opts.conform_num)
+        {
+            json_error("scrub serves bare frames at a decode scale; drop --encode, --mux, "
+                       "--output-size, --thumbnails, --probe-only and the frame range and step");
+            return false;
+        }
+        opts.output_fd = request.fds[0];
+        if (!load_inputs(opts, -1))
+            return false;
+        if (opts.inputs.size() != 1)
+        {
+            json_error("scrub takes a single clip");
+            return false;
+        }
+        return true;
+    }
+
+    json_error("Unknown request op");
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+#ifdef _WIN32
+    // Set stdout to binary mode on Windows
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    Options opts;
+    if (!parse_args(argc, argv, opts))
+        return 1;
+
+    // --- Kernel self-check (no SDK, no input) ---
+
+    if (opts.self_check)
+    {
+        bool ok = pixel_convert_self_check(stderr);
+        ok = resize_self_check(stderr) && ok;
+        ok = yuv_convert_self_check(stderr) && ok;
+        ok = post_process_self_check(stderr) && ok;
+        ok = bswap32_self_check(stderr) && ok;
+        ok = transport_self_check(stderr) && ok;
+        return ok ? 0 : 1;
+    }
+
+    // --- Build capabilities, for the backend to pick a path (no SDK) ---
+
+    if (opts.capabilities)
+    {
+        json_capabilities();
+        return 0;
+    }
+
+    // --- Frame transport benchmark at UHD and 8K (no SDK, no input) ---
+
+    if (opts.bench_transport)
+    {
+        bool ok = transport_bench(stderr, 3840, 2160, 32);
+        ok = transport_bench(stderr, 7680, 4320, 16) && ok;
+        return ok ? 0 : 1;
+    }
+
+    if (opts.serve_socket.empty() && !load_inputs(opts, STDIN_FILENO))
+        return 1;
+
+    // --- Initialize BRAW SDK ---
+
+    // A single --encode run (or a playlist that encodes) leaves part of the
+    // --threads budget to the encoders. A daemon sizes the SDK once for
+    // requests of every kind, so it gives the SDK the whole budget.
+    uint32_t decode_threads = opts.threads;
+    if (encodes(opts) && opts.serve_socket.empty())
+    {
+        unsigned budget = opts.threads ? opts.threads : std::thread::hardware_concurrency();
+        decode_threads = std::max(1u, budget - encoder_threads_for(opts));
+    }
+
+    Sdk sdk;
+    if (!open_sdk(opts, decode_threads, sdk))
+        return 1;
+
+    int code;
+    if (!opts.serve_socket.empty())
+    {
+        // Each request starts from the daemon's own options (--threads,
+        // --isa, ...) and adds its args on top
+        const Options defaults = opts;
+        auto handler = [&sdk, &defaults](const ServeRequest& request)
+        {
+            Options request_opts = defaults;
+            request_opts.serve_socket.clear();
+            if (!request_options(request, request_opts))
+                return 1;
+            if (request.op == "scrub")
+                return run_scrub(sdk, request_opts, request);
+            return run_clips(sdk, request_opts);
+        };
+
+        std::string error;
+        code = 0;
+        if (!serve(opts.serve_socket.c_str(), opts.max_requests, handler, error))
+        {
+            json_error(error.c_str());
+            code = 1;
+        }
+    }
+    else
+    {
+        code = run_clips(sdk, opts);
+    }
+
+    close_sdk(sdk);
+    return code;
+}
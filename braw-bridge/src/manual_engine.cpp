@@ -0,0 +1,434 @@
+#include "manual_engine.h"
+
+#include "frame_pool.h"
+#include "pixel_convert.h"
+#include "post_process.h"
+#include "reorder_buffer.h"
+#include "report.h"
+
+// Job tags: read jobs carry the frame index, decode/process jobs also the
+// DecodeContext they run in.
+static uint64_t frame_index_of(IBlackmagicRawJob* job)
+{
+    return job_tag(job)->frame_idx;
+}
+
+template <typename T>
+static T* user_data_of(IBlackmagicRawJob* job)
+{
+    return (T*)job_tag(job)->context;
+}
+
+ManualEngine::ManualEngine(const Config& config, ReorderBuffer* reorder,
+                           FramePool* frame_pool, StripePool* convert_pool)
+    : m_ref(1)
+    , m_config(config)
+    , m_reorder(reorder)
+    , m_frame_pool(frame_pool)
+    , m_convert_pool(convert_pool)
+    , m_error(false)
+    , m_jobs(this, report_stream(), report_input())
+    , m_bitstreams(config.read_slots)
+    , m_read_tags(config.read_slots)
+    , m_contexts(config.decode_slots)
+{
+    for (auto& ctx : m_contexts)
+        m_free_contexts.push_back(&ctx);
+}
+
+ManualEngine::~ManualEngine()
+{
+    shutdown();
+}
+
+ULONG STDMETHODCALLTYPE ManualEngine::Release()
+{
+    ULONG ref = --m_ref;
+    if (ref == 0) delete this;
+    return ref;
+}
+
+bool ManualEngine::init(IBlackmagicRaw* codec, IBlackmagicRawClip* clip, std::string& error)
+{
+    HRESULT hr = codec->QueryInterface(IID_IBlackmagicRawManualDecoderFlow1, (void**)&m_decoder);
+    if (FAILED(hr) || !m_decoder)
+    {
+        error = "Manual decoder (Flow1) not available in this SDK";
+        return false;
+    }
+
+    IBlackmagicRawConfigurationEx* config_ex = nullptr;
+    hr = codec->QueryInterface(IID_IBlackmagicRawConfigurationEx, (void**)&config_ex);
+    if (SUCCEEDED(hr) && config_ex)
+    {
+        config_ex->GetResourceManager(&m_resources);
+        config_ex->Release();
+    }
+    if (!m_resources)
+    {
+        error = "No resource manager for the manual decoder";
+        return false;
+    }
+
+    hr = clip->QueryInterface(IID_IBlackmagicRawClipEx, (void**)&m_clip_ex);
+    if (FAILED(hr) || !m_clip_ex)
+    {
+        error = "IBlackmagicRawClipEx not available";
+        return false;
+    }
+
+    // The LUT buffer is owned by the IBlackmagicRawPost3DLUT object
+    IBlackmagicRawClipProcessingAttributes* clip_attributes = nullptr;
+    hr = clip->QueryInterface(IID_IBlackmagicRawClipProcessingAttributes, (void**)&clip_attributes);
+    if (SUCCEEDED(hr) && clip_attributes)
+    {
+        clip_attributes->GetPost3DLUT(&m_post_lut);
+        if (m_post_lut)
+            m_post_lut->GetResourceCPU(&m_post_lut_buffer);
+        clip_attributes->Release();
+    }
+
+    return true;
+}
+
+void ManualEngine::shutdown()
+{
+    for (auto& bitstream : m_bitstreams)
+        release_buffer(bitstream);
+    for (auto& ctx : m_contexts)
+    {
+        release_buffer(ctx.frame_state);
+        release_buffer(ctx.decoded);
+        release_buffer(ctx.processed);
+    }
+
+    // Frames whose read completed but never got a decode slot
+    while (!m_decode_queue.empty())
+    {
+        m_decode_queue.top().frame->Release();
+        m_decode_queue.pop();
+    }
+
+    if (m_post_lut) { m_post_lut->Release(); m_post_lut = nullptr; }
+    if (m_clip_ex) { m_clip_ex->Release(); m_clip_ex = nullptr; }
+    if (m_resources) { m_resources->Release(); m_resources = nullptr; }
+    if (m_decoder) { m_decoder->Release(); m_decoder = nullptr; }
+}
+
+ManualEngine::StageDepths ManualEngine::depths()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    StageDepths d;
+    d.read_inflight = m_read_inflight;
+    d.decode_queued = (uint32_t)m_decode_queue.size();
+    d.decode_inflight = m_decode_inflight;
+    d.process_queued = (uint32_t)m_process_queue.size();
+    d.process_inflight = m_process_inflight;
+    return d;
+}
+
+// ---------------------------------------------------------------------------
+// Buffers
+// ---------------------------------------------------------------------------
+
+bool ManualEngine::ensure_buffer(Buffer& buffer, uint32_t bytes)
+{
+    if (buffer.ptr && buffer.bytes >= bytes)
+        return true;
+
+    release_buffer(buffer);
+    HRESULT hr = m_resources->CreateResource(nullptr, nullptr, bytes,
+        blackmagicRawResourceTypeBufferCPU, blackmagicRawResourceUsageReadCPUWriteCPU, &buffer.ptr);
+    if (FAILED(hr) || !buffer.ptr)
+    {
+        buffer.ptr = nullptr;
+        return false;
+    }
+    buffer.bytes = bytes;
+    return true;
+}
+
+void ManualEngine::release_buffer(Buffer& buffer)
+{
+    if (buffer.ptr && m_resources)
+        m_resources->ReleaseResource(nullptr, nullptr, buffer.ptr, blackmagicRawResourceTypeBufferCPU);
+    buffer.ptr = nullptr;
+    buffer.bytes = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Read stage
+// ---------------------------------------------------------------------------
+
+bool ManualEngine::submit_read(uint64_t frame_idx, uint64_t clip_frame)
+{
+    // The reorder window guarantees frame_idx - read_slots has been written,
+    // so its bitstream buffer is free again.
+    Buffer& bitstream = m_bitstreams[frame_idx % m_bitstreams.size()];
+
+    uint32_t bitstream_bytes = 0;
+    HRESULT hr = m_clip_ex->GetBitStreamSizeBytes(clip_frame, &bitstream_bytes);
+    if (FAILED(hr) || !ensure_buffer(bitstream, bitstream_bytes))
+    {
+        m_config.report_error("Failed to allocate bitstream buffer");
+        m_error = true;
+        return false;
+    }
+
+    IBlackmagicRawJob* read_job = nullptr;
+    hr = m_clip_ex->CreateJobReadFrame(clip_frame, bitstream.ptr, bitstream_bytes, &read_job);
+    if (FAILED(hr) || !read_job)
+    {
+        m_config.report_error("CreateJobReadFrame failed");
+        m_error = true;
+        return false;
+    }
+
+    JobTag& tag = m_read_tags[frame_idx % m_read_tags.size()];
+    tag.frame_idx = frame_idx;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_read_inflight++;
+    }
+
+    hr = m_jobs.submit(read_job, &tag);
+    if (FAILED(hr))
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_read_inflight--;
+        }
+        m_config.report_error("ReadJob submit failed");
+        read_job->Release();
+        m_error = true;
+        return false;
+    }
+    return true;
+}
+
+void STDMETHODCALLTYPE ManualEngine::ReadComplete(
+    IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawFrame* frame)
+{
+    uint64_t frame_idx = frame_index_of(job);
+    if (job) job->Release();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_read_inflight--;
+    }
+
+    if (FAILED(result) || !frame)
+    {
+        fail_frame(frame_idx, "ReadComplete failed");
+        return;
+    }
+
+    // Resource format and scale must be set before the frame state is
+    // populated in the decode stage
+    frame->SetResourceFormat(m_config.resource_format);
+    if (m_config.resolution_scale != blackmagicRawResolutionScaleFull)
+        frame->SetResolutionScale(m_config.resolution_scale);
+
+    frame->AddRef();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_decode_queue.push(PendingDecode{frame_idx, frame});
+    }
+    pump();
+}
+
+// ---------------------------------------------------------------------------
+// Decode / process stages
+// ---------------------------------------------------------------------------
+
+void ManualEngine::pump()
+{
+    for (;;)
+    {
+        DecodeContext* decode_ctx = nullptr;
+        IBlackmagicRawFrame* decode_frame = nullptr;
+        DecodeContext* process_ctx = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // Lowest frame index first: the frame the writer waits on must
+            // never sit behind frames that are further ahead.
+            if (!m_decode_queue.empty() && !m_free_contexts.empty())
+            {
+                decode_ctx = m_free_contexts.back();
+                m_free_contexts.pop_back();
+                decode_ctx->frame_idx = m_decode_queue.top().frame_idx;
+                decode_frame = m_decode_queue.top().frame;
+                m_decode_queue.pop();
+                m_decode_inflight++;
+            }
+            if (!m_process_queue.empty() && m_process_inflight < m_config.process_jobs)
+            {
+                process_ctx = m_process_queue.front();
+                m_process_queue.pop();
+                m_process_inflight++;
+            }
+        }
+
+        if (!decode_ctx && !process_ctx)
+            return;
+
+        if (decode_ctx)
+        {
+            bool ok = start_decode(decode_ctx, decode_frame);
+            decode_frame->Release();
+            if (!ok)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_decode_inflight--;
+                }
+                fail_frame(decode_ctx->frame_idx, "Failed to start decode job");
+                recycle(decode_ctx);
+            }
+        }
+
+        if (process_ctx && !start_process(process_ctx))
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_process_inflight--;
+            }
+            fail_frame(process_ctx->frame_idx, "Failed to start process job");
+            recycle(process_ctx);
+        }
+    }
+}
+
+bool ManualEngine::start_decode(DecodeContext* ctx, IBlackmagicRawFrame* frame)
+{
+    uint32_t frame_state_bytes = 0;
+    if (FAILED(m_decoder->GetFrameStateSizeBytes(&frame_state_bytes))
+        || !ensure_buffer(ctx->frame_state, frame_state_bytes))
+        return false;
+
+    if (FAILED(m_decoder->PopulateFrameStateBuffer(frame, nullptr, nullptr,
+                                                  ctx->frame_state.ptr, frame_state_bytes)))
+        return false;
+
+    uint32_t decoded_bytes = 0;
+    if (FAILED(m_decoder->GetDecodedSizeBytes(ctx->frame_state.ptr, &decoded_bytes))
+        || !ensure_buffer(ctx->decoded, decoded_bytes))
+        return false;
+
+    void* bitstream = m_bitstreams[ctx->frame_idx % m_bitstreams.size()].ptr;
+
+    IBlackmagicRawJob* decode_job = nullptr;
+    HRESULT hr = m_decoder->CreateJobDecode(ctx->frame_state.ptr, bitstream, ctx->decoded.ptr, &decode_job);
+    if (FAILED(hr) || !decode_job)
+        return false;
+
+    ctx->tag.frame_idx = ctx->frame_idx;
+    ctx->tag.context = ctx;
+    if (FAILED(m_jobs.submit(decode_job, &ctx->tag)))
+    {
+        decode_job->Release();
+        return false;
+    }
+    return true;
+}
+
+void STDMETHODCALLTYPE ManualEngine::DecodeComplete(IBlackmagicRawJob* job, HRESULT result)
+{
+    DecodeContext* ctx = user_data_of<DecodeContext>(job);
+    if (job) job->Release();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_decode_inflight--;
+        if (SUCCEEDED(result))
+            m_process_queue.push(ctx);
+    }
+
+    if (FAILED(result))
+    {
+        fail_frame(ctx->frame_idx, "DecodeComplete failed");
+        recycle(ctx);
+        return;
+    }
+    pump();
+}
+
+bool ManualEngine::start_process(DecodeContext* ctx)
+{
+    uint32_t processed_bytes = 0;
+    if (FAILED(m_decoder->GetProcessedSizeBytes(ctx->frame_state.ptr, &processed_bytes)))
+        return false;
+
+    // resource_format at the scaled size is what ProcessComplete reads
+    if (processed_bytes < m_config.resource_bytes
+        || !ensure_buffer(ctx->processed, processed_bytes))
+        return false;
+
+    IBlackmagicRawJob* process_job = nullptr;
+    HRESULT hr = m_decoder->CreateJobProcess(ctx->frame_state.ptr, ctx->decoded.ptr,
+                                             ctx->processed.ptr, m_post_lut_buffer, &process_job);
+    if (FAILED(hr) || !process_job)
+        return false;
+
+    if (FAILED(m_jobs.submit(process_job, &ctx->tag)))
+    {
+        process_job->Release();
+        return false;
+    }
+    return true;
+}
+
+void STDMETHODCALLTYPE ManualEngine::ProcessComplete(
+    IBlackmagicRawJob* job, HRESULT result, IBlackmagicRawProcessedImage*)
+{
+    DecodeContext* ctx = user_data_of<DecodeContext>(job);
+    if (job) job->Release();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_process_inflight--;
+    }
+
+    if (FAILED(result))
+    {
+        fail_frame(ctx->frame_idx, "ProcessComplete failed");
+        recycle(ctx);
+        return;
+    }
+
+    // The frame pool holds one buffer per reorder slot plus one per queued
+    // write, so this never waits
+    uint8_t* out_buf = m_frame_pool->checkout();
+    const uint8_t* processed = (const uint8_t*)ctx->processed.ptr;
+    size_t out_bytes;
+    if (m_config.post)
+    {
+        m_config.post->run(processed, out_buf, m_convert_pool);
+        out_bytes = m_config.post->dst_bytes();
+    }
+    else
+    {
+        // Already in the output layout
+        out_bytes = pix_fmt_frame_bytes(m_config.pix_fmt, m_config.out_width, m_config.out_height);
+        copy_frame(processed, out_buf, out_bytes, m_convert_pool);
+    }
+    m_reorder->publish(ctx->frame_idx, out_buf, out_bytes);
+
+    recycle(ctx);
+}
+
+void ManualEngine::recycle(DecodeContext* ctx)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free_contexts.push_back(ctx);
+    }
+    pump();
+}
+
+void ManualEngine::fail_frame(uint64_t frame_idx, const char* msg)
+{
+    m_config.report_error(msg);
+    m_error = true;
+    m_reorder->publish(frame_idx, nullptr, 0);
+}
@@ -0,0 +1,176 @@
+// ManualEngine: staged read → decode → process pipeline built on
+// IBlackmagicRawManualDecoderFlow1 (see sdk/Samples/ProcessClipManualFlow1).
+//
+// Unlike the callback flow, the bridge owns every buffer and decides when
+// each stage runs:
+//
+//   read     bitstream slot per in-flight frame (slot = frame % read_slots);
+//            reads are submitted by the main thread as far ahead as the
+//            reorder window allows
+//   decode   frames whose read completed wait in a queue (lowest frame index
+//            first) for one of `decode_slots` contexts holding the frame
+//            state, decoded and processed buffers
+//   process  decoded frames wait for one of `process_jobs` process slots;
+//            on completion the RGBA result is converted (and resized) into a
+//            FramePool buffer and published to the ReorderBuffer
+//
+// The SDK runs each job on its own worker pool; the engine only moves frames
+// between the bounded queues, so no callback thread ever blocks on another
+// stage. Jobs go through the engine's JobGroup, so the codec may be running
+// other clips' jobs alongside (see callback_router.h).
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "LinuxCOM.h"
+#include "BlackmagicRawAPI.h"
+
+#include "callback_router.h"
+#include "pixel_format.h"
+
+class FramePool;
+class ReorderBuffer;
+class PostProcessor;
+class StripePool;
+
+class ManualEngine : public IBlackmagicRawCallback
+{
+public:
+    struct Config
+    {
+        uint32_t read_slots = 0;    // bitstream buffers (= reorder window)
+        uint32_t decode_slots = 0;  // frame state + decoded + processed buffers
+        uint32_t process_jobs = 0;  // process jobs in flight
+        uint32_t out_width = 0;     // decode-scale dimensions
+        uint32_t out_height = 0;
+        PixFmt pix_fmt = PixFmt::RGB24;      // what goes to stdout
+        const PostProcessor* post = nullptr; // rgb24/YUV incl. --output-size, if set
+        BlackmagicRawResourceFormat resource_format = blackmagicRawResourceFormatRGBAU8;
+        uint64_t resource_bytes = 0;         // one processed frame at the decode size
+        BlackmagicRawResolutionScale resolution_scale = blackmagicRawResolutionScaleFull;
+        void (*report_error)(const char* msg) = nullptr;
+    };
+
+    // Per-stage queue depths, sampled for telemetry
+    struct StageDepths
+    {
+        uint32_t read_inflight = 0;
+        uint32_t decode_queued = 0;
+        uint32_t decode_inflight = 0;
+        uint32_t process_queued = 0;
+        uint32_t process_inflight = 0;
+    };
+
+    ManualEngine(const Config& config, ReorderBuffer* reorder,
+                 FramePool* frame_pool, StripePool* convert_pool);
+
+    // Looks up the Flow1 decoder, resource manager and post 3D LUT. Must be
+    // called before the first submit_read().
+    bool init(IBlackmagicRaw* codec, IBlackmagicRawClip* clip, std::string& error);
+
+    // Starts the read stage for frame `frame_idx` of the reorder buffer,
+    // read from `clip_frame` of the clip (the same unless a sparse decode
+    // skips frames). Main thread only.
+    bool submit_read(uint64_t frame_idx, uint64_t clip_frame);
+
+    StageDepths depths();
+    bool had_error() const { return m_error; }
+
+    // Blocks until every job the engine submitted has completed
+    void wait_idle() { m_jobs.wait_idle(); }
+
+    // Returns all SDK buffers and interfaces. Call after wait_idle().
+    void shutdown();
+
+    // IUnknown
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, LPVOID*) override { return E_NOINTERFACE; }
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++m_ref; }
+    ULONG STDMETHODCALLTYPE Release() override;
+
+    // IBlackmagicRawCallback
+    void STDMETHODCALLTYPE ReadComplete(IBlackmagicRawJob* job, HRESULT result,
+                                        IBlackmagicRawFrame* frame) override;
+    void STDMETHODCALLTYPE DecodeComplete(IBlackmagicRawJob* job, HRESULT result) override;
+    void STDMETHODCALLTYPE ProcessComplete(IBlackmagicRawJob* job, HRESULT result,
+                                           IBlackmagicRawProcessedImage* processed_image) override;
+    void STDMETHODCALLTYPE TrimProgress(IBlackmagicRawJob*, float) override {}
+    void STDMETHODCALLTYPE TrimComplete(IBlackmagicRawJob*, HRESULT) override {}
+    void STDMETHODCALLTYPE SidecarMetadataParseWarning(
+        IBlackmagicRawClip*, const char*, uint32_t, const char*) override {}
+    void STDMETHODCALLTYPE SidecarMetadataParseError(
+        IBlackmagicRawClip*, const char*, uint32_t, const char*) override {}
+    void STDMETHODCALLTYPE PreparePipelineComplete(void*, HRESULT) override {}
+
+private:
+    // A CPU buffer from the resource manager that only ever grows
+    struct Buffer
+    {
+        void* ptr = nullptr;
+        uint32_t bytes = 0;
+    };
+
+    struct DecodeContext
+    {
+        uint64_t frame_idx = 0;
+        JobTag tag; // of its decode and then its process job
+        Buffer frame_state;
+        Buffer decoded;
+        Buffer processed;
+    };
+
+    struct PendingDecode
+    {
+        uint64_t frame_idx;
+        IBlackmagicRawFrame* frame;
+        bool operator>(const PendingDecode& o) const { return frame_idx > o.frame_idx; }
+    };
+
+    ~ManualEngine();
+
+    bool ensure_buffer(Buffer& buffer, uint32_t bytes);
+    void release_buffer(Buffer& buffer);
+
+    // Moves frames from the decode/process queues into free slots and
+    // submits their jobs. Safe to call from any thread.
+    void pump();
+    bool start_decode(DecodeContext* ctx, IBlackmagicRawFrame* frame);
+    bool start_process(DecodeContext* ctx);
+
+    // Returns a context to the free list after its frame finished or failed.
+    void recycle(DecodeContext* ctx);
+    void fail_frame(uint64_t frame_idx, const char* msg);
+
+    std::atomic<ULONG> m_ref;
+    Config m_config;
+    ReorderBuffer* m_reorder;
+    FramePool* m_frame_pool;
+    StripePool* m_convert_pool;
+    std::atomic<bool> m_error;
+    JobGroup m_jobs;
+
+    IBlackmagicRawManualDecoderFlow1* m_decoder = nullptr;
+    IBlackmagicRawResourceManager* m_resources = nullptr;
+    IBlackmagicRawClipEx* m_clip_ex = nullptr;
+    IBlackmagicRawPost3DLUT* m_post_lut = nullptr;
+    void* m_post_lut_buffer = nullptr;
+
+    std::vector<Buffer> m_bitstreams;              // indexed by frame % read_slots
+    std::vector<JobTag> m_read_tags;               // likewise
+    std::vector<DecodeContext> m_contexts;
+
+    std::mutex m_mutex;
+    std::vector<DecodeContext*> m_free_contexts;
+    std::priority_queue<PendingDecode, std::vector<PendingDecode>,
+                        std::greater<PendingDecode>> m_decode_queue;
+    std::queue<DecodeContext*> m_process_queue;
+    uint32_t m_read_inflight = 0;
+    uint32_t m_decode_inflight = 0;
+    uint32_t m_process_inflight = 0;
+};
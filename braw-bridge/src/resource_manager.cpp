@@ -0,0 +1,184 @@
+#include "resource_manager.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// Page alignment keeps SDK buffers friendly to both SIMD loads and DMA, and
+// rounding sizes to whole pages lets near-identical requests share a bucket.
+static constexpr size_t kBufferAlignment = 4096;
+
+static size_t bucket_size(uint32_t size_bytes)
+{
+    return ((size_t)size_bytes + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+}
+
+PooledResourceManager::PooledResourceManager(IBlackmagicRawResourceManager* fallback,
+                                             size_t max_idle_bytes)
+    : m_ref(1)
+    , m_fallback(fallback)
+    , m_max_idle_bytes(max_idle_bytes)
+{
+    if (m_fallback)
+        m_fallback->AddRef();
+}
+
+PooledResourceManager::~PooledResourceManager()
+{
+    for (auto& bucket : m_free)
+        for (void* p : bucket.second)
+            free(p);
+
+    // Anything still live was leaked by the SDK; free it rather than keep it.
+    for (auto& live : m_live)
+        free(live.first);
+
+    if (m_fallback)
+        m_fallback->Release();
+}
+
+PooledResourceManager::Stats PooledResourceManager::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+HRESULT STDMETHODCALLTYPE PooledResourceManager::QueryInterface(REFIID, LPVOID*)
+{
+    return E_NOINTERFACE;
+}
+
+ULONG STDMETHODCALLTYPE PooledResourceManager::AddRef()
+{
+    return ++m_ref;
+}
+
+ULONG STDMETHODCALLTYPE PooledResourceManager::Release()
+{
+    ULONG ref = --m_ref;
+    if (ref == 0) delete this;
+    return ref;
+}
+
+HRESULT PooledResourceManager::CreateResource(void* context, void* command_queue, uint32_t size_bytes,
+                                              BlackmagicRawResourceType type,
+                                              BlackmagicRawResourceUsage usage, void** resource)
+{
+    if (!resource)
+        return E_POINTER;
+
+    if (type != blackmagicRawResourceTypeBufferCPU)
+    {
+        if (!m_fallback)
+            return E_NOTIMPL;
+        return m_fallback->CreateResource(context, command_queue, size_bytes, type, usage, resource);
+    }
+
+    size_t size = bucket_size(size_bytes);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_free.find(size);
+        if (it != m_free.end() && !it->second.empty())
+        {
+            void* p = it->second.back();
+            it->second.pop_back();
+            m_live.emplace(p, size);
+            m_stats.hits++;
+            m_stats.idle_bytes -= size;
+            m_stats.live_bytes += size;
+            *resource = p;
+            return S_OK;
+        }
+    }
+
+    // Allocate outside the lock; large allocations may take a while
+    void* p = nullptr;
+    if (posix_memalign(&p, kBufferAlignment, size) != 0 || !p)
+        return E_OUTOFMEMORY;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_live.emplace(p, size);
+    m_stats.misses++;
+    m_stats.live_bytes += size;
+    if (m_stats.live_bytes + m_stats.idle_bytes > m_stats.peak_bytes)
+        m_stats.peak_bytes = m_stats.live_bytes + m_stats.idle_bytes;
+    *resource = p;
+    return S_OK;
+}
+
+HRESULT PooledResourceManager::ReleaseResource(void* context, void* command_queue, void* resource,
+                                               BlackmagicRawResourceType type)
+{
+    if (type != blackmagicRawResourceTypeBufferCPU)
+    {
+        if (!m_fallback)
+            return E_NOTIMPL;
+        return m_fallback->ReleaseResource(context, command_queue, resource, type);
+    }
+
+    if (!resource)
+        return S_OK;
+
+    bool evict = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_live.find(resource);
+        if (it == m_live.end())
+            return E_INVALIDARG;
+
+        size_t size = it->second;
+        m_live.erase(it);
+        m_stats.live_bytes -= size;
+
+        if (m_stats.idle_bytes + size <= m_max_idle_bytes)
+        {
+            m_free[size].push_back(resource);
+            m_stats.idle_bytes += size;
+        }
+        else
+        {
+            m_stats.evictions++;
+            evict = true;
+        }
+    }
+
+    if (evict)
+        free(resource);
+    return S_OK;
+}
+
+HRESULT PooledResourceManager::CopyResource(void* context, void* command_queue,
+                                            void* source, BlackmagicRawResourceType source_type,
+                                            void* destination, BlackmagicRawResourceType destination_type,
+                                            uint32_t size_bytes, bool copy_async)
+{
+    if (source_type == blackmagicRawResourceTypeBufferCPU
+        && destination_type == blackmagicRawResourceTypeBufferCPU)
+    {
+        memcpy(destination, source, size_bytes);
+        return S_OK;
+    }
+
+    if (!m_fallback)
+        return E_NOTIMPL;
+    return m_fallback->CopyResource(context, command_queue, source, source_type,
+                                    destination, destination_type, size_bytes, copy_async);
+}
+
+HRESULT PooledResourceManager::GetResourceHostPointer(void* context, void* command_queue, void* resource,
+                                                      BlackmagicRawResourceType resource_type,
+                                                      void** host_pointer)
+{
+    if (!host_pointer)
+        return E_POINTER;
+
+    if (resource_type == blackmagicRawResourceTypeBufferCPU)
+    {
+        *host_pointer = resource;
+        return S_OK;
+    }
+
+    if (!m_fallback)
+        return E_NOTIMPL;
+    return m_fallback->GetResourceHostPointer(context, command_queue, resource, resource_type, host_pointer);
+}
@@ -0,0 +1,71 @@
+// PooledResourceManager: IBlackmagicRawResourceManager that recycles the
+// SDK's CPU buffers instead of allocating and freeing them per frame.
+//
+// The SDK requests the same handful of buffer sizes for every frame of a
+// clip, so released buffers go onto a free list keyed by size and are handed
+// out again on the next request of that size. GPU resource types are passed
+// through to the SDK's default manager untouched.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "LinuxCOM.h"
+#include "BlackmagicRawAPI.h"
+
+class PooledResourceManager : public IBlackmagicRawResourceManager
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;          // served from a free list
+        uint64_t misses = 0;        // fresh allocation
+        uint64_t evictions = 0;     // released to the OS (idle cap reached)
+        uint64_t live_bytes = 0;    // currently handed out to the SDK
+        uint64_t idle_bytes = 0;    // sitting on free lists
+        uint64_t peak_bytes = 0;    // max(live + idle)
+    };
+
+    // `fallback` handles non-CPU resource types (may be null). `max_idle_bytes`
+    // caps how much released memory is kept for reuse.
+    PooledResourceManager(IBlackmagicRawResourceManager* fallback, size_t max_idle_bytes);
+
+    Stats stats();
+
+    // IUnknown
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, LPVOID*) override;
+    ULONG STDMETHODCALLTYPE AddRef() override;
+    ULONG STDMETHODCALLTYPE Release() override;
+
+    // IBlackmagicRawResourceManager
+    HRESULT CreateResource(void* context, void* command_queue, uint32_t size_bytes,
+                           BlackmagicRawResourceType type, BlackmagicRawResourceUsage usage,
+                           void** resource) override;
+    HRESULT ReleaseResource(void* context, void* command_queue, void* resource,
+                            BlackmagicRawResourceType type) override;
+    HRESULT CopyResource(void* context, void* command_queue,
+                         void* source, BlackmagicRawResourceType source_type,
+                         void* destination, BlackmagicRawResourceType destination_type,
+                         uint32_t size_bytes, bool copy_async) override;
+    HRESULT GetResourceHostPointer(void* context, void* command_queue, void* resource,
+                                   BlackmagicRawResourceType resource_type,
+                                   void** host_pointer) override;
+
+protected:
+    ~PooledResourceManager() override;
+
+private:
+    std::atomic<ULONG> m_ref;
+    IBlackmagicRawResourceManager* m_fallback;
+    size_t m_max_idle_bytes;
+
+    std::mutex m_mutex;
+    std::unordered_map<size_t, std::vector<void*>> m_free;  // bucket size → buffers
+    std::unordered_map<void*, size_t> m_live;               // buffer → bucket size
+    Stats m_stats;
+};
@@ -0,0 +1,710 @@
+#include "av_encoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "frame_pool.h"
+
+#ifdef BRIDGE_LIBAV
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+}
+#endif
+
+const std::vector<std::string>& AvEncoder::codecs()
+{
+    static const std::vector<std::string> kCodecs = {
+        "h264", "h265", "prores_proxy", "prores_lt", "prores_422", "prores_hq",
+    };
+    return kCodecs;
+}
+
+bool AvEncoder::codec_pix_fmt(const std::string& codec, PixFmt& fmt)
+{
+    if (codec == "h264" || codec == "h265")
+        fmt = PixFmt::YUV420P;
+    else if (codec == "prores_proxy" || codec == "prores_lt"
+             || codec == "prores_422" || codec == "prores_hq")
+        fmt = PixFmt::YUV422P10LE;
+    else
+        return false;
+    return true;
+}
+
+#ifdef BRIDGE_LIBAV
+
+// Audio goes out in packets of at most this many samples per channel
+static constexpr uint64_t kAudioPacketSamples = 4096;
+
+struct AvEncoder::State
+{
+    AVFormatContext* format = nullptr;
+    AVCodecContext* codec = nullptr;
+    AVStream* video = nullptr;
+    AVStream* audio = nullptr;
+    AVPacket* packet = nullptr;
+    AVPixelFormat av_pix_fmt = AV_PIX_FMT_NONE;
+    AvEncoderConfig config;
+    size_t frame_bytes = 0;
+    uint32_t audio_block = 0; // bytes per sample frame, all channels
+    uint64_t audio_written = 0; // per channel
+    bool header_written = false;
+};
+
+// Same encoders as the FFmpeg command lines in the backend; null for codecs
+// not encoded in process
+static const char* encoder_name(const std::string& codec)
+{
+    PixFmt fmt;
+    if (!AvEncoder::codec_pix_fmt(codec, fmt))
+        return nullptr;
+    return fmt == PixFmt::YUV422P10LE ? "prores_ks" : codec == "h265" ? "libx265" : "libx264";
+}
+
+static std::string av_error(const char* what, int code)
+{
+    char buf[AV_ERROR_MAX_STRING_SIZE] = {};
+    av_strerror(code, buf, sizeof(buf));
+    return std::string(what) + ": " + buf;
+}
+
+static void give_back_buffer(void* opaque, uint8_t* data)
+{
+    static_cast<FramePool*>(opaque)->give_back(data);
+}
+
+// Plane pointers and line sizes of a frame in the bridges' packed planar
+// layout (pix_fmt_frame_bytes): planes back to back, no row padding
+static void frame_planes(PixFmt fmt, uint8_t* data, size_t width, size_t height,
+                         uint8_t* planes[4], int linesizes[4])
+{
+    size_t chroma_width = (width + 1) / 2;
+    size_t chroma_height = fmt == PixFmt::YUV420P ? (height + 1) / 2 : height;
+    size_t sample_bytes = fmt == PixFmt::YUV420P ? 1 : 2;
+
+    planes[0] = data;
+    planes[1] = planes[0] + width * height * sample_bytes;
+    planes[2] = planes[1] + chroma_width * chroma_height * sample_bytes;
+    planes[3] = nullptr;
+    linesizes[0] = (int)(width * sample_bytes);
+    linesizes[1] = linesizes[2] = (int)(chroma_width * sample_bytes);
+    linesizes[3] = 0;
+}
+
+static AvEncoder::State* free_state(AvEncoder::State* s)
+{
+    if (!s)
+        return nullptr;
+    // Frees frames libavcodec still holds, which gives their buffers back
+    avcodec_free_context(&s->codec);
+    av_packet_free(&s->packet);
+    if (s->format)
+    {
+        if (!(s->format->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&s->format->pb);
+        avformat_free_context(s->format);
+    }
+    delete s;
+    return nullptr;
+}
+
+AvEncoder::AvEncoder() = default;
+
+AvEncoder::~AvEncoder()
+{
+    m_state = free_state(m_state);
+}
+
+bool AvEncoder::available()
+{
+    return true;
+}
+
+bool AvEncoder::codec_available(const std::string& codec)
+{
+    const char* name = encoder_name(codec);
+    return name && avcodec_find_encoder_by_name(name)
+           && av_guess_format("mov", nullptr, nullptr);
+}
+
+bool AvEncoder::open(const AvEncoderConfig& config, std::string& error)
+{
+    PixFmt expected;
+    if (!codec_pix_fmt(config.codec, expected))
+    {
+        error = "encoder: codec " + config.codec + " is not encoded in process";
+        return false;
+    }
+    if (config.pix_fmt != expected)
+    {
+        error = "encoder: " + config.codec + " takes " + pix_fmt_name(expected) + " frames";
+        return false;
+    }
+
+    // Warnings would interleave with the NDJSON on stderr
+    av_log_set_level(AV_LOG_ERROR);
+
+    m_state = new State();
+    State& s = *m_state;
+    s.config = config;
+    s.frame_bytes = pix_fmt_frame_bytes(config.pix_fmt, config.width, config.height);
+    s.av_pix_fmt = config.pix_fmt == PixFmt::YUV420P ? AV_PIX_FMT_YUV420P
+                                                       : AV_PIX_FMT_YUV422P10LE;
+
+    int ret = avformat_alloc_output_context2(&s.format, nullptr, nullptr,
+                                             config.output_path.c_str());
+    if (ret < 0)
+    {
+        error = av_error("encoder: no muxer for the output", ret);
+        m_state = free_state(m_state);
+        return false;
+    }
+
+    // Same encoder settings as the FFmpeg command lines in the backend
+    bool prores = expected == PixFmt::YUV422P10LE;
+    const char* name = encoder_name(config.codec);
+    const AVCodec* codec = avcodec_find_encoder_by_name(name);
+    if (!codec)
+    {
+        error = std::string("encoder: libavcodec has no ") + name;
+        m_state = free_state(m_state);
+        return false;
+    }
+
+    s.codec = avcodec_alloc_context3(codec);
+    s.packet = av_packet_alloc();
+    s.video = avformat_new_stream(s.format, nullptr);
+    if (!s.codec || !s.packet || !s.video)
+    {
+        error = "encoder: out of memory";
+        m_state = free_state(m_state);
+        return false;
+    }
+
+    s.codec->width = (int)config.width;
+    s.codec->height = (int)config.height;
+    s.codec->pix_fmt = s.av_pix_fmt;
+    s.codec->time_base = AVRational{ (int)config.fps_den, (int)config.fps_num };
+    s.codec->framerate = AVRational{ (int)config.fps_num, (int)config.fps_den };
+    s.codec->colorspace = AVCOL_SPC_BT709;
+    s.codec->color_range = config.yuv_range == YuvRange::Full ? AVCOL_RANGE_JPEG
+                                                              : AVCOL_RANGE_MPEG;
+    s.codec->thread_count = (int)config.threads;
+    // Frame threads would keep pool buffers referenced across calls
+    if (prores)
+        s.codec->thread_type = FF_THREAD_SLICE;
+    if (s.format->oformat->flags & AVFMT_GLOBALHEADER)
+        s.codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary* options = nullptr;
+    if (prores)
+    {
+        static const char* const kProfiles[][2] = {
+            { "prores_proxy", "0" },
+            { "prores_lt",    "1" },
+            { "prores_422",   "2" },
+            { "prores_hq",    "3" },
+        };
+        for (const auto& p : kProfiles)
+        {
+            if (config.codec == p[0])
+                av_dict_set(&options, "profile", p[1], 0);
+        }
+    }
+    else
+    {
+        av_dict_set(&options, "crf", "23", 0);
+        av_dict_set(&options, "preset", "fast", 0);
+    }
+    ret = avcodec_open2(s.codec, codec, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+    {
+        error = av_error((std::string("encoder: opening ") + name + " failed").c_str(), ret);
+        m_state = free_state(m_state);
+        return false;
+    }
+    avcodec_parameters_from_context(s.video->codecpar, s.codec);
+    s.video->time_base = s.codec->time_base;
+    s.video->avg_frame_rate = s.codec->framerate;
+
+    if (config.channels > 0)
+    {
+        AVCodecID pcm_id;
+        switch (config.bits_per_sample)
+        {
+            case 16: pcm_id = AV_CODEC_ID_PCM_S16LE; break;
+            case 24: pcm_id = AV_CODEC_ID_PCM_S24LE; break;
+            case 32: pcm_id = AV_CODEC_ID_PCM_S32LE; break;
+            default:
+                error = "encoder: unsupported audio bit depth " + std::to_string(config.bits_per_sample);
+                m_state = free_state(m_state);
+                return false;
+        }
+        s.audio_block = config.channels * (config.bits_per_sample / 8);
+
+        // PCM needs no encoder; the samples are muxed as they are
+        s.audio = avformat_new_stream(s.format, nullptr);
+        if (!s.audio)
+        {
+            error = "encoder: out of memory";
+            m_state = free_state(m_state);
+            return false;
+        }
+        AVCodecParameters* par = s.audio->codecpar;
+        par->codec_type = AVMEDIA_TYPE_AUDIO;
+        par->codec_id = pcm_id;
+        par->format = config.bits_per_sample == 16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_S32;
+        par->sample_rate = (int)config.sample_rate;
+        av_channel_layout_default(&par->ch_layout, (int)config.channels);
+        par->bits_per_coded_sample = (int)config.bits_per_sample;
+        par->block_align = (int)s.audio_block;
+        par->bit_rate = (int64_t)config.sample_rate * s.audio_block * 8;
+        s.audio->time_base = AVRational{ 1, (int)config.sample_rate };
+    }
+
+    // Written natively instead of -metadata timecode=
+    if (!config.timecode.empty())
+        av_dict_set(&s.format->metadata, "timecode", config.timecode.c_str(), 0);
+
+    if (!(s.format->oformat->flags & AVFMT_NOFILE))
+    {
+        ret = avio_open(&s.format->pb, config.output_path.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0)
+        {
+            error = av_error("encoder: cannot create the output", ret);
+            m_state = free_state(m_state);
+            return false;
+        }
+    }
+    ret = avformat_write_header(s.format, nullptr);
+    if (ret < 0)
+    {
+        error = av_error("encoder: writing the header failed", ret);
+        m_state = free_state(m_state);
+        return false;
+    }
+    s.header_written = true;
+    return true;
+}
+
+// Muxes what the encoder has finished
+static bool drain_packets(AvEncoder::State& s, std::string& error)
+{
+    for (;;)
+    {
+        int ret = avcodec_receive_packet(s.codec, s.packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return true;
+        if (ret < 0)
+        {
+            error = av_error("encoder: encoding failed", ret);
+            return false;
+        }
+        av_packet_rescale_ts(s.packet, s.codec->time_base, s.video->time_base);
+        s.packet->stream_index = s.video->index;
+        ret = av_interleaved_write_frame(s.format, s.packet);
+        if (ret < 0)
+        {
+            error = av_error("encoder: writing a video packet failed", ret);
+            return false;
+        }
+    }
+}
+
+// Muxes the whole samples of `bytes` of PCM after those written so far
+static bool write_audio(AvEncoder::State& s, const uint8_t* data, size_t bytes, std::string& error)
+{
+    if (!s.audio)
+        return true;
+    uint64_t samples = bytes / s.audio_block;
+    for (uint64_t done = 0; done < samples;)
+    {
+        uint64_t count = std::min(samples - done, kAudioPacketSamples);
+        int ret = av_new_packet(s.packet, (int)(count * s.audio_block));
+        if (ret < 0)
+        {
+            error = av_error("encoder: audio packet", ret);
+            return false;
+        }
+        memcpy(s.packet->data, data + done * s.audio_block, count * s.audio_block);
+        s.packet->pts = s.packet->dts = (int64_t)s.audio_written;
+        s.packet->duration = (int64_t)count;
+        av_packet_rescale_ts(s.packet, AVRational{ 1, (int)s.config.sample_rate },
+                             s.audio->time_base);
+        s.packet->stream_index = s.audio->index;
+        ret = av_interleaved_write_frame(s.format, s.packet);
+        if (ret < 0)
+        {
+            error = av_error("encoder: writing an audio packet failed", ret);
+            return false;
+        }
+        s.audio_written += count;
+        done += count;
+    }
+    return true;
+}
+
+bool AvEncoder::encode(uint8_t* data, FramePool* pool, const uint8_t* audio, size_t audio_bytes)
+{
+    if (!m_state || !m_error.empty())
+    {
+        if (pool)
+            pool->give_back(data);
+        if (m_error.empty())
+            m_error = "encoder: not open";
+        return false;
+    }
+    State& s = *m_state;
+    const AvEncoderConfig& c = s.config;
+
+    uint8_t* planes[4];
+    int linesizes[4];
+    frame_planes(c.pix_fmt, data, c.width, c.height, planes, linesizes);
+
+    AVFrame* frame = av_frame_alloc();
+    bool ok = frame != nullptr;
+    if (ok && pool)
+    {
+        // Zero copy: the frame points into the pool buffer and owns it
+        frame->buf[0] = av_buffer_create(data, (int)s.frame_bytes, give_back_buffer, pool, 0);
+        ok = frame->buf[0] != nullptr;
+        for (int i = 0; i < 4; i++)
+        {
+            frame->data[i] = planes[i];
+            frame->linesize[i] = linesizes[i];
+        }
+    }
+    if (!ok && pool)
+        pool->give_back(data);
+
+    if (ok)
+    {
+        frame->format = s.av_pix_fmt;
+        frame->width = (int)c.width;
+        frame->height = (int)c.height;
+        frame->pts = (int64_t)m_frames;
+        if (!pool)
+        {
+            // Nothing keeps the caller from reusing an unpooled buffer
+            const uint8_t* src[4] = { planes[0], planes[1], planes[2], nullptr };
+            ok = av_frame_get_buffer(frame, 0) == 0;
+            if (ok)
+                av_image_copy(frame->data, frame->linesize, src, linesizes,
+                              s.av_pix_fmt, (int)c.width, (int)c.height);
+        }
+    }
+    if (!ok)
+    {
+        av_frame_free(&frame);
+        m_error = "encoder: out of memory";
+        return false;
+    }
+
+    int ret = avcodec_send_frame(s.codec, frame);
+    av_frame_free(&frame);
+    if (ret < 0)
+    {
+        m_error = av_error("encoder: encoding failed", ret);
+        return false;
+    }
+    m_frames++;
+    return drain_packets(s, m_error) && write_audio(s, audio, audio_bytes, m_error);
+}
+
+bool AvEncoder::finish()
+{
+    if (!m_state)
+        return m_error.empty();
+    State& s = *m_state;
+    bool ok = m_error.empty();
+
+    if (ok)
+    {
+        int ret = avcodec_send_frame(s.codec, nullptr);
+        if (ret < 0)
+        {
+            m_error = av_error("encoder: flushing failed", ret);
+            ok = false;
+        }
+    }
+    ok = ok && drain_packets(s, m_error);
+    if (ok && s.header_written)
+    {
+        int ret = av_write_trailer(s.format);
+        if (ret < 0)
+        {
+            m_error = av_error("encoder: writing the trailer failed", ret);
+            ok = false;
+        }
+    }
+    m_state = free_state(m_state);
+    return ok;
+}
+
+#else // !BRIDGE_LIBAV
+
+struct AvEncoder::State
+{
+};
+
+AvEncoder::AvEncoder() = default;
+AvEncoder::~AvEncoder() = default;
+
+bool AvEncoder::available()
+{
+    return false;
+}
+
+bool AvEncoder::codec_available(const std::string&)
+{
+    return false;
+}
+
+bool AvEncoder::open(const AvEncoderConfig&, std::string& error)
+{
+    error = "in-process encoding needs a bridge built with -DBRIDGE_LIBAV=ON";
+    return false;
+}
+
+bool AvEncoder::encode(uint8_t* data, FramePool* pool, const uint8_t*, size_t)
+{
+    if (pool)
+        pool->give_back(data);
+    m_error = "encoder: not open";
+    return false;
+}
+
+bool AvEncoder::finish()
+{
+    return m_error.empty();
+}
+
+#endif
+
+// Self-check: a short clip through the encoder and back through libav
+
+#ifdef BRIDGE_LIBAV
+
+// Frame `index` in the bridges' packed layout: flat, Y rising with the
+// index, neutral chroma
+static void fill_test_frame(PixFmt fmt, size_t width, size_t height, uint64_t index, uint8_t* data)
+{
+    uint8_t* planes[4];
+    int linesizes[4];
+    frame_planes(fmt, data, width, height, planes, linesizes);
+    size_t chroma_height = fmt == PixFmt::YUV420P ? (height + 1) / 2 : height;
+    uint32_t luma = 64 + (uint32_t)index * 8;
+    if (fmt == PixFmt::YUV420P)
+    {
+        memset(planes[0], (int)luma, (size_t)linesizes[0] * height);
+        memset(planes[1], 128, (size_t)linesizes[1] * chroma_height);
+        memset(planes[2], 128, (size_t)linesizes[2] * chroma_height);
+        return;
+    }
+    auto fill16 = [](uint8_t* p, uint32_t v, size_t bytes)
+    {
+        for (size_t i = 0; i + 1 < bytes; i += 2)
+        {
+            p[i] = (uint8_t)v;
+            p[i + 1] = (uint8_t)(v >> 8);
+        }
+    };
+    fill16(planes[0], luma << 2, (size_t)linesizes[0] * height);
+    fill16(planes[1], 512, (size_t)linesizes[1] * chroma_height);
+    fill16(planes[2], 512, (size_t)linesizes[2] * chroma_height);
+}
+
+// 8-bit luma in the middle of a decoded picture
+static int centre_luma(const AVFrame* frame)
+{
+    const uint8_t* row = frame->data[0] + (size_t)(frame->height / 2) * frame->linesize[0];
+    int x = frame->width / 2;
+    if (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P)
+        return row[x];
+    return (row[x * 2] | (row[x * 2 + 1] << 8)) >> 2; // 10-bit ProRes
+}
+
+struct ReadBack
+{
+    AVCodecID codec = AV_CODEC_ID_NONE;
+    int width = 0;
+    int height = 0;
+    uint64_t video_packets = 0;
+    uint64_t audio_samples = 0;
+    std::string timecode;
+    int first_luma = -1; // first frame in display order
+};
+
+static bool read_back(const std::string& path, uint32_t audio_block, ReadBack& r)
+{
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, path.c_str(), nullptr, nullptr) < 0)
+        return false;
+    bool ok = avformat_find_stream_info(format, nullptr) >= 0;
+    int video = ok ? av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0) : -1;
+    int audio = ok ? av_find_best_stream(format, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0) : -1;
+    ok = video >= 0 && audio >= 0;
+
+    AVCodecContext* decoder = nullptr;
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    if (ok)
+    {
+        const AVCodecParameters* par = format->streams[video]->codecpar;
+        r.codec = par->codec_id;
+        r.width = par->width;
+        r.height = par->height;
+
+        // The mov demuxer reports the tmcd track on the video stream
+        const AVDictionaryEntry* tc = av_dict_get(format->streams[video]->metadata, "timecode",
+                                                  nullptr, 0);
+        if (!tc)
+            tc = av_dict_get(format->metadata, "timecode", nullptr, 0);
+        if (tc)
+            r.timecode = tc->value;
+
+        const AVCodec* codec = avcodec_find_decoder(par->codec_id);
+        decoder = codec ? avcodec_alloc_context3(codec) : nullptr;
+        ok = decoder && packet && frame && avcodec_parameters_to_context(decoder, par) >= 0
+             && avcodec_open2(decoder, codec, nullptr) >= 0;
+    }
+
+    auto receive = [&]()
+    {
+        while (avcodec_receive_frame(decoder, frame) == 0)
+        {
+            if (r.first_luma < 0)
+                r.first_luma = centre_luma(frame);
+            av_frame_unref(frame);
+        }
+    };
+    while (ok && av_read_frame(format, packet) >= 0)
+    {
+        if (packet->stream_index == video)
+        {
+            r.video_packets++;
+            ok = avcodec_send_packet(decoder, packet) >= 0;
+            receive();
+        }
+        else if (packet->stream_index == audio)
+        {
+            r.audio_samples += (uint64_t)packet->size / audio_block;
+        }
+        av_packet_unref(packet);
+    }
+    if (ok && avcodec_send_packet(decoder, nullptr) >= 0)
+        receive();
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&format);
+    return ok;
+}
+
+// One codec: half the frames through a pool, half copied
+static bool encoder_check(const std::string& codec, const std::string& dir)
+{
+    static constexpr size_t kWidth = 128, kHeight = 96;
+    static constexpr uint64_t kFrames = 12;
+    static constexpr uint32_t kRate = 48000, kChannels = 2;
+    static constexpr uint64_t kSamples = kFrames * kRate / 24;
+
+    AvEncoderConfig config;
+    config.output_path = dir + "/" + codec + ".mov";
+    config.codec = codec;
+    AvEncoder::codec_pix_fmt(codec, config.pix_fmt);
+    config.width = kWidth;
+    config.height = kHeight;
+    config.fps_num = 24;
+    config.fps_den = 1;
+    config.timecode = "01:00:00:00";
+    config.threads = 2;
+    std::vector<uint8_t> pcm(kSamples * kChannels * 2);
+    for (size_t i = 0; i < pcm.size(); i++)
+        pcm[i] = (uint8_t)(i * 13);
+    config.sample_rate = kRate;
+    config.channels = kChannels;
+    config.bits_per_sample = 16;
+
+    size_t frame_bytes = pix_fmt_frame_bytes(config.pix_fmt, kWidth, kHeight);
+    FramePoolConfig pool_config;
+    pool_config.buffer_bytes = frame_bytes;
+    pool_config.count = 4;
+    pool_config.huge_pages = HugePageMode::Off;
+    pool_config.prefault = false;
+    FramePool pool;
+    std::string error;
+    AvEncoder encoder;
+    bool ok = pool.init(pool_config, error) && encoder.open(config, error);
+    std::vector<uint8_t> copied(frame_bytes);
+    const size_t block = kChannels * 2;
+    for (uint64_t i = 0; ok && i < kFrames; i++)
+    {
+        // Each frame brings its span of the audio, as from the bridges
+        const uint8_t* audio = pcm.data() + i * kRate / 24 * block;
+        size_t audio_bytes = kRate / 24 * block;
+        if (i < kFrames / 2)
+        {
+            uint8_t* data = pool.checkout();
+            fill_test_frame(config.pix_fmt, kWidth, kHeight, i, data);
+            ok = encoder.encode(data, &pool, audio, audio_bytes);
+        }
+        else
+        {
+            fill_test_frame(config.pix_fmt, kWidth, kHeight, i, copied.data());
+            ok = encoder.encode(copied.data(), nullptr, audio, audio_bytes);
+        }
+    }
+    ok = ok && encoder.finish() && encoder.frames() == kFrames;
+
+    AVCodecID expected = codec == "h264" ? AV_CODEC_ID_H264
+                       : codec == "h265" ? AV_CODEC_ID_HEVC : AV_CODEC_ID_PRORES;
+    ReadBack r;
+    ok = ok && read_back(config.output_path, kChannels * 2, r)
+         && r.codec == expected && r.width == (int)kWidth && r.height == (int)kHeight
+         && r.video_packets == kFrames && r.audio_samples == kSamples
+         && r.timecode == config.timecode && std::abs(r.first_luma - 64) <= 4;
+    unlink(config.output_path.c_str());
+    return ok;
+}
+
+bool av_encoder_self_check(FILE* report)
+{
+    char dir[] = "/tmp/av-encoder-self-check-XXXXXX";
+    bool ok = mkdtemp(dir) != nullptr;
+    std::string codecs;
+    for (const std::string& codec : AvEncoder::codecs())
+    {
+        if (!ok || !AvEncoder::codec_available(codec))
+            continue;
+        bool codec_ok = encoder_check(codec, dir);
+        codecs += std::string(codecs.empty() ? "" : ",") + "\"" + codec + "\"";
+        if (!codec_ok)
+            fprintf(report, "{\"type\":\"self_check\",\"check\":\"av_encoder\",\"codec\":\"%s\","
+                            "\"ok\":false}\n", codec.c_str());
+        ok = codec_ok && ok;
+    }
+    rmdir(dir);
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"av_encoder\",\"ok\":%s,\"libav\":true,"
+                    "\"codecs\":[%s]}\n", ok ? "true" : "false", codecs.c_str());
+    return ok;
+}
+
+#else // !BRIDGE_LIBAV
+
+bool av_encoder_self_check(FILE* report)
+{
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"av_encoder\",\"ok\":true,\"libav\":false}\n");
+    return true;
+}
+
+#endif
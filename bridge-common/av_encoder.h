@@ -0,0 +1,112 @@
+// av_encoder: in-process encoding and muxing with libavcodec/libavformat,
+// the alternative to piping frames into an FFmpeg child. The bridge writes
+// the proxy file itself: H.264/H.265 through libx264/libx265 (crf 23,
+// preset fast) or ProRes through prores_ks, PCM audio from the clip, and
+// the clip timecode as container metadata, matching what the backend asks
+// of FFmpeg (backend/src/ffmpeg/runner.rs).
+//
+// Frames are not copied on the way in: each pool buffer is wrapped as the
+// AVFrame's data, with a free callback that gives it back to its pool once
+// libavcodec lets go of it. The encoders used copy the picture into their
+// own lookahead (x264, x265) or are run slice-threaded (prores_ks), so that
+// normally happens before encode() returns.
+//
+// Only built with -DBRIDGE_LIBAV=ON; otherwise open() fails with a message
+// saying so, and the bridges keep writing to stdout. A bridge's
+// --capabilities line lists the codecs this build encodes (codec_available()),
+// so that the backend only asks for --encode where it works.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pixel_format.h"
+#include "yuv_convert.h"
+
+class FramePool;
+
+struct AvEncoderConfig
+{
+    std::string output_path;  // .mov or .mp4, by extension
+    std::string codec;        // h264, h265, prores_proxy|prores_lt|prores_422|prores_hq
+    PixFmt pix_fmt = PixFmt::YUV420P; // must be codec_pix_fmt(codec)
+    size_t width = 0;
+    size_t height = 0;
+    uint32_t fps_num = 0;
+    uint32_t fps_den = 1;
+    YuvRange yuv_range = YuvRange::Limited;
+    std::string timecode;     // "HH:MM:SS:FF", empty for none
+    unsigned threads = 0;     // encoder threads; 0 = libavcodec default
+
+    // Optional PCM audio, interleaved little endian, signed; none with 0
+    // channels. The samples come with each frame (encode()), so that
+    // nothing holds more than a frame's worth of them, as with --mux nut.
+    uint32_t sample_rate = 0;
+    uint32_t channels = 0;
+    uint32_t bits_per_sample = 0; // 16, 24 or 32
+};
+
+class AvEncoder
+{
+public:
+    AvEncoder();
+    ~AvEncoder();
+
+    AvEncoder(const AvEncoder&) = delete;
+    AvEncoder& operator=(const AvEncoder&) = delete;
+
+    // Whether this build links libavcodec/libavformat
+    static bool available();
+
+    // Every codec --encode-codec takes: h264, h265 and the ProRes profiles
+    static const std::vector<std::string>& codecs();
+
+    // Whether open() can encode `codec` here: libav linked, and libavcodec
+    // with its encoder (libx264, libx265, prores_ks) and the mov muxer
+    static bool codec_available(const std::string& codec);
+
+    // The pixel format the bridge hands `codec` frames in (yuv420p for
+    // H.264/H.265, yuv422p10le for ProRes). Returns false for codecs that
+    // are not encoded in process.
+    static bool codec_pix_fmt(const std::string& codec, PixFmt& fmt);
+
+    // Creates the output file, opens the encoder and writes the header. On
+    // failure returns false and sets `error`.
+    bool open(const AvEncoderConfig& config, std::string& error);
+
+    // Encodes the next frame and muxes `audio_bytes` of PCM behind it: the
+    // samples from where the previous frame's ended up to the end of this
+    // one (the clip's last frame: whatever is left). `data` belongs to the
+    // encoder from here on and goes back to `pool` once it is no longer
+    // referenced, also on failure; a frame without a pool is copied first.
+    // Returns false on failure, see error().
+    bool encode(uint8_t* data, FramePool* pool, const uint8_t* audio = nullptr,
+                size_t audio_bytes = 0);
+
+    // Flushes the encoder and finishes the file. Returns false on failure,
+    // see error().
+    bool finish();
+
+    const std::string& error() const { return m_error; }
+    uint64_t frames() const { return m_frames; }
+
+    // libav contexts, defined in av_encoder.cpp
+    struct State;
+
+private:
+    State* m_state = nullptr;
+    std::string m_error;
+    uint64_t m_frames = 0;
+};
+
+// bridge-common-tests: encodes a few frames with audio and a timecode to a
+// temporary .mov with each codec this build can encode, through a frame
+// pool and by copy, and reads the file back with libavformat/libavcodec
+// (streams, frame count, audio samples, timecode, decoded picture).
+// Prints one {"type":"self_check","check":"av_encoder"} line; returns false
+// on mismatch. Without libav it reports "libav":false and passes.
+bool av_encoder_self_check(FILE* report);
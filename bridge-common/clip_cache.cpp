@@ -0,0 +1,631 @@
+#include "clip_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// File layout
+// ---------------------------------------------------------------------------
+
+static const uint32_t kMagic = 0x43435242; // "BRCC"
+static const uint32_t kVersion = 1;
+
+// Past this size a store rewrites the cache once superseded records
+// outweigh the live ones
+static const size_t kCompactBytes = 1 << 20;
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+};
+
+// Followed by the path, timecode and camera bytes, then zero padding to a
+// multiple of 8
+struct RecordHeader
+{
+    uint32_t size;     // whole record
+    uint32_t checksum; // FNV-1a of the record after this field
+    uint64_t path_hash;
+    uint64_t device;
+    uint64_t inode;
+    uint64_t file_size;
+    int64_t mtime_ns;
+    uint64_t frame_count;
+    uint64_t audio_samples;
+    double pixel_aspect;
+    uint32_t fps_num;
+    uint32_t fps_den;
+    uint32_t width;
+    uint32_t height;
+    uint32_t audio_channels;
+    uint32_t audio_sample_rate;
+    uint32_t audio_bits;
+    uint32_t path_len;
+    uint32_t timecode_len;
+    uint32_t camera_len;
+};
+
+static uint32_t fnv1a32(const uint8_t* data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+static uint64_t fnv1a64(const std::string& s)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : s)
+        hash = (hash ^ c) * 1099511628211ull;
+    return hash;
+}
+
+static std::string encode_record(const std::string& clip, const ClipFingerprint& fingerprint,
+                                 const ClipInfo& info)
+{
+    RecordHeader h = {};
+    h.path_hash = fnv1a64(clip);
+    h.device = fingerprint.device;
+    h.inode = fingerprint.inode;
+    h.file_size = fingerprint.size;
+    h.mtime_ns = fingerprint.mtime_ns;
+    h.frame_count = info.frame_count;
+    h.audio_samples = info.audio_samples;
+    h.pixel_aspect = info.pixel_aspect;
+    h.fps_num = info.fps_num;
+    h.fps_den = info.fps_den;
+    h.width = info.width;
+    h.height = info.height;
+    h.audio_channels = info.audio_channels;
+    h.audio_sample_rate = info.audio_sample_rate;
+    h.audio_bits = info.audio_bits;
+    h.path_len = (uint32_t)clip.size();
+    h.timecode_len = (uint32_t)info.timecode.size();
+    h.camera_len = (uint32_t)info.camera.size();
+
+    size_t size = sizeof(h) + clip.size() + info.timecode.size() + info.camera.size();
+    size = (size + 7) & ~(size_t)7;
+    h.size = (uint32_t)size;
+
+    std::string record(size, '\0');
+    memcpy(&record[0], &h, sizeof(h));
+    size_t at = sizeof(h);
+    memcpy(&record[at], clip.data(), clip.size());
+    at += clip.size();
+    memcpy(&record[at], info.timecode.data(), info.timecode.size());
+    at += info.timecode.size();
+    memcpy(&record[at], info.camera.data(), info.camera.size());
+
+    const uint8_t* bytes = (const uint8_t*)record.data();
+    uint32_t checksum = fnv1a32(bytes + 8, size - 8);
+    memcpy(&record[4], &checksum, sizeof(checksum));
+    return record;
+}
+
+// The record at `offset` if it is whole and intact
+static bool read_record(const uint8_t* data, size_t end, size_t offset, RecordHeader& h)
+{
+    if (end - offset < sizeof(h))
+        return false;
+    memcpy(&h, data + offset, sizeof(h));
+    if (h.size < sizeof(h) || h.size % 8 != 0 || h.size > end - offset)
+        return false;
+    if ((uint64_t)h.path_len + h.timecode_len + h.camera_len > h.size - sizeof(h))
+        return false;
+    return fnv1a32(data + offset + 8, h.size - 8) == h.checksum;
+}
+
+static std::string record_path(const uint8_t* data, size_t offset, const RecordHeader& h)
+{
+    return std::string((const char*)data + offset + sizeof(h), h.path_len);
+}
+
+// Calls `visit(offset, header)` for each intact record in order; returns
+// where the intact records end
+template <typename Visit>
+static size_t scan_records(const uint8_t* data, size_t size, Visit visit)
+{
+    size_t offset = sizeof(FileHeader);
+    RecordHeader h;
+    while (offset < size && read_record(data, size, offset, h))
+    {
+        visit(offset, h);
+        offset += h.size;
+    }
+    return offset;
+}
+
+static bool header_valid(const uint8_t* data, size_t size)
+{
+    FileHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    return header.magic == kMagic && header.version == kVersion;
+}
+
+// ---------------------------------------------------------------------------
+// Locked, mapped access
+// ---------------------------------------------------------------------------
+
+// Opens `path` and flock()s it shared or exclusive. Retries when the file
+// was renamed away (by a compaction) while waiting for the lock. -1 with
+// errno set on failure.
+static int open_locked(const std::string& path, bool exclusive)
+{
+    for (;;)
+    {
+        int flags = exclusive ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC;
+        int fd = open(path.c_str(), flags, 0644);
+        if (fd < 0)
+            return -1;
+
+        int rc;
+        while ((rc = flock(fd, exclusive ? LOCK_EX : LOCK_SH)) != 0 && errno == EINTR) {}
+        if (rc != 0)
+        {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+
+        struct stat held, named;
+        if (fstat(fd, &held) == 0 && stat(path.c_str(), &named) == 0
+            && held.st_dev == named.st_dev && held.st_ino == named.st_ino)
+            return fd;
+        close(fd);
+    }
+}
+
+// A read-only mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile()
+    {
+        if (m_data)
+            munmap(m_data, m_size);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // An empty file maps to nothing and still succeeds
+    bool map(int fd)
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            return false;
+        m_size = (size_t)st.st_size;
+        if (m_size == 0)
+            return true;
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            m_size = 0;
+            return false;
+        }
+        m_data = (uint8_t*)p;
+        return true;
+    }
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+static bool write_all(int fd, const void* data, size_t size, off_t offset)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0)
+    {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool make_parent_dirs(const std::string& path, std::string& error)
+{
+    for (size_t slash = path.find('/', 1); slash != std::string::npos;
+         slash = path.find('/', slash + 1))
+    {
+        std::string dir = path.substr(0, slash);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            error = "Cannot create " + dir + ": " + strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+bool clip_fingerprint(const std::string& path, ClipFingerprint& out)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    out.device = (uint64_t)st.st_dev;
+    out.inode = (uint64_t)st.st_ino;
+    out.size = (uint64_t)st.st_size;
+    out.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+std::string clip_cache_default_path(const char* bridge)
+{
+    std::string base;
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (xdg && xdg[0] == '/')
+        base = xdg;
+    else if (home && home[0] != '\0')
+        base = std::string(home) + "/.cache";
+    else
+        return std::string();
+    return base + "/proxy-generator/" + bridge + "-clips.cache";
+}
+
+bool clip_cache_lookup(const std::string& cache, const std::string& clip,
+                       const ClipFingerprint& fingerprint, ClipInfo& info)
+{
+    if (cache.empty())
+        return false;
+    int fd = open_locked(cache, false);
+    if (fd < 0)
+        return false;
+
+    bool found = false;
+    {
+        MappedFile file;
+        if (file.map(fd) && header_valid(file.data(), file.size()))
+        {
+            // The clip's latest record decides
+            const uint8_t* data = file.data();
+            uint64_t path_hash = fnv1a64(clip);
+            size_t latest = 0;
+            scan_records(data, file.size(), [&](size_t offset, const RecordHeader& h)
+            {
+                if (h.path_hash == path_hash && record_path(data, offset, h) == clip)
+                    latest = offset;
+            });
+
+            RecordHeader h;
+            if (latest != 0 && read_record(data, file.size(), latest, h)
+                && h.device == fingerprint.device && h.inode == fingerprint.inode
+                && h.file_size == fingerprint.size && h.mtime_ns == fingerprint.mtime_ns)
+            {
+                const char* strings = (const char*)data + latest + sizeof(h) + h.path_len;
+                info.frame_count = h.frame_count;
+                info.fps_num = h.fps_num;
+                info.fps_den = h.fps_den;
+                info.width = h.width;
+                info.height = h.height;
+                info.pixel_aspect = h.pixel_aspect;
+                info.timecode.assign(strings, h.timecode_len);
+                info.audio_channels = h.audio_channels;
+                info.audio_sample_rate = h.audio_sample_rate;
+                info.audio_bits = h.audio_bits;
+                info.audio_samples = h.audio_samples;
+                info.camera.assign(strings + h.timecode_len, h.camera_len);
+                found = true;
+            }
+        }
+    }
+    close(fd);
+    return found;
+}
+
+// Writes the live records (the latest per clip) to a new file and renames
+// it over `cache`. `file` holds the records up to `old_end`; the one just
+// appended is `appended`.
+static bool compact(const std::string& cache, const MappedFile& file, size_t old_end,
+                    const std::vector<size_t>& live, const std::string& appended)
+{
+    std::string tmp = cache + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    FileHeader header = { kMagic, kVersion, 0 };
+    bool ok = write_all(fd, &header, sizeof(header), 0);
+    off_t at = sizeof(header);
+    for (size_t offset : live)
+    {
+        if (!ok)
+            break;
+        if (offset < old_end)
+        {
+            RecordHeader h;
+            memcpy(&h, file.data() + offset, sizeof(h));
+            ok = write_all(fd, file.data() + offset, h.size, at);
+            at += h.size;
+        }
+        else
+        {
+            ok = write_all(fd, appended.data(), appended.size(), at);
+            at += (off_t)appended.size();
+        }
+    }
+    close(fd);
+
+    if (ok && rename(tmp.c_str(), cache.c_str()) == 0)
+        return true;
+    unlink(tmp.c_str());
+    return false;
+}
+
+bool clip_cache_store(const std::string& cache, const std::string& clip,
+                      const ClipFingerprint& fingerprint, const ClipInfo& info,
+                      std::string& error)
+{
+    if (cache.empty())
+    {
+        error = "No clip cache path";
+        return false;
+    }
+    std::string record = encode_record(clip, fingerprint, info);
+    if (!make_parent_dirs(cache, error))
+        return false;
+
+    int fd = open_locked(cache, true);
+    if (fd < 0)
+    {
+        error = "Cannot open clip cache " + cache + ": " + strerror(errno);
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.map(fd))
+    {
+        error = "Cannot map clip cache " + cache + ": " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    // Latest record per clip; anything past the intact records (a torn
+    // append) or a file of another layout is dropped
+    std::unordered_map<std::string, size_t> latest;
+    size_t end = sizeof(FileHeader);
+    bool fresh = !header_valid(file.data(), file.size());
+    if (!fresh)
+    {
+        const uint8_t* data = file.data();
+        end = scan_records(data, file.size(), [&](size_t offset, const RecordHeader& h)
+        {
+            latest[record_path(data, offset, h)] = offset;
+        });
+    }
+
+    bool ok = true;
+    if (fresh)
+    {
+        FileHeader header = { kMagic, kVersion, 0 };
+        ok = write_all(fd, &header, sizeof(header), 0);
+    }
+    if (ok && file.size() != end)
+        ok = ftruncate(fd, (off_t)end) == 0;
+    if (ok)
+        ok = write_all(fd, record.data(), record.size(), (off_t)end);
+    if (!ok)
+    {
+        error = "Writing clip cache " + cache + " failed: " + strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    size_t old_end = end;
+    latest[clip] = end;
+    end += record.size();
+
+    size_t live_bytes = 0;
+    std::vector<size_t> live;
+    for (const auto& entry : latest)
+    {
+        live.push_back(entry.second);
+        if (entry.second < old_end)
+        {
+            RecordHeader h;
+            memcpy(&h, file.data() + entry.second, sizeof(h));
+            live_bytes += h.size;
+        }
+        else
+        {
+            live_bytes += record.size();
+        }
+    }
+    // A failed compaction leaves a valid, only larger cache
+    if (end > kCompactBytes && end - sizeof(FileHeader) - live_bytes > live_bytes)
+    {
+        std::sort(live.begin(), live.end());
+        compact(cache, file, old_end, live, record);
+    }
+
+    close(fd);
+    return true;
+}
+
+std::string clip_info_json_fields(const ClipInfo& info, bool cached)
+{
+    char buf[256];
+    std::string out;
+    snprintf(buf, sizeof(buf), ",\"pixel_aspect\":%.6g", info.pixel_aspect);
+    out += buf;
+    if (info.audio_channels > 0)
+    {
+        snprintf(buf, sizeof(buf),
+                 ",\"audio\":{\"channels\":%u,\"sample_rate\":%u,\"bits\":%u,\"samples\":%llu}",
+                 info.audio_channels, info.audio_sample_rate, info.audio_bits,
+                 (unsigned long long)info.audio_samples);
+        out += buf;
+    }
+    else
+    {
+        out += ",\"audio\":null";
+    }
+    out += ",\"camera\":";
+    out += info.camera.empty() ? std::string("{}") : info.camera;
+    if (cached)
+        out += ",\"cached\":true";
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+static bool same_info(const ClipInfo& a, const ClipInfo& b)
+{
+    return a.frame_count == b.frame_count && a.fps_num == b.fps_num && a.fps_den == b.fps_den
+        && a.width == b.width && a.height == b.height && a.pixel_aspect == b.pixel_aspect
+        && a.timecode == b.timecode && a.audio_channels == b.audio_channels
+        && a.audio_sample_rate == b.audio_sample_rate && a.audio_bits == b.audio_bits
+        && a.audio_samples == b.audio_samples && a.camera == b.camera;
+}
+
+static ClipInfo test_info(uint64_t frames, size_t camera_pad)
+{
+    ClipInfo info;
+    info.frame_count = frames;
+    info.fps_num = 24000;
+    info.fps_den = 1001;
+    info.width = 6144;
+    info.height = 3456;
+    info.pixel_aspect = 1.33;
+    info.timecode = "01:02:03:04";
+    info.audio_channels = 2;
+    info.audio_sample_rate = 48000;
+    info.audio_bits = 24;
+    info.audio_samples = frames * 2002;
+    info.camera = "{\"camera_type\":\"test\",\"pad\":\"" + std::string(camera_pad, 'x') + "\"}";
+    return info;
+}
+
+bool clip_cache_self_check(FILE* report)
+{
+    char dir[] = "/tmp/clip-cache-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        fprintf(report, "{\"type\":\"self_check\",\"check\":\"clip_cache\",\"ok\":false}\n");
+        return false;
+    }
+    std::string sub = std::string(dir) + "/sub";
+    std::string cache = sub + "/test.cache";
+    std::string error;
+    ClipInfo got;
+
+    ClipFingerprint fp1 = { 1, 100, 4096, 1000 };
+    ClipFingerprint fp2 = fp1;
+    fp2.mtime_ns++;
+    ClipInfo a1 = test_info(240, 8);
+    ClipInfo a2 = test_info(480, 8);
+    ClipInfo b = test_info(10, 0);
+    b.audio_channels = 0;
+    b.camera = "{}";
+
+    // Miss without a cache; hit, then stale once the fingerprint changes
+    bool ok = !clip_cache_lookup(cache, "/card/A001.braw", fp1, got);
+    ok = ok && clip_cache_store(cache, "/card/A001.braw", fp1, a1, error)
+         && clip_cache_lookup(cache, "/card/A001.braw", fp1, got) && same_info(got, a1)
+         && !clip_cache_lookup(cache, "/card/A001.braw", fp2, got)
+         && !clip_cache_lookup(cache, "/card/B001.braw", fp1, got);
+    ok = ok && clip_cache_store(cache, "/card/A001.braw", fp2, a2, error)
+         && clip_cache_lookup(cache, "/card/A001.braw", fp2, got) && same_info(got, a2)
+         && !clip_cache_lookup(cache, "/card/A001.braw", fp1, got);
+
+    // A torn append is ignored by lookups and cut off by the next store
+    if (FILE* f = fopen(cache.c_str(), "ab"))
+    {
+        fwrite("torn record", 1, 11, f);
+        fclose(f);
+    }
+    ok = ok && clip_cache_lookup(cache, "/card/A001.braw", fp2, got)
+         && clip_cache_store(cache, "/card/B001.braw", fp1, b, error)
+         && clip_cache_lookup(cache, "/card/B001.braw", fp1, got) && same_info(got, b)
+         && clip_cache_lookup(cache, "/card/A001.braw", fp2, got) && same_info(got, a2);
+
+    // Superseding one clip over and over compacts the file
+    ClipInfo c;
+    for (uint64_t i = 0; ok && i < 80; i++)
+    {
+        ClipFingerprint fp = fp1;
+        fp.mtime_ns += (int64_t)i;
+        c = test_info(1000 + i, 16384);
+        ok = clip_cache_store(cache, "/card/C001.braw", fp, c, error);
+    }
+    struct stat st;
+    ClipFingerprint last_c = fp1;
+    last_c.mtime_ns += 79;
+    ok = ok && stat(cache.c_str(), &st) == 0 && (size_t)st.st_size < kCompactBytes
+         && clip_cache_lookup(cache, "/card/C001.braw", last_c, got) && same_info(got, c)
+         && clip_cache_lookup(cache, "/card/A001.braw", fp2, got) && same_info(got, a2)
+         && clip_cache_lookup(cache, "/card/B001.braw", fp1, got);
+
+    // Stores and lookups from several threads at once
+    std::atomic<bool> threads_ok{true};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (int i = 0; i < 10; i++)
+            {
+                std::string clip = "/card/T" + std::to_string(t) + "_" + std::to_string(i) + ".braw";
+                ClipInfo info = test_info((uint64_t)(t * 100 + i), 4096);
+                ClipInfo back;
+                std::string err;
+                if (!clip_cache_store(cache, clip, fp1, info, err)
+                    || !clip_cache_lookup(cache, clip, fp1, back) || !same_info(back, info))
+                    threads_ok = false;
+            }
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    for (int t = 0; t < 4; t++)
+        for (int i = 0; i < 10; i++)
+        {
+            std::string clip = "/card/T" + std::to_string(t) + "_" + std::to_string(i) + ".braw";
+            if (!clip_cache_lookup(cache, clip, fp1, got) || got.frame_count != (uint64_t)(t * 100 + i))
+                threads_ok = false;
+        }
+    ok = ok && threads_ok;
+
+    unlink(cache.c_str());
+    rmdir(sub.c_str());
+    rmdir(dir);
+
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"clip_cache\",\"ok\":%s}\n",
+            ok ? "true" : "false");
+    return ok;
+}
@@ -0,0 +1,78 @@
+// clip_cache: what a probe learned about a clip, kept on disk so the next
+// --probe-only of the same file is answered without opening it.
+//
+// One cache file per bridge (--clip-cache, by default
+// $XDG_CACHE_HOME/proxy-generator/<bridge>-clips.cache). An entry is keyed
+// by the clip's path and a fingerprint of the file: device, inode, size and
+// mtime in ns. A clip that was rewritten, replaced or touched no longer
+// matches and is probed again; its new entry supersedes the old one.
+//
+// The file is an append-only log of checksummed records. A lookup maps it
+// and scans it under a shared flock(); a store appends under an exclusive
+// one, first cutting off a torn record a crashed writer left behind. Once
+// superseded records make up most of the file, the store rewrites the live
+// ones into a new file renamed over the old. Every call opens the file
+// afresh, so the workers of one batch probe lock against each other just as
+// separate bridge processes do, and a call that finds the file renamed away
+// under it starts over on the new one.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+struct ClipFingerprint
+{
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+};
+
+// stat()s `path`; false if it cannot
+bool clip_fingerprint(const std::string& path, ClipFingerprint& out);
+
+// The clip properties a probe reports, independent of any decode option
+struct ClipInfo
+{
+    uint64_t frame_count = 0;
+    uint32_t fps_num = 0;
+    uint32_t fps_den = 1;
+    uint32_t width = 0;  // full sensor resolution
+    uint32_t height = 0;
+    double pixel_aspect = 1.0;
+    std::string timecode;
+    uint32_t audio_channels = 0; // 0: no audio
+    uint32_t audio_sample_rate = 0;
+    uint32_t audio_bits = 0;
+    uint64_t audio_samples = 0;
+    std::string camera; // camera metadata as a JSON object, "{}" if none
+};
+
+// $XDG_CACHE_HOME (or ~/.cache)/proxy-generator/<bridge>-clips.cache;
+// empty if neither is set
+std::string clip_cache_default_path(const char* bridge);
+
+// The entry for `clip` if it matches `fingerprint`. A missing or unreadable
+// cache is a miss.
+bool clip_cache_lookup(const std::string& cache, const std::string& clip,
+                       const ClipFingerprint& fingerprint, ClipInfo& info);
+
+// Records `info` for `clip` as it was at `fingerprint` (taken before the
+// clip was opened, so a file changed meanwhile is probed again). Creates
+// the cache and its directory as needed. On failure returns false and sets
+// `error`.
+bool clip_cache_store(const std::string& cache, const std::string& clip,
+                      const ClipFingerprint& fingerprint, const ClipInfo& info,
+                      std::string& error);
+
+// ,"audio":{...},"camera":{...} for a probe's metadata line, plus
+// ,"cached":true when `info` came from the cache
+std::string clip_info_json_fields(const ClipInfo& info, bool cached);
+
+// bridge-common-tests: stores, supersedes, compacts and looks up entries
+// in a scratch cache, from several threads at once and past a torn record.
+// Prints one {"type":"self_check","check":"clip_cache"} line; returns false
+// on mismatch.
+bool clip_cache_self_check(FILE* report);
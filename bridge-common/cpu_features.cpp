@@ -0,0 +1,50 @@
+#include "cpu_features.h"
+
+#include <cstring>
+
+SimdLevel detect_simd_level()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const SimdLevel level = []
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("ssse3"))
+            return SimdLevel::SSSE3;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::SSSE3:  return "ssse3";
+        case SimdLevel::AVX2:   return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+        default:                return "scalar";
+    }
+}
+
+bool parse_simd_level(const char* name, SimdLevel& level)
+{
+    static const SimdLevel all[] = {
+        SimdLevel::Scalar, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512,
+    };
+    for (SimdLevel l : all)
+    {
+        if (strcmp(name, simd_level_name(l)) == 0)
+        {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,22 @@
+// cpu_features: runtime CPU feature detection for the SIMD kernels.
+
+#pragma once
+
+#include <cstdint>
+
+enum class SimdLevel
+{
+    Scalar = 0,
+    SSSE3,
+    AVX2,
+    AVX512,
+};
+
+// Highest SIMD level supported by both the CPU and this build.
+SimdLevel detect_simd_level();
+
+// Short name for NDJSON reports ("scalar", "ssse3", "avx2", "avx512").
+const char* simd_level_name(SimdLevel level);
+
+// Parses a name as produced by simd_level_name(). Returns false if unknown.
+bool parse_simd_level(const char* name, SimdLevel& level);
@@ -0,0 +1,134 @@
+#include "frame_pool.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr size_t kHugePageBytes = 2u << 20;
+
+static size_t round_up(size_t n, size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+bool parse_huge_page_mode(const char* name, HugePageMode& mode)
+{
+    if (strcmp(name, "off") == 0)     { mode = HugePageMode::Off;      return true; }
+    if (strcmp(name, "thp") == 0)     { mode = HugePageMode::Advise;   return true; }
+    if (strcmp(name, "hugetlb") == 0) { mode = HugePageMode::Explicit; return true; }
+    return false;
+}
+
+FramePool::~FramePool()
+{
+    if (m_base && m_mapped_bytes)
+        munmap(m_base, m_mapped_bytes);
+}
+
+bool FramePool::init(const FramePoolConfig& config, std::string& error)
+{
+    if (config.buffer_bytes == 0 || config.count == 0)
+    {
+        error = "frame pool: empty configuration";
+        return false;
+    }
+    if (config.alignment == 0 || (config.alignment & (config.alignment - 1)) != 0
+        || config.alignment > 4096)
+    {
+        error = "frame pool: alignment must be a power of two <= 4096";
+        return false;
+    }
+
+    m_config = config;
+
+    // mmap is page aligned, so rounding every stride up to the alignment keeps
+    // each buffer aligned too.
+    size_t stride = round_up(config.buffer_bytes, config.alignment);
+    size_t total = stride * config.count;
+
+    if (config.external)
+    {
+        carve(config.external, stride);
+        return true;
+    }
+
+    void* base = MAP_FAILED;
+    if (config.huge_pages == HugePageMode::Explicit)
+    {
+#ifdef MAP_HUGETLB
+        size_t huge_total = round_up(total, kHugePageBytes);
+        base = mmap(nullptr, huge_total, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB
+                        | (config.prefault ? MAP_POPULATE : 0),
+                    -1, 0);
+        if (base != MAP_FAILED)
+        {
+            total = huge_total;
+            m_huge_tlb = true;
+        }
+#endif
+    }
+
+    if (base == MAP_FAILED)
+    {
+        if (config.huge_pages != HugePageMode::Off)
+            total = round_up(total, kHugePageBytes);
+        base = mmap(nullptr, total, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            error = std::string("frame pool: mmap failed: ") + strerror(errno);
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        // Best effort: THP may be disabled system-wide
+        if (config.huge_pages != HugePageMode::Off)
+            madvise(base, total, MADV_HUGEPAGE);
+#endif
+        if (config.prefault)
+        {
+            // One write per page faults everything in now instead of inside
+            // the first frames of the decode loop.
+            long page = sysconf(_SC_PAGESIZE);
+            if (page <= 0) page = 4096;
+            volatile uint8_t* p = (volatile uint8_t*)base;
+            for (size_t off = 0; off < total; off += (size_t)page)
+                p[off] = 0;
+        }
+    }
+
+    m_mapped_bytes = total;
+    carve((uint8_t*)base, stride);
+    return true;
+}
+
+// Fills the free list with `count` buffers, `stride` apart from `base`
+void FramePool::carve(uint8_t* base, size_t stride)
+{
+    m_base = base;
+    m_free.reserve(m_config.count);
+    for (uint32_t i = m_config.count; i > 0; i--)
+        m_free.push_back(m_base + (size_t)(i - 1) * stride);
+}
+
+uint8_t* FramePool::checkout()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]{ return !m_free.empty(); });
+    uint8_t* buffer = m_free.back();
+    m_free.pop_back();
+    return buffer;
+}
+
+void FramePool::give_back(uint8_t* buffer)
+{
+    if (!buffer)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(buffer);
+    }
+    m_cv.notify_one();
+}
@@ -0,0 +1,73 @@
+// frame_pool: fixed set of equally sized frame buffers carved out of one
+// mapping, allocated once per clip. Buffers are checked out by the stage that
+// fills them and given back once the frame has been written, so peak memory
+// is count * buffer size no matter how long the clip is.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class HugePageMode
+{
+    Off,      // plain 4 KiB pages
+    Advise,   // madvise(MADV_HUGEPAGE), transparent huge pages if enabled
+    Explicit, // MAP_HUGETLB from the reserved pool, falls back to Advise
+};
+
+// Parses "off", "thp" or "hugetlb". Returns false if unknown.
+bool parse_huge_page_mode(const char* name, HugePageMode& mode);
+
+struct FramePoolConfig
+{
+    size_t buffer_bytes = 0;
+    uint32_t count = 0;
+    size_t alignment = 64;  // power of two, at most 4096
+    HugePageMode huge_pages = HugePageMode::Advise;
+    bool prefault = true;   // touch every page up front
+    // Carve the buffers out of caller-owned memory (a shared ring) instead
+    // of mapping them; it must be page aligned and hold count buffers at
+    // the aligned stride. huge_pages and prefault do not apply.
+    uint8_t* external = nullptr;
+};
+
+class FramePool
+{
+public:
+    FramePool() = default;
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Maps and (optionally) pre-faults the buffers. On failure returns false
+    // and sets `error`.
+    bool init(const FramePoolConfig& config, std::string& error);
+
+    // Blocks until a buffer is free.
+    uint8_t* checkout();
+
+    // Returns a buffer obtained from checkout().
+    void give_back(uint8_t* buffer);
+
+    size_t buffer_bytes() const { return m_config.buffer_bytes; }
+    uint32_t count() const { return m_config.count; }
+    size_t mapped_bytes() const { return m_mapped_bytes; }
+    bool huge_tlb() const { return m_huge_tlb; }
+
+private:
+    void carve(uint8_t* base, size_t stride);
+
+    FramePoolConfig m_config;
+    uint8_t* m_base = nullptr;
+    size_t m_mapped_bytes = 0; // 0 for external memory
+    bool m_huge_tlb = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<uint8_t*> m_free;
+};
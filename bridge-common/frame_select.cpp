@@ -0,0 +1,179 @@
+#include "frame_select.h"
+
+#include <cerrno>
+#include <cstdlib>
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static bool parse_u32(const char* text, const char** end, uint32_t& value)
+{
+    char* stop = nullptr;
+    errno = 0;
+    unsigned long long n = strtoull(text, &stop, 10);
+    if (stop == text || errno != 0 || n == 0 || n > UINT32_MAX || *text == '-')
+        return false;
+    value = (uint32_t)n;
+    *end = stop;
+    return true;
+}
+
+bool parse_fps(const char* text, uint32_t& num, uint32_t& den)
+{
+    const char* end = nullptr;
+    if (!parse_u32(text, &end, num))
+        return false;
+    den = 1;
+    if (*end == '/' && !parse_u32(end + 1, &end, den))
+        return false;
+    return *end == '\0';
+}
+
+bool frame_select_init(FrameSelect& select, uint32_t fps_num, uint32_t fps_den, uint32_t step,
+                       uint32_t conform_num, uint32_t conform_den, std::string& error)
+{
+    select = FrameSelect();
+    select.fps_num = fps_num;
+    select.fps_den = fps_den;
+    if (step <= 1 && conform_num == 0)
+        return true;
+    if (fps_num == 0 || fps_den == 0)
+    {
+        error = "The clip has no frame rate to drop frames from";
+        return false;
+    }
+
+    uint64_t out_num, out_den;
+    if (conform_num)
+    {
+        // Clip frames per output frame: (fps_num / fps_den) / (conform_num / conform_den)
+        select.step_num = (uint64_t)fps_num * conform_den;
+        select.step_den = (uint64_t)fps_den * conform_num;
+        if (select.step_num < select.step_den)
+        {
+            error = "--conform-fps " + std::to_string(conform_num) + "/" + std::to_string(conform_den)
+                  + " is above the clip's " + std::to_string(fps_num) + "/" + std::to_string(fps_den)
+                  + " fps; only dropping frames is supported";
+            return false;
+        }
+        out_num = conform_num;
+        out_den = conform_den;
+    }
+    else
+    {
+        select.step_num = step;
+        out_num = fps_num;
+        out_den = (uint64_t)fps_den * step;
+    }
+
+    uint64_t g = gcd(select.step_num, select.step_den);
+    select.step_num /= g;
+    select.step_den /= g;
+    g = gcd(out_num, out_den);
+    select.fps_num = (uint32_t)(out_num / g);
+    select.fps_den = (uint32_t)(out_den / g);
+    return true;
+}
+
+std::string select_timecode(const std::string& timecode, uint32_t fps_num, uint32_t fps_den,
+                            const FrameSelect& select)
+{
+    unsigned hh, mm, ss, ff;
+    char sep;
+    if (!select.sparse() || fps_den == 0 || select.fps_den == 0
+        || sscanf(timecode.c_str(), "%2u:%2u:%2u%c%u", &hh, &mm, &ss, &sep, &ff) != 5
+        || (sep != ':' && sep != ';'))
+        return timecode;
+
+    uint64_t clip_rate = ((uint64_t)fps_num + fps_den / 2) / fps_den;
+    uint64_t out_rate = ((uint64_t)select.fps_num + select.fps_den / 2) / select.fps_den;
+    if (clip_rate == 0 || out_rate == 0)
+        return timecode;
+    ff = (unsigned)(ff * out_rate / clip_rate);
+    // Drop-frame counting exists at 30 and 60 only
+    if (out_rate != 30 && out_rate != 60)
+        sep = ':';
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%02u:%02u:%02u%c%02u", hh, mm, ss, sep, ff);
+    return buf;
+}
+
+std::string select_json_fields(uint32_t fps_num, uint32_t fps_den, uint64_t frame_count)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), ",\"source_fps_num\":%u,\"source_fps_den\":%u,\"source_frame_count\":%llu",
+             fps_num, fps_den, (unsigned long long)frame_count);
+    return buf;
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+bool frame_select_self_check(FILE* report)
+{
+    bool ok = true;
+    std::string error;
+    FrameSelect select;
+
+    uint32_t num = 0, den = 0;
+    ok = ok && parse_fps("24000/1001", num, den) && num == 24000 && den == 1001;
+    ok = ok && parse_fps("25", num, den) && num == 25 && den == 1;
+    ok = ok && !parse_fps("", num, den) && !parse_fps("0", num, den) && !parse_fps("24/0", num, den)
+         && !parse_fps("24/", num, den) && !parse_fps("23.976", num, den)
+         && !parse_fps("-24", num, den);
+
+    // Nothing dropped
+    ok = ok && frame_select_init(select, 24000, 1001, 1, 0, 0, error) && !select.sparse()
+         && select.clip_frame(7) == 7 && select.output_frame(100) == 100
+         && select.fps_num == 24000 && select.fps_den == 1001;
+
+    // 119.88 fps, every 5th frame and conformed to 23.976: the same frames
+    for (int conform = 0; conform < 2; conform++)
+    {
+        ok = ok && frame_select_init(select, 120000, 1001, conform ? 1 : 5,
+                                     conform ? 24000 : 0, conform ? 1001 : 0, error)
+             && select.sparse() && select.fps_num == 24000 && select.fps_den == 1001
+             && select.clip_frame(3) == 15 && select.output_frame(1000) == 200
+             && select.output_frame(7) == 2 && select.output_frame(10) == 2;
+    }
+
+    // 120 to 23.976: 5.005 clip frames per output frame
+    ok = ok && frame_select_init(select, 120, 1, 1, 24000, 1001, error)
+         && select.step_num == 1001 && select.step_den == 200
+         && select.clip_frame(1) == 5 && select.clip_frame(200) == 1001
+         && select.output_frame(1001) == 200 && select.output_frame(1002) == 201;
+
+    // 25 to 24: one frame a second dropped. The output frames of ranges
+    // [0, 500) and [500, 1000) join up to those of [0, 1000).
+    ok = ok && frame_select_init(select, 25, 1, 1, 24, 1, error)
+         && select.clip_frame(23) == 23 && select.clip_frame(24) == 25
+         && select.output_frame(500) == 480 && select.clip_frame(479) < 500
+         && select.clip_frame(480) >= 500 && select.output_frame(1000) == 960;
+
+    // Repeating frames is not supported
+    ok = ok && !frame_select_init(select, 24, 1, 1, 25, 1, error)
+         && !frame_select_init(select, 0, 1, 2, 0, 0, error);
+
+    // Timecodes restated at the output rate
+    ok = ok && frame_select_init(select, 120, 1, 5, 0, 0, error)
+         && select_timecode("01:00:10:115", 120, 1, select) == "01:00:10:23"
+         && select_timecode("garbage", 120, 1, select) == "garbage";
+    ok = ok && frame_select_init(select, 60000, 1001, 2, 0, 0, error)
+         && select_timecode("01:00:00;58", 60000, 1001, select) == "01:00:00;29";
+    ok = ok && frame_select_init(select, 60000, 1001, 1, 24000, 1001, error)
+         && select_timecode("01:00:00;58", 60000, 1001, select) == "01:00:00:23";
+
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"frame_select\",\"ok\":%s}\n",
+            ok ? "true" : "false");
+    return ok;
+}
@@ -0,0 +1,66 @@
+// frame_select: sparse decode, only the frames a lower-rate proxy keeps.
+//
+// --frame-step N keeps every Nth frame of the clip (the output runs at
+// 1/N of the clip's rate); --conform-fps num/den keeps, for each frame of
+// a num/den output, the clip frame showing at its start. Output frame k is
+// clip frame floor(k * step), step = clip rate / output rate, so frame 0
+// is always kept and a --start-frame/--frame-count range keeps exactly the
+// output frames whose clip frame lies in it: the ranges of a clip's
+// segments concatenate to the whole sparse proxy.
+//
+// Everything downstream of the submit (reorder slots, progress, audio,
+// timecode, encoder and NUT rate) counts output frames at the output rate,
+// so the audio of output frames [a, b) is that of the time they cover.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+struct FrameSelect
+{
+    // Output rate; clip frames per output frame is step_num / step_den
+    uint32_t fps_num = 0;
+    uint32_t fps_den = 1;
+    uint64_t step_num = 1;
+    uint64_t step_den = 1;
+
+    // Whether frames are dropped at all
+    bool sparse() const { return step_num != step_den; }
+
+    // Clip frame shown by output frame `k`
+    uint64_t clip_frame(uint64_t k) const { return k * step_num / step_den; }
+
+    // First output frame whose clip frame is `frame` or later; the clip's
+    // frame count gives the output's
+    uint64_t output_frame(uint64_t frame) const
+    {
+        return (frame * step_den + step_num - 1) / step_num;
+    }
+};
+
+// Parses a --conform-fps value, "num/den" or "num"; false if malformed
+bool parse_fps(const char* text, uint32_t& num, uint32_t& den);
+
+// Sets `select` up for a clip at fps_num/fps_den: --frame-step `step`
+// (1 = every frame) or, with conform_num != 0, --conform-fps. A target
+// above the clip's rate (which would repeat frames) returns false and sets
+// `error`.
+bool frame_select_init(FrameSelect& select, uint32_t fps_num, uint32_t fps_den, uint32_t step,
+                       uint32_t conform_num, uint32_t conform_den, std::string& error);
+
+// A clip timecode "HH:MM:SS:FF" restated at the output rate: the frames
+// field scaled from the clip's nominal rate to the output's (the seconds
+// stay). Unchanged when nothing is dropped or the timecode is malformed.
+std::string select_timecode(const std::string& timecode, uint32_t fps_num, uint32_t fps_den,
+                            const FrameSelect& select);
+
+// ,"source_fps_num":..,"source_fps_den":..,"source_frame_count":.. for the
+// metadata line of a sparse decode
+std::string select_json_fields(uint32_t fps_num, uint32_t fps_den, uint64_t frame_count);
+
+// bridge-common-tests: maps frames, ranges and timecodes for step and conform
+// cases. Prints one {"type":"self_check","check":"frame_select"} line;
+// returns false on mismatch.
+bool frame_select_self_check(FILE* report);
@@ -0,0 +1,747 @@
+#include "frame_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "report.h"
+#include "serve.h"
+
+static constexpr size_t kFrameAlignment = 512; // what the SDKs ask of output buffers
+static constexpr size_t kMaxLineBytes = 64 * 1024;
+
+// ---------------------------------------------------------------------------
+// FrameBuffer, FrameCache
+// ---------------------------------------------------------------------------
+
+FrameBuffer::FrameBuffer(size_t bytes)
+{
+    void* p = nullptr;
+    if (posix_memalign(&p, kFrameAlignment, std::max<size_t>(bytes, 1)) == 0)
+    {
+        m_data = (uint8_t*)p;
+        m_bytes = bytes;
+    }
+}
+
+FrameBuffer::~FrameBuffer()
+{
+    free(m_data);
+}
+
+std::shared_ptr<const FrameBuffer> FrameCache::find(uint64_t frame, uint32_t scale)
+{
+    auto it = m_index.find(key(frame, scale));
+    if (it == m_index.end())
+        return nullptr;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->buffer;
+}
+
+bool FrameCache::contains(uint64_t frame, uint32_t scale) const
+{
+    return m_index.count(key(frame, scale)) != 0;
+}
+
+void FrameCache::insert(uint64_t frame, uint32_t scale, std::shared_ptr<const FrameBuffer> buffer)
+{
+    uint64_t k = key(frame, scale);
+    auto it = m_index.find(k);
+    if (it != m_index.end())
+    {
+        m_bytes -= it->second->buffer->bytes();
+        m_lru.erase(it->second);
+        m_index.erase(it);
+    }
+    if (!buffer || buffer->bytes() > m_max_bytes)
+        return;
+
+    m_bytes += buffer->bytes();
+    m_lru.push_front(Entry{k, std::move(buffer)});
+    m_index[k] = m_lru.begin();
+    while (m_bytes > m_max_bytes)
+    {
+        const Entry& last = m_lru.back();
+        m_bytes -= last.buffer->bytes();
+        m_index.erase(last.key);
+        m_lru.pop_back();
+        m_evictions++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Session
+// ---------------------------------------------------------------------------
+//
+// Three kinds of thread share the state under m_mutex: the reader turns
+// request lines into the current request and the decode queue, the workers
+// decode what is queued into the cache, and the session thread (the
+// request's own) writes every report line and every frame.
+
+namespace {
+
+struct Decode
+{
+    uint64_t frame;
+    uint32_t scale;
+    bool prefetch;
+};
+
+class Session
+{
+public:
+    Session(ScrubSource& source, const FrameServerConfig& config)
+        : m_source(source)
+        , m_config(config)
+        , m_cache(config.cache_bytes)
+    {}
+
+    int run(int conn, const std::string& pending, int frame_fd);
+
+private:
+    void read_requests(int conn, std::string buffered);
+    void handle_line(const std::string& line);
+    void start_request(uint64_t frame, uint32_t scale, size_t frame_bytes);
+    void decode_loop();
+
+    bool running(uint64_t frame, uint32_t scale) const
+    {
+        for (const Decode& d : m_running)
+            if (d.frame == frame && d.scale == scale)
+                return true;
+        return false;
+    }
+
+    bool wanted(uint64_t frame, uint32_t scale) const
+    {
+        return !m_cache.contains(frame, scale) && !running(frame, scale);
+    }
+
+    ScrubSource& m_source;
+    FrameServerConfig m_config;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed; // for the session thread
+    std::condition_variable m_work;    // for the workers
+    FrameCache m_cache;
+    std::deque<Decode> m_queue;
+    std::vector<Decode> m_running;
+    bool m_closed = false; // no more requests
+    bool m_stop = false;   // workers exit
+
+    // The request being answered
+    bool m_have_request = false;
+    uint64_t m_frame = 0;
+    uint32_t m_scale = 0;
+    bool m_cached = false;
+    std::chrono::steady_clock::time_point m_since;
+    std::shared_ptr<const FrameBuffer> m_buffer;
+    std::string m_decode_error;
+
+    // Lines for the session thread to write
+    std::vector<uint64_t> m_cancelled;
+    std::vector<std::string> m_errors;
+
+    // Sequential access: the previous request and its step
+    bool m_have_last = false;
+    uint64_t m_last_frame = 0;
+    uint32_t m_last_scale = 0;
+
+    uint64_t m_requests = 0;
+    uint64_t m_served = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_cancels = 0;
+    uint64_t m_decoded = 0;
+    uint64_t m_prefetched = 0;
+};
+
+void Session::start_request(uint64_t frame, uint32_t scale, size_t frame_bytes)
+{
+    m_requests++;
+    if (m_have_request)
+    {
+        m_cancelled.push_back(m_frame);
+        m_cancels++;
+    }
+    m_have_request = true;
+    m_frame = frame;
+    m_scale = scale;
+    m_since = std::chrono::steady_clock::now();
+    m_decode_error.clear();
+    m_buffer = m_cache.find(frame, scale);
+    m_cached = m_buffer != nullptr;
+
+    // A step of one or two frames from the last request, at its scale,
+    // reads as playback or jogging in that direction
+    int direction = 0;
+    if (m_have_last && scale == m_last_scale && frame != m_last_frame)
+    {
+        uint64_t step = frame > m_last_frame ? frame - m_last_frame : m_last_frame - frame;
+        if (step <= 2)
+            direction = frame > m_last_frame ? 1 : -1;
+    }
+    m_have_last = true;
+    m_last_frame = frame;
+    m_last_scale = scale;
+
+    // Whatever was queued was for earlier requests
+    m_queue.clear();
+    if (!m_cached && !running(frame, scale))
+        m_queue.push_back(Decode{frame, scale, false});
+
+    // Prefetch no more than half the cache holds, so the frames ahead do
+    // not push out the ones just shown
+    uint64_t ahead = m_config.prefetch;
+    if (frame_bytes)
+        ahead = std::min<uint64_t>(ahead, m_config.cache_bytes / 2 / frame_bytes);
+    for (uint64_t i = 1; direction && i <= ahead; i++)
+    {
+        if (direction < 0 ? i > frame : frame + i >= m_config.frame_count)
+            break;
+        uint64_t next = direction < 0 ? frame - i : frame + i;
+        if (wanted(next, scale))
+            m_queue.push_back(Decode{next, scale, true});
+    }
+
+    m_work.notify_all();
+    m_changed.notify_all();
+}
+
+void Session::handle_line(const std::string& line)
+{
+    ServeRequest request;
+    std::string error;
+    uint32_t width = 0, height = 0;
+    size_t bytes = 0;
+    uint32_t scale = 0;
+    if (parse_serve_request(line, request, error))
+    {
+        scale = request.scale ? request.scale : m_config.scale;
+        if (request.op == "close")
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            m_changed.notify_all();
+            return;
+        }
+        if (request.op != "frame")
+            error = "Unknown scrub op \"" + request.op + "\"; use frame or close";
+        else if (request.frame >= m_config.frame_count)
+            error = "Frame " + std::to_string(request.frame) + " is past the end of the clip ("
+                  + std::to_string(m_config.frame_count) + " frames)";
+        else if (!m_source.frame_size(scale, width, height, bytes))
+            error = "No decode scale 1/" + std::to_string(scale) + " for this clip";
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!error.empty())
+    {
+        m_errors.push_back(error);
+        m_changed.notify_all();
+        return;
+    }
+    start_request(request.frame, scale, bytes);
+}
+
+void Session::read_requests(int conn, std::string buffered)
+{
+    char buf[4096];
+    for (;;)
+    {
+        size_t newline;
+        while ((newline = buffered.find('\n')) != std::string::npos)
+        {
+            std::string line = buffered.substr(0, newline);
+            buffered.erase(0, newline + 1);
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                handle_line(line);
+        }
+
+        bool closed;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            closed = m_closed;
+        }
+        if (closed)
+            return;
+        if (buffered.size() > kMaxLineBytes)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_errors.push_back("Request line too long");
+            break;
+        }
+
+        ssize_t n;
+        do
+            n = recv(conn, buf, sizeof(buf), 0);
+        while (n < 0 && errno == EINTR);
+        if (n <= 0)
+            break;
+        buffered.append(buf, (size_t)n);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_changed.notify_all();
+}
+
+void Session::decode_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        m_work.wait(lock, [this]{ return m_stop || !m_queue.empty(); });
+        if (m_stop)
+            return;
+        Decode d = m_queue.front();
+        m_queue.pop_front();
+        if (!wanted(d.frame, d.scale))
+            continue;
+        m_running.push_back(d);
+        lock.unlock();
+
+        uint32_t width = 0, height = 0;
+        size_t bytes = 0;
+        std::string error;
+        std::shared_ptr<FrameBuffer> buffer;
+        if (!m_source.frame_size(d.scale, width, height, bytes))
+            error = "No decode scale 1/" + std::to_string(d.scale) + " for this clip";
+        else
+        {
+            buffer = std::make_shared<FrameBuffer>(bytes);
+            if (!buffer->data())
+                error = "Out of memory for a " + std::to_string(bytes) + "-byte frame";
+            else if (!m_source.decode(d.frame, d.scale, buffer->data(), error) && error.empty())
+                error = "Decoding frame " + std::to_string(d.frame) + " failed";
+        }
+        if (!error.empty())
+            buffer.reset();
+
+        lock.lock();
+        m_running.erase(std::find_if(m_running.begin(), m_running.end(), [&](const Decode& r)
+        {
+            return r.frame == d.frame && r.scale == d.scale;
+        }));
+        if (buffer)
+        {
+            m_cache.insert(d.frame, d.scale, buffer);
+            m_decoded++;
+            if (d.prefetch)
+                m_prefetched++;
+        }
+        if (m_have_request && m_frame == d.frame && m_scale == d.scale && !m_buffer)
+        {
+            m_buffer = buffer;
+            m_decode_error = buffer ? std::string() : error;
+        }
+        m_changed.notify_all();
+    }
+}
+
+static bool write_all(int fd, const uint8_t* data, size_t bytes)
+{
+    while (bytes)
+    {
+        ssize_t n = write(fd, data, bytes);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        bytes -= (size_t)n;
+    }
+    return true;
+}
+
+static std::string escape(const std::string& s)
+{
+    std::string out;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += (c == '\n' || c == '\r') ? ' ' : c;
+    }
+    return out;
+}
+
+int Session::run(int conn, const std::string& pending, int frame_fd)
+{
+    FILE* report = report_stream();
+    unsigned decodes = std::max(1u, m_config.decodes);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < decodes; i++)
+        workers.emplace_back([this]{ decode_loop(); });
+    std::thread reader([this, conn, pending]{ read_requests(conn, pending); });
+
+    int code = 0;
+    for (;;)
+    {
+        std::vector<uint64_t> cancelled;
+        std::vector<std::string> errors;
+        std::shared_ptr<const FrameBuffer> buffer;
+        std::string decode_error;
+        bool answer = false, cached = false, closed = false;
+        uint64_t frame = 0;
+        uint32_t scale = 0;
+        double ms = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this]
+            {
+                return m_closed || !m_cancelled.empty() || !m_errors.empty()
+                    || (m_have_request && (m_buffer || !m_decode_error.empty()));
+            });
+            cancelled.swap(m_cancelled);
+            errors.swap(m_errors);
+            if (m_have_request && (m_buffer || !m_decode_error.empty()))
+            {
+                answer = true;
+                m_have_request = false;
+                buffer = std::move(m_buffer);
+                decode_error.swap(m_decode_error);
+                frame = m_frame;
+                scale = m_scale;
+                cached = m_cached;
+                ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - m_since).count();
+                if (buffer)
+                {
+                    m_served++;
+                    if (cached)
+                        m_hits++;
+                }
+            }
+            closed = m_closed && !answer && cancelled.empty() && errors.empty();
+        }
+
+        for (uint64_t f : cancelled)
+            fprintf(report, "{\"type\":\"cancelled\",\"frame\":%llu}\n", (unsigned long long)f);
+        for (const std::string& e : errors)
+            fprintf(report, "{\"type\":\"error\",\"message\":\"%s\"}\n", escape(e).c_str());
+        if (answer && !buffer)
+        {
+            fprintf(report, "{\"type\":\"error\",\"frame\":%llu,\"message\":\"%s\"}\n",
+                    (unsigned long long)frame, escape(decode_error).c_str());
+        }
+        else if (answer)
+        {
+            uint32_t width = 0, height = 0;
+            size_t bytes = 0;
+            m_source.frame_size(scale, width, height, bytes);
+            fprintf(report,
+                    "{\"type\":\"frame\",\"frame\":%llu,\"scale\":%u,\"width\":%u,\"height\":%u,"
+                    "\"bytes\":%zu,\"cached\":%s,\"ms\":%.1f}\n",
+                    (unsigned long long)frame, scale, width, height, buffer->bytes(),
+                    cached ? "true" : "false", ms);
+            fflush(report);
+            if (!write_all(frame_fd, buffer->data(), buffer->bytes()))
+            {
+                fprintf(report, "{\"type\":\"error\",\"message\":\"Writing the frame failed: %s\"}\n",
+                        strerror(errno));
+                code = 1;
+                break;
+            }
+        }
+        // A client that went away ends the session
+        if (closed || ferror(report))
+            break;
+    }
+
+    // The reader may still be waiting for a line; the connection stays
+    // open for writing
+    shutdown(conn, SHUT_RD);
+    reader.join();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_work.notify_all();
+    for (auto& t : workers)
+        t.join();
+
+    fprintf(report,
+            "{\"type\":\"scrub\",\"requests\":%llu,\"served\":%llu,\"cache_hits\":%llu,"
+            "\"cancelled\":%llu,\"decoded\":%llu,\"prefetched\":%llu,\"cached_frames\":%zu,"
+            "\"cache_bytes\":%zu,\"evictions\":%llu}\n",
+            (unsigned long long)m_requests, (unsigned long long)m_served,
+            (unsigned long long)m_hits, (unsigned long long)m_cancels,
+            (unsigned long long)m_decoded, (unsigned long long)m_prefetched, m_cache.size(),
+            m_cache.bytes(), (unsigned long long)m_cache.evictions());
+    return code;
+}
+
+} // namespace
+
+int run_frame_server(int conn, const std::string& pending, int frame_fd, ScrubSource& source,
+                     const FrameServerConfig& config)
+{
+    Session session(source, config);
+    return session.run(conn, pending, frame_fd);
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// 64x36 rgb24 at full scale, halves and quarters, every byte a function of
+// frame, scale and offset. Decodes wait until the gate opens; frame 66
+// fails.
+class TestSource : public ScrubSource
+{
+public:
+    bool frame_size(uint32_t scale, uint32_t& width, uint32_t& height, size_t& bytes) override
+    {
+        if (scale != 1 && scale != 2 && scale != 4)
+            return false;
+        width = 64 / scale;
+        height = 36 / scale;
+        bytes = (size_t)width * height * 3;
+        return true;
+    }
+
+    bool decode(uint64_t frame, uint32_t scale, uint8_t* out, std::string& error) override
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_started++;
+            m_decodes[frame]++;
+            m_changed.notify_all();
+            m_changed.wait(lock, [this]{ return m_open; });
+        }
+        if (frame == 66)
+        {
+            error = "test failure";
+            return false;
+        }
+        uint32_t width = 0, height = 0;
+        size_t bytes = 0;
+        frame_size(scale, width, height, bytes);
+        for (size_t i = 0; i < bytes; i++)
+            out[i] = pattern(frame, scale, i);
+        return true;
+    }
+
+    static uint8_t pattern(uint64_t frame, uint32_t scale, size_t i)
+    {
+        return (uint8_t)(frame * 31 + scale * 7 + i);
+    }
+
+    bool wait_started(unsigned count)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_changed.wait_for(lock, std::chrono::seconds(5),
+                                  [&]{ return m_started >= count; });
+    }
+
+    void open()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_open = true;
+        m_changed.notify_all();
+    }
+
+    unsigned decodes(uint64_t frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_decodes[frame];
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    bool m_open = false;
+    unsigned m_started = 0;
+    std::unordered_map<uint64_t, unsigned> m_decodes;
+};
+
+// The client's end: report lines from the connection, frames from the pipe
+struct TestClient
+{
+    int conn;
+    int frames;
+    std::string buffered;
+
+    bool send(const char* lines)
+    {
+        size_t n = strlen(lines);
+        return write(conn, lines, n) == (ssize_t)n;
+    }
+
+    bool line(std::string& out)
+    {
+        for (;;)
+        {
+            size_t newline = buffered.find('\n');
+            if (newline != std::string::npos)
+            {
+                out = buffered.substr(0, newline);
+                buffered.erase(0, newline + 1);
+                return true;
+            }
+            struct pollfd pfd = { conn, POLLIN, 0 };
+            char buf[1024];
+            if (poll(&pfd, 1, 5000) <= 0)
+                return false;
+            ssize_t n = read(conn, buf, sizeof(buf));
+            if (n <= 0)
+                return false;
+            buffered.append(buf, (size_t)n);
+        }
+    }
+
+    // The next line of `type`, the cancelled frames before it collected
+    bool expect(const char* type, std::string& out, std::vector<uint64_t>* cancelled = nullptr)
+    {
+        std::string tag = std::string("{\"type\":\"") + type + "\"";
+        while (line(out))
+        {
+            if (out.compare(0, tag.size(), tag) == 0)
+                return true;
+            unsigned long long frame;
+            if (cancelled && sscanf(out.c_str(), "{\"type\":\"cancelled\",\"frame\":%llu}", &frame) == 1)
+                cancelled->push_back(frame);
+        }
+        return false;
+    }
+
+    // A frame's bytes, checked against the test pattern
+    bool frame(uint64_t frame, uint32_t scale, size_t bytes)
+    {
+        std::vector<uint8_t> data(bytes);
+        size_t got = 0;
+        while (got < bytes)
+        {
+            struct pollfd pfd = { frames, POLLIN, 0 };
+            if (poll(&pfd, 1, 5000) <= 0)
+                return false;
+            ssize_t n = read(frames, data.data() + got, bytes - got);
+            if (n <= 0)
+                return false;
+            got += (size_t)n;
+        }
+        for (size_t i = 0; i < bytes; i++)
+            if (data[i] != TestSource::pattern(frame, scale, i))
+                return false;
+        return true;
+    }
+};
+
+static bool contains(const std::string& line, const char* text)
+{
+    return line.find(text) != std::string::npos;
+}
+
+} // namespace
+
+bool frame_server_self_check(FILE* report)
+{
+    bool ok = true;
+
+    // LRU order and the byte budget
+    {
+        FrameCache cache(300);
+        for (uint64_t f = 0; f < 3; f++)
+            cache.insert(f, 1, std::make_shared<FrameBuffer>(100));
+        ok = ok && cache.size() == 3 && cache.bytes() == 300 && cache.find(0, 1);
+        cache.insert(3, 1, std::make_shared<FrameBuffer>(100));
+        ok = ok && cache.contains(0, 1) && !cache.contains(1, 1) && cache.contains(3, 1)
+                && cache.evictions() == 1 && !cache.contains(3, 2);
+        cache.insert(4, 1, std::make_shared<FrameBuffer>(301));
+        ok = ok && !cache.contains(4, 1) && cache.bytes() == 300;
+        cache.insert(0, 1, std::make_shared<FrameBuffer>(250));
+        ok = ok && cache.contains(0, 1) && cache.size() == 1 && cache.bytes() == 250;
+    }
+
+    // A session: frames 10 and 20 are overtaken by 30 while their decodes
+    // are held (each has started, so none is dropped from the queue), then
+    // cached, sequential, failing and invalid requests
+    int sv[2] = { -1, -1 };
+    int pipe_fds[2] = { -1, -1 };
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0
+        || pipe2(pipe_fds, O_CLOEXEC) != 0)
+        ok = false;
+    FILE* server_report = ok ? fdopen(dup(sv[1]), "w") : nullptr;
+    if (ok && server_report)
+    {
+        setvbuf(server_report, nullptr, _IOLBF, 0);
+        TestSource source;
+        FrameServerConfig config;
+        config.frame_count = 100;
+        config.scale = 2;
+        config.prefetch = 3;
+        config.decodes = 4;
+        int server_code = -1;
+        std::thread server([&]
+        {
+            ReportScope scope(server_report);
+            server_code = run_frame_server(sv[1], "{\"op\":\"frame\",\"frame\":10}\n", pipe_fds[1],
+                                           source, config);
+        });
+
+        TestClient client{sv[0], pipe_fds[0], {}};
+        std::string line;
+        std::vector<uint64_t> cancelled;
+        ok = ok && source.wait_started(1) && client.send("{\"op\":\"frame\",\"frame\":20}\n")
+                && source.wait_started(2)
+                && client.send("{\"op\":\"frame\",\"frame\":30,\"scale\":2}\n")
+                && source.wait_started(3);
+        source.open();
+        ok = ok && client.expect("frame", line, &cancelled)
+                && contains(line, "\"frame\":30,\"scale\":2,\"width\":32,\"height\":18,\"bytes\":1728,\"cached\":false")
+                && cancelled == std::vector<uint64_t>({ 10, 20 }) && client.frame(30, 2, 1728);
+
+        ok = ok && client.send("{\"op\":\"frame\",\"frame\":30}\n") && client.expect("frame", line)
+                && contains(line, "\"frame\":30,") && contains(line, "\"cached\":true")
+                && client.frame(30, 2, 1728);
+
+        // Playback from 31 on: each frame is decoded once, prefetched or not
+        for (uint64_t f = 31; ok && f <= 34; f++)
+        {
+            char request[64];
+            snprintf(request, sizeof(request), "{\"op\":\"frame\",\"frame\":%llu,\"scale\":4}\n",
+                     (unsigned long long)f);
+            ok = client.send(request) && client.expect("frame", line) && client.frame(f, 4, 432);
+        }
+        ok = ok && source.decodes(32) == 1 && source.decodes(33) == 1 && source.decodes(34) == 1;
+
+        ok = ok && client.send("{\"op\":\"frame\",\"frame\":66}\n") && client.expect("error", line)
+                && contains(line, "\"frame\":66") && contains(line, "test failure");
+        ok = ok && client.send("{\"op\":\"frame\",\"frame\":100}\n") && client.expect("error", line)
+                && contains(line, "past the end");
+        ok = ok && client.send("{\"op\":\"frame\",\"frame\":1,\"scale\":8}\n") && client.expect("error", line)
+                && contains(line, "scale");
+
+        ok = ok && client.send("{\"op\":\"close\"}\n") && client.expect("scrub", line)
+                && contains(line, "\"requests\":9,\"served\":6,\"cache_hits\":")
+                && contains(line, "\"cancelled\":2,");
+        shutdown(sv[0], SHUT_WR);
+        server.join();
+        ok = ok && server_code == 0;
+        fclose(server_report);
+    }
+    for (int fd : { sv[0], sv[1], pipe_fds[0], pipe_fds[1] })
+        if (fd >= 0)
+            close(fd);
+
+    fprintf(report,
+        "{\"type\":\"self_check\",\"check\":\"frame_server\",\"ok\":%s}\n",
+        ok ? "true" : "false");
+    return ok;
+}
@@ -0,0 +1,129 @@
+// frame_server: the "scrub" op of --serve. A preview player gets any frame
+// of a clip at any decode scale while the user scrubs, without a proxy: the
+// clip stays open for the whole session and decoded frames are kept.
+//
+// After the request line the connection carries one line per frame wanted,
+//
+//   {"op":"frame","frame":1200,"scale":2}
+//
+// ("scale" is the decode divisor, 1 = full resolution; without it the
+// session's, from the request line, default 2). {"op":"close"} or closing
+// the connection ends the session. Every frame served gets
+//
+//   {"type":"frame","frame":1200,"scale":2,"width":..,"height":..,
+//    "bytes":..,"cached":false,"ms":31.2}
+//
+// on the connection ("ms": from the request to the first byte written) and
+// then its bytes, tightly packed in the session's --pix-fmt, on fds[0]. A
+// request still unanswered when the next one arrives is dropped with a
+// {"type":"cancelled","frame":N} line, so while the playhead is dragged
+// only its newest position is decoded, and queued decodes nobody waits for
+// any more are dropped before they start. Decodes already running finish
+// into the cache: the SDKs' CPU decoders cannot abandon a frame half way.
+//
+// Decoded frames go into an LRU cache of --frame-cache-mb. Requests that
+// step through the clip a frame or two at a time (playback, jog) make the
+// next --prefetch frames in that direction decode speculatively alongside,
+// on up to --inflight decodes at once.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// A decoded frame, aligned for the SDKs' output buffers
+class FrameBuffer
+{
+public:
+    // data() is null if the allocation failed
+    explicit FrameBuffer(size_t bytes);
+    ~FrameBuffer();
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+    uint8_t* data() const { return m_data; }
+    size_t bytes() const { return m_bytes; }
+
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_bytes = 0;
+};
+
+// Decoded frames by (frame, scale), least recently used dropped first once
+// they take more than max_bytes. Not thread safe. Frames handed out stay
+// valid after they are dropped.
+class FrameCache
+{
+public:
+    explicit FrameCache(size_t max_bytes) : m_max_bytes(max_bytes) {}
+
+    // The frame, marked as just used; null if not cached
+    std::shared_ptr<const FrameBuffer> find(uint64_t frame, uint32_t scale);
+    bool contains(uint64_t frame, uint32_t scale) const;
+
+    // Adds (or replaces) a frame and drops the least recently used ones
+    // beyond max_bytes. A frame larger than max_bytes is not kept.
+    void insert(uint64_t frame, uint32_t scale, std::shared_ptr<const FrameBuffer> buffer);
+
+    size_t size() const { return m_index.size(); }
+    size_t bytes() const { return m_bytes; }
+    uint64_t evictions() const { return m_evictions; }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        std::shared_ptr<const FrameBuffer> buffer;
+    };
+
+    static uint64_t key(uint64_t frame, uint32_t scale) { return frame << 8 | (scale & 0xFF); }
+
+    size_t m_max_bytes;
+    size_t m_bytes = 0;
+    uint64_t m_evictions = 0;
+    std::list<Entry> m_lru; // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_index;
+};
+
+// What a session decodes from: the bridge's open clip
+class ScrubSource
+{
+public:
+    virtual ~ScrubSource() {}
+
+    // Size of a frame decoded at `scale`; false if the SDK has no such scale
+    virtual bool frame_size(uint32_t scale, uint32_t& width, uint32_t& height, size_t& bytes) = 0;
+
+    // Decodes `frame` at `scale` into `out` (frame_size() bytes). Called
+    // from several threads at once. On failure returns false and sets `error`.
+    virtual bool decode(uint64_t frame, uint32_t scale, uint8_t* out, std::string& error) = 0;
+};
+
+struct FrameServerConfig
+{
+    uint64_t frame_count = 0;
+    uint32_t scale = 2;                   // for requests without one
+    size_t cache_bytes = 512ULL << 20;    // --frame-cache-mb
+    uint32_t prefetch = 8;                // --prefetch
+    uint32_t decodes = 4;                 // --inflight: decodes at once
+};
+
+// Serves frame requests from the connection `conn` (`pending`: what arrived
+// after the request line) until the client closes it, frames to `frame_fd`
+// and lines to report_stream(). Ends with a {"type":"scrub"} summary line;
+// returns the exit code.
+int run_frame_server(int conn, const std::string& pending, int frame_fd, ScrubSource& source,
+                     const FrameServerConfig& config);
+
+// bridge-common-tests: the cache's LRU order and byte budget, and a
+// session over a socketpair against a synthetic source (cancelled, cached
+// and prefetched frames). Prints one
+// {"type":"self_check","check":"frame_server"} line; returns false on
+// mismatch.
+bool frame_server_self_check(FILE* report);
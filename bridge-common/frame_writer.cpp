@@ -0,0 +1,433 @@
+#include "frame_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#endif
+
+#include "av_encoder.h"
+#include "frame_pool.h"
+#include "nut_muxer.h"
+#include "shm_ring.h"
+
+// How often the writer looks at the pipe while spliced frames wait to be read
+static constexpr std::chrono::milliseconds kDrainPoll(1);
+
+// ---------------------------------------------------------------------------
+// Pipe setup and transfer
+// ---------------------------------------------------------------------------
+
+// Grows a pipe toward one frame, capped at /proc/sys/fs/pipe-max-size; the
+// request is halved while the per-user pipe budget refuses it. Returns the
+// resulting capacity.
+static size_t enlarge_pipe(int fd, size_t frame_bytes)
+{
+#if defined(__linux__) && defined(F_SETPIPE_SZ)
+    long current = fcntl(fd, F_GETPIPE_SZ);
+    if (current < 0)
+        return 0;
+
+    size_t limit = 1 << 20; // kernel default when /proc is unavailable
+    if (FILE* f = fopen("/proc/sys/fs/pipe-max-size", "r"))
+    {
+        unsigned long value = 0;
+        if (fscanf(f, "%lu", &value) == 1 && value > 0)
+            limit = value;
+        fclose(f);
+    }
+
+    size_t want = std::min(limit, std::max(frame_bytes, (size_t)current));
+    while (want > (size_t)current && fcntl(fd, F_SETPIPE_SZ, (int)want) < 0)
+        want /= 2;
+
+    current = fcntl(fd, F_GETPIPE_SZ);
+    return current > 0 ? (size_t)current : 0;
+#else
+    (void)fd;
+    (void)frame_bytes;
+    return 0;
+#endif
+}
+
+// Sends iov[0..count) with vmsplice or writev, advancing `iov`/`count` past
+// what went out so a failed call can be resumed another way. Adds calls and
+// bytes sent; on error returns false with errno set.
+static bool send_all(int fd, struct iovec*& iov, int& count, bool splice,
+                     uint64_t& calls, uint64_t& sent)
+{
+    while (count > 0)
+    {
+#ifdef __linux__
+        ssize_t n = splice ? vmsplice(fd, iov, (unsigned long)count, SPLICE_F_GIFT)
+                           : writev(fd, iov, count);
+#else
+        (void)splice;
+        ssize_t n = writev(fd, iov, count);
+#endif
+        calls++;
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        sent += (uint64_t)n;
+
+        size_t left = (size_t)n;
+        while (count > 0 && left >= iov->iov_len)
+        {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// FrameWriter
+// ---------------------------------------------------------------------------
+
+FrameWriter::FrameWriter(int fd, PixFmt fmt, size_t width, size_t height, uint32_t depth,
+                         ShmRing* ring, AvEncoder* encoder, NutMuxer* nut, bool allow_splice)
+    : m_fd(fd)
+    , m_fmt(fmt)
+    , m_width(width)
+    , m_height(height)
+    , m_frame_bytes(pix_fmt_frame_bytes(fmt, width, height))
+    , m_shm(ring)
+    , m_encoder(encoder)
+    , m_nut(nut)
+    , m_ring(std::max(1u, depth))
+{
+#ifdef __linux__
+    struct stat st;
+    if (!ring && !encoder && fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode))
+    {
+        m_stats.pipe_bytes = enlarge_pipe(fd, m_frame_bytes);
+
+        // Held buffers are tracked through FIONREAD; without it nothing
+        // tells when the pipe lets go of their pages
+        int pending = 0;
+        m_splice = allow_splice && fmt != PixFmt::DPX10
+                   && ioctl(fd, FIONREAD, &pending) == 0;
+    }
+#else
+    (void)allow_splice;
+#endif
+
+    m_thread = std::thread([this]{ writer_loop(); });
+}
+
+FrameWriter::~FrameWriter()
+{
+    finish();
+}
+
+bool FrameWriter::push(uint8_t* data, FramePool* pool, std::vector<uint8_t> audio)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this]{ return m_count + m_held_count < m_ring.size() || m_failed; });
+        if (!m_failed)
+        {
+            Entry& slot = m_ring[(m_head + m_count) % m_ring.size()];
+            slot.data = data;
+            slot.pool = pool;
+            slot.audio = std::move(audio);
+            m_count++;
+            lock.unlock();
+            m_not_empty.notify_one();
+            return true;
+        }
+    }
+
+    if (pool)
+        pool->give_back(data);
+    return false;
+}
+
+bool FrameWriter::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_not_empty.notify_one();
+    if (m_thread.joinable())
+        m_thread.join();
+    return !m_failed;
+}
+
+// Puts the NUT header out ahead of the first frame
+bool FrameWriter::write_header()
+{
+    m_prefix.clear();
+    m_nut->write_header(m_prefix);
+
+    struct iovec iov = { m_prefix.data(), m_prefix.size() };
+    struct iovec* cur = &iov;
+    int count = 1;
+    uint64_t sent = 0;
+    bool ok = send_all(m_fd, cur, count, false, m_stats.write_calls, sent);
+    m_stream_bytes += sent;
+    return ok;
+}
+
+// Writes one frame; `spliced` tells whether the pipe now references its pages
+bool FrameWriter::write_entry(const Entry& entry, bool& spliced)
+{
+    spliced = false;
+    if (m_encoder)
+    {
+        // The encoder takes the buffer over, pooled ones without a copy
+        if (!m_encoder->encode(entry.data, entry.pool, entry.audio.data(), entry.audio.size()))
+            return false;
+        if (entry.pool)
+            m_stats.spliced_bytes += m_frame_bytes;
+        return true;
+    }
+
+    if (m_shm)
+    {
+        // The frame already is in shared memory; publishing is all it takes
+        if (!m_shm->publish(entry.data))
+            return false;
+        m_stats.spliced_bytes += m_frame_bytes;
+        m_stream_bytes++;
+        spliced = true;
+        return true;
+    }
+
+    if (m_nut)
+    {
+        m_prefix.clear();
+        m_suffix.clear();
+        m_nut->begin_video_frame(m_prefix);
+        m_nut->write_audio(entry.audio.data(), entry.audio.size(), m_suffix);
+    }
+
+    if ((!m_splice || !entry.pool) && m_nut)
+    {
+        // Framing, frame and audio in one writev
+        struct iovec iov[kMaxFrameIovecs + 2];
+        int count = 0;
+        iov[count++] = { m_prefix.data(), m_prefix.size() };
+        count += frame_iovecs(m_fmt, entry.data, m_width, m_height, iov + count);
+        if (!m_suffix.empty())
+            iov[count++] = { m_suffix.data(), m_suffix.size() };
+
+        struct iovec* cur = iov;
+        uint64_t sent = 0;
+        bool ok = send_all(m_fd, cur, count, false, m_stats.write_calls, sent);
+        m_stream_bytes += sent;
+        return ok;
+    }
+
+    if (!m_splice || !entry.pool)
+    {
+        uint64_t calls = 0;
+        bool ok = write_frame(m_fd, m_fmt, entry.data, m_width, m_height, &calls);
+        m_stats.write_calls += calls;
+        // DPX never splices, so its header need not be counted here
+        if (ok)
+            m_stream_bytes += m_frame_bytes;
+        return ok;
+    }
+
+    struct iovec iov[kMaxFrameIovecs];
+    struct iovec* cur = iov;
+    int count = frame_iovecs(m_fmt, entry.data, m_width, m_height, iov);
+
+    uint64_t spliced_bytes = 0;
+    uint64_t copied_bytes = 0;
+
+    // NUT framing is small and not pool memory: it is copied in around the
+    // spliced frame
+    auto write_framing = [&](std::vector<uint8_t>& bytes)
+    {
+        struct iovec piece = { bytes.data(), bytes.size() };
+        struct iovec* at = &piece;
+        int pieces = bytes.empty() ? 0 : 1;
+        return send_all(m_fd, at, pieces, false, m_stats.write_calls, copied_bytes);
+    };
+
+    bool ok = !m_nut || write_framing(m_prefix);
+    if (ok)
+    {
+        ok = send_all(m_fd, cur, count, true, m_stats.write_calls, spliced_bytes);
+        if (!ok && errno != EPIPE)
+        {
+            // vmsplice refused (seccomp filter, unusual kernel): copy the
+            // rest of this frame and every later one
+            m_splice = false;
+            ok = send_all(m_fd, cur, count, false, m_stats.write_calls, copied_bytes);
+        }
+    }
+    if (ok && m_nut)
+        ok = write_framing(m_suffix);
+
+    m_stats.spliced_bytes += spliced_bytes;
+    m_stream_bytes += spliced_bytes + copied_bytes;
+    spliced = spliced_bytes > 0;
+    return ok;
+}
+
+// Gives back held buffers whose bytes the reader has taken out of the pipe
+// (or whose frames the ring consumer is done with), or all of them once it
+// is gone
+void FrameWriter::retire_drained()
+{
+    if (m_held.empty())
+        return;
+
+    bool gone = true; // nothing tracks the pipe: let everything go
+    uint64_t consumed = 0;
+    if (m_shm)
+    {
+        gone = m_shm->peer_gone();
+        consumed = m_shm->consumed();
+    }
+#ifdef __linux__
+    else
+    {
+        struct pollfd pfd = { m_fd, 0, 0 };
+        int pending = 0;
+        gone = (poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLERR))
+               || ioctl(m_fd, FIONREAD, &pending) != 0;
+        consumed = m_stream_bytes > (uint64_t)pending ? m_stream_bytes - (uint64_t)pending : 0;
+    }
+#endif
+
+    size_t retired = 0;
+    while (!m_held.empty() && (gone || m_held.front().end <= consumed))
+    {
+        m_held.front().entry.pool->give_back(m_held.front().entry.data);
+        m_held.pop_front();
+        retired++;
+    }
+
+    if (retired == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_held_count -= retired;
+    }
+    m_not_full.notify_one();
+}
+
+void FrameWriter::writer_loop()
+{
+    using Clock = std::chrono::steady_clock;
+    bool first = true;
+
+    if (m_nut && !write_header())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_failed = true;
+        }
+        m_not_full.notify_one();
+    }
+
+    for (;;)
+    {
+        Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto wait_start = Clock::now();
+            // While spliced frames sit in the pipe, look now and then for
+            // buffers the reader has released
+            while (m_count == 0 && !m_stop)
+            {
+                if (m_held.empty())
+                {
+                    m_not_empty.wait(lock);
+                    continue;
+                }
+                m_not_empty.wait_for(lock, kDrainPoll);
+                lock.unlock();
+                retire_drained();
+                lock.lock();
+            }
+            if (m_count == 0)
+                break; // stopped and drained
+            if (!first)
+                m_stats.wait_seconds += std::chrono::duration<double>(Clock::now() - wait_start).count();
+            first = false;
+            entry = std::move(m_ring[m_head]);
+        }
+
+        // After a failed write the rest is only handed back
+        bool ok = false;
+        bool spliced = false;
+        bool handed_off = false; // the encoder gives the buffer back itself
+        if (!m_failed)
+        {
+            auto write_start = Clock::now();
+            ok = write_entry(entry, spliced);
+            handed_off = m_encoder != nullptr;
+            m_stats.write_seconds += std::chrono::duration<double>(Clock::now() - write_start).count();
+        }
+        if (ok)
+        {
+            m_stats.frames++;
+            m_stats.bytes += m_frame_bytes;
+        }
+        if (spliced)
+            m_held.push_back({ { entry.data, entry.pool, {} }, m_stream_bytes });
+        else if (entry.pool && !handed_off)
+            entry.pool->give_back(entry.data);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_failed = m_failed || !ok;
+            m_head = (m_head + 1) % m_ring.size();
+            m_count--;
+            m_held_count += spliced ? 1 : 0;
+        }
+        m_not_full.notify_one();
+        retire_drained();
+    }
+
+    // The pool may reuse these buffers only once the reader has them
+    if (m_shm)
+        m_shm->close();
+    while (!m_held.empty())
+    {
+        retire_drained();
+        if (m_held.empty())
+            break;
+        if (m_shm)
+            m_shm->wait_free((int)kDrainPoll.count());
+        else
+            std::this_thread::sleep_for(kDrainPoll);
+    }
+}
+
+uint32_t default_write_queue(size_t frame_bytes)
+{
+    static constexpr uint64_t kWriteQueueMemoryBudget = 512ULL << 20; // 512 MiB
+    static constexpr uint32_t kMaxWriteQueue = 4;
+
+    if (frame_bytes == 0)
+        return kMaxWriteQueue;
+    return (uint32_t)std::max<uint64_t>(1, std::min<uint64_t>(kMaxWriteQueue,
+                                                              kWriteQueueMemoryBudget / frame_bytes));
+}
@@ -0,0 +1,146 @@
+// frame_writer: dedicated thread that writes finished frames to the output
+// fd (stdout) with write/writev, off the decode path and around stdio. The
+// main thread queues buffers into a bounded ring and goes back to feeding
+// the decoder until the ring is full; the writer gives each buffer back to
+// its pool once it is on the fd.
+//
+// When the fd is a pipe (FFmpeg's stdin), the pipe is grown toward
+// /proc/sys/fs/pipe-max-size and frames are handed over with
+// vmsplice(SPLICE_F_GIFT) instead of being copied in. The pipe then holds
+// references to the pool's pages, so a buffer only goes back to its pool
+// once the reader has taken all of its bytes out (FIONREAD), and those held
+// buffers count against the queue depth. Other fds, DPX frames (their
+// header is not pool memory) and kernels without vmsplice use writev.
+//
+// With a ShmRing the fd is unused: frames are published into the ring
+// (their buffers are its slots) and held until the consumer has them.
+//
+// With an AvEncoder the fd is unused too: the writer thread encodes and muxes
+// each frame, and the encoder gives the buffer back once it is done with it.
+//
+// With a NutMuxer the fd gets a NUT stream instead of bare frames: the
+// writer thread puts the header out first, then each frame between its NUT
+// frame header and the audio packets queued with it. Frames still go out by
+// vmsplice or writev as above; the framing around them is written.
+//
+// Time spent inside write calls (the encoder is not reading) against time
+// spent waiting for frames (decoding is not keeping up) tells which side
+// bounds a job.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pixel_format.h"
+
+class AvEncoder;
+class FramePool;
+class NutMuxer;
+class ShmRing;
+
+class FrameWriter
+{
+public:
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        uint64_t write_calls = 0;   // writev/vmsplice calls
+        uint64_t spliced_bytes = 0; // handed over without a copy (vmsplice, ring, encoder)
+        size_t pipe_bytes = 0;      // pipe capacity, 0 if the fd is no pipe
+        double write_seconds = 0.0; // inside write calls (or encoding)
+        double wait_seconds = 0.0;  // idle between frames, after the first
+    };
+
+    // Writes `fmt` frames of width x height to `fd`. At most `depth` frames
+    // are queued, being written or still referenced by the pipe at a time.
+    // Frame buffers must be page aligned and not share pages with other
+    // buffers for vmsplice to be used; `allow_splice` = false forces writev.
+    // Given a `ring`, frames go there instead and must be pushed from a pool
+    // carved out of its slots. Given an open `encoder`, frames go to it.
+    // Given an initialized `nut` muxer, `fd` gets a NUT stream.
+    FrameWriter(int fd, PixFmt fmt, size_t width, size_t height, uint32_t depth,
+                ShmRing* ring = nullptr, AvEncoder* encoder = nullptr,
+                NutMuxer* nut = nullptr, bool allow_splice = true);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    uint32_t depth() const { return (uint32_t)m_ring.size(); }
+
+    // Queues one frame; `data` goes back to `pool` (may be null) after the
+    // write. Blocks while the ring is full. Returns false once a write has
+    // failed; the frame is then given back unwritten. A frame without a pool
+    // is always copied, since nothing would keep its buffer from being
+    // reused. With a NUT muxer or an encoder, `audio` holds the PCM samples
+    // muxed after the frame; it is ignored otherwise.
+    bool push(uint8_t* data, FramePool* pool, std::vector<uint8_t> audio = {});
+
+    // Writes everything queued, waits until the reader has drained any
+    // spliced frames and stops the thread. Returns false if any write failed.
+    bool finish();
+
+    // Valid after finish()
+    Stats stats() const { return m_stats; }
+
+private:
+    struct Entry
+    {
+        uint8_t* data = nullptr;
+        FramePool* pool = nullptr;
+        std::vector<uint8_t> audio;
+    };
+
+    // A spliced frame whose pages the pipe may still reference
+    struct Held
+    {
+        Entry entry;
+        uint64_t end = 0; // fd stream offset past its last byte, or ring frame count
+    };
+
+    void writer_loop();
+    bool write_header();
+    bool write_entry(const Entry& entry, bool& spliced);
+    void retire_drained();
+
+    int m_fd;
+    PixFmt m_fmt;
+    size_t m_width;
+    size_t m_height;
+    size_t m_frame_bytes;
+    ShmRing* m_shm;
+    AvEncoder* m_encoder;
+    NutMuxer* m_nut;
+    std::vector<uint8_t> m_prefix; // NUT framing before the frame, writer thread only
+    std::vector<uint8_t> m_suffix; // and the audio packets after it
+    bool m_splice = false;
+    uint64_t m_stream_bytes = 0; // everything put into the fd so far
+
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::vector<Entry> m_ring;
+    size_t m_head = 0;  // next entry to write
+    size_t m_count = 0; // queued, including the one being written
+    size_t m_held_count = 0; // mirrors m_held.size() for push()
+    bool m_stop = false;
+    bool m_failed = false;
+
+    std::deque<Held> m_held; // writer thread only, oldest first
+    Stats m_stats;
+    std::thread m_thread;
+};
+
+// Write queue depth when none is given: a few frames, within a fixed memory
+// budget for large frames.
+uint32_t default_write_queue(size_t frame_bytes);
+
+// Frame buffer alignment that lets FrameWriter splice: whole pages
+constexpr size_t kFrameWriterAlignment = 4096;
@@ -0,0 +1,517 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef BRIDGE_ZLIB
+#include <zlib.h>
+#endif
+
+bool parse_image_format(const char* name, ImageFormat& format)
+{
+    if (strcmp(name, "jpeg") == 0 || strcmp(name, "jpg") == 0)
+        format = ImageFormat::Jpeg;
+    else if (strcmp(name, "png") == 0)
+        format = ImageFormat::Png;
+    else
+        return false;
+    return true;
+}
+
+const char* image_format_extension(ImageFormat format)
+{
+    return format == ImageFormat::Png ? "png" : "jpg";
+}
+
+static void put_be16(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back((uint8_t)(v >> 8));
+    out.push_back((uint8_t)v);
+}
+
+// ---------------------------------------------------------------------------
+// JPEG
+// ---------------------------------------------------------------------------
+
+// Natural (row-major) index of the i-th coefficient in zigzag order
+static const uint8_t kZigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Annex K.1, natural order
+static const uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Annex K.3: code counts per length 1..16, then the symbols
+static const uint8_t kLumaDcBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t kChromaDcBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t kDcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t kLumaAcBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t kLumaAcValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t kChromaAcBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t kChromaAcValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+// Code and length per symbol (Annex C)
+struct HuffTable
+{
+    uint16_t code[256] = {};
+    uint8_t length[256] = {};
+
+    HuffTable(const uint8_t* bits, const uint8_t* values)
+    {
+        uint16_t next = 0;
+        size_t k = 0;
+        for (int len = 1; len <= 16; len++)
+        {
+            for (int i = 0; i < bits[len - 1]; i++, k++)
+            {
+                code[values[k]] = next++;
+                length[values[k]] = (uint8_t)len;
+            }
+            next <<= 1;
+        }
+    }
+};
+
+// Entropy-coded segment: bits MSB first, 0xFF stuffed with 0x00
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void put(uint32_t bits, int count)
+    {
+        m_acc = (m_acc << count) | (bits & ((1u << count) - 1));
+        m_count += count;
+        while (m_count >= 8)
+        {
+            uint8_t byte = (uint8_t)(m_acc >> (m_count - 8));
+            m_out.push_back(byte);
+            if (byte == 0xFF)
+                m_out.push_back(0);
+            m_count -= 8;
+        }
+    }
+
+    // Pads the last byte with 1 bits
+    void flush()
+    {
+        if (m_count > 0)
+            put(0x7F, 8 - m_count);
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint64_t m_acc = 0;
+    int m_count = 0;
+};
+
+// Bits needed for |v|, and v in them (negatives as v - 1, Annex F.1.2.1)
+static int magnitude_bits(int v)
+{
+    int a = v < 0 ? -v : v;
+    int n = 0;
+    while (a)
+    {
+        n++;
+        a >>= 1;
+    }
+    return n;
+}
+
+class JpegBlockCoder
+{
+public:
+    JpegBlockCoder()
+    {
+        for (int u = 0; u < 8; u++)
+            for (int x = 0; x < 8; x++)
+                m_cos[u][x] = (float)((u == 0 ? std::sqrt(0.125) : 0.5)
+                                      * std::cos((2 * x + 1) * u * M_PI / 16));
+    }
+
+    // Level-shifted samples in, quantized coefficients in zigzag order out
+    void transform(const float* block, const uint8_t* quant, int* out) const
+    {
+        float rows[64];
+        for (int y = 0; y < 8; y++)
+            for (int u = 0; u < 8; u++)
+            {
+                float sum = 0;
+                for (int x = 0; x < 8; x++)
+                    sum += m_cos[u][x] * block[y * 8 + x];
+                rows[y * 8 + u] = sum;
+            }
+        for (int i = 0; i < 64; i++)
+        {
+            int n = kZigzag[i];
+            int u = n % 8, v = n / 8;
+            float sum = 0;
+            for (int y = 0; y < 8; y++)
+                sum += m_cos[v][y] * rows[y * 8 + u];
+            out[i] = (int)std::lround(sum / quant[n]);
+        }
+    }
+
+private:
+    float m_cos[8][8];
+};
+
+static void encode_block(BitWriter& bits, const int* coef, int& dc_pred,
+                         const HuffTable& dc, const HuffTable& ac)
+{
+    int diff = coef[0] - dc_pred;
+    dc_pred = coef[0];
+    int n = magnitude_bits(diff);
+    bits.put(dc.code[n], dc.length[n]);
+    if (n)
+        bits.put(diff < 0 ? diff - 1 : diff, n);
+
+    int run = 0;
+    for (int i = 1; i < 64; i++)
+    {
+        if (coef[i] == 0)
+        {
+            run++;
+            continue;
+        }
+        while (run >= 16)
+        {
+            bits.put(ac.code[0xF0], ac.length[0xF0]); // ZRL
+            run -= 16;
+        }
+        n = magnitude_bits(coef[i]);
+        int symbol = (run << 4) | n;
+        bits.put(ac.code[symbol], ac.length[symbol]);
+        bits.put(coef[i] < 0 ? coef[i] - 1 : coef[i], n);
+        run = 0;
+    }
+    if (run)
+        bits.put(ac.code[0x00], ac.length[0x00]); // EOB
+}
+
+static void scale_quant(const uint8_t* base, int quality, uint8_t* out)
+{
+    quality = std::max(1, std::min(100, quality));
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; i++)
+        out[i] = (uint8_t)std::max(1, std::min(255, (base[i] * scale + 50) / 100));
+}
+
+static void put_huff_table(std::vector<uint8_t>& out, uint8_t id, const uint8_t* bits,
+                           const uint8_t* values)
+{
+    size_t count = 0;
+    for (int i = 0; i < 16; i++)
+        count += bits[i];
+    out.push_back(0xFF);
+    out.push_back(0xC4);
+    put_be16(out, (uint32_t)(2 + 1 + 16 + count));
+    out.push_back(id);
+    out.insert(out.end(), bits, bits + 16);
+    out.insert(out.end(), values, values + count);
+}
+
+void encode_jpeg(const uint8_t* rgb, uint32_t width, uint32_t height, size_t stride, int quality,
+                 std::vector<uint8_t>& out)
+{
+    static const HuffTable luma_dc(kLumaDcBits, kDcValues);
+    static const HuffTable chroma_dc(kChromaDcBits, kDcValues);
+    static const HuffTable luma_ac(kLumaAcBits, kLumaAcValues);
+    static const HuffTable chroma_ac(kChromaAcBits, kChromaAcValues);
+    static const JpegBlockCoder coder;
+
+    uint8_t luma_q[64], chroma_q[64];
+    scale_quant(kLumaQuant, quality, luma_q);
+    scale_quant(kChromaQuant, quality, chroma_q);
+
+    out.clear();
+    out.reserve((size_t)width * height / 4 + 1024);
+
+    // SOI, APP0 (JFIF 1.01, no density)
+    static const uint8_t kHeader[] = {
+        0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+        0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+    };
+    out.insert(out.end(), kHeader, kHeader + sizeof(kHeader));
+
+    // DQT: both tables, zigzag order
+    out.push_back(0xFF);
+    out.push_back(0xDB);
+    put_be16(out, 2 + 2 * 65);
+    for (int t = 0; t < 2; t++)
+    {
+        out.push_back((uint8_t)t);
+        for (int i = 0; i < 64; i++)
+            out.push_back((t ? chroma_q : luma_q)[kZigzag[i]]);
+    }
+
+    // SOF0: Y sampled 2x2, Cb and Cr 1x1
+    out.push_back(0xFF);
+    out.push_back(0xC0);
+    put_be16(out, 8 + 3 * 3);
+    out.push_back(8);
+    put_be16(out, height);
+    put_be16(out, width);
+    out.push_back(3);
+    static const uint8_t kComponents[] = { 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 };
+    out.insert(out.end(), kComponents, kComponents + sizeof(kComponents));
+
+    put_huff_table(out, 0x00, kLumaDcBits, kDcValues);
+    put_huff_table(out, 0x10, kLumaAcBits, kLumaAcValues);
+    put_huff_table(out, 0x01, kChromaDcBits, kDcValues);
+    put_huff_table(out, 0x11, kChromaAcBits, kChromaAcValues);
+
+    // SOS
+    static const uint8_t kScan[] = {
+        0xFF, 0xDA, 0x00, 0x0C, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0,
+    };
+    out.insert(out.end(), kScan, kScan + sizeof(kScan));
+
+    // MCUs of 16x16 pixels: four Y blocks, then Cb and Cr averaged over 2x2.
+    // Edge MCUs repeat the last row and column.
+    BitWriter bits(out);
+    int dc_y = 0, dc_cb = 0, dc_cr = 0;
+    float y_px[16 * 16], cb_px[16 * 16], cr_px[16 * 16];
+    float block[64];
+    int coef[64];
+    for (uint32_t my = 0; my < height; my += 16)
+    {
+        for (uint32_t mx = 0; mx < width; mx += 16)
+        {
+            for (int py = 0; py < 16; py++)
+            {
+                const uint8_t* row = rgb + std::min<size_t>(my + py, height - 1) * stride;
+                for (int px = 0; px < 16; px++)
+                {
+                    const uint8_t* p = row + std::min<size_t>(mx + px, width - 1) * 3;
+                    float r = p[0], g = p[1], b = p[2];
+                    y_px[py * 16 + px] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+                    cb_px[py * 16 + px] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+                    cr_px[py * 16 + px] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+                }
+            }
+
+            for (int by = 0; by < 2; by++)
+                for (int bx = 0; bx < 2; bx++)
+                {
+                    for (int y = 0; y < 8; y++)
+                        for (int x = 0; x < 8; x++)
+                            block[y * 8 + x] = y_px[(by * 8 + y) * 16 + bx * 8 + x];
+                    coder.transform(block, luma_q, coef);
+                    encode_block(bits, coef, dc_y, luma_dc, luma_ac);
+                }
+
+            for (int c = 0; c < 2; c++)
+            {
+                const float* src = c ? cr_px : cb_px;
+                for (int y = 0; y < 8; y++)
+                    for (int x = 0; x < 8; x++)
+                    {
+                        const float* s = src + (y * 2) * 16 + x * 2;
+                        block[y * 8 + x] = 0.25f * (s[0] + s[1] + s[16] + s[17]);
+                    }
+                coder.transform(block, chroma_q, coef);
+                encode_block(bits, coef, c ? dc_cr : dc_cb, chroma_dc, chroma_ac);
+            }
+        }
+    }
+    bits.flush();
+
+    out.push_back(0xFF);
+    out.push_back(0xD9); // EOI
+}
+
+// ---------------------------------------------------------------------------
+// PNG
+// ---------------------------------------------------------------------------
+
+#ifdef BRIDGE_ZLIB
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t v)
+{
+    put_be16(out, v >> 16);
+    put_be16(out, v & 0xFFFF);
+}
+
+// Chunk length, type and data, then the CRC of type and data
+static void put_png_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t n)
+{
+    put_be32(out, (uint32_t)n);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + n);
+    put_be32(out, (uint32_t)crc32(0, out.data() + start, (uInt)(n + 4)));
+}
+
+bool png_available()
+{
+    return true;
+}
+
+// Paeth predictor of the PNG spec
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int p = (int)a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+bool encode_png(const uint8_t* rgb, uint32_t width, uint32_t height, size_t stride,
+                std::vector<uint8_t>& out)
+{
+    // Scanlines, each with the filter whose residuals have the smallest sum
+    // of magnitudes (libpng's heuristic): Sub, Up and Paeth leave photos
+    // mostly small values, which deflate far better than the pixels do
+    size_t row_bytes = (size_t)width * 3;
+    std::vector<uint8_t> raw((row_bytes + 1) * height);
+    std::vector<uint8_t> candidates[5];
+    for (std::vector<uint8_t>& c : candidates)
+        c.resize(row_bytes);
+    std::vector<uint8_t> zero_row(row_bytes, 0);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = rgb + y * stride;
+        const uint8_t* up = y ? rgb + (y - 1) * stride : zero_row.data();
+        for (size_t i = 0; i < row_bytes; i++)
+        {
+            uint8_t left = i >= 3 ? row[i - 3] : 0;
+            uint8_t up_left = i >= 3 ? up[i - 3] : 0;
+            candidates[0][i] = row[i];
+            candidates[1][i] = (uint8_t)(row[i] - left);
+            candidates[2][i] = (uint8_t)(row[i] - up[i]);
+            candidates[3][i] = (uint8_t)(row[i] - ((left + up[i]) >> 1));
+            candidates[4][i] = (uint8_t)(row[i] - paeth(left, up[i], up_left));
+        }
+        int best = 0;
+        uint64_t best_sum = UINT64_MAX;
+        for (int f = 0; f < 5; f++)
+        {
+            uint64_t sum = 0;
+            for (uint8_t v : candidates[f])
+                sum += v < 128 ? v : 256 - v;
+            if (sum < best_sum)
+            {
+                best = f;
+                best_sum = sum;
+            }
+        }
+        uint8_t* dst = &raw[y * (row_bytes + 1)];
+        dst[0] = (uint8_t)best;
+        memcpy(dst + 1, candidates[best].data(), row_bytes);
+    }
+
+    std::vector<uint8_t> z(compressBound((uLong)raw.size()));
+    uLongf z_len = (uLongf)z.size();
+    if (compress2(z.data(), &z_len, raw.data(), (uLong)raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+        return false;
+    z.resize(z_len);
+
+    out.clear();
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    out.insert(out.end(), kSignature, kSignature + 8);
+    std::vector<uint8_t> ihdr;
+    put_be32(ihdr, width);
+    put_be32(ihdr, height);
+    ihdr.push_back(8); // bit depth
+    ihdr.push_back(2); // RGB
+    ihdr.push_back(0); // deflate
+    ihdr.push_back(0); // adaptive filtering
+    ihdr.push_back(0); // no interlace
+    put_png_chunk(out, "IHDR", ihdr.data(), ihdr.size());
+    put_png_chunk(out, "IDAT", z.data(), z.size());
+    put_png_chunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+#else // !BRIDGE_ZLIB
+
+bool png_available()
+{
+    return false;
+}
+
+bool encode_png(const uint8_t*, uint32_t, uint32_t, size_t, std::vector<uint8_t>& out)
+{
+    out.clear();
+    return false;
+}
+
+#endif
+
+bool encode_image(ImageFormat format, const uint8_t* rgb, uint32_t width, uint32_t height,
+                  size_t stride, int quality, std::vector<uint8_t>& out)
+{
+    if (format == ImageFormat::Png)
+        return encode_png(rgb, width, height, stride, out);
+    encode_jpeg(rgb, width, height, stride, quality, out);
+    return true;
+}
+
+bool write_file(const std::string& path, const std::vector<uint8_t>& data, std::string& error)
+{
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f)
+    {
+        error = "Cannot create " + path + ": " + strerror(errno);
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+        error = "Failed to write " + path;
+    return ok;
+}
@@ -0,0 +1,48 @@
+// image_writer: still images for --thumbnails, encoded in the bridge
+// without an image library.
+//
+// JPEG is baseline JFIF: 4:2:0 YCbCr (full range, BT.601 as JFIF has it),
+// the Annex K quantization tables scaled by quality the way libjpeg does,
+// and the Annex K Huffman tables. PNG is 8-bit RGB, row-filtered and
+// deflated through zlib; a build without zlib (BRIDGE_ZLIB unset, see
+// CMakeLists.txt) writes no PNG at all rather than an uncompressed one.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class ImageFormat
+{
+    Jpeg,
+    Png,
+};
+
+bool parse_image_format(const char* name, ImageFormat& format);
+
+// File extension without the dot: "jpg" or "png"
+const char* image_format_extension(ImageFormat format);
+
+// Largest width or height a JPEG can have
+static constexpr uint32_t kJpegMaxDimension = 65535;
+
+// Whether this build writes PNG (it was built with zlib)
+bool png_available();
+
+// Encodes a packed rgb24 image whose rows are `stride` bytes apart into
+// `out` (replaced). quality 1..100 (JPEG only). encode_png() returns false
+// if the build has no zlib or deflating fails.
+void encode_jpeg(const uint8_t* rgb, uint32_t width, uint32_t height, size_t stride, int quality,
+                 std::vector<uint8_t>& out);
+bool encode_png(const uint8_t* rgb, uint32_t width, uint32_t height, size_t stride,
+                std::vector<uint8_t>& out);
+
+// encode_jpeg() or encode_png(); false as encode_png() is
+bool encode_image(ImageFormat format, const uint8_t* rgb, uint32_t width, uint32_t height,
+                  size_t stride, int quality, std::vector<uint8_t>& out);
+
+// Creates or replaces `path` with `data`. On failure returns false and sets
+// `error`.
+bool write_file(const std::string& path, const std::vector<uint8_t>& data, std::string& error);
@@ -0,0 +1,486 @@
+#include "nut_muxer.h"
+
+#include <algorithm>
+#include <cstring>
+
+// ---------------------------------------------------------------------------
+// NUT primitives (see the NUT specification and libavformat/nut.h)
+// ---------------------------------------------------------------------------
+
+static constexpr uint64_t nut_startcode(char c, uint64_t low)
+{
+    return ((((uint64_t)'N' << 8) | (uint64_t)c) << 48) | low;
+}
+
+static constexpr uint64_t kMainStartcode = nut_startcode('M', 0x7A561F5F04ADULL);
+static constexpr uint64_t kStreamStartcode = nut_startcode('S', 0x11405BF2F9DBULL);
+static constexpr uint64_t kSyncpointStartcode = nut_startcode('K', 0xE4ADEECA4569ULL);
+
+static const char kNutId[] = "nut/multimedia container"; // written with its NUL
+
+static constexpr uint64_t kNutVersion = 3;
+
+// Most bytes between a syncpoint and a frame header; FFmpeg's demuxer drops
+// frames whose header lies further out than the max_distance it was given
+static constexpr uint64_t kMaxDistance = 32768;
+
+// Audio packet size bound, so a packet header never ends up past
+// kMaxDistance behind the syncpoint put in front of it
+static constexpr size_t kMaxAudioPacketBytes = 16384;
+
+// Headroom for a frame header and a syncpoint packet
+static constexpr uint64_t kHeaderReserve = 64;
+
+// The one frame code used (code 0): every field is coded explicitly
+enum : uint64_t
+{
+    kFlagKey = 1,
+    kFlagCodedPts = 8,
+    kFlagStreamId = 16,
+    kFlagSizeMsb = 32,
+    kFlagChecksum = 64,
+};
+static constexpr uint64_t kFrameFlags = kFlagKey | kFlagCodedPts | kFlagStreamId
+                                        | kFlagSizeMsb | kFlagChecksum;
+static constexpr uint32_t kMsbPtsShift = 7; // coded pts >= 1 << 7 are absolute
+
+static constexpr uint64_t kVideoStream = 0;
+static constexpr uint64_t kAudioStream = 1;
+
+// CRC-32 with polynomial 0x04C11DB7, MSB first, no init or final xor
+static uint32_t nut_crc(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    static const struct Table
+    {
+        uint32_t v[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i << 24;
+                for (int bit = 0; bit < 8; bit++)
+                    c = (c & 0x80000000u) ? (c << 1) ^ 0x04C11DB7u : c << 1;
+                v[i] = c;
+            }
+        }
+    } table;
+
+    for (size_t i = 0; i < size; i++)
+        crc = (crc << 8) ^ table.v[((crc >> 24) ^ data[i]) & 0xFF];
+    return crc;
+}
+
+static void put_v(std::vector<uint8_t>& out, uint64_t value)
+{
+    int groups = 1;
+    while (groups < 10 && (value >> (7 * groups)) != 0)
+        groups++;
+    for (int i = groups - 1; i > 0; i--)
+        out.push_back((uint8_t)(0x80 | ((value >> (7 * i)) & 0x7F)));
+    out.push_back((uint8_t)(value & 0x7F));
+}
+
+static void put_s(std::vector<uint8_t>& out, int64_t value)
+{
+    put_v(out, value > 0 ? 2 * (uint64_t)value - 1 : (uint64_t)(-2 * value));
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((uint8_t)(value >> shift));
+}
+
+static void put_be64(std::vector<uint8_t>& out, uint64_t value)
+{
+    put_be32(out, (uint32_t)(value >> 32));
+    put_be32(out, (uint32_t)value);
+}
+
+static void put_fourcc(std::vector<uint8_t>& out, const uint8_t (&fourcc)[4])
+{
+    put_v(out, 4);
+    out.insert(out.end(), fourcc, fourcc + 4);
+}
+
+// startcode, forward_ptr (header checksum past 4 KiB), data, data checksum
+static void put_packet(std::vector<uint8_t>& out, uint64_t startcode, const std::vector<uint8_t>& data)
+{
+    size_t start = out.size();
+    put_be64(out, startcode);
+    uint64_t forward_ptr = data.size() + 4;
+    put_v(out, forward_ptr);
+    if (forward_ptr > 4096)
+        put_be32(out, nut_crc(out.data() + start, out.size() - start));
+    out.insert(out.end(), data.begin(), data.end());
+    put_be32(out, nut_crc(data.data(), data.size()));
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// rawvideo fourccs as libavcodec/raw.c maps them to pixel formats
+static bool video_fourcc(PixFmt fmt, uint8_t (&fourcc)[4])
+{
+    auto set = [&](uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+        fourcc[0] = a;
+        fourcc[1] = b;
+        fourcc[2] = c;
+        fourcc[3] = d;
+        return true;
+    };
+    switch (fmt)
+    {
+        case PixFmt::RGB24:       return set('R', 'G', 'B', 24);
+        case PixFmt::BGR24:       return set('B', 'G', 'R', 24);
+        case PixFmt::BGRA:        return set('B', 'G', 'R', 'A');
+        case PixFmt::RGB48LE:     return set('R', 'G', 'B', 48);
+        case PixFmt::GBRP16LE:    return set('G', '3', 0, 16);
+        case PixFmt::YUV420P:     return set('I', '4', '2', '0');
+        case PixFmt::NV12:        return set('N', 'V', '1', '2');
+        case PixFmt::YUV422P10LE: return set('Y', '3', 10, 10);
+        case PixFmt::DPX10:
+        case PixFmt::P010LE:
+            break;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// NutMuxer
+// ---------------------------------------------------------------------------
+
+bool NutMuxer::supports(PixFmt fmt)
+{
+    uint8_t fourcc[4];
+    return video_fourcc(fmt, fourcc);
+}
+
+bool NutMuxer::init(PixFmt fmt, size_t width, size_t height, uint32_t fps_num, uint32_t fps_den,
+                    const NutAudioFormat* audio, std::string& error)
+{
+    if (!supports(fmt))
+    {
+        error = std::string("--mux nut cannot carry ") + pix_fmt_name(fmt) + " frames";
+        return false;
+    }
+    if (width == 0 || height == 0 || fps_num == 0 || fps_den == 0)
+    {
+        error = "--mux nut needs the frame size and frame rate";
+        return false;
+    }
+    if (audio && audio->channels > 0)
+    {
+        uint32_t bits = audio->bits_per_sample;
+        if (audio->sample_rate == 0 || (bits != 16 && bits != 24 && bits != 32))
+        {
+            error = "Unsupported audio format for --mux nut ("
+                    + std::to_string(bits) + "-bit, " + std::to_string(audio->sample_rate) + " Hz)";
+            return false;
+        }
+        m_audio = *audio;
+    }
+    else
+    {
+        m_audio = NutAudioFormat();
+    }
+
+    m_fmt = fmt;
+    m_width = width;
+    m_height = height;
+    m_frame_bytes = pix_fmt_frame_bytes(fmt, width, height);
+    m_fps_num = fps_num;
+    m_fps_den = fps_den;
+    m_video_pts = 0;
+    m_audio_pts = 0;
+    m_since_syncpoint = 0;
+    return true;
+}
+
+void NutMuxer::write_header(std::vector<uint8_t>& out) const
+{
+    out.insert(out.end(), kNutId, kNutId + sizeof(kNutId));
+
+    // Time base 0: one frame; time base 1: one sample
+    uint64_t g = gcd(m_fps_num, m_fps_den);
+    std::vector<uint8_t> data;
+    put_v(data, kNutVersion);
+    put_v(data, has_audio() ? 2 : 1);
+    put_v(data, kMaxDistance);
+    put_v(data, has_audio() ? 2 : 1);
+    put_v(data, m_fps_den / g);
+    put_v(data, m_fps_num / g);
+    if (has_audio())
+    {
+        put_v(data, 1);
+        put_v(data, m_audio.sample_rate);
+    }
+    // Frame code table: one entry for all 255 codes ('N' is skipped), with
+    // pts, stream and size always coded in the frame header
+    put_v(data, kFrameFlags);
+    put_v(data, 6);   // fields
+    put_s(data, 0);   // pts delta
+    put_v(data, 1);   // size multiplier
+    put_v(data, 0);   // stream
+    put_v(data, 0);   // size lsb
+    put_v(data, 0);   // reserved
+    put_v(data, 255); // count
+    put_v(data, 0);   // elision headers - 1
+    put_packet(out, kMainStartcode, data);
+
+    uint8_t fourcc[4];
+    video_fourcc(m_fmt, fourcc);
+    data.clear();
+    put_v(data, kVideoStream);
+    put_v(data, 0); // class: video
+    put_fourcc(data, fourcc);
+    put_v(data, 0); // time base
+    put_v(data, kMsbPtsShift);
+    put_v(data, 1); // max pts distance
+    put_v(data, 0); // decode delay
+    put_v(data, 1); // flags: fixed fps
+    put_v(data, 0); // codec specific data
+    put_v(data, m_width);
+    put_v(data, m_height);
+    put_v(data, 0); // sample aspect ratio: unknown
+    put_v(data, 0);
+    put_v(data, 0); // colorspace: unknown
+    put_packet(out, kStreamStartcode, data);
+
+    if (has_audio())
+    {
+        const uint8_t pcm[4] = { 'P', 'S', 'D', (uint8_t)m_audio.bits_per_sample };
+        data.clear();
+        put_v(data, kAudioStream);
+        put_v(data, 1); // class: audio
+        put_fourcc(data, pcm);
+        put_v(data, 1); // time base
+        put_v(data, kMsbPtsShift);
+        put_v(data, m_audio.sample_rate);
+        put_v(data, 0); // decode delay
+        put_v(data, 0); // flags
+        put_v(data, 0); // codec specific data
+        put_v(data, m_audio.sample_rate);
+        put_v(data, 1); // sample rate denominator
+        put_v(data, m_audio.channels);
+        put_packet(out, kStreamStartcode, data);
+    }
+}
+
+void NutMuxer::write_syncpoint(uint64_t pts, uint64_t time_base, std::vector<uint8_t>& out)
+{
+    std::vector<uint8_t> data;
+    put_v(data, pts * (has_audio() ? 2 : 1) + time_base);
+    put_v(data, 0); // back pointer: no index is written
+    put_packet(out, kSyncpointStartcode, data);
+    m_since_syncpoint = 0;
+}
+
+void NutMuxer::write_frame_header(uint64_t stream, uint64_t pts, size_t bytes, std::vector<uint8_t>& out)
+{
+    size_t start = out.size();
+    out.push_back(0); // frame code
+    put_v(out, stream);
+    put_v(out, pts + (1u << kMsbPtsShift));
+    put_v(out, bytes);
+    put_be32(out, nut_crc(out.data() + start, out.size() - start));
+    m_since_syncpoint += out.size() - start + bytes;
+}
+
+void NutMuxer::begin_video_frame(std::vector<uint8_t>& out)
+{
+    write_syncpoint(m_video_pts, 0, out);
+    write_frame_header(kVideoStream, m_video_pts, m_frame_bytes, out);
+    m_video_pts++;
+}
+
+void NutMuxer::write_audio(const uint8_t* samples, size_t bytes, std::vector<uint8_t>& out)
+{
+    const size_t block = audio_block_bytes();
+    if (block == 0)
+        return;
+    const size_t max_packet = kMaxAudioPacketBytes / block * block;
+
+    while (bytes >= block)
+    {
+        size_t packet = std::min(bytes, max_packet) / block * block;
+        if (m_since_syncpoint + kHeaderReserve > kMaxDistance)
+            write_syncpoint(m_audio_pts, 1, out);
+        write_frame_header(kAudioStream, m_audio_pts, packet, out);
+        out.insert(out.end(), samples, samples + packet);
+        m_audio_pts += packet / block;
+        samples += packet;
+        bytes -= packet;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Reads back what NutMuxer writes, checking what FFmpeg's demuxer checks
+struct NutReader
+{
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint64_t get_v()
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 10; i++)
+        {
+            if (p >= end)
+                break;
+            uint8_t b = *p++;
+            v = (v << 7) | (b & 0x7F);
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    uint64_t get_be(int bytes)
+    {
+        uint64_t v = 0;
+        if (end - p < bytes)
+        {
+            ok = false;
+            return 0;
+        }
+        for (int i = 0; i < bytes; i++)
+            v = (v << 8) | *p++;
+        return v;
+    }
+
+    // A packet's data; checks both checksums
+    bool packet(uint64_t& startcode, const uint8_t*& data, size_t& size)
+    {
+        const uint8_t* start = p;
+        startcode = get_be(8);
+        uint64_t forward_ptr = get_v();
+        if (forward_ptr > 4096)
+        {
+            get_be(4);
+            ok = ok && nut_crc(start, (size_t)(p - start)) == 0;
+        }
+        if (!ok || forward_ptr < 4 || (uint64_t)(end - p) < forward_ptr)
+            return ok = false;
+        data = p;
+        size = (size_t)forward_ptr - 4;
+        ok = nut_crc(p, (size_t)forward_ptr) == 0;
+        p += forward_ptr;
+        return ok;
+    }
+};
+
+} // namespace
+
+bool nut_self_check(FILE* report)
+{
+    static const uint32_t kFrames = 5;
+    static const size_t kWidth = 64;
+    static const size_t kHeight = 36;
+    const PixFmt fmt = PixFmt::YUV420P;
+    const size_t frame_bytes = pix_fmt_frame_bytes(fmt, kWidth, kHeight);
+
+    // 48 kHz stereo 24-bit at 24000/1001: 2002 samples per frame, more than
+    // one packet's worth, so packets are split and syncpoints repeated
+    NutAudioFormat audio;
+    audio.sample_rate = 48000;
+    audio.channels = 2;
+    audio.bits_per_sample = 24;
+    const size_t per_frame = 2002 * 6;
+
+    NutMuxer mux;
+    std::string error;
+    bool ok = mux.init(fmt, kWidth, kHeight, 24000, 1001, &audio, error);
+
+    std::vector<uint8_t> stream;
+    mux.write_header(stream);
+    std::vector<uint8_t> pcm(per_frame);
+    for (uint32_t f = 0; f < kFrames; f++)
+    {
+        mux.begin_video_frame(stream);
+        stream.insert(stream.end(), frame_bytes, (uint8_t)f);
+        for (size_t i = 0; i < pcm.size(); i++)
+            pcm[i] = (uint8_t)(f * 7 + i);
+        mux.write_audio(pcm.data(), pcm.size(), stream);
+    }
+
+    NutReader r{ stream.data(), stream.data() + stream.size() };
+    ok = ok && stream.size() > sizeof(kNutId) && memcmp(stream.data(), kNutId, sizeof(kNutId)) == 0;
+    r.p += sizeof(kNutId);
+
+    uint64_t startcode = 0;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    int stream_headers = 0;
+    uint64_t video_frames = 0;
+    uint64_t audio_samples = 0;
+    uint64_t audio_bytes_ok = 0;
+    const uint8_t* last_syncpoint = nullptr;
+    while (ok && r.p < r.end)
+    {
+        if (*r.p == 'N')
+        {
+            const uint8_t* at = r.p;
+            ok = r.packet(startcode, data, size);
+            if (startcode == kSyncpointStartcode)
+                last_syncpoint = at;
+            else if (startcode == kStreamStartcode)
+                stream_headers++;
+            else
+                ok = ok && startcode == kMainStartcode;
+            continue;
+        }
+
+        // Frame: code 0, stream, coded pts, size, header checksum
+        ok = last_syncpoint && (uint64_t)(r.p + 1 - last_syncpoint) <= kMaxDistance;
+        const uint8_t* start = r.p++;
+        uint64_t stream_id = r.get_v();
+        uint64_t pts = r.get_v() - (1u << kMsbPtsShift);
+        uint64_t bytes = r.get_v();
+        r.get_be(4);
+        ok = ok && r.ok && start[0] == 0 && nut_crc(start, (size_t)(r.p - start)) == 0
+             && (uint64_t)(r.end - r.p) >= bytes;
+        if (!ok)
+            break;
+        if (stream_id == kVideoStream)
+        {
+            ok = pts == video_frames && bytes == frame_bytes && r.p[0] == (uint8_t)video_frames
+                 && r.p[bytes - 1] == (uint8_t)video_frames;
+            video_frames++;
+        }
+        else
+        {
+            ok = stream_id == kAudioStream && pts == audio_samples && bytes % 6 == 0;
+            size_t offset = (size_t)(audio_samples * 6 % per_frame);
+            uint32_t f = (uint32_t)(audio_samples * 6 / per_frame);
+            if (ok && r.p[0] == (uint8_t)(f * 7 + offset))
+                audio_bytes_ok += bytes;
+            audio_samples += bytes / 6;
+        }
+        r.p += bytes;
+    }
+
+    ok = ok && r.ok && stream_headers == 2 && video_frames == kFrames
+         && audio_samples == kFrames * per_frame / 6 && audio_bytes_ok == kFrames * per_frame;
+
+    fprintf(report,
+        "{\"type\":\"self_check\",\"check\":\"nut_mux\",\"ok\":%s}\n",
+        ok ? "true" : "false");
+    return ok;
+}
@@ -0,0 +1,82 @@
+// nut_muxer: NUT container framing for the bridges' stdout (--mux nut), so
+// one stream carries both the frames and the clip's PCM audio, interleaved
+// by time, and FFmpeg reads everything from a single `-f nut -i pipe:0`
+// instead of a rawvideo pipe plus a WAV extracted beforehand.
+//
+// Only the framing is produced here; frame data stays in the pool buffers.
+// Each video frame is preceded by a syncpoint and a frame header and is
+// followed by the audio packets that cover its duration, so FrameWriter
+// still hands the frame itself over with writev or vmsplice and just adds
+// these small pieces around it. Video is rawvideo in one of the NUT
+// fourccs FFmpeg maps back to its pixel formats, audio is PCM (PSD fourcc,
+// signed little endian). Every video frame is a keyframe with a syncpoint
+// of its own; audio packets get one where FFmpeg's demuxer would otherwise
+// find their header too far from the last.
+//
+// DPX and p010le have no rawvideo fourcc and stay on the raw pipe.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "pixel_format.h"
+
+struct NutAudioFormat
+{
+    uint32_t sample_rate = 0;
+    uint32_t channels = 0;
+    uint32_t bits_per_sample = 0; // 16, 24 or 32
+};
+
+class NutMuxer
+{
+public:
+    // Whether frames of `fmt` can be carried (has a rawvideo fourcc)
+    static bool supports(PixFmt fmt);
+
+    // Sets up a video stream of width x height `fmt` frames at
+    // fps_num/fps_den and, given `audio`, a PCM stream. On failure returns
+    // false and sets `error`.
+    bool init(PixFmt fmt, size_t width, size_t height, uint32_t fps_num, uint32_t fps_den,
+              const NutAudioFormat* audio, std::string& error);
+
+    bool has_audio() const { return m_audio.channels > 0; }
+
+    // Bytes of one sample on all channels
+    size_t audio_block_bytes() const { return (size_t)m_audio.channels * m_audio.bits_per_sample / 8; }
+
+    // Appends the file ID string, the main header and the stream headers
+    void write_header(std::vector<uint8_t>& out) const;
+
+    // Appends the syncpoint and frame header of the next video frame; its
+    // pix_fmt_frame_bytes() of data (in frame_iovecs() order) follow
+    void begin_video_frame(std::vector<uint8_t>& out);
+
+    // Appends `bytes` of interleaved samples (whole sample blocks) as audio
+    // packets, timestamped after the ones before them
+    void write_audio(const uint8_t* samples, size_t bytes, std::vector<uint8_t>& out);
+
+private:
+    void write_syncpoint(uint64_t pts, uint64_t time_base, std::vector<uint8_t>& out);
+    void write_frame_header(uint64_t stream, uint64_t pts, size_t bytes, std::vector<uint8_t>& out);
+
+    PixFmt m_fmt = PixFmt::RGB24;
+    size_t m_width = 0;
+    size_t m_height = 0;
+    size_t m_frame_bytes = 0;
+    uint32_t m_fps_num = 0;
+    uint32_t m_fps_den = 1;
+    NutAudioFormat m_audio;
+    uint64_t m_video_pts = 0; // in frames
+    uint64_t m_audio_pts = 0; // in samples
+    uint64_t m_since_syncpoint = 0; // bytes written after the last syncpoint
+};
+
+// bridge-common-tests: muxes a short clip with audio, parses it back
+// (startcodes, checksums, frame headers, timestamps) and prints one
+// {"type":"self_check","check":"nut_mux"} line. Returns false on mismatch.
+bool nut_self_check(FILE* report);
@@ -0,0 +1,242 @@
+#include "pixel_convert.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "stripe_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BRIDGE_X86 1
+#endif
+
+// ---------------------------------------------------------------------------
+// RGBA → RGB24
+// ---------------------------------------------------------------------------
+
+static void rgba_to_rgb24_scalar(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++)
+    {
+        dst[0] = src[0]; // R
+        dst[1] = src[1]; // G
+        dst[2] = src[2]; // B
+        dst += 3;
+        src += 4; // skip A
+    }
+}
+
+#ifdef BRIDGE_X86
+
+// Per 16-byte lane: gather the 12 colour bytes of 4 pixels into the low
+// 12 bytes, zero the rest.
+#define RGBA_TO_RGB_LANE_MASK \
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+
+__attribute__((target("ssse3")))
+static void rgba_to_rgb24_ssse3(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    const __m128i mask = _mm_setr_epi8(RGBA_TO_RGB_LANE_MASK);
+    size_t i = 0;
+
+    // 16 pixels in (64 bytes) → 48 bytes out as three full stores
+    for (; i + 16 <= pixels; i += 16)
+    {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 0)), mask);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 16)), mask);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 32)), mask);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 48)), mask);
+
+        _mm_storeu_si128((__m128i*)(dst + 0),
+            _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i*)(dst + 16),
+            _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i*)(dst + 32),
+            _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+
+        src += 64;
+        dst += 48;
+    }
+
+    rgba_to_rgb24_scalar(src, dst, pixels - i);
+}
+
+__attribute__((target("avx2")))
+static void rgba_to_rgb24_avx2(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    const __m256i mask = _mm256_setr_epi8(RGBA_TO_RGB_LANE_MASK, RGBA_TO_RGB_LANE_MASK);
+    // Compact the two 12-byte lane results into the low 24 bytes
+    const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    size_t i = 0;
+
+    // Each 32-byte store spills 8 bytes past its 24 valid ones; the next
+    // store overwrites them, so keep 3 pixels of headroom after the last.
+    for (; i + 16 + 3 <= pixels; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + 0));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + 32));
+        a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(a, mask), pack);
+        b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(b, mask), pack);
+        _mm256_storeu_si256((__m256i*)(dst + 0), a);
+        _mm256_storeu_si256((__m256i*)(dst + 24), b);
+
+        src += 64;
+        dst += 48;
+    }
+
+    rgba_to_rgb24_ssse3(src, dst, pixels - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void rgba_to_rgb24_avx512(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    const __m512i mask = _mm512_broadcast_i32x4(_mm_setr_epi8(RGBA_TO_RGB_LANE_MASK));
+    const __m512i pack = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 15, 15, 15, 15);
+    const __mmask64 full_store = (1ULL << 48) - 1;
+    size_t i = 0;
+
+    for (; i + 16 <= pixels; i += 16)
+    {
+        __m512i v = _mm512_loadu_si512((const void*)src);
+        v = _mm512_permutexvar_epi32(pack, _mm512_shuffle_epi8(v, mask));
+        _mm512_mask_storeu_epi8(dst, full_store, v);
+        src += 64;
+        dst += 48;
+    }
+
+    // Masked tail: no scalar loop, no over-read or over-write
+    size_t rest = pixels - i;
+    if (rest > 0)
+    {
+        __m512i v = _mm512_maskz_loadu_epi32((__mmask16)((1u << rest) - 1), src);
+        v = _mm512_permutexvar_epi32(pack, _mm512_shuffle_epi8(v, mask));
+        _mm512_mask_storeu_epi8(dst, (__mmask64)((1ULL << (rest * 3)) - 1), v);
+    }
+}
+
+#endif // BRIDGE_X86
+
+RgbaToRgbFn rgba_to_rgb24_kernel(SimdLevel level)
+{
+#ifdef BRIDGE_X86
+    switch (level)
+    {
+        case SimdLevel::AVX512: return rgba_to_rgb24_avx512;
+        case SimdLevel::AVX2:   return rgba_to_rgb24_avx2;
+        case SimdLevel::SSSE3:  return rgba_to_rgb24_ssse3;
+        default: break;
+    }
+#else
+    (void)level;
+#endif
+    return rgba_to_rgb24_scalar;
+}
+
+void rgba_to_rgb24_frame(const uint8_t* src, uint8_t* dst,
+                         uint32_t width, uint32_t height, StripePool* pool)
+{
+    static const RgbaToRgbFn kernel = rgba_to_rgb24_kernel(detect_simd_level());
+
+    size_t pixels = (size_t)width * height;
+    if (!pool || pixels < kStripeMinPixels)
+    {
+        kernel(src, dst, pixels);
+        return;
+    }
+
+    size_t min_rows = width ? std::max<size_t>(16, (kStripeMinPixels / 8) / width) : 1;
+    pool->run(height, min_rows, [&](size_t row_begin, size_t row_end)
+    {
+        size_t offset = row_begin * width;
+        kernel(src + offset * 4, dst + offset * 3, (row_end - row_begin) * width);
+    });
+}
+
+void copy_frame(const uint8_t* src, uint8_t* dst, size_t bytes, StripePool* pool)
+{
+    static constexpr size_t kBlockBytes = 1u << 20;
+
+    size_t blocks = (bytes + kBlockBytes - 1) / kBlockBytes;
+    if (!pool || bytes < kStripeMinPixels * 3)
+    {
+        memcpy(dst, src, bytes);
+        return;
+    }
+
+    pool->run(blocks, 4, [&](size_t block_begin, size_t block_end)
+    {
+        size_t begin = block_begin * kBlockBytes;
+        size_t end = std::min(bytes, block_end * kBlockBytes);
+        memcpy(dst + begin, src + begin, end - begin);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+bool pixel_convert_self_check(FILE* report)
+{
+    static const SimdLevel levels[] = {
+        SimdLevel::Scalar, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512,
+    };
+    // Odd sizes exercise every tail path; 4096 covers the steady-state loops
+    static const size_t sizes[] = { 0, 1, 3, 7, 15, 16, 17, 31, 33, 63, 65, 127, 4096 + 13 };
+
+    SimdLevel best = detect_simd_level();
+    bool all_ok = true;
+
+    // Deterministic pseudo-random input (xorshift)
+    std::vector<uint8_t> src(4 * 8192 + 64);
+    uint32_t state = 0x9E3779B9u;
+    for (auto& b : src)
+    {
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        b = (uint8_t)state;
+    }
+
+    for (SimdLevel level : levels)
+    {
+        if ((int)level > (int)best)
+            break;
+
+        RgbaToRgbFn fn = rgba_to_rgb24_kernel(level);
+        bool ok = true;
+
+        for (size_t n : sizes)
+        {
+            for (size_t misalign = 0; misalign < 4 && ok; misalign++)
+            {
+                // Guard bytes after the output catch over-writes
+                std::vector<uint8_t> expect(n * 3 + 64, 0xA5);
+                std::vector<uint8_t> got(n * 3 + 64 + misalign, 0xA5);
+                rgba_to_rgb24_scalar(src.data() + misalign, expect.data(), n);
+                fn(src.data() + misalign, got.data() + misalign, n);
+                if (memcmp(expect.data(), got.data() + misalign, expect.size()) != 0)
+                    ok = false;
+            }
+        }
+
+        // Throughput on a UHD-sized frame
+        static constexpr size_t kBenchPixels = 3840 * 2160;
+        std::vector<uint8_t> bench_src(kBenchPixels * 4, 0x40);
+        std::vector<uint8_t> bench_dst(kBenchPixels * 3);
+        auto t0 = std::chrono::steady_clock::now();
+        static constexpr int kIterations = 10;
+        for (int it = 0; it < kIterations; it++)
+            fn(bench_src.data(), bench_dst.data(), kBenchPixels);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        double mpix_per_s = secs > 0 ? (kBenchPixels * (double)kIterations) / secs / 1e6 : 0.0;
+
+        fprintf(report,
+            "{\"type\":\"self_check\",\"kernel\":\"rgba_to_rgb24\",\"isa\":\"%s\","
+            "\"ok\":%s,\"mpix_per_s\":%.1f}\n",
+            simd_level_name(level), ok ? "true" : "false", mpix_per_s);
+
+        all_ok = all_ok && ok;
+    }
+
+    return all_ok;
+}
@@ -0,0 +1,36 @@
+// pixel_convert: packed pixel layout conversions for the bridge output path.
+// Each kernel has a scalar reference and SIMD variants chosen at runtime.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "cpu_features.h"
+
+class StripePool;
+
+// Converts one run of pixels: R,G,B,A → R,G,B (alpha dropped).
+using RgbaToRgbFn = void (*)(const uint8_t* src, uint8_t* dst, size_t pixels);
+
+// Kernel for the given level; falls back to the next lower level the build
+// provides. Never returns null.
+RgbaToRgbFn rgba_to_rgb24_kernel(SimdLevel level);
+
+// Converts a tightly packed width x height RGBA frame into packed RGB24 using
+// the best kernel for this CPU. Frames of at least kStripeMinPixels are split
+// into row stripes on `pool` (may be null).
+void rgba_to_rgb24_frame(const uint8_t* src, uint8_t* dst,
+                         uint32_t width, uint32_t height, StripePool* pool);
+
+static constexpr size_t kStripeMinPixels = 1u << 21;
+
+// Copies a frame buffer that already has the output layout (e.g. 16-bit SDK
+// formats); large copies are split into blocks on `pool` (may be null).
+void copy_frame(const uint8_t* src, uint8_t* dst, size_t bytes, StripePool* pool);
+
+// Compares every SIMD level this CPU supports against the scalar reference
+// over a range of sizes and misalignments. Writes one NDJSON line per
+// kernel/ISA to `report` (with throughput) and returns true if all match.
+bool pixel_convert_self_check(FILE* report);
@@ -0,0 +1,233 @@
+#include "pixel_format.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/uio.h>
+
+// ---------------------------------------------------------------------------
+// Names and sizes
+// ---------------------------------------------------------------------------
+
+static const struct
+{
+    PixFmt fmt;
+    const char* name;
+} kPixFmtNames[] = {
+    { PixFmt::RGB24,       "rgb24" },
+    { PixFmt::BGR24,       "bgr24" },
+    { PixFmt::BGRA,        "bgra" },
+    { PixFmt::RGB48LE,     "rgb48le" },
+    { PixFmt::GBRP16LE,    "gbrp16le" },
+    { PixFmt::DPX10,       "dpx10" },
+    { PixFmt::YUV420P,     "yuv420p" },
+    { PixFmt::NV12,        "nv12" },
+    { PixFmt::YUV422P10LE, "yuv422p10le" },
+    { PixFmt::P010LE,      "p010le" },
+};
+
+bool parse_pix_fmt(const char* name, PixFmt& fmt)
+{
+    for (const auto& entry : kPixFmtNames)
+    {
+        if (strcmp(name, entry.name) == 0)
+        {
+            fmt = entry.fmt;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* pix_fmt_name(PixFmt fmt)
+{
+    for (const auto& entry : kPixFmtNames)
+    {
+        if (entry.fmt == fmt)
+            return entry.name;
+    }
+    return "unknown";
+}
+
+size_t pix_fmt_frame_bytes(PixFmt fmt, size_t width, size_t height)
+{
+    size_t pixels = width * height;
+    // Chroma planes round odd sizes up, as FFmpeg does
+    size_t chroma_width = (width + 1) / 2;
+    size_t chroma_420 = chroma_width * ((height + 1) / 2);
+    switch (fmt)
+    {
+        case PixFmt::RGB24:
+        case PixFmt::BGR24:       return pixels * 3;
+        case PixFmt::BGRA:        return pixels * 4;
+        case PixFmt::RGB48LE:
+        case PixFmt::GBRP16LE:    return pixels * 6;
+        case PixFmt::DPX10:       return pixels * 4;
+        case PixFmt::YUV420P:
+        case PixFmt::NV12:        return pixels + 2 * chroma_420;
+        case PixFmt::YUV422P10LE: return 2 * (pixels + 2 * chroma_width * height);
+        case PixFmt::P010LE:      return 2 * (pixels + 2 * chroma_420);
+    }
+    return 0;
+}
+
+bool pix_fmt_resizable(PixFmt fmt)
+{
+    return fmt == PixFmt::RGB24 || fmt == PixFmt::BGR24
+        || fmt == PixFmt::YUV420P || fmt == PixFmt::NV12;
+}
+
+bool pix_fmt_is_yuv(PixFmt fmt)
+{
+    return fmt == PixFmt::YUV420P || fmt == PixFmt::NV12
+        || fmt == PixFmt::YUV422P10LE || fmt == PixFmt::P010LE;
+}
+
+uint32_t pix_fmt_bit_depth(PixFmt fmt)
+{
+    switch (fmt)
+    {
+        case PixFmt::RGB48LE:
+        case PixFmt::GBRP16LE:    return 16;
+        case PixFmt::DPX10:
+        case PixFmt::YUV422P10LE:
+        case PixFmt::P010LE:      return 10;
+        default:                  return 8;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// DPX framing
+// ---------------------------------------------------------------------------
+
+// SMPTE 268M header: file (768) + image (640) + orientation (256) +
+// film (256) + television (128) information
+static constexpr size_t kDpxHeaderBytes = 2048;
+
+static void put_be32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void put_be16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+// Minimal big-endian header for one RGB element of 10-bit samples in
+// 32-bit words, method B (pad bits at the top of each word) — the layout
+// R3D's PixelType_10Bit_DPX_MethodB decodes to.
+static void fill_dpx_header(uint8_t* h, uint32_t width, uint32_t height)
+{
+    memset(h, 0, kDpxHeaderBytes);
+    uint32_t image_bytes = width * height * 4;
+
+    memcpy(h + 0, "SDPX", 4);                            // magic (big endian)
+    put_be32(h + 4, (uint32_t)kDpxHeaderBytes);           // offset to image data
+    memcpy(h + 8, "V2.0", 4);
+    put_be32(h + 16, (uint32_t)kDpxHeaderBytes + image_bytes); // file size
+    put_be32(h + 20, 1);                                  // ditto key: new frame
+    put_be32(h + 24, 1664);                               // generic header size
+    put_be32(h + 28, 384);                                // industry header size
+    put_be32(h + 660, 0xFFFFFFFFu);                       // not encrypted
+
+    put_be16(h + 768, 0);                                 // orientation: left to right, top to bottom
+    put_be16(h + 770, 1);                                 // one image element
+    put_be32(h + 772, width);
+    put_be32(h + 776, height);
+
+    uint8_t* element = h + 780;
+    put_be32(element + 0, 0);                             // unsigned samples
+    put_be32(element + 12, 1023);                         // reference high code
+    element[20] = 50;                                     // descriptor: RGB
+    element[21] = 0;                                      // transfer: user defined (the clip's gamma)
+    element[22] = 0;                                      // colorimetry: user defined
+    element[23] = 10;                                     // bits per sample
+    put_be16(element + 24, 2);                            // packing: method B
+    put_be16(element + 26, 0);                            // no encoding
+    put_be32(element + 28, (uint32_t)kDpxHeaderBytes);    // offset to data
+
+    put_be32(h + 1920, 0xFFFFFFFFu);                      // no timecode
+    put_be32(h + 1924, 0xFFFFFFFFu);                      // no user bits
+}
+
+// ---------------------------------------------------------------------------
+// Frame output
+// ---------------------------------------------------------------------------
+
+// Writes every byte of iov[0..count), advancing past short writes
+static bool writev_all(int fd, struct iovec* iov, int count, uint64_t* calls)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(fd, iov, count);
+        if (calls)
+            (*calls)++;
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        size_t left = (size_t)n;
+        while (count > 0 && left >= iov->iov_len)
+        {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+int frame_iovecs(PixFmt fmt, const uint8_t* data, size_t width, size_t height,
+                 struct iovec* iov)
+{
+    size_t bytes = pix_fmt_frame_bytes(fmt, width, height);
+    uint8_t* base = const_cast<uint8_t*>(data);
+
+    if (fmt == PixFmt::DPX10)
+        return 0;
+
+    if (fmt == PixFmt::GBRP16LE)
+    {
+        // SDK planes are R,G,B; FFmpeg's gbrp order is G,B,R
+        size_t plane = bytes / 3;
+        iov[0] = { base + plane, plane };
+        iov[1] = { base + 2 * plane, plane };
+        iov[2] = { base, plane };
+        return 3;
+    }
+
+    iov[0] = { base, bytes };
+    return 1;
+}
+
+bool write_frame(int fd, PixFmt fmt, const uint8_t* data, size_t width, size_t height,
+                 uint64_t* calls)
+{
+    if (fmt == PixFmt::DPX10)
+    {
+        uint8_t header[kDpxHeaderBytes];
+        fill_dpx_header(header, (uint32_t)width, (uint32_t)height);
+        struct iovec iov[2] = {
+            { header, sizeof(header) },
+            { const_cast<uint8_t*>(data), pix_fmt_frame_bytes(fmt, width, height) },
+        };
+        return writev_all(fd, iov, 2, calls);
+    }
+
+    struct iovec iov[kMaxFrameIovecs];
+    int count = frame_iovecs(fmt, data, width, height, iov);
+    return writev_all(fd, iov, count, calls);
+}
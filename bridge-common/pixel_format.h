@@ -0,0 +1,58 @@
+// pixel_format: output pixel formats the bridges can put on stdout, named as
+// FFmpeg's rawvideo demuxer knows them, and how a frame of each is written.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class PixFmt
+{
+    RGB24,       // packed 8-bit R,G,B (default)
+    BGR24,       // packed 8-bit B,G,R
+    BGRA,        // packed 8-bit B,G,R,A
+    RGB48LE,     // packed 16-bit R,G,B, little endian
+    GBRP16LE,    // planar 16-bit; the SDKs deliver R,G,B planes
+    DPX10,       // 10-bit RGB in 32-bit DPX method B words, one DPX image per frame
+    YUV420P,     // BT.709 planar 8-bit 4:2:0
+    NV12,        // BT.709 8-bit 4:2:0, Y plane + interleaved U/V plane
+    YUV422P10LE, // BT.709 planar 10-bit 4:2:2 in 16-bit words
+    P010LE,      // BT.709 10-bit 4:2:0 (MSB-aligned), Y plane + interleaved U/V plane
+};
+
+// "rgb24", "bgr24", "bgra", "rgb48le", "gbrp16le", "dpx10", "yuv420p",
+// "nv12", "yuv422p10le", "p010le"
+bool parse_pix_fmt(const char* name, PixFmt& fmt);
+const char* pix_fmt_name(PixFmt fmt);
+
+// Bytes of pixel data in one width x height frame (without any DPX header)
+size_t pix_fmt_frame_bytes(PixFmt fmt, size_t width, size_t height);
+
+// Whether --output-size can resample this format (resizes 8-bit RGB, so
+// 8-bit RGB and 8-bit YUV outputs only)
+bool pix_fmt_resizable(PixFmt fmt);
+
+// YUV formats are converted from the SDK's RGB output by YuvConverter; the
+// 10-bit ones from its 16-bit RGB so no 8-bit intermediate is involved.
+bool pix_fmt_is_yuv(PixFmt fmt);
+uint32_t pix_fmt_bit_depth(PixFmt fmt);
+
+struct iovec;
+
+// Most pieces write_frame() splits a frame into
+constexpr int kMaxFrameIovecs = 3;
+
+// Describes one frame in stdout order as iovecs pointing into `data`, so it
+// can go out with a single writev or vmsplice. Returns the count, or 0 for
+// DPX, whose per-frame header lives outside the frame buffer.
+int frame_iovecs(PixFmt fmt, const uint8_t* data, size_t width, size_t height,
+                 struct iovec* iov);
+
+// Writes one frame to `fd` as FFmpeg expects it, in a single writev where
+// the layout needs several pieces: R,G,B planes go out in G,B,R order for
+// gbrp16le, DPX frames are prefixed with a DPX file header so FFmpeg's
+// image2pipe/dpx decoder reads the packing from it. Short writes and EINTR
+// are retried; returns false on a write error. Adds the writev calls made
+// to `calls` if given.
+bool write_frame(int fd, PixFmt fmt, const uint8_t* data, size_t width, size_t height,
+                 uint64_t* calls = nullptr);
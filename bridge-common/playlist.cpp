@@ -0,0 +1,261 @@
+#include "playlist.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool has_prefix(const std::string& s, const char* prefix, std::string& rest)
+{
+    size_t n = strlen(prefix);
+    if (s.compare(0, n, prefix) != 0)
+        return false;
+    rest = s.substr(n);
+    return true;
+}
+
+bool parse_output_spec(const std::string& spec, OutputSpec& out, std::string& error)
+{
+    out = OutputSpec();
+    std::string rest;
+    if (has_prefix(spec, "fd:", rest))
+    {
+        char* end = nullptr;
+        errno = 0;
+        long fd = strtol(rest.c_str(), &end, 10);
+        if (rest.empty() || errno != 0 || *end != '\0' || fd < 0 || fd > INT_MAX)
+        {
+            error = "Invalid output " + spec + ": fd:N needs a descriptor number";
+            return false;
+        }
+        out.kind = OutputSpec::Kind::Fd;
+        out.fd = (int)fd;
+    }
+    else if (has_prefix(spec, "unix:", rest))
+    {
+        out.kind = OutputSpec::Kind::Socket;
+        out.path = rest;
+    }
+    else if (has_prefix(spec, "encode:", rest))
+    {
+        out.kind = OutputSpec::Kind::Encode;
+        out.path = rest;
+    }
+    else
+    {
+        out.kind = OutputSpec::Kind::File;
+        out.path = spec;
+    }
+
+    if (out.kind != OutputSpec::Kind::Fd && out.path.empty())
+    {
+        error = "Invalid output \"" + spec + "\": no path";
+        return false;
+    }
+    if (out.kind == OutputSpec::Kind::Socket && out.path.size() >= sizeof(sockaddr_un::sun_path))
+    {
+        error = "Invalid output " + spec + ": socket path too long";
+        return false;
+    }
+    return true;
+}
+
+bool open_output(OutputSpec& out, std::string& error)
+{
+    switch (out.kind)
+    {
+    case OutputSpec::Kind::Fd:
+        if (fcntl(out.fd, F_GETFD) < 0)
+        {
+            error = "Output fd:" + std::to_string(out.fd) + " is not open";
+            return false;
+        }
+        return true;
+
+    case OutputSpec::Kind::Encode:
+        return true;
+
+    case OutputSpec::Kind::File:
+        // A FIFO blocks here until its reader opens it
+        out.fd = open(out.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (out.fd < 0)
+        {
+            error = "Cannot open output " + out.path + ": " + strerror(errno);
+            return false;
+        }
+        out.owned = true;
+        return true;
+
+    case OutputSpec::Kind::Socket:
+    {
+        out.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (out.fd < 0)
+        {
+            error = std::string("socket() failed: ") + strerror(errno);
+            return false;
+        }
+        out.owned = true;
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, out.path.c_str(), out.path.size() + 1);
+        if (connect(out.fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            error = "Cannot connect output unix:" + out.path + ": " + strerror(errno);
+            close_output(out);
+            return false;
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+void close_output(OutputSpec& out)
+{
+    if (out.owned && out.fd >= 0)
+    {
+        close(out.fd);
+        out.fd = -1;
+    }
+    out.owned = false;
+}
+
+void split_output_specs(std::vector<std::string>& inputs, size_t first,
+                        std::vector<std::string>& outputs)
+{
+    for (size_t i = first; i < inputs.size(); i++)
+    {
+        size_t tab = inputs[i].find('\t');
+        if (tab == std::string::npos)
+        {
+            outputs.push_back(std::string());
+            continue;
+        }
+        outputs.push_back(inputs[i].substr(tab + 1));
+        inputs[i].resize(tab);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+static bool write_read_back(OutputSpec& out, int read_fd)
+{
+    std::string error;
+    if (!open_output(out, error) || write(out.fd, "frame", 5) != 5)
+        return false;
+    char buf[8] = {};
+    bool ok = read(read_fd, buf, sizeof(buf)) == 5 && memcmp(buf, "frame", 5) == 0;
+    close_output(out);
+    return ok;
+}
+
+bool playlist_self_check(FILE* report)
+{
+    bool ok = true;
+    std::string error;
+    OutputSpec out;
+
+    // Spec syntax
+    ok = ok && parse_output_spec("fd:7", out, error) && out.kind == OutputSpec::Kind::Fd
+         && out.fd == 7;
+    ok = ok && parse_output_spec("encode:/proxies/A001.mov", out, error)
+         && out.kind == OutputSpec::Kind::Encode && out.path == "/proxies/A001.mov";
+    ok = ok && parse_output_spec("unix:/run/x.sock", out, error)
+         && out.kind == OutputSpec::Kind::Socket && out.path == "/run/x.sock";
+    ok = ok && parse_output_spec("/tmp/A001.rgb", out, error) && out.kind == OutputSpec::Kind::File;
+    ok = ok && !parse_output_spec("fd:", out, error) && !parse_output_spec("fd:x1", out, error)
+         && !parse_output_spec("fd:-1", out, error) && !parse_output_spec("", out, error)
+         && !parse_output_spec("encode:", out, error)
+         && !parse_output_spec("unix:" + std::string(200, 's'), out, error);
+
+    // List lines: --input clips keep their --output, list lines split at
+    // the first tab
+    std::vector<std::string> inputs = { "/card/A001.braw", "/card/A002.braw\tfd:3",
+                                        "/card/A 003.braw\tencode:/p/a\tb.mov", "/card/A004.braw" };
+    std::vector<std::string> outputs = { "/p/A001.rgb" };
+    split_output_specs(inputs, 1, outputs);
+    ok = ok && outputs.size() == 4 && outputs[0] == "/p/A001.rgb" && outputs[1] == "fd:3"
+         && inputs[1] == "/card/A002.braw" && inputs[2] == "/card/A 003.braw"
+         && outputs[2] == "encode:/p/a\tb.mov" && outputs[3].empty();
+
+    char dir[] = "/tmp/playlist-XXXXXX";
+    if (!mkdtemp(dir))
+        ok = false;
+    else
+    {
+        // A file, created and truncated
+        std::string file = std::string(dir) + "/clip.rgb";
+        if (FILE* f = fopen(file.c_str(), "w"))
+        {
+            fputs("stale contents", f);
+            fclose(f);
+        }
+        ok = ok && parse_output_spec(file, out, error) && open_output(out, error)
+             && write(out.fd, "frame", 5) == 5;
+        close_output(out);
+        int read_fd = open(file.c_str(), O_RDONLY);
+        if (read_fd >= 0)
+        {
+            char buf[32] = {};
+            ok = ok && read(read_fd, buf, sizeof(buf)) == 5 && memcmp(buf, "frame", 5) == 0;
+            close(read_fd);
+        }
+        else
+            ok = false;
+        unlink(file.c_str());
+
+        // An inherited fd, left open
+        int pipe_fds[2];
+        if (pipe(pipe_fds) == 0)
+        {
+            ok = ok && parse_output_spec("fd:" + std::to_string(pipe_fds[1]), out, error)
+                 && write_read_back(out, pipe_fds[0]) && fcntl(pipe_fds[1], F_GETFD) >= 0;
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            ok = ok && parse_output_spec("fd:" + std::to_string(pipe_fds[1]), out, error)
+                 && !open_output(out, error);
+        }
+        else
+            ok = false;
+
+        // A listening socket
+        std::string sock_path = std::string(dir) + "/out.sock";
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, sock_path.c_str(), sock_path.size() + 1);
+        if (listener >= 0 && bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0
+            && listen(listener, 1) == 0)
+        {
+            ok = ok && parse_output_spec("unix:" + sock_path, out, error) && open_output(out, error)
+                 && write(out.fd, "frame", 5) == 5;
+            close_output(out);
+            int conn = accept(listener, nullptr, nullptr);
+            char buf[8] = {};
+            ok = ok && conn >= 0 && read(conn, buf, sizeof(buf)) == 5 && memcmp(buf, "frame", 5) == 0;
+            if (conn >= 0)
+                close(conn);
+        }
+        else
+            ok = false;
+        if (listener >= 0)
+            close(listener);
+        unlink(sock_path.c_str());
+
+        // Nobody listening
+        ok = ok && parse_output_spec("unix:" + sock_path, out, error) && !open_output(out, error);
+
+        rmdir(dir);
+    }
+
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"playlist\",\"ok\":%s}\n",
+            ok ? "true" : "false");
+    return ok;
+}
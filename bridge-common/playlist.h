@@ -0,0 +1,51 @@
+// playlist: several clips decoded by one bridge process, each into an
+// output of its own.
+//
+// The clips come as repeated --input with one --output each (the Nth
+// output is the Nth clip's), or as --input-list lines "clip<TAB>output".
+// They run side by side on the bridge's one SDK instance through
+// run_each() (see probe_batch.h), up to --max-clips at a time, every line
+// of a clip tagged with its "input". A clip's frames reach its output in
+// order; a failing output fails its clip only.
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Where one clip of a playlist goes:
+//   fd:N          an inherited fd (pipe, socket, file), left open
+//   unix:PATH     a stream socket connected to PATH
+//   encode:PATH   the bridge encodes the proxy to PATH itself (--encode)
+//   PATH          a file or FIFO, opened for writing (a file is truncated)
+struct OutputSpec
+{
+    enum class Kind { File, Fd, Socket, Encode };
+
+    Kind kind = Kind::File;
+    std::string path; // File, Socket, Encode
+    int fd = -1;      // Fd; after open_output() the one to write to
+    bool owned = false;
+};
+
+// Parses `spec`; false with `error` set if it is malformed. Opens nothing.
+bool parse_output_spec(const std::string& spec, OutputSpec& out, std::string& error);
+
+// Opens `out` for writing (an Encode output stays closed: the encoder opens
+// its file). On failure returns false and sets `error`.
+bool open_output(OutputSpec& out, std::string& error);
+
+// Closes what open_output() opened
+void close_output(OutputSpec& out);
+
+// Splits the "clip<TAB>output" lines inputs[first..] into the clip and its
+// output spec, appended to `outputs`; a line without a tab gets an empty
+// spec.
+void split_output_specs(std::vector<std::string>& inputs, size_t first,
+                        std::vector<std::string>& outputs);
+
+// bridge-common-tests: parses and splits specs and writes through a file, an fd
+// and a socket. Prints one {"type":"self_check","check":"playlist"} line;
+// returns false on mismatch.
+bool playlist_self_check(FILE* report);
@@ -0,0 +1,441 @@
+#include "post_process.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "resize.h"
+#include "stripe_pool.h"
+
+// Output rows per tile. Matches the resizer's chunk so scaled tiles cost no
+// extra horizontal passes; a 1080p RGB tile is ~180 KB and stays in L2
+// between the resample and the pack.
+static constexpr size_t kTileRows = 32;
+
+enum class Pack
+{
+    Keep,   // packed 3-byte RGB in source channel order
+    SwapRB, // packed 3-byte RGB, R and B exchanged
+    Yuv,    // YuvConverter
+};
+
+template <RgbSource S>
+static constexpr size_t source_bpp()
+{
+    return S == RgbSource::RGB16 ? 6 : (S == RgbSource::RGBA8 ? 4 : 3);
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+// Factor x Factor area average with the Resizer's rounding (per row first,
+// then across rows), so box2/box4 output is bit-identical to its area filter
+template <size_t Bpp, uint32_t Factor>
+static void box_rows(const uint8_t* src, size_t src_width, uint8_t* dst, size_t dst_width,
+                     size_t row_begin, size_t row_end)
+{
+    constexpr int kShift = Factor == 2 ? 1 : 2;
+    constexpr int32_t kHalf = Factor / 2;
+    const size_t src_stride = src_width * Bpp;
+
+    for (size_t y = row_begin; y < row_end; y++)
+    {
+        const uint8_t* block = src + y * Factor * src_stride;
+        uint8_t* out = dst + (y - row_begin) * dst_width * 3;
+        for (size_t x = 0; x < dst_width; x++)
+        {
+            const uint8_t* p = block + x * Factor * Bpp;
+            for (int c = 0; c < 3; c++)
+            {
+                int32_t sum = 0;
+                for (uint32_t k = 0; k < Factor; k++)
+                {
+                    const uint8_t* row = p + k * src_stride + c;
+                    int32_t h = 0;
+                    for (uint32_t j = 0; j < Factor; j++)
+                        h += row[j * Bpp];
+                    sum += (h + kHalf) >> kShift;
+                }
+                out[x * 3 + c] = (uint8_t)((sum + kHalf) >> kShift);
+            }
+        }
+    }
+}
+
+// Packs `pixels` source pixels into 3-byte RGB. Safe in place for Bpp 3.
+template <size_t Bpp, bool Swap>
+static void pack_rgb(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const uint8_t* s = src + i * Bpp;
+        uint8_t c0 = s[0], c1 = s[1], c2 = s[2];
+        dst[i * 3 + 0] = Swap ? c2 : c0;
+        dst[i * 3 + 1] = c1;
+        dst[i * 3 + 2] = Swap ? c0 : c2;
+    }
+}
+
+static uint8_t* tile_buffer(size_t bytes)
+{
+    static thread_local std::vector<uint8_t> tile;
+    if (tile.size() < bytes)
+        tile.resize(bytes);
+    return tile.data();
+}
+
+struct PostKernels
+{
+    // Output rows [row_begin, row_end) scaled into packed 3-byte rows in
+    // source channel order
+    template <RgbSource In, uint32_t Factor>
+    static void scale_rows(const PostProcessor& pp, const uint8_t* src, uint8_t* out,
+                           size_t row_begin, size_t row_end)
+    {
+        if constexpr (Factor == 0)
+            pp.m_resizer->run_rows(src, out, row_begin, row_end);
+        else
+            box_rows<source_bpp<In>(), Factor>(src, pp.m_src_width, out, pp.m_width, row_begin, row_end);
+    }
+
+    template <RgbSource In, Pack P, uint32_t Factor>
+    static void tile(const PostProcessor& pp, const uint8_t* src, uint8_t* dst,
+                     size_t row_begin, size_t row_end)
+    {
+        const size_t width = pp.m_width;
+        const size_t pixels = (row_end - row_begin) * width;
+
+        if constexpr (P == Pack::Yuv)
+        {
+            const uint32_t per_chroma = pp.m_yuv.rows_per_chroma();
+            const size_t chroma_begin = row_begin / per_chroma;
+            const size_t chroma_end = (row_end + per_chroma - 1) / per_chroma;
+            if constexpr (Factor == 1)
+            {
+                pp.m_yuv.convert_rows(src, 0, dst, chroma_begin, chroma_end);
+            }
+            else
+            {
+                uint8_t* scaled = tile_buffer(pixels * 3);
+                scale_rows<In, Factor>(pp, src, scaled, row_begin, row_end);
+                pp.m_yuv.convert_rows(scaled, row_begin, dst, chroma_begin, chroma_end);
+            }
+        }
+        else
+        {
+            // RGB output needs no tile: rows are scaled straight into the
+            // output and swapped there while still in cache
+            uint8_t* out = dst + row_begin * width * 3;
+            if constexpr (Factor == 1)
+            {
+                const uint8_t* in = src + row_begin * width * source_bpp<In>();
+                if constexpr (In == RgbSource::RGBA8 && P == Pack::Keep)
+                    pp.m_rgba_fn(in, out, pixels);
+                else
+                    pack_rgb<source_bpp<In>(), P == Pack::SwapRB>(in, out, pixels);
+            }
+            else
+            {
+                scale_rows<In, Factor>(pp, src, out, row_begin, row_end);
+                if constexpr (P == Pack::SwapRB)
+                    pack_rgb<3, true>(out, out, pixels);
+            }
+        }
+    }
+
+    template <RgbSource In, Pack P>
+    static PostProcessor::TileFn pick(uint32_t factor)
+    {
+        switch (factor)
+        {
+            case 1:  return tile<In, P, 1>;
+            case 2:  return tile<In, P, 2>;
+            case 4:  return tile<In, P, 4>;
+            default: return tile<In, P, 0>;
+        }
+    }
+
+    template <Pack P>
+    static PostProcessor::TileFn pick(RgbSource source, uint32_t factor)
+    {
+        switch (source)
+        {
+            case RgbSource::RGB8:  return pick<RgbSource::RGB8, P>(factor);
+            case RgbSource::BGR8:  return pick<RgbSource::BGR8, P>(factor);
+            case RgbSource::RGBA8: return pick<RgbSource::RGBA8, P>(factor);
+            // 16-bit frames are never scaled (init rejects a resizer)
+            case RgbSource::RGB16: return tile<RgbSource::RGB16, P, 1>;
+        }
+        return nullptr;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// PostProcessor
+// ---------------------------------------------------------------------------
+
+bool PostProcessor::supports(PixFmt fmt)
+{
+    return fmt == PixFmt::RGB24 || fmt == PixFmt::BGR24 || pix_fmt_is_yuv(fmt);
+}
+
+bool PostProcessor::init(RgbSource source, uint32_t width, uint32_t height, PixFmt fmt,
+                         YuvRange range, const Resizer* resizer, std::string& error,
+                         SimdLevel level)
+{
+    if (!supports(fmt))
+    {
+        error = "PostProcessor: output must be rgb24, bgr24 or YUV";
+        return false;
+    }
+    if (width == 0 || height == 0)
+    {
+        error = "PostProcessor: empty frame size";
+        return false;
+    }
+    bool yuv = pix_fmt_is_yuv(fmt);
+    if (source == RgbSource::RGB16 && (!yuv || resizer))
+    {
+        error = "PostProcessor: 16-bit sources only convert to YUV, unscaled";
+        return false;
+    }
+
+    m_source = source;
+    m_src_width = width;
+    m_src_height = height;
+    m_width = width;
+    m_height = height;
+    m_fmt = fmt;
+    m_factor = 1;
+    m_resizer = resizer;
+
+    if (resizer)
+    {
+        uint32_t bpp = source == RgbSource::RGBA8 ? 4 : 3;
+        if (resizer->src_width() != width || resizer->src_height() != height
+            || resizer->src_bpp() != bpp)
+        {
+            error = "PostProcessor: resizer does not match the source frames";
+            return false;
+        }
+        m_width = resizer->dst_width();
+        m_height = resizer->dst_height();
+        m_factor = 0;
+        if (resizer->filter() == ResizeFilter::Area)
+        {
+            for (uint32_t factor : { 2u, 4u })
+            {
+                if (width == factor * m_width && height == factor * m_height)
+                    m_factor = factor;
+            }
+        }
+    }
+
+    if (yuv)
+    {
+        // Scaled tiles are packed 3-byte rows in source channel order
+        RgbSource packed = m_factor == 1 ? source
+                         : (source == RgbSource::BGR8 ? RgbSource::BGR8 : RgbSource::RGB8);
+        if (!m_yuv.init(packed, m_width, m_height, fmt, range, error, level))
+            return false;
+        m_tile_fn = PostKernels::pick<Pack::Yuv>(source, m_factor);
+    }
+    else
+    {
+        bool source_bgr = source == RgbSource::BGR8;
+        bool swap = source_bgr != (fmt == PixFmt::BGR24);
+        m_tile_fn = swap ? PostKernels::pick<Pack::SwapRB>(source, m_factor)
+                         : PostKernels::pick<Pack::Keep>(source, m_factor);
+    }
+    m_rgba_fn = rgba_to_rgb24_kernel(level);
+    return true;
+}
+
+void PostProcessor::run(const uint8_t* src, uint8_t* dst, StripePool* pool) const
+{
+    const size_t tiles = (m_height + kTileRows - 1) / kTileRows;
+    auto run_tiles = [&](size_t tile_begin, size_t tile_end)
+    {
+        for (size_t t = tile_begin; t < tile_end; t++)
+            m_tile_fn(*this, src, dst, t * kTileRows, std::min<size_t>(m_height, (t + 1) * kTileRows));
+    };
+
+    // The stage is bound by reading the decoded frame, so its size decides
+    if (pool && (size_t)m_src_width * m_src_height >= kStripeMinPixels && tiles >= 2)
+        pool->run(tiles, 1, run_tiles);
+    else
+        run_tiles(0, tiles);
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+// The unfused chain at scalar level: full-frame resize, then swap or YUV
+static bool reference_frame(RgbSource source, uint32_t width, uint32_t height, PixFmt fmt,
+                            YuvRange range, const uint32_t* scale, ResizeFilter filter,
+                            const uint8_t* src, std::vector<uint8_t>& out)
+{
+    std::string error;
+    std::vector<uint8_t> resized;
+    const uint8_t* rgb = src;
+    RgbSource layout = source;
+    uint32_t out_w = width, out_h = height;
+    if (scale)
+    {
+        Resizer resizer;
+        uint32_t bpp = source == RgbSource::RGBA8 ? 4 : 3;
+        if (!resizer.init(width, height, bpp, scale[0], scale[1], filter, error, SimdLevel::Scalar))
+            return false;
+        resized.resize(resizer.dst_bytes());
+        resizer.run(src, resized.data(), nullptr);
+        rgb = resized.data();
+        layout = source == RgbSource::BGR8 ? RgbSource::BGR8 : RgbSource::RGB8;
+        out_w = scale[0];
+        out_h = scale[1];
+    }
+
+    out.assign(pix_fmt_frame_bytes(fmt, out_w, out_h) + 64, 0xA5);
+    if (pix_fmt_is_yuv(fmt))
+    {
+        YuvConverter converter;
+        if (!converter.init(layout, out_w, out_h, fmt, range, error, SimdLevel::Scalar))
+            return false;
+        converter.run(rgb, out.data(), nullptr);
+        return true;
+    }
+
+    size_t bpp = layout == RgbSource::RGBA8 ? 4 : 3;
+    bool swap = (layout == RgbSource::BGR8) != (fmt == PixFmt::BGR24);
+    for (size_t i = 0; i < (size_t)out_w * out_h; i++)
+    {
+        const uint8_t* s = rgb + i * bpp;
+        out[i * 3 + 0] = swap ? s[2] : s[0];
+        out[i * 3 + 1] = s[1];
+        out[i * 3 + 2] = swap ? s[0] : s[2];
+    }
+    return true;
+}
+
+bool post_process_self_check(FILE* report)
+{
+    static const SimdLevel levels[] = {
+        SimdLevel::Scalar, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512,
+    };
+    static const RgbSource sources[] = {
+        RgbSource::RGB8, RgbSource::BGR8, RgbSource::RGBA8, RgbSource::RGB16,
+    };
+    static const PixFmt formats[] = {
+        PixFmt::RGB24, PixFmt::BGR24, PixFmt::YUV420P, PixFmt::NV12,
+        PixFmt::YUV422P10LE, PixFmt::P010LE,
+    };
+    // src w, src h, dst w, dst h (0 = unscaled), filter: every scale path,
+    // odd sizes and more than one tile
+    struct Case { uint32_t size[4]; ResizeFilter filter; };
+    static const Case cases[] = {
+        { {  37,  23,   0,  0 }, ResizeFilter::Area },
+        { { 101,  70,   0,  0 }, ResizeFilter::Area },
+        { {  34,  22,  17, 11 }, ResizeFilter::Area },
+        { { 130,  78,  65, 39 }, ResizeFilter::Area },
+        { {  36,  20,   9,  5 }, ResizeFilter::Area },
+        { { 260, 148,  65, 37 }, ResizeFilter::Area },
+        { {  37,  23,  17, 11 }, ResizeFilter::Area },
+        { { 101,  90,  47, 67 }, ResizeFilter::Lanczos },
+        { {  96,  54,  31, 54 }, ResizeFilter::Bilinear },
+    };
+
+    SimdLevel best = detect_simd_level();
+    bool all_ok = true;
+
+    std::vector<uint8_t> src(260 * 148 * 6 + 64);
+    uint32_t state = 0x9E3779B9u;
+    for (auto& b : src)
+    {
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        b = (uint8_t)state;
+    }
+
+    for (SimdLevel level : levels)
+    {
+        if ((int)level > (int)best)
+            break;
+
+        bool ok = true;
+        std::string error;
+
+        for (const Case& c : cases)
+        {
+            const uint32_t* scale = c.size[2] ? &c.size[2] : nullptr;
+            for (RgbSource source : sources)
+            {
+                for (PixFmt fmt : formats)
+                {
+                    Resizer resizer;
+                    if (scale)
+                    {
+                        uint32_t bpp = source == RgbSource::RGBA8 ? 4 : 3;
+                        resizer.init(c.size[0], c.size[1], bpp, scale[0], scale[1], c.filter,
+                                     error, level);
+                    }
+                    PostProcessor candidate;
+                    if (!candidate.init(source, c.size[0], c.size[1], fmt, YuvRange::Limited,
+                                        scale ? &resizer : nullptr, error, level))
+                        continue; // 16-bit to RGB or scaled
+
+                    std::vector<uint8_t> expect;
+                    if (!reference_frame(source, c.size[0], c.size[1], fmt, YuvRange::Limited,
+                                         scale, c.filter, src.data(), expect))
+                    {
+                        ok = false;
+                        continue;
+                    }
+
+                    // Guard bytes after the output catch over-writes
+                    std::vector<uint8_t> got(candidate.dst_bytes() + 64, 0xA5);
+                    candidate.run(src.data(), got.data(), nullptr);
+                    if (expect != got)
+                        ok = false;
+
+                    // Unscaled 3-byte RGB also runs in place
+                    if (!scale && !pix_fmt_is_yuv(fmt) && source != RgbSource::RGBA8)
+                    {
+                        std::vector<uint8_t> frame(src.begin(), src.begin() + candidate.dst_bytes());
+                        candidate.run(frame.data(), frame.data(), nullptr);
+                        if (!std::equal(frame.begin(), frame.end(), expect.begin()))
+                            ok = false;
+                    }
+                }
+            }
+        }
+
+        // Throughput: half-res 6K-ish decode to 1080p yuv420p, single thread
+        static constexpr uint32_t kBenchSrcW = 2880, kBenchSrcH = 1620;
+        static constexpr uint32_t kBenchDstW = 1920, kBenchDstH = 1080;
+        std::vector<uint8_t> bench_src((size_t)kBenchSrcW * kBenchSrcH * 4, 0x40);
+        Resizer bench_resizer;
+        bench_resizer.init(kBenchSrcW, kBenchSrcH, 4, kBenchDstW, kBenchDstH,
+                           ResizeFilter::Lanczos, error, level);
+        PostProcessor bench;
+        bench.init(RgbSource::RGBA8, kBenchSrcW, kBenchSrcH, PixFmt::YUV420P, YuvRange::Limited,
+                   &bench_resizer, error, level);
+        std::vector<uint8_t> bench_dst(bench.dst_bytes());
+        static constexpr int kIterations = 5;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int it = 0; it < kIterations; it++)
+            bench.run(bench_src.data(), bench_dst.data(), nullptr);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        double mpix_per_s = secs > 0
+            ? ((double)kBenchDstW * kBenchDstH * kIterations) / secs / 1e6 : 0.0;
+
+        fprintf(report,
+            "{\"type\":\"self_check\",\"kernel\":\"post_process\",\"isa\":\"%s\","
+            "\"ok\":%s,\"mpix_per_s\":%.1f}\n",
+            simd_level_name(level), ok ? "true" : "false", mpix_per_s);
+
+        all_ok = all_ok && ok;
+    }
+
+    return all_ok;
+}
@@ -0,0 +1,76 @@
+// post_process: the bridges' fused post-decode stage. Channel reorder,
+// resize and RGB → YUV conversion / packing run in one pass over tiles of
+// output rows: each tile is resampled into a per-thread buffer small enough
+// to stay in L2 and packed into the output frame right away, so a decoded
+// frame is read once and the output written once instead of every step
+// crossing memory on its own.
+//
+// The tile kernels are instantiated at compile time per source layout,
+// output layout and scale: exact 2:1 and 4:1 area reductions use fixed box
+// kernels (bit-identical to the Resizer's area filter), other ratios the
+// Resizer's rows, unscaled frames go straight to the packer.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "cpu_features.h"
+#include "pixel_convert.h"
+#include "pixel_format.h"
+#include "yuv_convert.h"
+
+class Resizer;
+class StripePool;
+
+class PostProcessor
+{
+public:
+    // Frames arrive width x height in `source` layout and leave as `fmt`
+    // (rgb24, bgr24 or a YUV format; `range` applies to YUV). With `resizer`
+    // (8-bit sources only, must outlive this) the output has its size.
+    bool init(RgbSource source, uint32_t width, uint32_t height, PixFmt fmt, YuvRange range,
+              const Resizer* resizer, std::string& error, SimdLevel level = detect_simd_level());
+
+    // Whether `fmt` is an output this stage produces
+    static bool supports(PixFmt fmt);
+
+    uint32_t src_width() const { return m_src_width; }
+    uint32_t src_height() const { return m_src_height; }
+    uint32_t dst_width() const { return m_width; }
+    uint32_t dst_height() const { return m_height; }
+    size_t dst_bytes() const { return pix_fmt_frame_bytes(m_fmt, m_width, m_height); }
+
+    // Processes one tightly packed frame. Tile stripes run on `pool` (may be
+    // null). Several threads may call this concurrently; tiles are per thread.
+    // For unscaled rgb24/bgr24 from a 3-byte source, src may equal dst.
+    void run(const uint8_t* src, uint8_t* dst, StripePool* pool) const;
+
+    // Output rows [row_begin, row_end) of one frame
+    using TileFn = void (*)(const PostProcessor& pp, const uint8_t* src, uint8_t* dst,
+                            size_t row_begin, size_t row_end);
+
+private:
+    friend struct PostKernels;
+
+    RgbSource m_source = RgbSource::RGB8;
+    uint32_t m_src_width = 0;
+    uint32_t m_src_height = 0;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    PixFmt m_fmt = PixFmt::RGB24;
+    uint32_t m_factor = 1; // 1 unscaled, 2/4 box, 0 any other ratio
+    const Resizer* m_resizer = nullptr;
+    YuvConverter m_yuv;
+    RgbaToRgbFn m_rgba_fn = nullptr;
+    TileFn m_tile_fn = nullptr;
+};
+
+// Compares the fused stage at every SIMD level this CPU supports against the
+// unfused scalar chain (Resizer, then channel swap or YuvConverter) for all
+// sources, outputs and scale paths over odd sizes. Writes one NDJSON line per
+// ISA (with throughput for a 2880x1620 RGBA → 1920x1080 yuv420p Lanczos
+// frame) to `report` and returns true if all match.
+bool post_process_self_check(FILE* report);
@@ -0,0 +1,148 @@
+#include "probe_batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <unistd.h>
+
+#include "report.h"
+
+static void read_lines(FILE* file, std::vector<std::string>& inputs)
+{
+    std::string line;
+    int c;
+    while ((c = fgetc(file)) != EOF)
+    {
+        if (c != '\n')
+        {
+            line += (char)c;
+            continue;
+        }
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            inputs.push_back(line);
+        line.clear();
+    }
+    if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+    if (!line.empty())
+        inputs.push_back(line);
+}
+
+bool load_input_list(const std::string& path, int list_fd, std::vector<std::string>& inputs,
+                     std::string& error)
+{
+    FILE* file = nullptr;
+    if (path == "-")
+    {
+        int fd = list_fd >= 0 ? dup(list_fd) : -1;
+        file = fd >= 0 ? fdopen(fd, "r") : nullptr;
+        if (!file && fd >= 0)
+            close(fd);
+    }
+    else
+    {
+        file = fopen(path.c_str(), "r");
+    }
+    if (!file)
+    {
+        error = "Cannot read --input-list " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    read_lines(file, inputs);
+    bool ok = !ferror(file);
+    fclose(file);
+    if (!ok)
+        error = "Reading --input-list " + path + " failed";
+    return ok;
+}
+
+size_t run_each(const std::vector<std::string>& inputs, unsigned threads,
+                const std::function<bool(size_t index)>& run)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = (unsigned)std::min<size_t>(threads, inputs.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{0};
+    // The report stream is the caller's (a --serve connection, say)
+    FILE* report = report_stream();
+    auto worker = [&]()
+    {
+        ReportScope scope(report);
+        for (size_t i; (i = next.fetch_add(1)) < inputs.size(); )
+        {
+            ReportInputScope input(inputs[i].c_str());
+            if (!run(i))
+                failed.fetch_add(1);
+            fflush(report);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; t++)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& t : workers)
+        t.join();
+    return failed.load();
+}
+
+size_t probe_each(const std::vector<std::string>& inputs, unsigned threads,
+                  const std::function<bool(const std::string& input)>& probe)
+{
+    return run_each(inputs, threads, [&](size_t i) { return probe(inputs[i]); });
+}
+
+bool probe_batch_self_check(FILE* report)
+{
+    bool ok = true;
+
+    // List parsing: blank lines and CRLF endings, no trailing newline
+    const char list[] = "/card/A001.braw\n\n/card/A002.braw\r\n/card/A 003.braw";
+    FILE* file = tmpfile();
+    std::vector<std::string> inputs;
+    std::string error;
+    if (!file || fwrite(list, 1, sizeof(list) - 1, file) != sizeof(list) - 1)
+    {
+        ok = false;
+    }
+    else
+    {
+        rewind(file);
+        ok = load_input_list("-", fileno(file), inputs, error)
+             && inputs.size() == 3 && inputs[1] == "/card/A002.braw"
+             && inputs[2] == "/card/A 003.braw";
+    }
+    if (file)
+        fclose(file);
+
+    // Every input probed once, on its own tag, failures counted
+    for (int i = 0; i < 40; i++)
+        inputs.push_back("/card/B" + std::to_string(i) + ".braw");
+    std::mutex mutex;
+    std::vector<std::string> seen;
+    size_t failed = probe_each(inputs, 4, [&](const std::string& input)
+    {
+        bool tagged = report_input() && input == report_input();
+        std::lock_guard<std::mutex> lock(mutex);
+        seen.push_back(tagged ? input : std::string());
+        return input.find("B1") == std::string::npos;
+    });
+    std::vector<std::string> expected = inputs;
+    std::sort(seen.begin(), seen.end());
+    std::sort(expected.begin(), expected.end());
+    // B1 and B10..B19 fail
+    ok = ok && seen == expected && failed == 11 && !report_input();
+
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"probe_batch\",\"ok\":%s}\n",
+            ok ? "true" : "false");
+    return ok;
+}
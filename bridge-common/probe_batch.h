@@ -0,0 +1,37 @@
+// probe_batch: --probe-only over many clips at once, e.g. a whole camera
+// card. The clips come as repeated --input, or one path per line from
+// --input-list (a file, or "-": stdin, or in a --serve request the fd sent
+// with it). Workers open them side by side on the bridge's one SDK
+// instance, and each clip's metadata (or error) line goes out as soon as
+// that clip is done, tagged with its "input" (see report.h). Lines arrive
+// in completion order, not list order.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Appends the paths listed in `path`, one per line (blank lines and a
+// trailing '\r' skipped); "-" reads `list_fd` instead, which stays open.
+// On failure returns false and sets `error`.
+bool load_input_list(const std::string& path, int list_fd, std::vector<std::string>& inputs,
+                     std::string& error);
+
+// Runs `run(i)` for every index of `inputs` on up to `threads` workers
+// (0 = one per core), each call with inputs[i] as report_input(). Returns
+// the number of calls that returned false. A playlist decodes its clips
+// through this too (see playlist.h).
+size_t run_each(const std::vector<std::string>& inputs, unsigned threads,
+                const std::function<bool(size_t index)>& run);
+
+// run_each() with the input itself
+size_t probe_each(const std::vector<std::string>& inputs, unsigned threads,
+                  const std::function<bool(const std::string& input)>& probe);
+
+// bridge-common-tests: reads a list and probes it on several workers. Prints one
+// {"type":"self_check","check":"probe_batch"} line; returns false on
+// mismatch.
+bool probe_batch_self_check(FILE* report);
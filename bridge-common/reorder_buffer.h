@@ -0,0 +1,88 @@
+// ReorderBuffer: hands frames that complete out of order on decoder threads
+// (SDK callbacks or our own workers) to the main thread strictly in frame
+// order.
+//
+// Frame i always lands in slot i % N. The main thread never submits frame i
+// before frame i - N has been written, so a slot has exactly one producer at a
+// time. Each slot carries its own mutex/condvar, so decoder threads working on
+// different frames never contend with each other; they only meet the main
+// thread on the slot it is currently waiting for.
+//
+// The slots do not own pixel memory: the producer checks a buffer out of the
+// FramePool, publishes it here, and the main thread gives it back after the
+// write.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class ReorderBuffer
+{
+public:
+    explicit ReorderBuffer(uint32_t slot_count)
+        : m_slots(slot_count)
+    {
+        for (auto& slot : m_slots)
+            slot.reset(new Slot());
+    }
+
+    uint32_t slot_count() const { return (uint32_t)m_slots.size(); }
+
+    // Producer side (decoder thread). `data` == nullptr marks the frame
+    // as failed.
+    void publish(uint64_t frame_idx, uint8_t* data, size_t bytes)
+    {
+        Slot& slot = slot_for(frame_idx);
+        {
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            slot.ready = true;
+            slot.data = data;
+            slot.bytes = bytes;
+        }
+        slot.cv.notify_one();
+    }
+
+    // Consumer side (main thread). Blocks until the frame has been published
+    // and returns whether it completed successfully.
+    bool wait(uint64_t frame_idx, uint8_t*& data, size_t& bytes)
+    {
+        Slot& slot = slot_for(frame_idx);
+        std::unique_lock<std::mutex> lock(slot.mutex);
+        slot.cv.wait(lock, [&slot]{ return slot.ready; });
+        data = slot.data;
+        bytes = slot.bytes;
+        return data != nullptr;
+    }
+
+    // Hand the slot back so frame_idx + N may be submitted.
+    void release(uint64_t frame_idx)
+    {
+        Slot& slot = slot_for(frame_idx);
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        slot.ready = false;
+        slot.data = nullptr;
+        slot.bytes = 0;
+    }
+
+private:
+    struct Slot
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool ready = false;
+        uint8_t* data = nullptr;
+        size_t bytes = 0;
+    };
+
+    Slot& slot_for(uint64_t frame_idx)
+    {
+        return *m_slots[frame_idx % m_slots.size()];
+    }
+
+    std::vector<std::unique_ptr<Slot>> m_slots;
+};
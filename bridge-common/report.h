@@ -0,0 +1,77 @@
+// report: where a thread's NDJSON lines (metadata, progress, errors) go.
+//
+// A bridge run from the command line reports on stderr. With --serve every
+// request reports on its own connection instead: the request thread opens
+// a ReportScope for it, and so do the SDK callback threads while they work
+// on that request's frames, so the bridges' json_* helpers only ever ask
+// report_stream(). Workers of a batch --probe-only also tag their lines
+// with the clip they are on (report_input()).
+
+#pragma once
+
+#include <cstdio>
+
+inline FILE*& report_stream_override()
+{
+    static thread_local FILE* stream = nullptr;
+    return stream;
+}
+
+// The calling thread's report stream: stderr unless a ReportScope is open
+inline FILE* report_stream()
+{
+    FILE* stream = report_stream_override();
+    return stream ? stream : stderr;
+}
+
+// Sends the calling thread's reports to `stream` until it goes out of scope
+class ReportScope
+{
+public:
+    explicit ReportScope(FILE* stream)
+        : m_previous(report_stream_override())
+    {
+        report_stream_override() = stream;
+    }
+
+    ~ReportScope() { report_stream_override() = m_previous; }
+
+    ReportScope(const ReportScope&) = delete;
+    ReportScope& operator=(const ReportScope&) = delete;
+
+private:
+    FILE* m_previous;
+};
+
+inline const char*& report_input_override()
+{
+    static thread_local const char* input = nullptr;
+    return input;
+}
+
+// The clip the calling thread reports on in a batch --probe-only, carried
+// in its lines as "input" so the reader can tell the clips apart; nullptr
+// for a single clip
+inline const char* report_input()
+{
+    return report_input_override();
+}
+
+// Tags the calling thread's reports with `input` until it goes out of scope
+class ReportInputScope
+{
+public:
+    explicit ReportInputScope(const char* input)
+        : m_previous(report_input_override())
+    {
+        report_input_override() = input;
+    }
+
+    ~ReportInputScope() { report_input_override() = m_previous; }
+
+    ReportInputScope(const ReportInputScope&) = delete;
+    ReportInputScope& operator=(const ReportInputScope&) = delete;
+
+private:
+    const char* m_previous;
+};
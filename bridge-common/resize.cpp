@@ -0,0 +1,547 @@
+#include "resize.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "stripe_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BRIDGE_X86 1
+#endif
+
+// Weights are scaled by 2^kWeightBits; results are rounded, then shifted back
+static constexpr int kWeightBits = 14;
+static constexpr int32_t kRound = 1 << (kWeightBits - 1);
+
+// Output rows resampled per scratch fill; bounds scratch to a few hundred KB
+// per thread and keeps the horizontal rows cache-resident for the vertical pass
+static constexpr size_t kChunkRows = 32;
+
+static inline uint8_t clamp_u8(int32_t v)
+{
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// ---------------------------------------------------------------------------
+// Option parsing
+// ---------------------------------------------------------------------------
+
+bool parse_resize_filter(const char* name, ResizeFilter& filter)
+{
+    if (strcmp(name, "area") == 0)
+        filter = ResizeFilter::Area;
+    else if (strcmp(name, "bilinear") == 0)
+        filter = ResizeFilter::Bilinear;
+    else if (strcmp(name, "lanczos") == 0)
+        filter = ResizeFilter::Lanczos;
+    else
+        return false;
+    return true;
+}
+
+const char* resize_filter_name(ResizeFilter filter)
+{
+    switch (filter)
+    {
+        case ResizeFilter::Area:     return "area";
+        case ResizeFilter::Bilinear: return "bilinear";
+        case ResizeFilter::Lanczos:  return "lanczos";
+    }
+    return "unknown";
+}
+
+static bool parse_dimension(const char* begin, const char* end, int32_t& value)
+{
+    if (begin == end)
+        return false;
+    char* parse_end = nullptr;
+    long v = strtol(begin, &parse_end, 10);
+    if (parse_end != end)
+        return false;
+    if (v != -1 && v != -2 && (v < 1 || v > 32768))
+        return false;
+    value = (int32_t)v;
+    return true;
+}
+
+bool parse_output_size(const char* text, int32_t& width, int32_t& height)
+{
+    const char* sep = strchr(text, 'x');
+    if (!sep)
+        return false;
+    if (!parse_dimension(text, sep, width) || !parse_dimension(sep + 1, sep + strlen(sep), height))
+        return false;
+    // Only one side may be derived from the other
+    return width > 0 || height > 0;
+}
+
+void resolve_output_size(int32_t& width, int32_t& height,
+                         uint32_t src_width, uint32_t src_height, double pixel_aspect)
+{
+    if (src_width == 0 || src_height == 0)
+        return;
+    double display_aspect = (double)src_width * pixel_aspect / src_height;
+
+    auto derive = [](double exact, int32_t mode) -> int32_t
+    {
+        int32_t v = mode == -2 ? 2 * (int32_t)lround(exact / 2) : (int32_t)lround(exact);
+        return std::max<int32_t>(mode == -2 ? 2 : 1, v);
+    };
+
+    if (width < 0)
+        width = derive(height * display_aspect, width);
+    else if (height < 0)
+        height = derive(width / display_aspect, height);
+}
+
+// ---------------------------------------------------------------------------
+// Coefficients
+// ---------------------------------------------------------------------------
+
+static double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+// Builds per-output-pixel weights for one axis. Source pixels outside the
+// image are dropped and the remaining weights renormalised. Every window is
+// `taps` wide and starts inside the image, so kernels never branch on edges.
+static void build_axis(uint32_t src_size, uint32_t dst_size, ResizeFilter filter,
+                       Resizer::Axis& axis)
+{
+    double scale = (double)src_size / dst_size;
+    double filter_scale = std::max(scale, 1.0);
+
+    // Half-width of the filter footprint in source pixels
+    double support = 0.0;
+    switch (filter)
+    {
+        case ResizeFilter::Area:     support = 0.5 * scale;        break;
+        case ResizeFilter::Bilinear: support = 1.0 * filter_scale; break;
+        case ResizeFilter::Lanczos:  support = 3.0 * filter_scale; break;
+    }
+
+    uint32_t taps = std::min<uint32_t>(src_size, (uint32_t)ceil(2.0 * support) + 1);
+    axis.taps = taps;
+    axis.start.resize(dst_size);
+    axis.weights.assign((size_t)dst_size * taps, 0);
+
+    std::vector<double> w(taps);
+    for (uint32_t i = 0; i < dst_size; i++)
+    {
+        double center = (i + 0.5) * scale;
+        int32_t first = (int32_t)floor(center - support);
+        int32_t start = std::max<int32_t>(0, std::min<int32_t>(first, (int32_t)(src_size - taps)));
+        axis.start[i] = start;
+
+        double sum = 0.0;
+        for (uint32_t k = 0; k < taps; k++)
+        {
+            double x = start + k; // left edge of the source pixel
+            double v = 0.0;
+            if (filter == ResizeFilter::Area)
+            {
+                // Overlap of [x, x+1) with the output pixel's footprint
+                v = std::min(x + 1.0, center + support) - std::max(x, center - support);
+                v = std::max(v, 0.0);
+            }
+            else
+            {
+                double d = fabs((x + 0.5 - center) / filter_scale);
+                if (filter == ResizeFilter::Bilinear)
+                    v = std::max(0.0, 1.0 - d);
+                else if (d < 3.0)
+                    v = sinc(d) * sinc(d / 3.0);
+            }
+            w[k] = v;
+            sum += v;
+        }
+
+        // Quantise so the weights sum to exactly 1.0: flat areas stay flat
+        int16_t* out = &axis.weights[(size_t)i * taps];
+        int32_t total = 0;
+        uint32_t largest = 0;
+        for (uint32_t k = 0; k < taps; k++)
+        {
+            out[k] = (int16_t)lround(sum != 0.0 ? w[k] / sum * (1 << kWeightBits) : 0.0);
+            total += out[k];
+            if (out[k] > out[largest])
+                largest = k;
+        }
+        out[largest] = (int16_t)(out[largest] + ((1 << kWeightBits) - total));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+template <int Bpp>
+static void horizontal_scalar(const uint8_t* src, uint8_t* dst, const Resizer::Axis& axis)
+{
+    const uint32_t taps = axis.taps;
+    for (size_t x = 0; x < axis.start.size(); x++)
+    {
+        const uint8_t* s = src + (size_t)axis.start[x] * Bpp;
+        const int16_t* w = &axis.weights[x * taps];
+        int32_t r = kRound, g = kRound, b = kRound;
+        for (uint32_t k = 0; k < taps; k++)
+        {
+            r += w[k] * s[0];
+            g += w[k] * s[1];
+            b += w[k] * s[2];
+            s += Bpp;
+        }
+        dst[0] = clamp_u8(r >> kWeightBits);
+        dst[1] = clamp_u8(g >> kWeightBits);
+        dst[2] = clamp_u8(b >> kWeightBits);
+        dst += 3;
+    }
+}
+
+// Output bytes [begin, end); SIMD kernels finish their row tails with this
+static void vertical_scalar_range(const uint8_t* const* rows, const int16_t* weights,
+                                  uint32_t taps, uint8_t* dst, size_t begin, size_t end)
+{
+    for (size_t j = begin; j < end; j++)
+    {
+        int32_t acc = kRound;
+        for (uint32_t k = 0; k < taps; k++)
+            acc += weights[k] * rows[k][j];
+        dst[j] = clamp_u8(acc >> kWeightBits);
+    }
+}
+
+static void vertical_scalar(const uint8_t* const* rows, const int16_t* weights,
+                            uint32_t taps, uint8_t* dst, size_t bytes)
+{
+    vertical_scalar_range(rows, weights, taps, dst, 0, bytes);
+}
+
+#ifdef BRIDGE_X86
+
+// Two 16-bit weights in one 32-bit lane, as _mm_madd_epi16 pairs them
+static inline int32_t weight_pair(int16_t w0, int16_t w1)
+{
+    return (int32_t)(((uint32_t)(uint16_t)w1 << 16) | (uint16_t)w0);
+}
+
+// One source pixel in the low lane bytes. RGB reads exactly 3 bytes so the
+// last pixel of a frame never reads past the buffer.
+template <int Bpp>
+__attribute__((target("ssse3")))
+static inline __m128i load_pixel(const uint8_t* p)
+{
+    uint32_t v;
+    if (Bpp == 4)
+        memcpy(&v, p, 4);
+    else
+        v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return _mm_cvtsi32_si128((int)v);
+}
+
+// Two taps per step: bytes of neighbouring pixels are interleaved so one
+// madd yields the R, G, B (and ignored 4th) partial sums.
+template <int Bpp>
+__attribute__((target("ssse3")))
+static void horizontal_ssse3(const uint8_t* src, uint8_t* dst, const Resizer::Axis& axis)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const uint32_t taps = axis.taps;
+
+    for (size_t x = 0; x < axis.start.size(); x++)
+    {
+        const uint8_t* s = src + (size_t)axis.start[x] * Bpp;
+        const int16_t* w = &axis.weights[x * taps];
+        __m128i acc = _mm_set1_epi32(kRound);
+
+        uint32_t k = 0;
+        for (; k + 2 <= taps; k += 2)
+        {
+            __m128i p = _mm_unpacklo_epi8(load_pixel<Bpp>(s), load_pixel<Bpp>(s + Bpp));
+            p = _mm_unpacklo_epi8(p, zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(weight_pair(w[k], w[k + 1]))));
+            s += 2 * Bpp;
+        }
+        if (k < taps)
+        {
+            __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(load_pixel<Bpp>(s), zero), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(weight_pair(w[k], 0))));
+        }
+
+        acc = _mm_srai_epi32(acc, kWeightBits);
+        acc = _mm_packus_epi16(_mm_packs_epi32(acc, acc), acc);
+        uint32_t rgbx = (uint32_t)_mm_cvtsi128_si32(acc);
+        memcpy(dst, &rgbx, 3);
+        dst += 3;
+    }
+}
+
+// 16 output bytes per step, two source rows per madd
+__attribute__((target("ssse3")))
+static void vertical_ssse3(const uint8_t* const* rows, const int16_t* weights,
+                           uint32_t taps, uint8_t* dst, size_t bytes)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t j = 0;
+
+    for (; j + 16 <= bytes; j += 16)
+    {
+        __m128i a0 = _mm_set1_epi32(kRound), a1 = a0, a2 = a0, a3 = a0;
+        for (uint32_t k = 0; k < taps; k += 2)
+        {
+            bool pair = k + 1 < taps;
+            __m128i r0 = _mm_loadu_si128((const __m128i*)(rows[k] + j));
+            __m128i r1 = pair ? _mm_loadu_si128((const __m128i*)(rows[k + 1] + j)) : zero;
+            __m128i wp = _mm_set1_epi32(weight_pair(weights[k], pair ? weights[k + 1] : 0));
+
+            __m128i lo = _mm_unpacklo_epi8(r0, r1);
+            __m128i hi = _mm_unpackhi_epi8(r0, r1);
+            a0 = _mm_add_epi32(a0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wp));
+            a1 = _mm_add_epi32(a1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wp));
+            a2 = _mm_add_epi32(a2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wp));
+            a3 = _mm_add_epi32(a3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wp));
+        }
+        __m128i p01 = _mm_packs_epi32(_mm_srai_epi32(a0, kWeightBits), _mm_srai_epi32(a1, kWeightBits));
+        __m128i p23 = _mm_packs_epi32(_mm_srai_epi32(a2, kWeightBits), _mm_srai_epi32(a3, kWeightBits));
+        _mm_storeu_si128((__m128i*)(dst + j), _mm_packus_epi16(p01, p23));
+    }
+
+    vertical_scalar_range(rows, weights, taps, dst, j, bytes);
+}
+
+// Same as the SSSE3 kernel on 32 bytes. Unpack and pack both work per
+// 128-bit lane, so the output order comes out right without a permute.
+__attribute__((target("avx2")))
+static void vertical_avx2(const uint8_t* const* rows, const int16_t* weights,
+                          uint32_t taps, uint8_t* dst, size_t bytes)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t j = 0;
+
+    for (; j + 32 <= bytes; j += 32)
+    {
+        __m256i a0 = _mm256_set1_epi32(kRound), a1 = a0, a2 = a0, a3 = a0;
+        for (uint32_t k = 0; k < taps; k += 2)
+        {
+            bool pair = k + 1 < taps;
+            __m256i r0 = _mm256_loadu_si256((const __m256i*)(rows[k] + j));
+            __m256i r1 = pair ? _mm256_loadu_si256((const __m256i*)(rows[k + 1] + j)) : zero;
+            __m256i wp = _mm256_set1_epi32(weight_pair(weights[k], pair ? weights[k + 1] : 0));
+
+            __m256i lo = _mm256_unpacklo_epi8(r0, r1);
+            __m256i hi = _mm256_unpackhi_epi8(r0, r1);
+            a0 = _mm256_add_epi32(a0, _mm256_madd_epi16(_mm256_unpacklo_epi8(lo, zero), wp));
+            a1 = _mm256_add_epi32(a1, _mm256_madd_epi16(_mm256_unpackhi_epi8(lo, zero), wp));
+            a2 = _mm256_add_epi32(a2, _mm256_madd_epi16(_mm256_unpacklo_epi8(hi, zero), wp));
+            a3 = _mm256_add_epi32(a3, _mm256_madd_epi16(_mm256_unpackhi_epi8(hi, zero), wp));
+        }
+        __m256i p01 = _mm256_packs_epi32(_mm256_srai_epi32(a0, kWeightBits), _mm256_srai_epi32(a1, kWeightBits));
+        __m256i p23 = _mm256_packs_epi32(_mm256_srai_epi32(a2, kWeightBits), _mm256_srai_epi32(a3, kWeightBits));
+        _mm256_storeu_si256((__m256i*)(dst + j), _mm256_packus_epi16(p01, p23));
+    }
+
+    vertical_scalar_range(rows, weights, taps, dst, j, bytes);
+}
+
+#endif // BRIDGE_X86
+
+struct ResizeKernels
+{
+    Resizer::HorizontalFn horizontal_rgb;
+    Resizer::HorizontalFn horizontal_rgbx;
+    Resizer::VerticalFn vertical;
+};
+
+static ResizeKernels resize_kernels(SimdLevel level)
+{
+#ifdef BRIDGE_X86
+    switch (level)
+    {
+        case SimdLevel::AVX512:
+        case SimdLevel::AVX2:
+            return { horizontal_ssse3<3>, horizontal_ssse3<4>, vertical_avx2 };
+        case SimdLevel::SSSE3:
+            return { horizontal_ssse3<3>, horizontal_ssse3<4>, vertical_ssse3 };
+        default: break;
+    }
+#else
+    (void)level;
+#endif
+    return { horizontal_scalar<3>, horizontal_scalar<4>, vertical_scalar };
+}
+
+// ---------------------------------------------------------------------------
+// Resizer
+// ---------------------------------------------------------------------------
+
+bool Resizer::init(uint32_t src_width, uint32_t src_height, uint32_t src_bpp,
+                   uint32_t dst_width, uint32_t dst_height, ResizeFilter filter,
+                   std::string& error, SimdLevel level)
+{
+    if (src_width == 0 || src_height == 0 || dst_width == 0 || dst_height == 0)
+    {
+        error = "Resizer: empty source or output size";
+        return false;
+    }
+    if (src_bpp != 3 && src_bpp != 4)
+    {
+        error = "Resizer: source must have 3 or 4 bytes per pixel";
+        return false;
+    }
+
+    m_src_width = src_width;
+    m_src_height = src_height;
+    m_src_bpp = src_bpp;
+    m_dst_width = dst_width;
+    m_dst_height = dst_height;
+    m_filter = filter;
+    build_axis(src_width, dst_width, filter, m_horizontal);
+    build_axis(src_height, dst_height, filter, m_vertical);
+
+    ResizeKernels kernels = resize_kernels(level);
+    m_horizontal_fn = src_bpp == 4 ? kernels.horizontal_rgbx : kernels.horizontal_rgb;
+    m_vertical_fn = kernels.vertical;
+    return true;
+}
+
+void Resizer::run_rows(const uint8_t* src, uint8_t* dst, size_t row_begin, size_t row_end) const
+{
+    const size_t src_stride = (size_t)m_src_width * m_src_bpp;
+    const size_t row_bytes = (size_t)m_dst_width * 3;
+    const uint32_t taps = m_vertical.taps;
+
+    // Horizontally resampled source rows for the current chunk
+    static thread_local std::vector<uint8_t> scratch;
+    static thread_local std::vector<const uint8_t*> rows;
+    rows.resize(taps);
+
+    for (size_t chunk = row_begin; chunk < row_end; chunk += kChunkRows)
+    {
+        size_t chunk_end = std::min(row_end, chunk + kChunkRows);
+        size_t first = (size_t)m_vertical.start[chunk];
+        size_t last = (size_t)m_vertical.start[chunk_end - 1] + taps;
+
+        if (scratch.size() < (last - first) * row_bytes)
+            scratch.resize((last - first) * row_bytes);
+
+        for (size_t y = first; y < last; y++)
+            m_horizontal_fn(src + y * src_stride, scratch.data() + (y - first) * row_bytes,
+                            m_horizontal);
+
+        for (size_t y = chunk; y < chunk_end; y++)
+        {
+            const uint8_t* base = scratch.data() + (m_vertical.start[y] - first) * row_bytes;
+            for (uint32_t k = 0; k < taps; k++)
+                rows[k] = base + k * row_bytes;
+            m_vertical_fn(rows.data(), &m_vertical.weights[y * taps], taps,
+                          dst + (y - row_begin) * row_bytes, row_bytes);
+        }
+    }
+}
+
+void Resizer::run(const uint8_t* src, uint8_t* dst, StripePool* pool) const
+{
+    const size_t row_bytes = (size_t)m_dst_width * 3;
+    auto resize_rows = [&](size_t row_begin, size_t row_end)
+    {
+        run_rows(src, dst + row_begin * row_bytes, row_begin, row_end);
+    };
+
+    if (pool && m_dst_height >= 2 * kChunkRows)
+        pool->run(m_dst_height, kChunkRows, resize_rows);
+    else
+        resize_rows(0, m_dst_height);
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+bool resize_self_check(FILE* report)
+{
+    static const SimdLevel levels[] = {
+        SimdLevel::Scalar, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512,
+    };
+    static const ResizeFilter filters[] = {
+        ResizeFilter::Area, ResizeFilter::Bilinear, ResizeFilter::Lanczos,
+    };
+    // src w, src h, dst w, dst h: odd sizes, up/down, anamorphic, tiny
+    static const uint32_t cases[][4] = {
+        { 37, 23, 17, 11 }, { 101, 67, 211, 29 }, { 640, 360, 427, 240 },
+        { 1, 1, 3, 2 }, { 5, 3, 1, 1 }, { 1000, 9, 333, 7 }, { 96, 54, 31, 54 },
+    };
+
+    SimdLevel best = detect_simd_level();
+    bool all_ok = true;
+
+    std::vector<uint8_t> src(640 * 360 * 4 + 64);
+    uint32_t state = 0x9E3779B9u;
+    for (auto& b : src)
+    {
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        b = (uint8_t)state;
+    }
+
+    for (SimdLevel level : levels)
+    {
+        if ((int)level > (int)best)
+            break;
+
+        bool ok = true;
+        std::string error;
+
+        for (const auto& c : cases)
+        {
+            for (uint32_t bpp = 3; bpp <= 4 && ok; bpp++)
+            {
+                for (ResizeFilter filter : filters)
+                {
+                    Resizer reference, candidate;
+                    reference.init(c[0], c[1], bpp, c[2], c[3], filter, error, SimdLevel::Scalar);
+                    candidate.init(c[0], c[1], bpp, c[2], c[3], filter, error, level);
+
+                    // Guard bytes after the output catch over-writes
+                    std::vector<uint8_t> expect(reference.dst_bytes() + 64, 0xA5);
+                    std::vector<uint8_t> got(candidate.dst_bytes() + 64, 0xA5);
+                    reference.run(src.data(), expect.data(), nullptr);
+                    candidate.run(src.data(), got.data(), nullptr);
+                    if (expect != got)
+                        ok = false;
+                }
+            }
+        }
+
+        // Throughput: half-res 6K-ish decode down to 1080p, single thread
+        static constexpr uint32_t kBenchSrcW = 2880, kBenchSrcH = 1620;
+        static constexpr uint32_t kBenchDstW = 1920, kBenchDstH = 1080;
+        std::vector<uint8_t> bench_src((size_t)kBenchSrcW * kBenchSrcH * 4, 0x40);
+        Resizer bench;
+        bench.init(kBenchSrcW, kBenchSrcH, 4, kBenchDstW, kBenchDstH,
+                   ResizeFilter::Lanczos, error, level);
+        std::vector<uint8_t> bench_dst(bench.dst_bytes());
+        static constexpr int kIterations = 5;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int it = 0; it < kIterations; it++)
+            bench.run(bench_src.data(), bench_dst.data(), nullptr);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        double mpix_per_s = secs > 0
+            ? ((double)kBenchDstW * kBenchDstH * kIterations) / secs / 1e6 : 0.0;
+
+        fprintf(report,
+            "{\"type\":\"self_check\",\"kernel\":\"resize\",\"isa\":\"%s\","
+            "\"ok\":%s,\"mpix_per_s\":%.1f}\n",
+            simd_level_name(level), ok ? "true" : "false", mpix_per_s);
+
+        all_ok = all_ok && ok;
+    }
+
+    return all_ok;
+}
@@ -0,0 +1,610 @@
+#include "serve.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "report.h"
+
+static constexpr size_t kMaxRequestBytes = 64 * 1024;
+static constexpr size_t kMaxRequestFds = 4;
+
+// ---------------------------------------------------------------------------
+// Request parsing
+// ---------------------------------------------------------------------------
+//
+// Just enough JSON for a request line: one object whose values are strings,
+// unsigned integers or arrays of strings. Keys other than op/args/frame/
+// scale are skipped as long as their values are of those kinds.
+
+namespace {
+
+struct RequestParser
+{
+    const char* p;
+    const char* end;
+    std::string error;
+
+    void skip_space()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            p++;
+    }
+
+    bool expect(char c)
+    {
+        skip_space();
+        if (p < end && *p == c)
+        {
+            p++;
+            return true;
+        }
+        error = std::string("expected '") + c + "'";
+        return false;
+    }
+
+    bool peek(char c)
+    {
+        skip_space();
+        return p < end && *p == c;
+    }
+
+    static void put_utf8(std::string& out, uint32_t cp)
+    {
+        if (cp < 0x80)
+            out += (char)cp;
+        else if (cp < 0x800)
+        {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool hex4(uint32_t& v)
+    {
+        if (end - p < 4)
+            return false;
+        v = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            char c = *p++;
+            v <<= 4;
+            if (c >= '0' && c <= '9')      v |= (uint32_t)(c - '0');
+            else if (c >= 'a' && c <= 'f') v |= (uint32_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') v |= (uint32_t)(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    bool string(std::string& out)
+    {
+        if (!expect('"'))
+            return false;
+        out.clear();
+        while (p < end && *p != '"')
+        {
+            char c = *p++;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (p >= end)
+                break;
+            c = *p++;
+            switch (c)
+            {
+                case '"':  out += '"';  break;
+                case '\\': out += '\\'; break;
+                case '/':  out += '/';  break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+                case 'u':
+                {
+                    uint32_t cp = 0, low = 0;
+                    if (!hex4(cp))
+                    {
+                        error = "bad \\u escape";
+                        return false;
+                    }
+                    // Surrogate pair
+                    if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                    {
+                        p += 2;
+                        if (!hex4(low) || low < 0xDC00 || low > 0xDFFF)
+                        {
+                            error = "bad surrogate pair";
+                            return false;
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    put_utf8(out, cp);
+                    break;
+                }
+                default:
+                    error = "bad escape";
+                    return false;
+            }
+        }
+        if (p >= end)
+        {
+            error = "unterminated string";
+            return false;
+        }
+        p++;
+        return true;
+    }
+
+    bool number(uint64_t& out)
+    {
+        skip_space();
+        if (p >= end || *p < '0' || *p > '9')
+        {
+            error = "expected an unsigned integer";
+            return false;
+        }
+        out = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            uint64_t digit = (uint64_t)(*p++ - '0');
+            if (out > (UINT64_MAX - digit) / 10)
+            {
+                error = "number out of range";
+                return false;
+            }
+            out = out * 10 + digit;
+        }
+        return true;
+    }
+
+    bool string_array(std::vector<std::string>& out)
+    {
+        if (!expect('['))
+            return false;
+        out.clear();
+        if (peek(']'))
+            return expect(']');
+        do
+        {
+            out.emplace_back();
+            if (!string(out.back()))
+                return false;
+        } while (peek(',') && expect(','));
+        return expect(']');
+    }
+
+    bool skip_value()
+    {
+        std::string s;
+        uint64_t n;
+        std::vector<std::string> a;
+        if (peek('"')) return string(s);
+        if (peek('[')) return string_array(a);
+        return number(n);
+    }
+};
+
+} // namespace
+
+bool parse_serve_request(const std::string& line, ServeRequest& request, std::string& error)
+{
+    RequestParser parser{line.data(), line.data() + line.size(), {}};
+    request.op.clear();
+    request.args.clear();
+    request.frame = 0;
+    request.scale = 0;
+
+    bool ok = parser.expect('{');
+    if (ok && !parser.peek('}'))
+    {
+        do
+        {
+            std::string key;
+            ok = parser.string(key) && parser.expect(':');
+            if (!ok)
+                break;
+            if (key == "op")
+                ok = parser.string(request.op);
+            else if (key == "args")
+                ok = parser.string_array(request.args);
+            else if (key == "frame")
+                ok = parser.number(request.frame);
+            else if (key == "scale")
+            {
+                uint64_t scale = 0;
+                ok = parser.number(scale);
+                if (ok && (scale == 0 || scale > 64))
+                {
+                    parser.error = "scale out of range";
+                    ok = false;
+                }
+                request.scale = (uint32_t)scale;
+            }
+            else
+                ok = parser.skip_value();
+        } while (ok && parser.peek(',') && parser.expect(','));
+    }
+    ok = ok && parser.expect('}');
+    parser.skip_space();
+    if (ok && parser.p != parser.end)
+    {
+        parser.error = "trailing data";
+        ok = false;
+    }
+    if (ok && request.op.empty())
+    {
+        parser.error = "missing \"op\"";
+        ok = false;
+    }
+
+    if (!ok)
+        error = "Invalid request: " + parser.error;
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Connections
+// ---------------------------------------------------------------------------
+
+// Reads the request line and the fds sent with it; what arrived after the
+// line goes to `pending`. Fds beyond kMaxRequestFds are closed.
+static bool receive_request(int conn, std::string& line, std::string& pending,
+                            std::vector<int>& fds, std::string& error)
+{
+    line.clear();
+    char buf[4096];
+    for (;;)
+    {
+        union
+        {
+            char buf[CMSG_SPACE(sizeof(int) * kMaxRequestFds)];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = { buf, sizeof(buf) };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t n;
+        do
+            n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+        while (n < 0 && errno == EINTR);
+        if (n < 0)
+        {
+            error = std::string("Reading the request failed: ") + strerror(errno);
+            return false;
+        }
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; i++)
+            {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                if (fds.size() < kMaxRequestFds)
+                    fds.push_back(fd);
+                else
+                    close(fd);
+            }
+        }
+
+        if (n == 0)
+        {
+            error = "Connection closed before a complete request";
+            return false;
+        }
+        const char* newline = (const char*)memchr(buf, '\n', (size_t)n);
+        line.append(buf, newline ? (size_t)(newline - buf) : (size_t)n);
+        if (newline)
+        {
+            pending.assign(newline + 1, (size_t)(buf + n - (newline + 1)));
+            return true;
+        }
+        if (line.size() > kMaxRequestBytes)
+        {
+            error = "Request line too long";
+            return false;
+        }
+    }
+}
+
+static std::string escape(const std::string& s)
+{
+    std::string out;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += (c == '\n' || c == '\r') ? ' ' : c;
+    }
+    return out;
+}
+
+static void handle_connection(int conn, const ServeHandler& handler)
+{
+    FILE* report = fdopen(conn, "w");
+    if (!report)
+    {
+        close(conn);
+        return;
+    }
+    // One line per write, so progress reaches the client as it happens and
+    // a client that went away shows up as a write error
+    setvbuf(report, nullptr, _IOLBF, 0);
+
+    ServeRequest request;
+    std::string line, error;
+    int code = 1;
+    {
+        ReportScope scope(report);
+        request.conn = conn;
+        if (receive_request(conn, line, request.pending, request.fds, error)
+            && parse_serve_request(line, request, error))
+            code = handler(request);
+        else
+            fprintf(report, "{\"type\":\"error\",\"message\":\"%s\"}\n", escape(error).c_str());
+    }
+    fprintf(report, "{\"type\":\"exit\",\"code\":%d}\n", code);
+
+    for (int fd : request.fds)
+        close(fd);
+    fclose(report);
+}
+
+// ---------------------------------------------------------------------------
+// Listener
+// ---------------------------------------------------------------------------
+
+// SIGTERM/SIGINT end up as a byte in this pipe, so the accept loop notices
+// whichever thread the signal was delivered to
+static int g_stop_pipe[2] = { -1, -1 };
+
+static void on_stop_signal(int)
+{
+    int saved = errno;
+    char c = 0;
+    (void)!write(g_stop_pipe[1], &c, 1);
+    errno = saved;
+}
+
+bool serve(const char* socket_path, unsigned max_requests, const ServeHandler& handler,
+           std::string& error)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        error = std::string("Socket path too long: ") + socket_path;
+        return false;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        error = std::string("socket() failed: ") + strerror(errno);
+        return false;
+    }
+
+    // A socket left behind by a daemon that did not shut down cleanly
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || chmod(socket_path, 0600) != 0
+        || listen(listen_fd, 64) != 0)
+    {
+        error = std::string("Listening on ") + socket_path + " failed: " + strerror(errno);
+        close(listen_fd);
+        return false;
+    }
+
+    if (pipe2(g_stop_pipe, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        error = std::string("pipe2() failed: ") + strerror(errno);
+        close(listen_fd);
+        unlink(socket_path);
+        return false;
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+    // Clients that go away must not take the daemon with them
+    signal(SIGPIPE, SIG_IGN);
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    unsigned active = 0;
+    bool stop = false;
+
+    while (!stop)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (active >= max_requests && !stop)
+            {
+                idle.wait_for(lock, std::chrono::milliseconds(200));
+                char c;
+                stop = read(g_stop_pipe[0], &c, 1) == 1;
+            }
+        }
+        if (stop)
+            break;
+
+        struct pollfd pfds[2] = {
+            { listen_fd, POLLIN, 0 },
+            { g_stop_pipe[0], POLLIN, 0 },
+        };
+        if (poll(pfds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            error = std::string("poll() failed: ") + strerror(errno);
+            break;
+        }
+        if (pfds[1].revents)
+            break;
+        if (!(pfds[0].revents & POLLIN))
+            continue;
+
+        int conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+                continue;
+            error = std::string("accept() failed: ") + strerror(errno);
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active++;
+        }
+        std::thread([&, conn]
+        {
+            handle_connection(conn, handler);
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+            idle.notify_all();
+        }).detach();
+    }
+
+    // New clients get ECONNREFUSED from here on; running requests finish
+    // (a client that goes away cancels its decode)
+    close(listen_fd);
+    unlink(socket_path);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [&]{ return active == 0; });
+    }
+    close(g_stop_pipe[0]);
+    close(g_stop_pipe[1]);
+    return error.empty();
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+bool serve_self_check(FILE* report)
+{
+    bool ok = true;
+    ServeRequest request;
+    std::string error;
+
+    // Escapes (a non-ASCII path as \u escapes, surrogate pair included),
+    // an unknown key, whitespace
+    ok = ok && parse_serve_request(
+        " { \"op\" : \"thumbnail\", \"id\": 7, \"args\": [\"--input\", \"/card/\\u00e9t\\u00e9 \\\"A\\\"\\\\\\ud83c\\udfac.braw\", "
+        "\"--output-size\",\"320x-2\"], \"frame\": 12, \"scale\": 4 } ", request, error);
+    ok = ok && request.op == "thumbnail" && request.frame == 12 && request.scale == 4
+            && request.args.size() == 4
+            && request.args[1] == "/card/\xC3\xA9t\xC3\xA9 \"A\"\\\xF0\x9F\x8E\xAC.braw"
+            && request.args[3] == "320x-2";
+
+    // Malformed lines are refused
+    const char* bad[] = {
+        "", "{}", "{\"op\":\"probe\"", "{\"op\":\"probe\"} x", "{\"op\":\"probe\",\"args\":[1]}",
+        "{\"op\":\"probe\",\"frame\":-1}", "{\"op\":\"probe\",\"args\":[\"\\q\"]}",
+        "{\"op\":\"frame\",\"scale\":0}",
+    };
+    for (const char* line : bad)
+        ok = ok && !parse_serve_request(line, request, error);
+
+    // A request in two pieces with a pipe fd attached to the first, and the
+    // start of the next line kept
+    int sv[2] = { -1, -1 };
+    int pipe_fds[2] = { -1, -1 };
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0
+        || pipe2(pipe_fds, O_CLOEXEC) != 0)
+        ok = false;
+    if (ok)
+    {
+        const char first[] = "{\"op\":\"decode\",\"args\":[\"--input\",";
+        const char second[] = "\"x.R3D\"]}\n{\"op\":\"frame\"";
+
+        union
+        {
+            char buf[CMSG_SPACE(sizeof(int))];
+            struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+        struct iovec iov = { (void*)first, sizeof(first) - 1 };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &pipe_fds[1], sizeof(int));
+
+        ok = sendmsg(sv[0], &msg, MSG_NOSIGNAL) == (ssize_t)(sizeof(first) - 1)
+             && write(sv[0], second, sizeof(second) - 1) == (ssize_t)(sizeof(second) - 1);
+
+        std::string line, pending;
+        std::vector<int> fds;
+        ok = ok && receive_request(sv[1], line, pending, fds, error)
+                && parse_serve_request(line, request, error)
+                && request.op == "decode" && request.args.size() == 2 && request.args[1] == "x.R3D"
+                && pending == "{\"op\":\"frame\""
+                && fds.size() == 1;
+
+        // The fd that arrived is the pipe's write end
+        char c = 'x', got = 0;
+        ok = ok && write(fds[0], &c, 1) == 1 && read(pipe_fds[0], &got, 1) == 1 && got == 'x';
+        for (int fd : fds)
+            close(fd);
+    }
+    for (int fd : { sv[0], sv[1], pipe_fds[0], pipe_fds[1] })
+        if (fd >= 0)
+            close(fd);
+
+    fprintf(report,
+        "{\"type\":\"self_check\",\"check\":\"serve_request\",\"ok\":%s}\n",
+        ok ? "true" : "false");
+    return ok;
+}
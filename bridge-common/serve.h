@@ -0,0 +1,63 @@
+// serve: the socket side of --serve. A bridge started with
+// `--serve <socket>` sets its SDK up once and then answers requests from any
+// number of clients on that Unix socket, several at a time, so a job no
+// longer pays for SDK start-up (and a fresh decoder thread pool) per clip.
+//
+// A client connects and sends one request as a single NDJSON line,
+//
+//   {"op":"decode","args":["--input","/card/A001.braw","--pix-fmt","yuv420p"]}
+//
+// with the fds the op needs attached (SCM_RIGHTS). `args` are the bridge's
+// own command-line options. The ops:
+//
+//   probe          metadata line only (like --probe-only)
+//   extract-audio  args carry --extract-audio <wav>
+//   decode         fds[0] gets the frames (what stdout gets otherwise)
+//   thumbnail      fds[0] gets the single frame "frame" (default 0), rgb24
+//                  unless --pix-fmt says otherwise
+//   scrub          the connection stays open for frame requests; fds[0]
+//                  gets the frames (see frame_server.h)
+//
+// The request's NDJSON report (the lines a command-line run writes to
+// stderr) comes back on the same connection, followed by
+// {"type":"exit","code":N} with the exit code the command-line run would
+// have had. Closing the connection early cancels a decode at its next frame.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct ServeRequest
+{
+    std::string op;
+    std::vector<std::string> args;
+    uint64_t frame = 0;    // thumbnail, scrub frame requests
+    uint32_t scale = 0;    // scrub: decode divisor, 0 = unset
+    std::vector<int> fds;  // received with the request; closed after it
+    int conn = -1;         // the connection, for ops that read more from it
+    std::string pending;   // what arrived after the request line
+};
+
+// Runs one request on the calling thread with report_stream() on its
+// connection and returns its exit code
+using ServeHandler = std::function<int(const ServeRequest& request)>;
+
+// Parses a request line. On failure returns false and sets `error`.
+bool parse_serve_request(const std::string& line, ServeRequest& request, std::string& error);
+
+// Listens on `socket_path` (a stale socket there is replaced) and runs each
+// request on a thread of its own, at most `max_requests` at once; further
+// clients wait in the listen backlog. Returns once SIGTERM or SIGINT
+// arrived and the running requests finished; on a socket error returns
+// false and sets `error`.
+bool serve(const char* socket_path, unsigned max_requests, const ServeHandler& handler,
+           std::string& error);
+
+// bridge-common-tests: parses request lines and passes one with an fd over a
+// socketpair. Prints one {"type":"self_check","check":"serve_request"}
+// line; returns false on mismatch.
+bool serve_self_check(FILE* report);
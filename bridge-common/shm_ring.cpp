@@ -0,0 +1,252 @@
+#include "shm_ring.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#endif
+
+static constexpr char kShmMagic[8] = { 'B', 'R', 'S', 'H', 'M', '0', '1', '\0' };
+static constexpr size_t kShmPage = 4096;
+static constexpr size_t kOrderOffset = 192;
+
+static size_t round_up(size_t n, size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+struct ShmRing::Header
+{
+    char magic[8];
+    uint32_t header_bytes;
+    uint32_t slot_count;
+    uint64_t slot_stride;
+    uint64_t frame_bytes;
+    uint32_t width;
+    uint32_t height;
+    char pix_fmt[16];
+    // Producer and consumer counters on their own cache lines
+    alignas(64) std::atomic<uint64_t> produced;
+    std::atomic<uint32_t> closed;
+    alignas(64) std::atomic<uint64_t> consumed;
+
+    uint32_t* order() { return (uint32_t*)((uint8_t*)this + kOrderOffset); }
+};
+
+static_assert(offsetof(ShmRing::Header, pix_fmt) == 40, "shm header layout");
+static_assert(offsetof(ShmRing::Header, produced) == 64, "shm header layout");
+static_assert(offsetof(ShmRing::Header, closed) == 72, "shm header layout");
+static_assert(offsetof(ShmRing::Header, consumed) == 128, "shm header layout");
+static_assert(sizeof(ShmRing::Header) <= kOrderOffset, "shm header layout");
+
+#ifdef __linux__
+
+static void signal_eventfd(int fd)
+{
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR)
+    {
+    }
+}
+
+ShmRing::~ShmRing()
+{
+    if (m_header)
+        munmap(m_header, m_mapped_bytes);
+    for (int fd : { m_memfd, m_ready_fd, m_free_fd, m_socket })
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+}
+
+bool ShmRing::init(PixFmt fmt, size_t width, size_t height, size_t slot_bytes,
+                   uint32_t slot_count, std::string& error)
+{
+    struct iovec iov[kMaxFrameIovecs];
+    if (frame_iovecs(fmt, nullptr, width, height, iov) != 1)
+    {
+        error = std::string("shared-memory transport: ") + pix_fmt_name(fmt)
+                + " is not written as one piece";
+        return false;
+    }
+    if (slot_count == 0 || slot_bytes < pix_fmt_frame_bytes(fmt, width, height))
+    {
+        error = "shared-memory transport: slots too small";
+        return false;
+    }
+
+    m_slot_stride = round_up(slot_bytes, kShmPage);
+    m_slot_count = slot_count;
+    size_t header_bytes = round_up(kOrderOffset + sizeof(uint32_t) * slot_count, kShmPage);
+    size_t total = header_bytes + m_slot_stride * slot_count;
+
+    m_memfd = memfd_create("bridge-frames", MFD_CLOEXEC);
+    if (m_memfd < 0 || ftruncate(m_memfd, (off_t)total) != 0)
+    {
+        error = std::string("shared-memory transport: memfd failed: ") + strerror(errno);
+        return false;
+    }
+
+    // Populated up front like the anonymous frame pools
+    void* base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      m_memfd, 0);
+    if (base == MAP_FAILED)
+    {
+        error = std::string("shared-memory transport: mmap failed: ") + strerror(errno);
+        return false;
+    }
+    m_mapped_bytes = total;
+    m_slots = (uint8_t*)base + header_bytes;
+
+    m_ready_fd = eventfd(0, EFD_CLOEXEC);
+    m_free_fd = eventfd(0, EFD_CLOEXEC);
+    if (m_ready_fd < 0 || m_free_fd < 0)
+    {
+        munmap(base, total);
+        error = std::string("shared-memory transport: eventfd failed: ") + strerror(errno);
+        return false;
+    }
+
+    // The memfd starts zeroed, which is also the counters' initial state
+    m_header = new (base) Header();
+    memcpy(m_header->magic, kShmMagic, sizeof(kShmMagic));
+    m_header->header_bytes = (uint32_t)header_bytes;
+    m_header->slot_count = slot_count;
+    m_header->slot_stride = m_slot_stride;
+    m_header->frame_bytes = pix_fmt_frame_bytes(fmt, width, height);
+    m_header->width = (uint32_t)width;
+    m_header->height = (uint32_t)height;
+    strncpy(m_header->pix_fmt, pix_fmt_name(fmt), sizeof(m_header->pix_fmt) - 1);
+    return true;
+}
+
+bool ShmRing::send_fds(int socket_fd, std::string& error)
+{
+    int fds[3] = { m_memfd, m_ready_fd, m_free_fd };
+    char payload[sizeof(kShmMagic)];
+    memcpy(payload, kShmMagic, sizeof(payload));
+    struct iovec iov = { payload, sizeof(payload) };
+
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t n;
+    do
+        n = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+    while (n < 0 && errno == EINTR);
+    if (n < 0)
+    {
+        error = std::string("shared-memory transport: sending fds failed: ") + strerror(errno);
+        return false;
+    }
+
+    m_socket = socket_fd;
+    return true;
+}
+
+bool ShmRing::publish(const uint8_t* data)
+{
+    if (peer_gone())
+        return false;
+
+    uint32_t slot = (uint32_t)((size_t)(data - m_slots) / m_slot_stride);
+    uint64_t n = m_header->produced.load(std::memory_order_relaxed);
+    m_header->order()[n % m_slot_count] = slot;
+    m_header->produced.store(n + 1, std::memory_order_release);
+    signal_eventfd(m_ready_fd);
+    return true;
+}
+
+uint64_t ShmRing::produced() const
+{
+    return m_header->produced.load(std::memory_order_acquire);
+}
+
+uint64_t ShmRing::consumed() const
+{
+    return m_header->consumed.load(std::memory_order_acquire);
+}
+
+bool ShmRing::peer_gone() const
+{
+    if (m_socket < 0)
+        return false;
+    struct pollfd pfd = { m_socket, 0, 0 };
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & (POLLHUP | POLLERR));
+}
+
+void ShmRing::wait_free(int timeout_ms) const
+{
+    struct pollfd pfds[2] = {
+        { m_free_fd, POLLIN, 0 },
+        { m_socket, 0, 0 },
+    };
+    if (poll(pfds, m_socket >= 0 ? 2 : 1, timeout_ms) > 0 && (pfds[0].revents & POLLIN))
+    {
+        uint64_t count;
+        while (read(m_free_fd, &count, sizeof(count)) < 0 && errno == EINTR)
+        {
+        }
+    }
+}
+
+void ShmRing::close()
+{
+    if (!m_header)
+        return;
+    m_header->closed.store(1, std::memory_order_release);
+    signal_eventfd(m_ready_fd);
+}
+
+#else // !__linux__
+
+ShmRing::~ShmRing() = default;
+
+bool ShmRing::init(PixFmt, size_t, size_t, size_t, uint32_t, std::string& error)
+{
+    error = "shared-memory transport needs Linux (memfd, eventfd)";
+    return false;
+}
+
+bool ShmRing::send_fds(int, std::string& error)
+{
+    error = "shared-memory transport needs Linux (memfd, eventfd)";
+    return false;
+}
+
+bool ShmRing::publish(const uint8_t*) { return false; }
+uint64_t ShmRing::produced() const { return 0; }
+uint64_t ShmRing::consumed() const { return 0; }
+bool ShmRing::peer_gone() const { return true; }
+void ShmRing::wait_free(int) const {}
+void ShmRing::close() {}
+
+#endif
@@ -0,0 +1,85 @@
+// shm_ring: shared-memory frame transport, the alternative to stdout. One
+// memfd holds a small header and the frame slots. The bridge's output pool
+// is carved from the slots, so frames are decoded or converted straight
+// into shared memory and published by slot index; nothing is copied on the
+// bridge side and the consumer reads the frames in place.
+//
+// The memfd and two eventfds go to the consumer with SCM_RIGHTS over a Unix
+// socket the bridge inherited (--shm-socket FD). "ready" is signalled after
+// each published frame and at the end, "free" by the consumer once it is
+// done with a frame. Both are wakeups only; the counters in the header are
+// what counts. A hung-up socket means the consumer is gone.
+//
+// Header layout (little endian, read by backend/src/ffmpeg/shm.rs):
+//   0    char[8]   magic          "BRSHM01\0"
+//   8    uint32    header_bytes   offset of slot 0, a page multiple
+//   12   uint32    slot_count
+//   16   uint64    slot_stride
+//   24   uint64    frame_bytes
+//   32   uint32    width
+//   36   uint32    height
+//   40   char[16]  pix_fmt        FFmpeg name, NUL terminated
+//   64   uint64    produced       frames published (atomic)
+//   72   uint32    closed         1 once no more frames follow (atomic)
+//   128  uint64    consumed       frames the consumer is done with (atomic)
+//   192  uint32[]  order          slot of frame n at order[n % slot_count]
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "pixel_format.h"
+
+class ShmRing
+{
+public:
+    ShmRing() = default;
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    // Creates the memfd with `slot_count` page-aligned slots of `slot_bytes`
+    // for `fmt` frames of width x height, and the eventfds. Only formats
+    // written as one piece (frame_iovecs() == 1) can be shared. On failure
+    // returns false and sets `error`.
+    bool init(PixFmt fmt, size_t width, size_t height, size_t slot_bytes,
+              uint32_t slot_count, std::string& error);
+
+    // Hands the memfd and eventfds to the consumer on `socket_fd` and keeps
+    // the socket to notice a hang-up.
+    bool send_fds(int socket_fd, std::string& error);
+
+    uint8_t* slots() const { return m_slots; }
+    uint32_t slot_count() const { return m_slot_count; }
+
+    // Publishes the frame in slot buffer `data` as the next one. Returns
+    // false once the consumer is gone.
+    bool publish(const uint8_t* data);
+
+    uint64_t produced() const;
+    uint64_t consumed() const;
+    bool peer_gone() const;
+
+    // Blocks up to `timeout_ms` for the consumer to free a slot or hang up
+    void wait_free(int timeout_ms) const;
+
+    // No more frames follow
+    void close();
+
+    // Shared layout, see above
+    struct Header;
+
+private:
+    Header* m_header = nullptr;
+    uint8_t* m_slots = nullptr;
+    size_t m_mapped_bytes = 0;
+    size_t m_slot_stride = 0;
+    uint32_t m_slot_count = 0;
+    int m_memfd = -1;
+    int m_ready_fd = -1;
+    int m_free_fd = -1;
+    int m_socket = -1;
+};
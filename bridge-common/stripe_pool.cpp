@@ -0,0 +1,96 @@
+#include "stripe_pool.h"
+
+#include <algorithm>
+
+StripePool::StripePool(unsigned worker_count)
+{
+    for (unsigned i = 0; i < worker_count; i++)
+        m_workers.emplace_back([this]{ worker_loop(); });
+}
+
+StripePool::~StripePool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& t : m_workers)
+        t.join();
+}
+
+void StripePool::run(size_t rows, size_t min_rows, const StripeFn& fn)
+{
+    if (rows == 0)
+        return;
+
+    size_t threads = m_workers.size() + 1;
+    min_rows = std::max<size_t>(min_rows, 1);
+    if (m_workers.empty() || rows < 2 * min_rows)
+    {
+        fn(0, rows);
+        return;
+    }
+
+    // A few stripes per thread so a thread that started late can still help
+    size_t stripe_count = std::min(rows / min_rows, threads * 4);
+    auto batch = std::make_shared<Batch>();
+    batch->fn = &fn;
+    batch->rows = rows;
+    batch->stripe_rows = (rows + stripe_count - 1) / stripe_count;
+    batch->stripe_count = (rows + batch->stripe_rows - 1) / batch->stripe_rows;
+    batch->remaining = batch->stripe_count;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(batch);
+    }
+    m_cv.notify_all();
+
+    work_on(*batch);
+
+    std::unique_lock<std::mutex> lock(batch->done_mutex);
+    batch->done_cv.wait(lock, [&batch]{ return batch->remaining.load() == 0; });
+}
+
+bool StripePool::work_on(Batch& batch)
+{
+    for (;;)
+    {
+        size_t stripe = batch.next_stripe.fetch_add(1);
+        if (stripe >= batch.stripe_count)
+            return false;
+
+        size_t begin = stripe * batch.stripe_rows;
+        size_t end = std::min(batch.rows, begin + batch.stripe_rows);
+        (*batch.fn)(begin, end);
+
+        if (batch.remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(batch.done_mutex);
+            batch.done_cv.notify_all();
+        }
+    }
+}
+
+void StripePool::worker_loop()
+{
+    for (;;)
+    {
+        std::shared_ptr<Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]{ return m_stop || !m_queue.empty(); });
+            if (m_stop)
+                return;
+            batch = m_queue.front();
+        }
+
+        work_on(*batch);
+
+        // Every stripe of this batch is claimed: retire it from the queue
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_queue.empty() && m_queue.front() == batch)
+            m_queue.pop_front();
+    }
+}
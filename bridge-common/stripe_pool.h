@@ -0,0 +1,59 @@
+// stripe_pool: small fixed-size worker pool that splits a frame into row
+// stripes. Several threads (e.g. SDK callback threads) may call run()
+// concurrently; the calling thread always works on its own batch too, so a
+// saturated pool never blocks progress.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class StripePool
+{
+public:
+    using StripeFn = std::function<void(size_t row_begin, size_t row_end)>;
+
+    // worker_count = 0 runs everything on the calling thread.
+    explicit StripePool(unsigned worker_count);
+    ~StripePool();
+
+    StripePool(const StripePool&) = delete;
+    StripePool& operator=(const StripePool&) = delete;
+
+    unsigned worker_count() const { return (unsigned)m_workers.size(); }
+
+    // Calls fn over [0, rows) in stripes of at least min_rows rows and
+    // returns once every stripe has finished.
+    void run(size_t rows, size_t min_rows, const StripeFn& fn);
+
+private:
+    struct Batch
+    {
+        const StripeFn* fn = nullptr;
+        size_t rows = 0;
+        size_t stripe_rows = 0;
+        size_t stripe_count = 0;
+        std::atomic<size_t> next_stripe{0};
+        std::atomic<size_t> remaining{0};
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+    };
+
+    // Claims and runs stripes until none are left. Returns false once the
+    // batch has no unclaimed stripes.
+    static bool work_on(Batch& batch);
+    void worker_loop();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::shared_ptr<Batch>> m_queue;
+    bool m_stop = false;
+};
@@ -0,0 +1,85 @@
+// bridge-common-tests: the checks of the shared code, without either SDK.
+// Each bridge's build tree runs them with ctest, one test per check:
+//
+//   bridge-common-tests            every check
+//   bridge-common-tests <check>    one of them
+//
+// The kernels (pixel conversion, resize, YUV, post stage, byte swap, frame
+// transports) also run from the bridges' --self-check, on the machine that
+// will decode; the modules' checks run here only. av_encoder encodes and
+// reads back a short clip per codec in a -DBRIDGE_LIBAV=ON build, the smoke
+// test of the in-process encoder against the FFmpeg it links.
+
+#include <cstdio>
+#include <cstring>
+
+#include "av_encoder.h"
+#include "clip_cache.h"
+#include "frame_select.h"
+#include "frame_server.h"
+#include "nut_muxer.h"
+#include "pixel_convert.h"
+#include "playlist.h"
+#include "post_process.h"
+#include "probe_batch.h"
+#include "resize.h"
+#include "serve.h"
+#include "thumbnails.h"
+#include "transport_bench.h"
+#include "wav_writer.h"
+#include "yuv_convert.h"
+
+// image_writer_check.cpp: test images through the encoders and back, with
+// a JPEG decoder that only the tests need
+bool image_writer_self_check(FILE* report);
+
+struct Check
+{
+    const char* name;
+    bool (*run)(FILE* report);
+};
+
+static const Check kChecks[] = {
+    { "rgba_to_rgb24",   pixel_convert_self_check },
+    { "resize",          resize_self_check },
+    { "rgb_to_yuv",      yuv_convert_self_check },
+    { "post_process",    post_process_self_check },
+    { "bswap32",         bswap32_self_check },
+    { "frame_transport", transport_self_check },
+    { "av_encoder",      av_encoder_self_check },
+    { "nut_mux",         nut_self_check },
+    { "wav_writer",      wav_writer_self_check },
+    { "serve_request",   serve_self_check },
+    { "probe_batch",     probe_batch_self_check },
+    { "clip_cache",      clip_cache_self_check },
+    { "playlist",        playlist_self_check },
+    { "frame_select",    frame_select_self_check },
+    { "image_writer",    image_writer_self_check },
+    { "thumbnails",      thumbnails_self_check },
+    { "frame_server",    frame_server_self_check },
+};
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2)
+    {
+        fprintf(stderr, "Usage: bridge-common-tests [check]\n");
+        return 2;
+    }
+
+    bool ok = true;
+    bool found = false;
+    for (const Check& check : kChecks)
+    {
+        if (argc == 2 && strcmp(argv[1], check.name) != 0)
+            continue;
+        found = true;
+        ok = check.run(stdout) && ok;
+    }
+    if (!found)
+    {
+        fprintf(stderr, "Unknown check: %s\n", argv[1]);
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
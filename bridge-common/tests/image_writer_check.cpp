@@ -0,0 +1,522 @@
+// image_writer's check for bridge-common-tests: encodes test images and
+// decodes them back, the JPEG with a baseline decoder of its own. The
+// decoder lives here, not in the library, since the bridges only ever write
+// images.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef BRIDGE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "image_writer.h"
+
+
+#ifdef BRIDGE_ZLIB
+
+static uint32_t get_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Paeth predictor of the PNG spec
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int p = (int)a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+// Inflates and unfilters a PNG written by encode_png() (IHDR, one IDAT,
+// IEND) back to rgb24
+static bool decode_png(const std::vector<uint8_t>& png, uint32_t& width, uint32_t& height,
+                       std::vector<uint8_t>& rgb)
+{
+    if (png.size() < 8 + 25 || get_be32(&png[8]) != 13 || memcmp(&png[12], "IHDR", 4) != 0
+        || get_be32(&png[29]) != crc32(0, &png[12], 17))
+        return false;
+    width = get_be32(&png[16]);
+    height = get_be32(&png[20]);
+
+    size_t idat = 33;
+    if (png.size() < idat + 12 || memcmp(&png[idat + 4], "IDAT", 4) != 0)
+        return false;
+    size_t z_len = get_be32(&png[idat]);
+    if (png.size() != idat + 12 + z_len + 12
+        || get_be32(&png[idat + 8 + z_len]) != crc32(0, &png[idat + 4], (uInt)(z_len + 4))
+        || memcmp(&png[idat + 12 + z_len + 4], "IEND", 4) != 0)
+        return false;
+    size_t row_bytes = (size_t)width * 3;
+    std::vector<uint8_t> raw((row_bytes + 1) * height);
+    uLongf raw_len = (uLongf)raw.size();
+    if (uncompress(raw.data(), &raw_len, &png[idat + 8], (uLong)z_len) != Z_OK
+        || raw_len != raw.size())
+        return false;
+
+    rgb.assign(row_bytes * height, 0);
+    std::vector<uint8_t> zero_row(row_bytes, 0);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* src = raw.data() + y * (row_bytes + 1);
+        uint8_t* row = &rgb[y * row_bytes];
+        const uint8_t* up = y ? row - row_bytes : zero_row.data();
+        for (size_t i = 0; i < row_bytes; i++)
+        {
+            uint8_t left = i >= 3 ? row[i - 3] : 0;
+            uint8_t up_left = i >= 3 ? up[i - 3] : 0;
+            uint8_t v = src[1 + i];
+            switch (src[0])
+            {
+            case 0: row[i] = v; break;
+            case 1: row[i] = (uint8_t)(v + left); break;
+            case 2: row[i] = (uint8_t)(v + up[i]); break;
+            case 3: row[i] = (uint8_t)(v + ((left + up[i]) >> 1)); break;
+            case 4: row[i] = (uint8_t)(v + paeth(left, up[i], up_left)); break;
+            default: return false;
+            }
+        }
+    }
+    return true;
+}
+
+#endif
+
+// Baseline sequential JPEG decoder: takes the tables
+// and sampling from the stream's own DQT, DHT and SOF0 segments, not from
+// the encoder, and derives the zigzag order by walking the diagonals.
+// Chroma is upsampled by repetition. No restart intervals, progressive or
+// 12-bit streams.
+class JpegReader
+{
+public:
+    bool decode(const std::vector<uint8_t>& jpeg, uint32_t& width, uint32_t& height,
+                std::vector<uint8_t>& rgb)
+    {
+        m_data = jpeg.data();
+        m_size = jpeg.size();
+        if (m_size < 4 || m_data[0] != 0xFF || m_data[1] != 0xD8)
+            return false;
+        size_t pos = 2;
+        while (pos + 4 <= m_size)
+        {
+            if (m_data[pos] != 0xFF)
+                return false;
+            uint8_t marker = m_data[pos + 1];
+            size_t len = ((size_t)m_data[pos + 2] << 8) | m_data[pos + 3];
+            const uint8_t* seg = m_data + pos + 4;
+            if (len < 2 || pos + 2 + len > m_size)
+                return false;
+            size_t n = len - 2;
+            bool ok = true;
+            if (marker == 0xDB)
+                ok = read_dqt(seg, n);
+            else if (marker == 0xC4)
+                ok = read_dht(seg, n);
+            else if (marker == 0xC0)
+                ok = read_sof(seg, n);
+            else if (marker == 0xDA)
+            {
+                if (!read_sos(seg, n))
+                    return false;
+                m_pos = pos + 2 + len;
+                if (!decode_scan(rgb))
+                    return false;
+                width = m_width;
+                height = m_height;
+                return true;
+            }
+            else if ((marker & 0xF0) == 0xC0 || marker == 0xDD)
+                ok = false; // other frame types, arithmetic coding, restarts
+            if (!ok)
+                return false;
+            pos += 2 + len;
+        }
+        return false;
+    }
+
+private:
+    struct Huffman
+    {
+        int32_t max_code[17];
+        int32_t val_ptr[17];
+        int32_t min_code[17];
+        uint8_t values[256];
+        bool defined = false;
+    };
+
+    struct Component
+    {
+        uint8_t id, h, v, quant, dc, ac;
+        int pred;
+        std::vector<uint8_t> plane; // h*8 x v*8 samples per MCU, whole image
+        size_t stride;
+    };
+
+    bool read_dqt(const uint8_t* p, size_t n)
+    {
+        while (n >= 65)
+        {
+            if ((p[0] >> 4) != 0 || (p[0] & 15) > 3)
+                return false;
+            memcpy(m_quant[p[0] & 15], p + 1, 64);
+            p += 65;
+            n -= 65;
+        }
+        return n == 0;
+    }
+
+    bool read_dht(const uint8_t* p, size_t n)
+    {
+        while (n >= 17)
+        {
+            uint8_t cls = p[0] >> 4, id = p[0] & 15;
+            if (cls > 1 || id > 3)
+                return false;
+            Huffman& t = m_huff[cls][id];
+            size_t count = 0;
+            for (int i = 0; i < 16; i++)
+                count += p[1 + i];
+            if (count > 256 || n < 17 + count)
+                return false;
+            int32_t code = 0, k = 0;
+            for (int len = 1; len <= 16; len++)
+            {
+                t.val_ptr[len] = k;
+                t.min_code[len] = code;
+                code += p[len];
+                k += p[len];
+                t.max_code[len] = p[len] ? code - 1 : -1;
+                code <<= 1;
+            }
+            memcpy(t.values, p + 17, count);
+            t.defined = true;
+            p += 17 + count;
+            n -= 17 + count;
+        }
+        return n == 0;
+    }
+
+    bool read_sof(const uint8_t* p, size_t n)
+    {
+        if (n < 6 || p[0] != 8)
+            return false;
+        m_height = ((uint32_t)p[1] << 8) | p[2];
+        m_width = ((uint32_t)p[3] << 8) | p[4];
+        size_t count = p[5];
+        if (count != 3 || n != 6 + 3 * count || !m_width || !m_height)
+            return false;
+        m_components.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            Component& c = m_components[i];
+            c.id = p[6 + i * 3];
+            c.h = p[7 + i * 3] >> 4;
+            c.v = p[7 + i * 3] & 15;
+            c.quant = p[8 + i * 3];
+            if (c.h < 1 || c.h > 2 || c.v < 1 || c.v > 2 || c.quant > 3)
+                return false;
+            m_hmax = std::max(m_hmax, (uint32_t)c.h);
+            m_vmax = std::max(m_vmax, (uint32_t)c.v);
+        }
+        return true;
+    }
+
+    bool read_sos(const uint8_t* p, size_t n)
+    {
+        if (m_components.empty() || n < 1 || p[0] != m_components.size()
+            || n != 1 + 2 * m_components.size() + 3)
+            return false;
+        for (size_t i = 0; i < m_components.size(); i++)
+        {
+            Component& c = m_components[i];
+            if (p[1 + i * 2] != c.id)
+                return false;
+            c.dc = p[2 + i * 2] >> 4;
+            c.ac = p[2 + i * 2] & 15;
+            if (c.dc > 3 || c.ac > 3 || !m_huff[0][c.dc].defined || !m_huff[1][c.ac].defined)
+                return false;
+        }
+        const uint8_t* spectral = p + 1 + 2 * m_components.size();
+        return spectral[0] == 0 && spectral[1] == 63 && spectral[2] == 0;
+    }
+
+    // Next entropy-coded bit; false past the end of the scan
+    bool bit(int& b)
+    {
+        if (m_bits == 0)
+        {
+            if (m_pos >= m_size)
+                return false;
+            m_byte = m_data[m_pos++];
+            if (m_byte == 0xFF)
+            {
+                if (m_pos >= m_size || m_data[m_pos] != 0x00)
+                    return false;
+                m_pos++;
+            }
+            m_bits = 8;
+        }
+        b = (m_byte >> --m_bits) & 1;
+        return true;
+    }
+
+    bool receive(int count, int& v)
+    {
+        v = 0;
+        for (int i = 0; i < count; i++)
+        {
+            int b;
+            if (!bit(b))
+                return false;
+            v = (v << 1) | b;
+        }
+        return true;
+    }
+
+    // Annex F.2.2.3
+    bool symbol(const Huffman& t, int& s)
+    {
+        int32_t code = 0;
+        for (int len = 1; len <= 16; len++)
+        {
+            int b;
+            if (!bit(b))
+                return false;
+            code = (code << 1) | b;
+            if (code <= t.max_code[len])
+            {
+                s = t.values[t.val_ptr[len] + code - t.min_code[len]];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static int extend(int v, int n)
+    {
+        return n && v < (1 << (n - 1)) ? v - (1 << n) + 1 : v;
+    }
+
+    bool decode_block(Component& c, uint8_t* out, size_t stride)
+    {
+        // Zigzag: along the anti-diagonals, alternating direction
+        static const auto zigzag = [] {
+            std::vector<int> order;
+            for (int d = 0; d < 15; d++)
+                for (int i = 0; i < 8; i++)
+                {
+                    int row = d % 2 ? i : d - i;
+                    int col = d - row;
+                    if (row >= 0 && row < 8 && col >= 0 && col < 8)
+                        order.push_back(row * 8 + col);
+                }
+            return order;
+        }();
+
+        float coef[64] = {};
+        const uint8_t* q = m_quant[c.quant];
+        int t, v;
+        if (!symbol(m_huff[0][c.dc], t) || t > 11 || !receive(t, v))
+            return false;
+        c.pred += extend(v, t);
+        coef[0] = (float)(c.pred * q[0]);
+        for (int k = 1; k < 64; )
+        {
+            int rs;
+            if (!symbol(m_huff[1][c.ac], rs))
+                return false;
+            int run = rs >> 4, size = rs & 15;
+            if (size == 0)
+            {
+                if (run != 15)
+                    break; // EOB
+                k += 16;
+                continue;
+            }
+            k += run;
+            if (k > 63 || !receive(size, v))
+                return false;
+            coef[zigzag[k]] = (float)(extend(v, size) * q[k]);
+            k++;
+        }
+
+        for (int y = 0; y < 8; y++)
+            for (int x = 0; x < 8; x++)
+            {
+                double sum = 0;
+                for (int v2 = 0; v2 < 8; v2++)
+                    for (int u = 0; u < 8; u++)
+                    {
+                        float f = coef[v2 * 8 + u];
+                        if (f == 0)
+                            continue;
+                        double cu = u ? 1.0 : std::sqrt(0.5), cv = v2 ? 1.0 : std::sqrt(0.5);
+                        sum += cu * cv * f * std::cos((2 * x + 1) * u * M_PI / 16)
+                               * std::cos((2 * y + 1) * v2 * M_PI / 16);
+                    }
+                long s = std::lround(sum / 4 + 128);
+                out[y * stride + x] = (uint8_t)std::max(0L, std::min(255L, s));
+            }
+        return true;
+    }
+
+    bool decode_scan(std::vector<uint8_t>& rgb)
+    {
+        uint32_t mcu_w = 8 * m_hmax, mcu_h = 8 * m_vmax;
+        uint32_t mcus_x = (m_width + mcu_w - 1) / mcu_w, mcus_y = (m_height + mcu_h - 1) / mcu_h;
+        for (Component& c : m_components)
+        {
+            c.pred = 0;
+            c.stride = (size_t)mcus_x * c.h * 8;
+            c.plane.assign(c.stride * mcus_y * c.v * 8, 0);
+        }
+        for (uint32_t my = 0; my < mcus_y; my++)
+            for (uint32_t mx = 0; mx < mcus_x; mx++)
+                for (Component& c : m_components)
+                    for (int by = 0; by < c.v; by++)
+                        for (int bx = 0; bx < c.h; bx++)
+                        {
+                            size_t x = ((size_t)mx * c.h + bx) * 8;
+                            size_t y = ((size_t)my * c.v + by) * 8;
+                            if (!decode_block(c, &c.plane[y * c.stride + x], c.stride))
+                                return false;
+                        }
+
+        rgb.resize((size_t)m_width * m_height * 3);
+        for (uint32_t y = 0; y < m_height; y++)
+            for (uint32_t x = 0; x < m_width; x++)
+            {
+                float s[3];
+                for (int i = 0; i < 3; i++)
+                {
+                    const Component& c = m_components[i];
+                    s[i] = c.plane[(size_t)(y * c.v / m_vmax) * c.stride + x * c.h / m_hmax];
+                }
+                float cb = s[1] - 128, cr = s[2] - 128;
+                float px[3] = { s[0] + 1.402f * cr, s[0] - 0.344136f * cb - 0.714136f * cr,
+                                s[0] + 1.772f * cb };
+                for (int i = 0; i < 3; i++)
+                    rgb[((size_t)y * m_width + x) * 3 + i]
+                        = (uint8_t)std::max(0L, std::min(255L, std::lround(px[i])));
+            }
+        return true;
+    }
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_pos = 0;
+    uint8_t m_byte = 0;
+    int m_bits = 0;
+    uint8_t m_quant[4][64] = {};
+    Huffman m_huff[2][4];
+    std::vector<Component> m_components;
+    uint32_t m_width = 0, m_height = 0, m_hmax = 1, m_vmax = 1;
+};
+
+bool image_writer_self_check(FILE* report)
+{
+    bool ok = true;
+
+    // A gradient not a multiple of the MCU size, in a padded buffer
+    const uint32_t w = 37, h = 21;
+    const size_t stride = w * 3 + 5;
+    std::vector<uint8_t> rgb(stride * h, 0xEE);
+    for (uint32_t y = 0; y < h; y++)
+        for (uint32_t x = 0; x < w; x++)
+        {
+            uint8_t* p = &rgb[y * stride + x * 3];
+            p[0] = (uint8_t)(x * 7);
+            p[1] = (uint8_t)(y * 12);
+            p[2] = (uint8_t)((x ^ y) * 5);
+        }
+
+    // PNG: lossless round trip, the stride dropped, and deflated: a flat
+    // frame shrinks to a sliver. Without zlib, no PNG at all
+    std::vector<uint8_t> png, back;
+    std::vector<uint8_t> big(200 * 120 * 3, 0x40);
+#ifdef BRIDGE_ZLIB
+    uint32_t bw = 0, bh = 0;
+    ok = ok && png_available() && encode_png(rgb.data(), w, h, stride, png)
+         && decode_png(png, bw, bh, back) && bw == w && bh == h;
+    for (uint32_t y = 0; ok && y < h; y++)
+        ok = memcmp(&back[y * w * 3], &rgb[y * stride], w * 3) == 0;
+    ok = ok && encode_png(big.data(), 200, 120, 200 * 3, png) && decode_png(png, bw, bh, back)
+         && back == big && png.size() < big.size() / 50;
+#else
+    ok = ok && !png_available() && !encode_png(big.data(), 200, 120, 200 * 3, png) && png.empty();
+#endif
+
+    // JPEG: markers in place, dimensions in the SOF0, no unstuffed 0xFF in
+    // the entropy-coded data, higher quality larger, and it decodes
+    std::vector<uint8_t> jpeg, jpeg_low;
+    encode_jpeg(rgb.data(), w, h, stride, 90, jpeg);
+    encode_jpeg(rgb.data(), w, h, stride, 20, jpeg_low);
+    ok = ok && jpeg.size() > 2 + 18 + 134 + 19 + 14 && jpeg[0] == 0xFF && jpeg[1] == 0xD8
+         && jpeg[jpeg.size() - 2] == 0xFF && jpeg[jpeg.size() - 1] == 0xD9
+         && jpeg_low.size() < jpeg.size();
+    size_t sof = 0, sos = 0;
+    for (size_t i = 2; ok && i + 4 < jpeg.size() && !sos; )
+    {
+        if (jpeg[i] != 0xFF)
+        {
+            ok = false;
+            break;
+        }
+        if (jpeg[i + 1] == 0xC0)
+            sof = i;
+        if (jpeg[i + 1] == 0xDA)
+            sos = i;
+        i += 2 + ((jpeg[i + 2] << 8) | jpeg[i + 3]);
+    }
+    ok = ok && sof && sos && ((jpeg[sof + 5] << 8) | jpeg[sof + 6]) == h
+         && ((jpeg[sof + 7] << 8) | jpeg[sof + 8]) == w;
+    for (size_t i = sos + 14; ok && i + 2 < jpeg.size(); i++)
+        ok = jpeg[i] != 0xFF || jpeg[i + 1] == 0x00;
+
+    // Decoded, the gradient comes back close to the source: its XOR
+    // channel has edges 4:2:0 cannot keep, so on average only
+    std::vector<uint8_t> decoded;
+    uint32_t dw = 0, dh = 0;
+    ok = ok && JpegReader().decode(jpeg, dw, dh, decoded) && dw == w && dh == h;
+    double error = 0;
+    for (uint32_t y = 0; ok && y < h; y++)
+        for (uint32_t x = 0; x < w * 3; x++)
+            error += std::abs(decoded[y * w * 3 + x] - rgb[y * stride + x]);
+    ok = ok && error / (w * h * 3) < 6.0;
+
+    // A smooth frame within a few codes everywhere
+    const uint32_t sw = 64, sh = 48;
+    std::vector<uint8_t> smooth(sw * sh * 3);
+    for (uint32_t y = 0; y < sh; y++)
+        for (uint32_t x = 0; x < sw; x++)
+        {
+            uint8_t* p = &smooth[(y * sw + x) * 3];
+            p[0] = (uint8_t)(x * 3);
+            p[1] = (uint8_t)(y * 4);
+            p[2] = (uint8_t)(100 + x + y);
+        }
+    encode_jpeg(smooth.data(), sw, sh, sw * 3, 90, jpeg);
+    ok = ok && JpegReader().decode(jpeg, dw, dh, decoded) && dw == sw && dh == sh;
+    for (size_t i = 0; ok && i < smooth.size(); i++)
+        ok = std::abs(decoded[i] - smooth[i]) <= 8;
+
+    // A flat grey frame is all DC: a handful of bytes per MCU, and grey
+    // again when decoded
+    std::vector<uint8_t> grey(64 * 64 * 3, 128);
+    encode_jpeg(grey.data(), 64, 64, 64 * 3, 85, jpeg);
+    ok = ok && jpeg.size() - sos < 16 * 6 + 16;
+    ok = ok && JpegReader().decode(jpeg, dw, dh, decoded) && decoded.size() == grey.size();
+    for (size_t i = 0; ok && i < grey.size(); i++)
+        ok = std::abs(decoded[i] - 128) <= 1;
+
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"image_writer\",\"ok\":%s}\n",
+            ok ? "true" : "false");
+    return ok;
+}
@@ -0,0 +1,372 @@
+#include "thumbnails.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Largest sprite canvas, rgb24
+static constexpr uint64_t kMaxSpriteBytes = 1ULL << 30;
+
+static bool parse_pick(const std::string& token, ThumbnailPick& pick)
+{
+    const char* s = token.c_str();
+    char* end = nullptr;
+    if (token == "first")
+    {
+        pick.kind = ThumbnailPick::Kind::Frame;
+        pick.value = 0;
+        return true;
+    }
+    if (token == "last")
+    {
+        pick.kind = ThumbnailPick::Kind::Last;
+        return true;
+    }
+    if (token.compare(0, 6, "every:") == 0)
+    {
+        pick.kind = ThumbnailPick::Kind::Every;
+        pick.value = strtod(s + 6, &end);
+        if (end != s + 6 && *end == 's')
+            end++;
+        return end != s + 6 && *end == '\0' && std::isfinite(pick.value) && pick.value > 0;
+    }
+    if (!token.empty() && token.back() == '%')
+    {
+        pick.kind = ThumbnailPick::Kind::Percent;
+        pick.value = strtod(s, &end);
+        return end == s + token.size() - 1 && end != s && pick.value >= 0 && pick.value <= 100;
+    }
+    if (token.empty() || token.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    pick.kind = ThumbnailPick::Kind::Frame;
+    pick.value = (double)strtoull(s, nullptr, 10);
+    return true;
+}
+
+bool parse_thumbnail_picks(const char* text, std::vector<ThumbnailPick>& picks)
+{
+    picks.clear();
+    std::string list = text;
+    size_t pos = 0;
+    while (true)
+    {
+        size_t comma = list.find(',', pos);
+        ThumbnailPick pick;
+        if (!parse_pick(list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos), pick))
+            return false;
+        picks.push_back(pick);
+        if (comma == std::string::npos)
+            return true;
+        pos = comma + 1;
+    }
+}
+
+bool resolve_thumbnail_frames(const std::vector<ThumbnailPick>& picks, uint64_t frame_count,
+                              uint32_t fps_num, uint32_t fps_den, std::vector<uint64_t>& frames,
+                              std::string& error)
+{
+    frames.clear();
+    if (frame_count == 0)
+        return true;
+    uint64_t last = frame_count - 1;
+    for (const ThumbnailPick& pick : picks)
+    {
+        switch (pick.kind)
+        {
+        case ThumbnailPick::Kind::Frame:
+            frames.push_back(std::min<uint64_t>((uint64_t)pick.value, last));
+            break;
+        case ThumbnailPick::Kind::Last:
+            frames.push_back(last);
+            break;
+        case ThumbnailPick::Kind::Percent:
+            frames.push_back((uint64_t)std::floor(last * pick.value / 100.0));
+            break;
+        case ThumbnailPick::Kind::Every:
+        {
+            if (fps_num == 0 || fps_den == 0)
+            {
+                error = "--thumbnail-at every: needs a clip with a frame rate";
+                return false;
+            }
+            // Steps under a frame land on the same frame several times
+            double step = pick.value * fps_num / fps_den;
+            uint64_t previous = UINT64_MAX;
+            for (uint64_t k = 0; frames.size() <= kMaxThumbnails; k++)
+            {
+                uint64_t frame = (uint64_t)std::llround(k * step);
+                if (frame > last)
+                    break;
+                if (frame != previous)
+                    frames.push_back(frame);
+                previous = frame;
+            }
+            break;
+        }
+        }
+    }
+
+    std::sort(frames.begin(), frames.end());
+    frames.erase(std::unique(frames.begin(), frames.end()), frames.end());
+    if (frames.size() > kMaxThumbnails)
+    {
+        error = "--thumbnail-at picks more than " + std::to_string(kMaxThumbnails) + " frames";
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ThumbnailSink
+// ---------------------------------------------------------------------------
+
+bool ThumbnailSink::open(const ThumbnailConfig& config, const std::vector<uint64_t>& frames,
+                         std::string& error)
+{
+    m_config = config;
+    m_frames = frames;
+    m_sheet.clear();
+    m_sprite_path.clear();
+    m_vtt_path.clear();
+    m_columns = m_rows = 0;
+
+    if (config.format == ImageFormat::Png && !png_available())
+    {
+        error = "PNG thumbnails need a bridge built with zlib; use --thumbnail-format jpeg";
+        return false;
+    }
+    if (mkdir(config.dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        error = "Cannot create " + config.dir + ": " + strerror(errno);
+        return false;
+    }
+    if (!sprite() || frames.empty())
+        return true;
+
+    m_columns = std::min<uint32_t>(config.columns, (uint32_t)frames.size());
+    m_rows = (uint32_t)((frames.size() + m_columns - 1) / m_columns);
+    uint64_t sheet_width = (uint64_t)m_columns * config.tile_width;
+    uint64_t sheet_height = (uint64_t)m_rows * config.tile_height;
+    if (sheet_width * sheet_height * 3 > kMaxSpriteBytes
+        || (config.format == ImageFormat::Jpeg
+            && (sheet_width > kJpegMaxDimension || sheet_height > kJpegMaxDimension)))
+    {
+        error = "A sprite sheet of " + std::to_string(sheet_width) + "x" + std::to_string(sheet_height)
+              + " is too large; pick fewer frames, fewer --sprite columns or a smaller --output-size";
+        return false;
+    }
+    m_sheet.assign(sheet_width * sheet_height * 3, 0);
+
+    std::string base = config.dir + "/" + config.clip_name + "_sprite";
+    m_sprite_path = base + "." + image_format_extension(config.format);
+    m_vtt_path = base + ".vtt";
+    return true;
+}
+
+bool ThumbnailSink::add(size_t index, const uint8_t* rgb, std::string& path, std::string& error)
+{
+    size_t tile_row = (size_t)m_config.tile_width * 3;
+    path.clear();
+    if (sprite())
+    {
+        size_t sheet_row = tile_row * m_columns;
+        uint8_t* dst = m_sheet.data() + (index / m_columns) * m_config.tile_height * sheet_row
+                     + (index % m_columns) * tile_row;
+        for (uint32_t y = 0; y < m_config.tile_height; y++)
+            memcpy(dst + y * sheet_row, rgb + y * tile_row, tile_row);
+        return true;
+    }
+
+    char frame[32];
+    snprintf(frame, sizeof(frame), "_%06llu.", (unsigned long long)m_frames[index]);
+    path = m_config.dir + "/" + m_config.clip_name + frame + image_format_extension(m_config.format);
+    std::vector<uint8_t> image;
+    if (!encode_image(m_config.format, rgb, m_config.tile_width, m_config.tile_height, tile_row,
+                      m_config.quality, image))
+    {
+        error = "Cannot encode " + path;
+        return false;
+    }
+    return write_file(path, image, error);
+}
+
+bool ThumbnailSink::finish(std::string& error)
+{
+    if (!sprite() || m_frames.empty())
+        return true;
+
+    std::vector<uint8_t> image;
+    if (!encode_image(m_config.format, m_sheet.data(), m_columns * m_config.tile_width,
+                      m_rows * m_config.tile_height, (size_t)m_columns * m_config.tile_width * 3,
+                      m_config.quality, image))
+    {
+        error = "Cannot encode " + m_sprite_path;
+        return false;
+    }
+    if (!write_file(m_sprite_path, image, error))
+        return false;
+
+    // One cue per tile, until the next tile's frame (the last one until the
+    // end of the clip), pointing at the tile's rectangle
+    std::string sprite_name = m_sprite_path.substr(m_sprite_path.rfind('/') + 1);
+    std::string vtt = "WEBVTT\n\n";
+    for (size_t i = 0; i < m_frames.size(); i++)
+    {
+        uint64_t end = i + 1 < m_frames.size() ? m_frames[i + 1] : m_config.frame_count;
+        char rect[96];
+        snprintf(rect, sizeof(rect), "#xywh=%u,%u,%u,%u\n\n",
+                 (uint32_t)(i % m_columns) * m_config.tile_width,
+                 (uint32_t)(i / m_columns) * m_config.tile_height,
+                 m_config.tile_width, m_config.tile_height);
+        vtt += webvtt_timestamp(frame_time(m_frames[i])) + " --> " + webvtt_timestamp(frame_time(end))
+             + "\n" + sprite_name + rect;
+    }
+    return write_file(m_vtt_path, std::vector<uint8_t>(vtt.begin(), vtt.end()), error);
+}
+
+double ThumbnailSink::frame_time(uint64_t frame) const
+{
+    return m_config.fps_num ? (double)frame * m_config.fps_den / m_config.fps_num : 0.0;
+}
+
+std::string thumbnail_clip_name(const std::string& input)
+{
+    size_t slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.rfind('.');
+    return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+std::string webvtt_timestamp(double seconds)
+{
+    unsigned long long ms = (unsigned long long)std::llround(std::max(0.0, seconds) * 1000);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%02llu:%02llu:%02llu.%03llu",
+             ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000);
+    return buf;
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+static bool read_text(const std::string& path, std::string& text)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    char buf[4096];
+    size_t n;
+    text.clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        text.append(buf, n);
+    fclose(f);
+    return true;
+}
+
+bool thumbnails_self_check(FILE* report)
+{
+    bool ok = true;
+    std::string error;
+    std::vector<ThumbnailPick> picks;
+    std::vector<uint64_t> frames;
+
+    // 250 frames at 25 fps
+    ok = ok && parse_thumbnail_picks("first,50%,last,every:2s,12,100000", picks) && picks.size() == 6
+         && resolve_thumbnail_frames(picks, 250, 25, 1, frames, error)
+         && frames == std::vector<uint64_t>({ 0, 12, 50, 100, 124, 150, 200, 249 });
+    ok = ok && parse_thumbnail_picks("every:1.001", picks)
+         && resolve_thumbnail_frames(picks, 100, 30000, 1001, frames, error)
+         && frames == std::vector<uint64_t>({ 0, 30, 60, 90 });
+    ok = ok && !parse_thumbnail_picks("", picks) && !parse_thumbnail_picks("first,,last", picks)
+         && !parse_thumbnail_picks("101%", picks) && !parse_thumbnail_picks("every:0", picks)
+         && !parse_thumbnail_picks("every:-2", picks) && !parse_thumbnail_picks("-3", picks)
+         && !parse_thumbnail_picks("middle", picks);
+    ok = ok && parse_thumbnail_picks("every:0.001", picks)
+         && !resolve_thumbnail_frames(picks, 1000000, 25, 1, frames, error);
+
+    ok = ok && thumbnail_clip_name("/card/A001_C002.braw") == "A001_C002"
+         && thumbnail_clip_name("A001.R3D") == "A001" && thumbnail_clip_name("/x/.hidden") == ".hidden";
+    ok = ok && webvtt_timestamp(3723.4567) == "01:02:03.457" && webvtt_timestamp(0) == "00:00:00.000";
+
+    char dir[] = "/tmp/thumbnails-XXXXXX";
+    if (!mkdtemp(dir))
+        ok = false;
+    else
+    {
+        std::string out_dir = std::string(dir) + "/out";
+        std::vector<uint8_t> tile(4 * 2 * 3);
+
+        // A sprite of five 4x2 tiles in three columns, PNG
+        ThumbnailConfig config;
+        config.dir = out_dir;
+        config.clip_name = "A001";
+        config.format = ImageFormat::Png;
+        config.columns = 3;
+        config.tile_width = 4;
+        config.tile_height = 2;
+        config.fps_num = 25;
+        config.fps_den = 1;
+        config.frame_count = 250;
+        ThumbnailSink sink;
+        std::string path;
+        frames = { 0, 12, 50, 100, 249 };
+        if (!png_available())
+        {
+            // Refused up front, before any decoding
+            ok = ok && !sink.open(config, frames, error);
+        }
+        else
+        {
+            ok = ok && sink.open(config, frames, error) && sink.columns() == 3 && sink.rows() == 2;
+            for (size_t i = 0; ok && i < frames.size(); i++)
+            {
+                std::fill(tile.begin(), tile.end(), (uint8_t)(i * 40));
+                ok = sink.add(i, tile.data(), path, error) && path.empty();
+            }
+            std::string vtt;
+            ok = ok && sink.finish(error) && sink.sprite_path() == out_dir + "/A001_sprite.png"
+                 && read_text(sink.vtt_path(), vtt)
+                 && vtt.compare(0, 8, "WEBVTT\n\n") == 0
+                 && vtt.find("00:00:00.000 --> 00:00:00.480\nA001_sprite.png#xywh=0,0,4,2\n\n") != std::string::npos
+                 && vtt.find("00:00:04.000 --> 00:00:09.960\nA001_sprite.png#xywh=0,2,4,2\n\n") != std::string::npos
+                 && vtt.find("00:00:09.960 --> 00:00:10.000\nA001_sprite.png#xywh=4,2,4,2\n\n") != std::string::npos;
+            std::string sprite;
+            ok = ok && read_text(sink.sprite_path(), sprite) && sprite.compare(1, 3, "PNG") == 0;
+            unlink(sink.sprite_path().c_str());
+            unlink(sink.vtt_path().c_str());
+        }
+
+        // One JPEG per frame
+        config.columns = 0;
+        config.format = ImageFormat::Jpeg;
+        frames = { 7, 123456 };
+        ok = ok && sink.open(config, frames, error);
+        for (size_t i = 0; ok && i < frames.size(); i++)
+        {
+            ok = sink.add(i, tile.data(), path, error)
+                 && path == out_dir + (i ? "/A001_123456.jpg" : "/A001_000007.jpg")
+                 && access(path.c_str(), F_OK) == 0;
+            unlink(path.c_str());
+        }
+        ok = ok && sink.finish(error);
+
+        // Too large a sheet
+        config.columns = 1;
+        config.tile_height = 40000;
+        frames = { 0, 1 };
+        ok = ok && !sink.open(config, frames, error);
+
+        rmdir(out_dir.c_str());
+        rmdir(dir);
+    }
+
+    fprintf(report, "{\"type\":\"self_check\",\"check\":\"thumbnails\",\"ok\":%s}\n",
+            ok ? "true" : "false");
+    return ok;
+}
@@ -0,0 +1,107 @@
+// thumbnails: poster frames and scrub sprites for --thumbnails, without a
+// proxy decode.
+//
+// --thumbnail-at picks the frames: "first", "last", a frame number, a
+// percentage of the clip ("50%") or "every:S" (a frame every S seconds),
+// comma separated; they are decoded in frame order. The bridge decodes
+// only those, side by side at the smallest SDK scale that covers
+// --output-size, resizes them in the post stage and hands each to a
+// ThumbnailSink, which writes one image per frame or, with --sprite, packs
+// them into one sprite sheet with a WebVTT index of the tiles
+// ("<sprite>#xywh=x,y,w,h" per cue, as players' scrub bars read them).
+//
+// Files go to the --thumbnails directory, named after the clip:
+// <clip>_<frame>.jpg, or <clip>_sprite.jpg and <clip>_sprite.vtt.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "image_writer.h"
+
+// One entry of --thumbnail-at
+struct ThumbnailPick
+{
+    enum class Kind { Frame, Last, Percent, Every };
+
+    Kind kind = Kind::Frame;
+    double value = 0; // frame, percent or seconds
+};
+
+// Most frames one run picks
+static constexpr size_t kMaxThumbnails = 10000;
+
+// Parses a --thumbnail-at list; false if an entry is malformed
+bool parse_thumbnail_picks(const char* text, std::vector<ThumbnailPick>& picks);
+
+// The frames `picks` name in a clip of frame_count frames at
+// fps_num/fps_den: in range, sorted, each once. Returns false and sets
+// `error` if there are more than kMaxThumbnails.
+bool resolve_thumbnail_frames(const std::vector<ThumbnailPick>& picks, uint64_t frame_count,
+                              uint32_t fps_num, uint32_t fps_den, std::vector<uint64_t>& frames,
+                              std::string& error);
+
+struct ThumbnailConfig
+{
+    std::string dir;        // created if missing
+    std::string clip_name;  // file name prefix, e.g. the clip's file stem
+    ImageFormat format = ImageFormat::Jpeg;
+    int quality = 85;       // JPEG
+    uint32_t columns = 0;   // sprite sheet columns; 0 = one file per frame
+    uint32_t tile_width = 0;
+    uint32_t tile_height = 0;
+    uint32_t fps_num = 0;   // the clip's, for the WebVTT cue times
+    uint32_t fps_den = 1;
+    uint64_t frame_count = 0;
+};
+
+class ThumbnailSink
+{
+public:
+    // Prepares the output for `frames` (see resolve_thumbnail_frames()). On
+    // failure returns false and sets `error`.
+    bool open(const ThumbnailConfig& config, const std::vector<uint64_t>& frames, std::string& error);
+
+    // Takes thumbnail `index` as a packed rgb24 tile: writes its file (path
+    // in `path`) or copies it into the sprite (`path` cleared). On failure
+    // returns false and sets `error`.
+    bool add(size_t index, const uint8_t* rgb, std::string& path, std::string& error);
+
+    // Writes the sprite sheet and its WebVTT index; nothing for single
+    // files. On failure returns false and sets `error`.
+    bool finish(std::string& error);
+
+    bool sprite() const { return m_config.columns != 0; }
+    const std::string& sprite_path() const { return m_sprite_path; }
+    const std::string& vtt_path() const { return m_vtt_path; }
+    uint32_t columns() const { return m_columns; }
+    uint32_t rows() const { return m_rows; }
+
+    // Seconds into the clip of `frame`
+    double frame_time(uint64_t frame) const;
+
+private:
+    ThumbnailConfig m_config;
+    std::vector<uint64_t> m_frames;
+    std::vector<uint8_t> m_sheet; // sprite canvas, rgb24
+    std::string m_sprite_path;
+    std::string m_vtt_path;
+    uint32_t m_columns = 0;
+    uint32_t m_rows = 0;
+};
+
+// File name prefix for a clip's thumbnails: its file name without
+// directory and extension
+std::string thumbnail_clip_name(const std::string& input);
+
+// "HH:MM:SS.mmm"
+std::string webvtt_timestamp(double seconds);
+
+// bridge-common-tests: picks, sprite layout and a WebVTT index written to a
+// temporary directory. Prints one {"type":"self_check","check":"thumbnails"}
+// line; returns false on mismatch.
+bool thumbnails_self_check(FILE* report);
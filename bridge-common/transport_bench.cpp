@@ -0,0 +1,288 @@
+#include "transport_bench.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#endif
+
+#include "frame_pool.h"
+#include "frame_writer.h"
+#include "shm_ring.h"
+
+static constexpr uint32_t kBenchDepth = 3;
+
+enum class Transport
+{
+    Writev,
+    Vmsplice,
+    Shm,
+};
+
+static const char* transport_name(Transport t)
+{
+    switch (t)
+    {
+        case Transport::Writev:   return "writev";
+        case Transport::Vmsplice: return "vmsplice";
+        case Transport::Shm:      return "shm";
+    }
+    return "?";
+}
+
+struct TransportRun
+{
+    bool ok = false;
+    double seconds = 0.0;
+    FrameWriter::Stats stats;
+};
+
+static uint8_t bench_frame_value(uint64_t frame)
+{
+    return (uint8_t)(frame * 37 + 1);
+}
+
+// ---------------------------------------------------------------------------
+// Consumers
+// ---------------------------------------------------------------------------
+
+// Reads the pipe in 1 MiB chunks, like FFmpeg's pipe protocol
+static void pipe_consumer(int fd, size_t frame_bytes, bool& verified, uint64_t& received)
+{
+    std::vector<uint8_t> buf(1 << 20);
+    for (;;)
+    {
+        ssize_t n = read(fd, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        for (size_t i = 0; i < (size_t)n; i += 4096)
+        {
+            if (buf[i] != bench_frame_value((received + i) / frame_bytes))
+                verified = false;
+        }
+        received += (uint64_t)n;
+    }
+}
+
+#ifdef __linux__
+
+// Takes the ring over the socket the way the backend's reader does, going
+// by the documented header offsets, and reads every frame in place
+static void shm_consumer(int sock, bool& verified, uint64_t& received)
+{
+    char payload[8];
+    struct iovec iov = { payload, sizeof(payload) };
+    union
+    {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr* cmsg = nullptr;
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) <= 0
+        || !(cmsg = CMSG_FIRSTHDR(&msg)) || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        verified = false;
+        return;
+    }
+    int fds[3];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    int memfd = fds[0], ready_fd = fds[1], free_fd = fds[2];
+
+    struct stat st;
+    fstat(memfd, &st);
+    uint8_t* base = (uint8_t*)mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED, memfd, 0);
+    if (base == MAP_FAILED)
+    {
+        verified = false;
+        return;
+    }
+
+    uint32_t header_bytes, slot_count;
+    uint64_t slot_stride, frame_bytes;
+    memcpy(&header_bytes, base + 8, 4);
+    memcpy(&slot_count, base + 12, 4);
+    memcpy(&slot_stride, base + 16, 8);
+    memcpy(&frame_bytes, base + 24, 8);
+    uint64_t* produced = (uint64_t*)(base + 64);
+    uint32_t* closed = (uint32_t*)(base + 72);
+    uint64_t* consumed = (uint64_t*)(base + 128);
+    const uint32_t* order = (const uint32_t*)(base + 192);
+
+    uint64_t next = 0;
+    for (;;)
+    {
+        if (next < __atomic_load_n(produced, __ATOMIC_ACQUIRE))
+        {
+            const uint8_t* frame = base + header_bytes + order[next % slot_count] * slot_stride;
+            for (size_t i = 0; i < frame_bytes; i += 4096)
+            {
+                if (frame[i] != bench_frame_value(next))
+                    verified = false;
+            }
+            received += frame_bytes;
+            next++;
+            __atomic_store_n(consumed, next, __ATOMIC_RELEASE);
+            uint64_t one = 1;
+            (void)!write(free_fd, &one, sizeof(one));
+            continue;
+        }
+        if (__atomic_load_n(closed, __ATOMIC_ACQUIRE)
+            && next == __atomic_load_n(produced, __ATOMIC_ACQUIRE))
+            break;
+        uint64_t count;
+        (void)!read(ready_fd, &count, sizeof(count));
+    }
+
+    munmap(base, (size_t)st.st_size);
+    for (int fd : fds)
+        close(fd);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Runs
+// ---------------------------------------------------------------------------
+
+static bool run_transport(Transport t, size_t width, size_t height, uint32_t frames,
+                          TransportRun& run)
+{
+    const size_t frame_bytes = pix_fmt_frame_bytes(PixFmt::RGB24, width, height);
+
+    // fds[1] is the bridge's end, fds[0] the consumer's
+    int fds[2];
+#ifdef __linux__
+    int rc = t == Transport::Shm ? socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds)
+                                 : pipe(fds);
+#else
+    if (t == Transport::Shm)
+        return false;
+    int rc = pipe(fds);
+#endif
+    if (rc != 0)
+        return false;
+
+    FramePoolConfig config;
+    config.buffer_bytes = frame_bytes;
+    config.count = kBenchDepth + 1;
+    config.alignment = kFrameWriterAlignment;
+
+    ShmRing ring;
+    std::string error;
+    if (t == Transport::Shm)
+    {
+        if (!ring.init(PixFmt::RGB24, width, height, frame_bytes, config.count, error)
+            || !ring.send_fds(fds[1], error))
+        {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        config.external = ring.slots();
+        fds[1] = -1; // the ring owns the socket now
+    }
+
+    FramePool pool;
+    if (!pool.init(config, error))
+    {
+        close(fds[0]);
+        if (fds[1] >= 0)
+            close(fds[1]);
+        return false;
+    }
+
+    bool verified = true;
+    uint64_t received = 0;
+    std::thread consumer([&]
+    {
+#ifdef __linux__
+        if (t == Transport::Shm)
+            shm_consumer(fds[0], verified, received);
+        else
+#endif
+            pipe_consumer(fds[0], frame_bytes, verified, received);
+        close(fds[0]);
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok;
+    {
+        FrameWriter writer(fds[1], PixFmt::RGB24, width, height, kBenchDepth,
+                           t == Transport::Shm ? &ring : nullptr, nullptr, nullptr,
+                           t == Transport::Vmsplice);
+        for (uint32_t f = 0; f < frames; f++)
+        {
+            uint8_t* buf = pool.checkout();
+            memset(buf, bench_frame_value(f), frame_bytes);
+            if (!writer.push(buf, &pool))
+                break;
+        }
+        ok = writer.finish();
+        run.stats = writer.stats();
+    }
+    if (fds[1] >= 0)
+        close(fds[1]);
+    consumer.join();
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    run.ok = ok && verified && received == (uint64_t)frames * frame_bytes;
+    return true;
+}
+
+static void print_run(FILE* out, const char* type, Transport t, size_t width, size_t height,
+                      uint32_t frames, const TransportRun& run)
+{
+    double mpix = (double)width * height * frames / 1e6;
+    fprintf(out,
+        "{\"type\":\"%s\",\"check\":\"frame_transport\",\"transport\":\"%s\","
+        "\"width\":%zu,\"height\":%zu,\"ok\":%s,\"mpix_per_s\":%.1f,"
+        "\"calls_per_frame\":%.1f,\"copied_mib\":%.1f,\"pipe_kib\":%zu}\n",
+        type, transport_name(t), width, height, run.ok ? "true" : "false",
+        run.seconds > 0.0 ? mpix / run.seconds : 0.0,
+        (double)run.stats.write_calls / frames,
+        (double)(run.stats.bytes - run.stats.spliced_bytes) / (1 << 20),
+        run.stats.pipe_bytes / 1024);
+}
+
+static bool run_all(FILE* out, const char* type, size_t width, size_t height, uint32_t frames)
+{
+    bool all_ok = true;
+    for (Transport t : { Transport::Writev, Transport::Vmsplice, Transport::Shm })
+    {
+        TransportRun run;
+        if (!run_transport(t, width, height, frames, run))
+            run.ok = false;
+        print_run(out, type, t, width, height, frames, run);
+        all_ok = all_ok && run.ok;
+    }
+    return all_ok;
+}
+
+bool transport_self_check(FILE* out)
+{
+    return run_all(out, "self_check", 1920, 1080, 64);
+}
+
+bool transport_bench(FILE* out, size_t width, size_t height, uint32_t frames)
+{
+    return run_all(out, "bench", width, height, frames);
+}
@@ -0,0 +1,21 @@
+// transport_bench: how frames get from a bridge to its consumer, measured.
+// rgb24 frames go through a FrameWriter to a consumer thread over each
+// transport: a pipe with writev, a pipe with vmsplice, and a ShmRing whose
+// fds travel over a socketpair. The pipe consumer reads the way FFmpeg's
+// pipe protocol does; the ring consumer reads the slots in place. Both check
+// one byte per page, so a buffer reused too early shows as ok:false.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// --self-check: 1080p, one {"type":"self_check","check":"frame_transport"}
+// line per transport
+bool transport_self_check(FILE* out);
+
+// --bench-transport: one {"type":"bench","check":"frame_transport"} line
+// per transport with throughput, write calls per frame and MiB copied into
+// the kernel
+bool transport_bench(FILE* out, size_t width, size_t height, uint32_t frames);
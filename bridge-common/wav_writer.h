@@ -0,0 +1,72 @@
+// wav_writer: streams PCM into a WAV file for --extract-audio, so a clip's
+// audio goes to disk block by block as the SDK decodes it and memory stays
+// the same whatever the clip length.
+//
+// The header goes out first with placeholder sizes and a 28-byte JUNK chunk
+// after "WAVE"; finish() seeks back and fills the sizes in. Past 4 GiB of
+// data the file becomes RF64 (EBU Tech 3306): "RIFF" turns into "RF64", the
+// 32-bit sizes into 0xFFFFFFFF and the JUNK chunk into the ds64 chunk that
+// carries the 64-bit sizes. FFmpeg's wav demuxer reads both.
+//
+// Also home to the big-endian -> little-endian swap of 32-bit samples that
+// R3D audio blocks need, with SIMD variants picked at runtime.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "cpu_features.h"
+
+class WavWriter
+{
+public:
+    WavWriter() = default;
+    ~WavWriter();
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    // Creates `path` and writes the header for interleaved signed PCM (8-bit
+    // unsigned). On failure returns false and sets `error`.
+    bool open(const char* path, uint32_t sample_rate, uint32_t channels,
+              uint32_t bits_per_sample, std::string& error);
+
+    // Appends interleaved samples. Returns false on a write error.
+    bool write(const void* samples, size_t bytes);
+
+    // Fills in the sizes (RF64 past 4 GiB) and closes the file. On failure
+    // returns false and sets `error`. A writer destroyed without finish()
+    // leaves an incomplete file behind.
+    bool finish(std::string& error);
+
+    uint64_t data_bytes() const { return m_data_bytes; }
+
+private:
+    FILE* m_file = nullptr;
+    uint32_t m_block_align = 0;
+    uint64_t m_data_bytes = 0;
+    bool m_failed = false;
+};
+
+// Reverses the bytes of each 32-bit word in place: words = bytes / 4
+using Bswap32Fn = void (*)(uint8_t* data, size_t words);
+
+// Kernel for the given level; falls back to the next lower level the build
+// provides. Never returns null.
+Bswap32Fn bswap32_kernel(SimdLevel level);
+
+// Swaps every whole 32-bit word of `bytes` with the best kernel for this CPU
+void bswap32_buffer(uint8_t* data, size_t bytes);
+
+// --self-check: compares every SIMD swap this CPU supports against the
+// scalar reference. Writes one NDJSON line per ISA to `report`; returns true
+// if all match.
+bool bswap32_self_check(FILE* report);
+
+// bridge-common-tests: writes a short WAV and an RF64 header and reads them
+// back. Prints one {"type":"self_check","check":"wav_writer"} line; returns
+// false on mismatch.
+bool wav_writer_self_check(FILE* report);
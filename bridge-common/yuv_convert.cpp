@@ -0,0 +1,566 @@
+#include "yuv_convert.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "pixel_convert.h"
+#include "stripe_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BRIDGE_X86 1
+#endif
+
+// Matrix coefficients are scaled by 2^kMatrixBits; per-pixel chroma is kept
+// at 2^kChromaBits so the subsampling filter sums cannot overflow int32
+static constexpr int kMatrixBits = 20;
+static constexpr int kChromaBits = 16;
+
+// ---------------------------------------------------------------------------
+// Option parsing
+// ---------------------------------------------------------------------------
+
+bool parse_yuv_range(const char* name, YuvRange& range)
+{
+    if (strcmp(name, "limited") == 0)
+        range = YuvRange::Limited;
+    else if (strcmp(name, "full") == 0)
+        range = YuvRange::Full;
+    else
+        return false;
+    return true;
+}
+
+const char* yuv_range_name(YuvRange range)
+{
+    return range == YuvRange::Full ? "full" : "limited";
+}
+
+// ---------------------------------------------------------------------------
+// BT.709 matrix
+// ---------------------------------------------------------------------------
+
+static YuvMatrix build_matrix(uint32_t src_bits, uint32_t out_bits, YuvRange range)
+{
+    static constexpr double kKr = 0.2126, kKb = 0.0722;
+
+    const int32_t max_code = (1 << out_bits) - 1;
+    const int level_shift = (int)out_bits - 8;
+    double y_scale, c_scale;
+    int32_t y_offset;
+    if (range == YuvRange::Limited)
+    {
+        y_scale = (double)(219 << level_shift);
+        c_scale = (double)(224 << level_shift);
+        y_offset = 16 << level_shift;
+    }
+    else
+    {
+        y_scale = (double)max_code;
+        c_scale = (double)max_code;
+        y_offset = 0;
+    }
+
+    const double unit = (double)(1 << kMatrixBits) / (double)((1u << src_bits) - 1);
+    auto fixed = [unit](double v) { return (int32_t)std::lround(v * unit); };
+
+    YuvMatrix m;
+    // The middle coefficient takes the rounding slack so that grey maps to
+    // exactly the reference Y and to zero chroma
+    m.yr = fixed(kKr * y_scale);
+    m.yb = fixed(kKb * y_scale);
+    m.yg = fixed(y_scale) - m.yr - m.yb;
+    m.ur = fixed(-kKr / (2.0 * (1.0 - kKb)) * c_scale);
+    m.ub = fixed(0.5 * c_scale);
+    m.ug = -m.ur - m.ub;
+    m.vr = fixed(0.5 * c_scale);
+    m.vb = fixed(-kKb / (2.0 * (1.0 - kKr)) * c_scale);
+    m.vg = -m.vr - m.vb;
+    m.y_bias = (y_offset << kMatrixBits) + (1 << (kMatrixBits - 1));
+    m.max_code = max_code;
+    m.chroma_offset = 1 << (out_bits - 1);
+    return m;
+}
+
+// ---------------------------------------------------------------------------
+// Row kernels
+// ---------------------------------------------------------------------------
+
+static inline int32_t clamp_code(int32_t v, int32_t max_code)
+{
+    return v < 0 ? 0 : (v > max_code ? max_code : v);
+}
+
+template <RgbSource S>
+static inline void load_rgb(const uint8_t* p, int32_t& r, int32_t& g, int32_t& b)
+{
+    if constexpr (S == RgbSource::RGB16)
+    {
+        uint16_t v[3];
+        memcpy(v, p, sizeof(v));
+        r = v[0]; g = v[1]; b = v[2];
+    }
+    else if constexpr (S == RgbSource::BGR8)
+    {
+        b = p[0]; g = p[1]; r = p[2];
+    }
+    else
+    {
+        r = p[0]; g = p[1]; b = p[2];
+    }
+}
+
+template <RgbSource S>
+static constexpr size_t source_bpp()
+{
+    return S == RgbSource::RGB16 ? 6 : (S == RgbSource::RGBA8 ? 4 : 3);
+}
+
+template <RgbSource S>
+static void rows_scalar(const uint8_t* src, size_t pixels, const YuvMatrix& m,
+                        int32_t* y, int32_t* cb, int32_t* cr)
+{
+    constexpr int kChromaShift = kMatrixBits - kChromaBits;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        int32_t r, g, b;
+        load_rgb<S>(src + i * source_bpp<S>(), r, g, b);
+        y[i] = clamp_code((m.yr * r + m.yg * g + m.yb * b + m.y_bias) >> kMatrixBits, m.max_code);
+        cb[i] = (m.ur * r + m.ug * g + m.ub * b) >> kChromaShift;
+        cr[i] = (m.vr * r + m.vg * g + m.vb * b) >> kChromaShift;
+    }
+}
+
+#ifdef BRIDGE_X86
+
+// Eight pixels per step. Packed 3- and 6-byte pixels are fetched with 32-bit
+// gathers that read a little past the pixel, so the loop stops one pixel
+// early and leaves the tail to the scalar kernel.
+template <RgbSource S>
+__attribute__((target("avx2")))
+static void rows_avx2(const uint8_t* src, size_t pixels, const YuvMatrix& m,
+                      int32_t* y, int32_t* cb, int32_t* cr)
+{
+    constexpr int kChromaShift = kMatrixBits - kChromaBits;
+    const __m256i yr = _mm256_set1_epi32(m.yr), yg = _mm256_set1_epi32(m.yg), yb = _mm256_set1_epi32(m.yb);
+    const __m256i ur = _mm256_set1_epi32(m.ur), ug = _mm256_set1_epi32(m.ug), ub = _mm256_set1_epi32(m.ub);
+    const __m256i vr = _mm256_set1_epi32(m.vr), vg = _mm256_set1_epi32(m.vg), vb = _mm256_set1_epi32(m.vb);
+    const __m256i y_bias = _mm256_set1_epi32(m.y_bias);
+    const __m256i max_code = _mm256_set1_epi32(m.max_code);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+    const __m256i word_mask = _mm256_set1_epi32(0xFFFF);
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                               _mm256_set1_epi32((int)source_bpp<S>()));
+
+    size_t i = 0;
+    for (; i + 8 < pixels; i += 8)
+    {
+        const uint8_t* p = src + i * source_bpp<S>();
+        __m256i r, g, b;
+        if constexpr (S == RgbSource::RGB16)
+        {
+            __m256i rg = _mm256_i32gather_epi32((const int*)p, offsets, 1);
+            __m256i bx = _mm256_i32gather_epi32((const int*)(p + 4), offsets, 1);
+            r = _mm256_and_si256(rg, word_mask);
+            g = _mm256_srli_epi32(rg, 16);
+            b = _mm256_and_si256(bx, word_mask);
+        }
+        else
+        {
+            __m256i v = S == RgbSource::RGBA8
+                ? _mm256_loadu_si256((const __m256i*)p)
+                : _mm256_i32gather_epi32((const int*)p, offsets, 1);
+            __m256i c0 = _mm256_and_si256(v, byte_mask);
+            __m256i c2 = _mm256_and_si256(_mm256_srli_epi32(v, 16), byte_mask);
+            g = _mm256_and_si256(_mm256_srli_epi32(v, 8), byte_mask);
+            r = S == RgbSource::BGR8 ? c2 : c0;
+            b = S == RgbSource::BGR8 ? c0 : c2;
+        }
+
+        __m256i yy = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, yr),
+                                                       _mm256_mullo_epi32(g, yg)),
+                                      _mm256_mullo_epi32(b, yb));
+        yy = _mm256_srai_epi32(_mm256_add_epi32(yy, y_bias), kMatrixBits);
+        yy = _mm256_min_epi32(_mm256_max_epi32(yy, zero), max_code);
+        _mm256_storeu_si256((__m256i*)(y + i), yy);
+
+        __m256i u = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, ur),
+                                                      _mm256_mullo_epi32(g, ug)),
+                                     _mm256_mullo_epi32(b, ub));
+        _mm256_storeu_si256((__m256i*)(cb + i), _mm256_srai_epi32(u, kChromaShift));
+
+        __m256i v = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(r, vr),
+                                                      _mm256_mullo_epi32(g, vg)),
+                                     _mm256_mullo_epi32(b, vb));
+        _mm256_storeu_si256((__m256i*)(cr + i), _mm256_srai_epi32(v, kChromaShift));
+    }
+
+    rows_scalar<S>(src + i * source_bpp<S>(), pixels - i, m, y + i, cb + i, cr + i);
+}
+
+#endif // BRIDGE_X86
+
+static YuvConverter::RowFn row_kernel(RgbSource source, SimdLevel level)
+{
+#ifdef BRIDGE_X86
+    if (level >= SimdLevel::AVX2)
+    {
+        switch (source)
+        {
+            case RgbSource::RGB8:  return rows_avx2<RgbSource::RGB8>;
+            case RgbSource::BGR8:  return rows_avx2<RgbSource::BGR8>;
+            case RgbSource::RGBA8: return rows_avx2<RgbSource::RGBA8>;
+            case RgbSource::RGB16: return rows_avx2<RgbSource::RGB16>;
+        }
+    }
+#else
+    (void)level;
+#endif
+    switch (source)
+    {
+        case RgbSource::RGB8:  return rows_scalar<RgbSource::RGB8>;
+        case RgbSource::BGR8:  return rows_scalar<RgbSource::BGR8>;
+        case RgbSource::RGBA8: return rows_scalar<RgbSource::RGBA8>;
+        case RgbSource::RGB16: return rows_scalar<RgbSource::RGB16>;
+    }
+    return rows_scalar<RgbSource::RGB8>;
+}
+
+// ---------------------------------------------------------------------------
+// Output planes
+// ---------------------------------------------------------------------------
+
+struct YuvLayout
+{
+    uint32_t chroma_rows_per_row; // 2 for 4:2:0, 1 for 4:2:2
+    bool semi_planar;             // one interleaved U/V plane
+    int shift;                    // P010 keeps 10 bits at the top of 16
+};
+
+static YuvLayout yuv_layout(PixFmt fmt)
+{
+    switch (fmt)
+    {
+        case PixFmt::NV12:        return { 2, true, 0 };
+        case PixFmt::YUV422P10LE: return { 1, false, 0 };
+        case PixFmt::P010LE:      return { 2, true, 6 };
+        default:                  return { 2, false, 0 };
+    }
+}
+
+// Co-sited [1 2 1] at even x, edges repeated
+static inline int32_t chroma_tap(const int32_t* c, size_t x, size_t width)
+{
+    size_t left = x ? x - 1 : 0;
+    size_t right = x + 1 < width ? x + 1 : width - 1;
+    return c[left] + 2 * c[x] + c[right];
+}
+
+template <typename T>
+static void convert_rows_t(const uint8_t* src, size_t src_row0, uint8_t* dst,
+                           size_t chroma_begin, size_t chroma_end,
+                           size_t width, size_t height, size_t src_stride, const YuvLayout& layout,
+                           const YuvMatrix& m, YuvConverter::RowFn row_fn)
+{
+    const size_t chroma_width = (width + 1) / 2;
+    const size_t chroma_height = (height + layout.chroma_rows_per_row - 1) / layout.chroma_rows_per_row;
+    T* luma = (T*)dst;
+    T* chroma = luma + width * height;
+    const size_t chroma_plane = chroma_width * chroma_height;
+
+    // Filter sum scale: 2^kChromaBits, x4 for the [1 2 1] taps, x2 per extra row
+    const int chroma_shift = kChromaBits + 2 + (layout.chroma_rows_per_row == 2 ? 1 : 0);
+    const int32_t chroma_bias = (m.chroma_offset << chroma_shift) + (1 << (chroma_shift - 1));
+
+    static thread_local std::vector<int32_t> scratch;
+    if (scratch.size() < width * 5)
+        scratch.resize(width * 5);
+    int32_t* y = scratch.data();
+    int32_t* cb[2] = { y + width, y + 2 * width };
+    int32_t* cr[2] = { y + 3 * width, y + 4 * width };
+
+    for (size_t cy = chroma_begin; cy < chroma_end; cy++)
+    {
+        size_t first_row = cy * layout.chroma_rows_per_row;
+        size_t rows = std::min<size_t>(layout.chroma_rows_per_row, height - first_row);
+        for (size_t k = 0; k < rows; k++)
+        {
+            size_t row = first_row + k;
+            row_fn(src + (row - src_row0) * src_stride, width, m, y, cb[k], cr[k]);
+            T* out = luma + row * width;
+            for (size_t x = 0; x < width; x++)
+                out[x] = (T)(y[x] << layout.shift);
+        }
+
+        // An odd last row of a 4:2:0 frame pairs with itself
+        const int32_t* cb1 = rows == 2 ? cb[1] : cb[0];
+        const int32_t* cr1 = rows == 2 ? cr[1] : cr[0];
+
+        T* u;
+        T* v;
+        size_t step;
+        if (layout.semi_planar)
+        {
+            u = chroma + cy * chroma_width * 2;
+            v = u + 1;
+            step = 2;
+        }
+        else
+        {
+            u = chroma + cy * chroma_width;
+            v = u + chroma_plane;
+            step = 1;
+        }
+
+        for (size_t cx = 0; cx < chroma_width; cx++)
+        {
+            size_t x = cx * 2;
+            int32_t su = chroma_tap(cb[0], x, width);
+            int32_t sv = chroma_tap(cr[0], x, width);
+            if (layout.chroma_rows_per_row == 2)
+            {
+                su += chroma_tap(cb1, x, width);
+                sv += chroma_tap(cr1, x, width);
+            }
+            u[cx * step] = (T)(clamp_code((su + chroma_bias) >> chroma_shift, m.max_code) << layout.shift);
+            v[cx * step] = (T)(clamp_code((sv + chroma_bias) >> chroma_shift, m.max_code) << layout.shift);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// YuvConverter
+// ---------------------------------------------------------------------------
+
+bool YuvConverter::init(RgbSource source, uint32_t width, uint32_t height, PixFmt fmt,
+                        YuvRange range, std::string& error, SimdLevel level)
+{
+    if (!pix_fmt_is_yuv(fmt))
+    {
+        error = "YuvConverter: output format is not YUV";
+        return false;
+    }
+    if (width == 0 || height == 0)
+    {
+        error = "YuvConverter: empty frame size";
+        return false;
+    }
+
+    m_width = width;
+    m_height = height;
+    m_source = source;
+    size_t bpp = source == RgbSource::RGB16 ? 6 : (source == RgbSource::RGBA8 ? 4 : 3);
+    m_src_stride = (size_t)width * bpp;
+    m_fmt = fmt;
+    m_matrix = build_matrix(source == RgbSource::RGB16 ? 16 : 8, pix_fmt_bit_depth(fmt), range);
+    m_row_fn = row_kernel(source, level);
+    return true;
+}
+
+uint32_t YuvConverter::rows_per_chroma() const
+{
+    return yuv_layout(m_fmt).chroma_rows_per_row;
+}
+
+void YuvConverter::convert_rows(const uint8_t* src, size_t src_row0, uint8_t* dst,
+                                size_t chroma_begin, size_t chroma_end) const
+{
+    YuvLayout layout = yuv_layout(m_fmt);
+    if (pix_fmt_bit_depth(m_fmt) > 8)
+        convert_rows_t<uint16_t>(src, src_row0, dst, chroma_begin, chroma_end, m_width, m_height,
+                                 m_src_stride, layout, m_matrix, m_row_fn);
+    else
+        convert_rows_t<uint8_t>(src, src_row0, dst, chroma_begin, chroma_end, m_width, m_height,
+                                m_src_stride, layout, m_matrix, m_row_fn);
+}
+
+void YuvConverter::run(const uint8_t* src, uint8_t* dst, StripePool* pool) const
+{
+    const uint32_t per_chroma = rows_per_chroma();
+    const size_t chroma_rows = (m_height + per_chroma - 1) / per_chroma;
+    const size_t pixels = (size_t)m_width * m_height;
+    if (!pool || pixels < kStripeMinPixels)
+    {
+        convert_rows(src, 0, dst, 0, chroma_rows);
+        return;
+    }
+
+    size_t min_rows = std::max<size_t>(8, (kStripeMinPixels / 8) / m_width / per_chroma);
+    pool->run(chroma_rows, min_rows, [&](size_t row_begin, size_t row_end)
+    {
+        convert_rows(src, 0, dst, row_begin, row_end);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// Self-check
+// ---------------------------------------------------------------------------
+
+// First Y, Cb and Cr code of a converted frame
+static void first_codes(const std::vector<uint8_t>& frame, PixFmt fmt, uint32_t width,
+                        uint32_t height, int32_t codes[3])
+{
+    YuvLayout layout = yuv_layout(fmt);
+    size_t sample = pix_fmt_bit_depth(fmt) > 8 ? 2 : 1;
+    size_t chroma_width = (width + 1) / 2;
+    size_t chroma_height = (height + layout.chroma_rows_per_row - 1) / layout.chroma_rows_per_row;
+    size_t luma_bytes = (size_t)width * height * sample;
+    size_t offsets[3] = {
+        0, luma_bytes,
+        layout.semi_planar ? luma_bytes + sample : luma_bytes + chroma_width * chroma_height * sample,
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        int32_t v = frame[offsets[i]];
+        if (sample == 2)
+            v |= (int32_t)frame[offsets[i] + 1] << 8;
+        codes[i] = v >> layout.shift;
+    }
+}
+
+bool yuv_convert_self_check(FILE* report)
+{
+    static const SimdLevel levels[] = {
+        SimdLevel::Scalar, SimdLevel::SSSE3, SimdLevel::AVX2, SimdLevel::AVX512,
+    };
+    static const RgbSource sources[] = {
+        RgbSource::RGB8, RgbSource::BGR8, RgbSource::RGBA8, RgbSource::RGB16,
+    };
+    static const PixFmt formats[] = {
+        PixFmt::YUV420P, PixFmt::NV12, PixFmt::YUV422P10LE, PixFmt::P010LE,
+    };
+    static const YuvRange ranges[] = { YuvRange::Limited, YuvRange::Full };
+    // Odd sizes exercise the vector tails, edge taps and unpaired last rows
+    static const uint32_t sizes[][2] = {
+        { 1, 1 }, { 2, 2 }, { 3, 3 }, { 9, 2 }, { 17, 5 }, { 64, 4 }, { 101, 37 },
+    };
+
+    // Reference colours (8-bit RGB, scaled for 16-bit sources) and their
+    // BT.709 limited-range 8-bit codes; 10-bit limited is 4x, full range is
+    // checked for black and white
+    struct Colour { uint8_t rgb[3]; int32_t limited[3]; };
+    static const Colour colours[] = {
+        { {   0,   0,   0 }, {  16, 128, 128 } },
+        { { 255, 255, 255 }, { 235, 128, 128 } },
+        { { 255,   0,   0 }, {  63, 102, 240 } },
+        { {   0, 255,   0 }, { 173,  42,  26 } },
+        { {   0,   0, 255 }, {  32, 240, 118 } },
+    };
+
+    SimdLevel best = detect_simd_level();
+    bool all_ok = true;
+
+    std::vector<uint8_t> src(101 * 37 * 6 + 64);
+    uint32_t state = 0x9E3779B9u;
+    for (auto& b : src)
+    {
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        b = (uint8_t)state;
+    }
+
+    for (SimdLevel level : levels)
+    {
+        if ((int)level > (int)best)
+            break;
+
+        bool ok = true;
+        std::string error;
+
+        for (RgbSource source : sources)
+        {
+            for (PixFmt fmt : formats)
+            {
+                for (YuvRange range : ranges)
+                {
+                    for (const auto& size : sizes)
+                    {
+                        YuvConverter reference, candidate;
+                        reference.init(source, size[0], size[1], fmt, range, error, SimdLevel::Scalar);
+                        candidate.init(source, size[0], size[1], fmt, range, error, level);
+
+                        // Guard bytes after the output catch over-writes
+                        std::vector<uint8_t> expect(reference.dst_bytes() + 64, 0xA5);
+                        std::vector<uint8_t> got(candidate.dst_bytes() + 64, 0xA5);
+                        reference.run(src.data(), expect.data(), nullptr);
+                        candidate.run(src.data(), got.data(), nullptr);
+                        if (expect != got)
+                            ok = false;
+                    }
+
+                    for (const Colour& colour : colours)
+                    {
+                        bool sixteen = source == RgbSource::RGB16;
+                        bool ten = pix_fmt_bit_depth(fmt) > 8;
+                        // 16-bit sources are checked into 10-bit formats only
+                        if (sixteen != ten)
+                            continue;
+
+                        std::vector<uint8_t> pixels;
+                        for (int px = 0; px < 4; px++)
+                        {
+                            for (int c = 0; c < 3; c++)
+                            {
+                                uint8_t v = colour.rgb[source == RgbSource::BGR8 ? 2 - c : c];
+                                pixels.push_back(v);
+                                if (sixteen)
+                                    pixels.push_back(v);
+                            }
+                            if (source == RgbSource::RGBA8)
+                                pixels.push_back(0xFF);
+                        }
+
+                        YuvConverter converter;
+                        converter.init(source, 2, 2, fmt, range, error, level);
+                        std::vector<uint8_t> out(converter.dst_bytes());
+                        converter.run(pixels.data(), out.data(), nullptr);
+
+                        int32_t codes[3];
+                        first_codes(out, fmt, 2, 2, codes);
+                        bool extreme = colour.rgb[0] == colour.rgb[1] && colour.rgb[1] == colour.rgb[2];
+                        for (int i = 0; i < 3; i++)
+                        {
+                            int32_t expected;
+                            if (range == YuvRange::Limited)
+                                expected = colour.limited[i] * (ten ? 4 : 1);
+                            else if (extreme)
+                                expected = i ? (ten ? 512 : 128) : (colour.rgb[0] ? (ten ? 1023 : 255) : 0);
+                            else
+                                continue;
+                            // 10-bit codes of the primaries sit between 4x the 8-bit ones
+                            if (std::abs(codes[i] - expected) > (ten && !extreme ? 2 : 0))
+                                ok = false;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Throughput: 1080p RGBA → yuv420p, single thread
+        static constexpr uint32_t kBenchW = 1920, kBenchH = 1080;
+        std::vector<uint8_t> bench_src((size_t)kBenchW * kBenchH * 4, 0x40);
+        YuvConverter bench;
+        bench.init(RgbSource::RGBA8, kBenchW, kBenchH, PixFmt::YUV420P, YuvRange::Limited, error, level);
+        std::vector<uint8_t> bench_dst(bench.dst_bytes());
+        static constexpr int kIterations = 10;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int it = 0; it < kIterations; it++)
+            bench.run(bench_src.data(), bench_dst.data(), nullptr);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        double mpix_per_s = secs > 0
+            ? ((double)kBenchW * kBenchH * kIterations) / secs / 1e6 : 0.0;
+
+        fprintf(report,
+            "{\"type\":\"self_check\",\"kernel\":\"rgb_to_yuv\",\"isa\":\"%s\","
+            "\"ok\":%s,\"mpix_per_s\":%.1f}\n",
+            simd_level_name(level), ok ? "true" : "false", mpix_per_s);
+
+        all_ok = all_ok && ok;
+    }
+
+    return all_ok;
+}
@@ -0,0 +1,97 @@
+// yuv_convert: BT.709 RGB → YUV conversion so the bridges can hand FFmpeg
+// the encoder's own input format (4:2:0 for H.264/H.265, 10-bit 4:2:2 for
+// ProRes) instead of RGB that swscale converts on every frame.
+//
+// The matrix runs in 20-bit fixed point, so every SIMD level produces output
+// bit-identical to the scalar reference. Chroma is co-sited horizontally
+// ([1 2 1] filter) and, for 4:2:0, centred vertically between row pairs, as
+// H.264/H.265 and ProRes expect by default.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "cpu_features.h"
+#include "pixel_format.h"
+
+class StripePool;
+
+// Packed RGB layouts the converter reads
+enum class RgbSource
+{
+    RGB8,  // R,G,B bytes
+    BGR8,  // B,G,R bytes (R3D 8-bit)
+    RGBA8, // R,G,B,A bytes (BRAW RGBAU8), alpha ignored
+    RGB16, // R,G,B little-endian 16-bit words (BRAW RGBU16, R3D 16-bit interleaved)
+};
+
+enum class YuvRange
+{
+    Limited, // video levels: Y 16..235, C 16..240 (scaled for 10-bit)
+    Full,    // Y and C use every code value
+};
+
+// "limited", "full"
+bool parse_yuv_range(const char* name, YuvRange& range);
+const char* yuv_range_name(YuvRange range);
+
+// Fixed-point BT.709 coefficients for one source depth / output format
+struct YuvMatrix
+{
+    int32_t yr, yg, yb;    // Y  = (yr*R + yg*G + yb*B + y_bias) >> 20
+    int32_t ur, ug, ub;    // Cb = (ur*R + ug*G + ub*B) >> 4, offset added later
+    int32_t vr, vg, vb;    // Cr likewise
+    int32_t y_bias;        // Y offset and rounding
+    int32_t max_code;      // 255 or 1023
+    int32_t chroma_offset; // 128 or 512
+};
+
+class YuvConverter
+{
+public:
+    // Converts width x height frames in `source` layout to `fmt` (one of the
+    // YUV formats). Resizing happens before, see PostProcessor.
+    bool init(RgbSource source, uint32_t width, uint32_t height, PixFmt fmt,
+              YuvRange range, std::string& error, SimdLevel level = detect_simd_level());
+
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    size_t dst_bytes() const { return pix_fmt_frame_bytes(m_fmt, m_width, m_height); }
+
+    // Source rows per chroma row: 2 for 4:2:0, 1 for 4:2:2
+    uint32_t rows_per_chroma() const;
+
+    // Converts one tightly packed frame. Chroma row stripes run on `pool`
+    // (may be null). Several threads may call this concurrently.
+    void run(const uint8_t* src, uint8_t* dst, StripePool* pool) const;
+
+    // Converts chroma rows [chroma_begin, chroma_end) and their luma rows on
+    // the calling thread. `src` holds source rows from `src_row0` on (a tile),
+    // `dst` is the whole output frame.
+    void convert_rows(const uint8_t* src, size_t src_row0, uint8_t* dst,
+                      size_t chroma_begin, size_t chroma_end) const;
+
+    // Converts `pixels` source pixels to final Y codes and Cb/Cr scaled by
+    // 2^16 (before subsampling and offset).
+    using RowFn = void (*)(const uint8_t* src, size_t pixels, const YuvMatrix& m,
+                           int32_t* y, int32_t* cb, int32_t* cr);
+
+private:
+    RgbSource m_source = RgbSource::RGB8;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    size_t m_src_stride = 0;
+    PixFmt m_fmt = PixFmt::YUV420P;
+    YuvMatrix m_matrix = {};
+    RowFn m_row_fn = nullptr;
+};
+
+// Compares every SIMD level this CPU supports against the scalar reference
+// for all sources, formats and ranges over odd sizes, and checks reference
+// colours (black, white, primaries) against their BT.709 codes. Writes one
+// NDJSON line per ISA (with throughput for a 1920x1080 RGBA → yuv420p
+// conversion) to `report` and returns true if all match.
+bool yuv_convert_self_check(FILE* report);
@@ -1,25 +1,63 @@
-// r3d-bridge: Decode RED R3D files, output raw rgb24 video on stdout
-// and NDJSON metadata/progress on stderr.
+// r3d-bridge: Decode RED R3D files, output raw video (rgb24 unless --pix-fmt
+// says otherwise) on stdout and NDJSON metadata/progress on stderr.
 //
-// Usage:
-//   r3d-bridge --input <file.R3D> [--debayer premium|half|quarter|eighth]
-//   r3d-bridge --input <file.R3D> --extract-audio /path/to/output.wav
-//   r3d-bridge --input <file.R3D> --probe-only
+// Usage (the options: Options and parse_args() below):
+//   r3d-bridge --input <file.R3D> [decode options]
+//   r3d-bridge --input <file.R3D> --extract-audio <out.wav>
+//   r3d-bridge --input <a.R3D> --output <spec> [--input <b.R3D> --output <spec> ...]
+//   r3d-bridge --input <file.R3D> [--input ...] --probe-only
+//   r3d-bridge --input <file.R3D> [--input ...] --thumbnails <dir>
+//   r3d-bridge --serve <socket>
+//   r3d-bridge --self-check | --capabilities
 //
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <cstdint>
 #include <cmath>
 #include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <csignal>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 
 #include <unistd.h>
 
 #include "R3DSDK.h"
+#include "R3DSDKDecoder.h"
+
+#include "av_encoder.h"
+#include "frame_pool.h"
+#include "frame_writer.h"
+#include "nut_muxer.h"
+#include "pixel_format.h"
+#include "reorder_buffer.h"
+#include "report.h"
+#include "resize.h"
+#include "post_process.h"
+#include "frame_select.h"
+#include "playlist.h"
+#include "thumbnails.h"
+#include "frame_server.h"
+#include "probe_batch.h"
+#include "clip_cache.h"
+#include "serve.h"
+#include "shm_ring.h"
+#include "stripe_pool.h"
+#include "transport_bench.h"
+#include "wav_writer.h"
+#include "yuv_convert.h"
 
 // ---------------------------------------------------------------------------
-// Utility: write NDJSON to stderr
+// Utility: write NDJSON to the report stream (stderr, see report.h)
 // ---------------------------------------------------------------------------
 
 static std::string json_escape(const char* s)
@@ -40,86 +78,123 @@ static std::string json_escape(const char* s)
     return out;
 }
 
+// ,"input":"<clip>" while a batch probe worker reports (see report.h)
+static std::string json_input_field()
+{
+    const char* input = report_input();
+    return input ? ",\"input\":\"" + json_escape(input) + "\"" : std::string();
+}
+
 static void json_error(const char* msg)
 {
     std::string escaped = json_escape(msg);
-    fprintf(stderr, "{\"type\":\"error\",\"message\":\"%s\"}\n", escaped.c_str());
+    fprintf(report_stream(), "{\"type\":\"error\"%s,\"message\":\"%s\"}\n",
+            json_input_field().c_str(), escaped.c_str());
+}
+
+static void json_warning(const char* msg)
+{
+    std::string escaped = json_escape(msg);
+    fprintf(report_stream(), "{\"type\":\"warning\"%s,\"message\":\"%s\"}\n",
+            json_input_field().c_str(), escaped.c_str());
 }
 
 static void json_metadata(const char* timecode, uint32_t fps_num, uint32_t fps_den,
-                           uint32_t width, uint32_t height, uint64_t frame_count)
+                           uint32_t width, uint32_t height, uint64_t frame_count,
+                           uint32_t output_width, uint32_t output_height,
+                           const char* pix_fmt, const char* yuv_range, bool nut,
+                           const std::string& extra_fields)
 {
-    fprintf(stderr,
-        "{\"type\":\"metadata\","
+    // yuv_range only for YUV output, mux only for a NUT stream; a probe adds
+    // audio layout and camera metadata (see clip_cache.h), a range decode
+    // its range and start timecode
+    std::string range_field = yuv_range
+        ? std::string(",\"yuv_range\":\"") + yuv_range + "\"" : std::string();
+    if (nut)
+        range_field += ",\"mux\":\"nut\"";
+    range_field += extra_fields;
+    fprintf(report_stream(),
+        "{\"type\":\"metadata\"%s,"
         "\"timecode\":\"%s\","
         "\"fps_num\":%u,"
         "\"fps_den\":%u,"
         "\"width\":%u,"
         "\"height\":%u,"
-        "\"frame_count\":%llu}\n",
-        timecode, fps_num, fps_den, width, height,
-        (unsigned long long)frame_count);
+        "\"frame_count\":%llu,"
+        "\"output_width\":%u,"
+        "\"output_height\":%u,"
+        "\"pix_fmt\":\"%s\"%s}\n",
+        json_input_field().c_str(), timecode, fps_num, fps_den, width, height,
+        (unsigned long long)frame_count, output_width, output_height, pix_fmt,
+        range_field.c_str());
+}
+
+// ,"start_frame":..,"end_frame":..,"start_timecode":".." for a range decode
+static std::string range_json_fields(uint64_t first_frame, uint64_t end_frame,
+                                     const std::string& start_timecode)
+{
+    char buf[96];
+    snprintf(buf, sizeof(buf), ",\"start_frame\":%llu,\"end_frame\":%llu,",
+             (unsigned long long)first_frame, (unsigned long long)end_frame);
+    return buf + ("\"start_timecode\":\"" + json_escape(start_timecode.c_str()) + "\"");
 }
 
 static void json_progress(uint64_t frame, uint64_t total)
 {
-    fprintf(stderr, "{\"type\":\"progress\",\"frame\":%llu,\"total\":%llu}\n",
+    fprintf(report_stream(), "{\"type\":\"progress\",\"frame\":%llu,\"total\":%llu}\n",
         (unsigned long long)frame, (unsigned long long)total);
 }
 
-static void json_done()
+static void json_writer(const FrameWriter::Stats& st)
 {
-    fprintf(stderr, "{\"type\":\"done\"}\n");
+    // More time blocked in write than waiting for frames: FFmpeg is the limit
+    fprintf(report_stream(),
+        "{\"type\":\"writer\",\"frames\":%llu,\"bytes\":%llu,"
+        "\"spliced_bytes\":%llu,\"write_calls\":%llu,\"pipe_bytes\":%zu,"
+        "\"write_s\":%.3f,\"wait_s\":%.3f,\"bound\":\"%s\"}\n",
+        (unsigned long long)st.frames, (unsigned long long)st.bytes,
+        (unsigned long long)st.spliced_bytes, (unsigned long long)st.write_calls,
+        st.pipe_bytes, st.write_seconds, st.wait_seconds,
+        st.write_seconds > st.wait_seconds ? "encoder" : "decoder");
 }
 
-// ---------------------------------------------------------------------------
-// WAV writer
-// ---------------------------------------------------------------------------
+static void json_thumbnail(uint64_t frame, double time, const std::string& path)
+{
+    fprintf(report_stream(), "{\"type\":\"thumbnail\"%s,\"frame\":%llu,\"time\":%.3f,\"path\":\"%s\"}\n",
+            json_input_field().c_str(), (unsigned long long)frame, time,
+            json_escape(path.c_str()).c_str());
+}
+
+static void json_sprite(const ThumbnailSink& sink, size_t tiles, uint32_t tile_width,
+                        uint32_t tile_height)
+{
+    fprintf(report_stream(),
+            "{\"type\":\"sprite\"%s,\"path\":\"%s\",\"vtt\":\"%s\",\"tiles\":%zu,"
+            "\"columns\":%u,\"rows\":%u,\"tile_width\":%u,\"tile_height\":%u}\n",
+            json_input_field().c_str(), json_escape(sink.sprite_path().c_str()).c_str(),
+            json_escape(sink.vtt_path().c_str()).c_str(), tiles, sink.columns(), sink.rows(),
+            tile_width, tile_height);
+}
 
-static bool write_wav(const char* path, const void* samples, uint64_t sample_count,
-                      uint32_t sample_rate, uint32_t channels, uint32_t bits_per_sample)
+static void json_done()
 {
-    FILE* f = fopen(path, "wb");
-    if (!f) return false;
+    fprintf(report_stream(), "{\"type\":\"done\"}\n");
+}
 
-    uint32_t byte_rate = sample_rate * channels * (bits_per_sample / 8);
-    uint32_t block_align = channels * (bits_per_sample / 8);
-    uint64_t data_size_64 = (uint64_t)sample_count * channels * (bits_per_sample / 8);
-    if (data_size_64 > 0xFFFFFFFFULL)
+// --capabilities: what this build can do beyond raw frames, the
+// --encode-codec values it encodes in process (none without
+// -DBRIDGE_LIBAV=ON), as one
+// {"type":"capabilities","encode":..,"encode_codecs":[..]} line
+static void json_capabilities()
+{
+    std::string codecs;
+    for (const std::string& codec : AvEncoder::codecs())
     {
-        json_error("Audio data too large for WAV format (exceeds 4 GiB)");
-        fclose(f);
-        return false;
+        if (AvEncoder::codec_available(codec))
+            codecs += (codecs.empty() ? "\"" : ",\"") + codec + "\"";
     }
-    uint32_t data_size = (uint32_t)data_size_64;
-    uint32_t riff_size = 36 + data_size;
-
-    // RIFF header
-    fwrite("RIFF", 1, 4, f);
-    fwrite(&riff_size, 4, 1, f);
-    fwrite("WAVE", 1, 4, f);
-
-    // fmt chunk
-    fwrite("fmt ", 1, 4, f);
-    uint32_t fmt_size = 16;
-    uint16_t audio_format = 1; // PCM
-    uint16_t ch = (uint16_t)channels;
-    uint16_t bps = (uint16_t)bits_per_sample;
-    fwrite(&fmt_size, 4, 1, f);
-    fwrite(&audio_format, 2, 1, f);
-    fwrite(&ch, 2, 1, f);
-    fwrite(&sample_rate, 4, 1, f);
-    fwrite(&byte_rate, 4, 1, f);
-    fwrite(&block_align, 2, 1, f);
-    fwrite(&bps, 2, 1, f);
-
-    // data chunk
-    fwrite("data", 1, 4, f);
-    fwrite(&data_size, 4, 1, f);
-    fwrite(samples, 1, data_size, f);
-
-    fclose(f);
-    return true;
+    fprintf(report_stream(), "{\"type\":\"capabilities\",\"encode\":%s,\"encode_codecs\":[%s]}\n",
+            codecs.empty() ? "false" : "true", codecs.c_str());
 }
 
 // ---------------------------------------------------------------------------
@@ -181,389 +256,2505 @@ static std::string find_sdk_lib_dir()
 // Audio extraction
 // ---------------------------------------------------------------------------
 
-static bool extract_audio(R3DSDK::Clip* clip, const char* output_path)
+// A clip's audio, decoded block by block and handed out front to back as
+// interleaved 32-bit little-endian PCM. The SDK delivers 4-byte words per
+// sample whatever the recorded depth (24 or 32); FFmpeg reads pcm_s32le.
+class AudioStream
 {
-    size_t max_block_size = 0;
-    size_t blocks = clip->AudioBlockCountAndSize(&max_block_size);
+public:
+    AudioStream() = default;
+    ~AudioStream() { m_block.free_buf(); }
 
-    if (blocks == 0 || max_block_size == 0)
-    {
-        json_error("No audio in R3D clip");
-        return false;
-    }
+    AudioStream(const AudioStream&) = delete;
+    AudioStream& operator=(const AudioStream&) = delete;
 
-    size_t channels = clip->AudioChannelCount();
-    if (channels == 0)
+    // On failure (also for a clip without audio) returns false and sets `error`
+    bool open(R3DSDK::Clip* clip, std::string& error)
     {
-        json_error("No audio channels in R3D clip");
-        return false;
-    }
+        m_blocks = clip->AudioBlockCountAndSize(&m_max_block_size);
+        if (m_blocks == 0 || m_max_block_size == 0)
+        {
+            error = "No audio in R3D clip";
+            return false;
+        }
 
-    uint32_t sample_rate = clip->MetadataItemAsInt(R3DSDK::RMD_SAMPLERATE);
-    if (sample_rate == 0) sample_rate = 48000;
+        m_channels = (uint32_t)clip->AudioChannelCount();
+        if (m_channels == 0)
+        {
+            error = "No audio channels in R3D clip";
+            return false;
+        }
 
-    // SDK always delivers 4-byte (32-bit) words per sample regardless of the recorded
-    // bit depth (24 or 32). We write 32-bit signed LE PCM to WAV; FFmpeg reads pcm_s32le.
-    const uint32_t wav_bits = 32;
-    const size_t bytes_per_sample = 4;
+        m_sample_rate = clip->MetadataItemAsInt(R3DSDK::RMD_SAMPLERATE);
+        if (m_sample_rate == 0) m_sample_rate = 48000;
 
-    // Total sample count per channel
-    unsigned long long total_samples = clip->AudioSampleCount();
-    if (total_samples == 0)
-    {
-        json_error("No audio samples in R3D clip");
-        return false;
-    }
+        m_sample_count = clip->AudioSampleCount();
+        if (m_sample_count == 0)
+        {
+            error = "No audio samples in R3D clip";
+            return false;
+        }
 
-    // Allocate output buffer (all audio in memory)
-    uint64_t total_bytes = (uint64_t)total_samples * channels * bytes_per_sample;
-    if (total_bytes > 0xFFFFFFFFULL)
-    {
-        json_error("Audio data too large for WAV format (exceeds 4 GiB)");
-        return false;
+        // 512-byte aligned block buffer for decoding
+        if (!m_block.alloc(m_max_block_size))
+        {
+            error = "Failed to allocate audio block buffer";
+            return false;
+        }
+        m_clip = clip;
+        return true;
     }
 
-    uint8_t* audio_out = (uint8_t*)malloc((size_t)total_bytes);
-    if (!audio_out)
+    // Appends the samples up to `end` (per channel, capped at the end of the
+    // clip) to `out`, decoding blocks as needed; the rest of a block waits
+    // for the next call. Returns false once the SDK fails to deliver; later
+    // calls then add nothing.
+    bool read_until(uint64_t end, std::vector<uint8_t>& out)
     {
-        json_error("Failed to allocate audio output buffer");
-        return false;
-    }
+        const uint64_t end_bytes = std::min(end, m_sample_count) * m_channels * kBytesPerSample;
+        while (m_bytes_read < end_bytes)
+        {
+            if (m_pending_at == m_pending_end)
+            {
+                if (m_failed || m_next_block >= m_blocks)
+                {
+                    m_failed = true;
+                    return false;
+                }
+                size_t size = m_max_block_size;
+                R3DSDK::DecodeStatus ds = m_clip->DecodeAudioBlock(m_next_block++, m_block.ptr, &size);
+                if (ds != R3DSDK::DSDecodeOK || size == 0)
+                {
+                    m_failed = true;
+                    return false;
+                }
+
+                // R3D audio is big-endian 32-bit; swap to little endian
+                bswap32_buffer(m_block.ptr, size);
+                m_pending_at = 0;
+                m_pending_end = size;
+            }
 
-    // Allocate 512-byte aligned block buffer for decoding
-    AlignedBuffer block_buf;
-    if (!block_buf.alloc(max_block_size))
-    {
-        json_error("Failed to allocate audio block buffer");
-        free(audio_out);
-        return false;
+            size_t take = (size_t)std::min<uint64_t>(m_pending_end - m_pending_at,
+                                                     end_bytes - m_bytes_read);
+            out.insert(out.end(), m_block.ptr + m_pending_at, m_block.ptr + m_pending_at + take);
+            m_pending_at += take;
+            m_bytes_read += take;
+        }
+        return true;
     }
 
-    size_t out_offset = 0;
-
-    for (size_t bl = 0; bl < blocks; bl++)
+    // Continues reading at `position` (per channel, capped at the end of
+    // the clip). Blocks only decode in order, so the audio before it is
+    // decoded and dropped; a position already passed is ignored.
+    bool skip_to(uint64_t position)
     {
-        size_t buf_size = max_block_size;
-        R3DSDK::DecodeStatus ds = clip->DecodeAudioBlock(bl, block_buf.ptr, &buf_size);
-        if (ds != R3DSDK::DSDecodeOK || buf_size == 0)
-            break;
-
-        // Byte-swap: R3D audio is Big Endian 32-bit; swap to Little Endian
-        uint8_t* p = block_buf.ptr;
-        for (size_t i = 0; i + 3 < buf_size; i += 4)
+        static constexpr uint64_t kChunkSamples = 48000;
+        std::vector<uint8_t> dropped;
+        const uint64_t block = (uint64_t)m_channels * kBytesPerSample;
+        position = std::min(position, m_sample_count);
+        while (m_bytes_read / block < position)
         {
-            uint8_t b0 = p[i], b1 = p[i+1], b2 = p[i+2], b3 = p[i+3];
-            p[i]   = b3;
-            p[i+1] = b2;
-            p[i+2] = b1;
-            p[i+3] = b0;
+            dropped.clear();
+            if (!read_until(std::min(m_bytes_read / block + kChunkSamples, position), dropped))
+                return false;
         }
+        return true;
+    }
 
-        size_t copy_bytes = buf_size;
-        if (out_offset + copy_bytes > (size_t)total_bytes)
-            copy_bytes = (size_t)total_bytes - out_offset;
+    uint64_t sample_count() const { return m_sample_count; }
+    uint32_t sample_rate() const { return m_sample_rate; }
+    uint32_t channels() const { return m_channels; }
+    uint32_t bits_per_sample() const { return kBytesPerSample * 8; }
+
+private:
+    static constexpr uint32_t kBytesPerSample = 4;
+
+    R3DSDK::Clip* m_clip = nullptr;
+    AlignedBuffer m_block;
+    size_t m_max_block_size = 0;
+    size_t m_blocks = 0;
+    size_t m_next_block = 0;
+    size_t m_pending_at = 0;  // swapped bytes in m_block not handed out yet
+    size_t m_pending_end = 0;
+    uint64_t m_bytes_read = 0;
+    uint64_t m_sample_count = 0; // per channel
+    uint32_t m_sample_rate = 0;
+    uint32_t m_channels = 0;
+    bool m_failed = false;
+};
 
-        memcpy(audio_out + out_offset, block_buf.ptr, copy_bytes);
-        out_offset += copy_bytes;
-    }
+// The first audio sample of `frame`, so that a frame range's audio starts
+// where the previous range's ended
+static uint64_t frame_audio_start(uint64_t frame, uint32_t sample_rate,
+                                  uint32_t fps_num, uint32_t fps_den)
+{
+    return fps_num ? frame * sample_rate * fps_den / fps_num : 0;
+}
+
+// Audio of frames [first_frame, end_frame) of a clip with `frame_count`
+// frames, as samples [start, end) capped at `sample_count`; a range that
+// ends with the clip takes whatever audio is left
+struct AudioRange
+{
+    uint64_t start = 0;
+    uint64_t end = 0;
+};
 
-    block_buf.free_buf();
+static AudioRange frame_audio_range(uint64_t first_frame, uint64_t end_frame, uint64_t frame_count,
+                                    uint64_t sample_count, uint32_t sample_rate,
+                                    uint32_t fps_num, uint32_t fps_den)
+{
+    AudioRange range;
+    range.start = std::min(sample_count, frame_audio_start(first_frame, sample_rate, fps_num, fps_den));
+    range.end = end_frame < frame_count
+        ? std::min(sample_count, frame_audio_start(end_frame, sample_rate, fps_num, fps_den))
+        : sample_count;
+    range.end = std::max(range.start, range.end);
+    return range;
+}
 
-    bool ok = write_wav(output_path, audio_out, total_samples,
-                        sample_rate, (uint32_t)channels, wav_bits);
-    free(audio_out);
+// Streams the audio of frames [first_frame, end_frame) into a WAV (RF64
+// past 4 GiB) one piece at a time, so memory stays at one audio block and
+// one chunk whatever the clip length. Audio the SDK stops delivering
+// partway is left silent.
+static bool extract_audio(R3DSDK::Clip* clip, const char* output_path,
+                          uint64_t first_frame, uint64_t end_frame, uint64_t frame_count,
+                          uint32_t fps_num, uint32_t fps_den)
+{
+    static constexpr uint64_t kChunkSamples = 48000;
 
-    if (!ok)
+    AudioStream audio;
+    WavWriter wav;
+    std::string error;
+    if (!audio.open(clip, error)
+        || !wav.open(output_path, audio.sample_rate(), audio.channels(), audio.bits_per_sample(), error))
     {
-        json_error("Failed to write WAV file");
+        json_error(error.c_str());
         return false;
     }
 
-    return true;
-}
-
-// ---------------------------------------------------------------------------
-// CLI parsing
-// ---------------------------------------------------------------------------
-
-struct Options
-{
-    std::string input_file;
-    std::string extract_audio_path;
-    R3DSDK::VideoDecodeMode decode_mode = R3DSDK::DECODE_HALF_RES_GOOD;
-    bool probe_only = false;
-};
+    AudioRange range = frame_audio_range(first_frame, end_frame, frame_count,
+                                         audio.sample_count(), audio.sample_rate(),
+                                         fps_num, fps_den);
+    audio.skip_to(range.start);
 
-static bool parse_args(int argc, char* argv[], Options& opts)
-{
-    for (int i = 1; i < argc; i++)
+    const size_t block = (size_t)audio.channels() * audio.bits_per_sample() / 8;
+    std::vector<uint8_t> chunk;
+    for (uint64_t pos = range.start; pos < range.end; pos += kChunkSamples)
     {
-        if ((strcmp(argv[i], "--input") == 0 || strcmp(argv[i], "-i") == 0) && i + 1 < argc)
-        {
-            opts.input_file = argv[++i];
-        }
-        else if (strcmp(argv[i], "--debayer") == 0 && i + 1 < argc)
-        {
-            i++;
-            if (strcmp(argv[i], "premium") == 0)
-                opts.decode_mode = R3DSDK::DECODE_FULL_RES_PREMIUM;
-            else if (strcmp(argv[i], "half") == 0)
-                opts.decode_mode = R3DSDK::DECODE_HALF_RES_GOOD;
-            else if (strcmp(argv[i], "quarter") == 0)
-                opts.decode_mode = R3DSDK::DECODE_QUARTER_RES_GOOD;
-            else if (strcmp(argv[i], "eighth") == 0)
-                opts.decode_mode = R3DSDK::DECODE_EIGHT_RES_GOOD;
-            else
-            {
-                json_error("Invalid debayer option. Use: premium, half, quarter, eighth");
-                return false;
-            }
-        }
-        else if (strcmp(argv[i], "--extract-audio") == 0 && i + 1 < argc)
-        {
-            opts.extract_audio_path = argv[++i];
-        }
-        else if (strcmp(argv[i], "--probe-only") == 0)
+        uint64_t end = std::min(pos + kChunkSamples, range.end);
+        chunk.clear();
+        audio.read_until(end, chunk);
+        chunk.resize((size_t)(end - pos) * block);
+        if (!wav.write(chunk.data(), chunk.size()))
         {
-            opts.probe_only = true;
-        }
-        else
-        {
-            char msg[256];
-            snprintf(msg, sizeof(msg), "Unknown argument: %s", argv[i]);
-            json_error(msg);
+            json_error("Failed to write WAV file");
             return false;
         }
     }
 
-    if (opts.input_file.empty())
+    if (!wav.finish(error))
     {
-        json_error("Missing --input <file.R3D>");
+        json_error(error.c_str());
         return false;
     }
-
     return true;
 }
 
 // ---------------------------------------------------------------------------
-// Main
+// Decode engines
+//
+// Both keep up to N frames decoding concurrently into pooled buffers and
+// publish them to a ReorderBuffer; the main thread writes them in order.
+//
+//   threads  our own worker pool calling Clip::DecodeVideoFrame (the Clip
+//            class is thread-safe for decoding); --decompression-threads
+//            caps its workers unless --inflight sets them
+//   decoder  the SDK's R3DDecoder engine (needs a CUDA or OpenCL device and
+//            InitializeSdk(..., OPTION_RED_DECODER))
 // ---------------------------------------------------------------------------
 
-int main(int argc, char* argv[])
+// What the SDK decodes to for the requested --pix-fmt. rgb24 is decoded as
+// BGR and swapped by the post stage; YUV is converted from BGR (8-bit) or
+// 16-bit RGB (10-bit).
+// Everything else is written in the SDK's own layout (gbrp16le planes
+// reordered on write).
+struct FrameFormat
 {
-    Options opts;
-    if (!parse_args(argc, argv, opts))
-        return 1;
-
-    // --- Initialize R3D SDK ---
-
-    std::string lib_dir = find_sdk_lib_dir();
-
-    R3DSDK::InitializeStatus init_status = R3DSDK::InitializeSdk(lib_dir.c_str(), OPTION_RED_NONE);
-    if (init_status != R3DSDK::ISInitializeOK)
-    {
-        char msg[512];
-        snprintf(msg, sizeof(msg),
-            "Failed to initialize R3D SDK (status=%d). "
-            "Dynamic libraries not found at: %s",
-            (int)init_status, lib_dir.c_str());
-        json_error(msg);
-        return 1;
-    }
-
-    // --- Open clip ---
-
-    R3DSDK::Clip* clip = new R3DSDK::Clip(opts.input_file.c_str());
+    PixFmt pix_fmt = PixFmt::RGB24;
+    R3DSDK::VideoPixelType pixel_type = R3DSDK::PixelType_8Bit_BGR_Interleaved;
+    size_t width = 0;       // decode size
+    size_t height = 0;
+    size_t frame_bytes = 0; // one decoded frame
+};
 
-    if (clip->Status() != R3DSDK::LSClipLoaded)
+static FrameFormat frame_format_for(PixFmt fmt, size_t width, size_t height)
+{
+    FrameFormat f;
+    f.pix_fmt = fmt;
+    f.width = width;
+    f.height = height;
+
+    // The resizer keeps the channel order, so rgb24 decodes as bgr24
+    PixFmt decoded = fmt;
+    if (fmt == PixFmt::RGB24 || (pix_fmt_is_yuv(fmt) && pix_fmt_bit_depth(fmt) == 8))
+        decoded = PixFmt::BGR24;
+    else if (pix_fmt_is_yuv(fmt))
+        decoded = PixFmt::RGB48LE;
+
+    switch (decoded)
     {
-        char msg[512];
-        snprintf(msg, sizeof(msg), "Failed to open R3D clip (status=%d): %s",
-            (int)clip->Status(), opts.input_file.c_str());
-        json_error(msg);
-        delete clip;
-        R3DSDK::FinalizeSdk();
-        return 1;
+        case PixFmt::BGRA:     f.pixel_type = R3DSDK::PixelType_8Bit_BGRA_Interleaved; break;
+        case PixFmt::RGB48LE:  f.pixel_type = R3DSDK::PixelType_16Bit_RGB_Interleaved; break;
+        case PixFmt::GBRP16LE: f.pixel_type = R3DSDK::PixelType_16Bit_RGB_Planar; break;
+        case PixFmt::DPX10:    f.pixel_type = R3DSDK::PixelType_10Bit_DPX_MethodB; break;
+        default:               f.pixel_type = R3DSDK::PixelType_8Bit_BGR_Interleaved; break;
     }
+    f.frame_bytes = pix_fmt_frame_bytes(decoded, width, height);
+    return f;
+}
 
-    // --- Get clip properties ---
-
-    size_t full_width  = clip->Width();
-    size_t full_height = clip->Height();
-    size_t frame_count = clip->VideoFrameCount();
+class DecodeEngine
+{
+public:
+    virtual ~DecodeEngine() {}
+
+    // Starts decoding `clip_frame` of the clip as frame_idx of the reorder
+    // buffer (the same unless a sparse decode skips frames). The main
+    // thread calls this in frame order and never more than slot_count
+    // frames ahead of the last written frame.
+    virtual bool submit(uint64_t frame_idx, uint64_t clip_frame) = 0;
+
+    // Whether published frames are still as decoded and must go through the
+    // post stage before the write (done on the main thread so SDK callbacks
+    // stay short). Otherwise they are final frames.
+    virtual bool finish_on_write() const = 0;
+};
 
-    if (full_width == 0 || full_height == 0 || frame_count == 0)
+// Threads that run the threads engine's decodes, one frame each. A
+// playlist's clips share one set, so frames of several clips are in flight
+// on one pool; a single clip gets a set of its own.
+class DecodeWorkers
+{
+public:
+    explicit DecodeWorkers(unsigned count)
     {
-        json_error("R3D clip has zero width, height or frames");
-        delete clip;
-        R3DSDK::FinalizeSdk();
-        return 1;
+        for (unsigned i = 0; i < std::max(1u, count); i++)
+            m_threads.emplace_back([this]{ worker_loop(); });
     }
 
-    // Frame rate → rational
-    float fps_float = clip->VideoAudioFramerate();
-    uint32_t fps_num = 0, fps_den = 1;
+    ~DecodeWorkers()
     {
-        struct { float rate; uint32_t num; uint32_t den; } known_rates[] = {
-            {23.976f,  24000, 1001},
-            {24.0f,    24,    1},
-            {25.0f,    25,    1},
-            {29.97f,   30000, 1001},
-            {30.0f,    30,    1},
-            {47.952f,  48000, 1001},
-            {48.0f,    48,    1},
-            {50.0f,    50,    1},
-            {59.94f,   60000, 1001},
-            {60.0f,    60,    1},
-            {119.88f,  120000, 1001},
-            {120.0f,   120,   1},
-        };
-
-        bool matched = false;
-        for (auto& kr : known_rates)
-        {
-            if (fabsf(fps_float - kr.rate) < 0.05f)
-            {
-                fps_num = kr.num;
-                fps_den = kr.den;
-                matched = true;
-                break;
-            }
-        }
-        if (!matched)
         {
-            fps_num = (uint32_t)roundf(fps_float);
-            fps_den = 1;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
         }
+        m_cv.notify_all();
+        for (auto& t : m_threads)
+            t.join();
     }
 
-    // Timecode: try AbsoluteTimecode first, fall back to Timecode
-    std::string timecode = "00:00:00:00";
+    DecodeWorkers(const DecodeWorkers&) = delete;
+    DecodeWorkers& operator=(const DecodeWorkers&) = delete;
+
+    // Queues `task`; tasks start in the order they were queued
+    void run(std::function<void()> task)
     {
-        const char* tc = clip->AbsoluteTimecode(0);
-        if (tc && tc[0] != '\0')
-            timecode = tc;
-        else
         {
-            tc = clip->Timecode(0);
-            if (tc && tc[0] != '\0')
-                timecode = tc;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(task));
         }
+        m_cv.notify_one();
     }
 
-    // Dimensions after debayer
-    size_t out_width  = full_width;
-    size_t out_height = full_height;
-    switch (opts.decode_mode)
-    {
-        case R3DSDK::DECODE_HALF_RES_GOOD:
-        case R3DSDK::DECODE_HALF_RES_PREMIUM:
-            out_width  /= 2;
-            out_height /= 2;
-            break;
-        case R3DSDK::DECODE_QUARTER_RES_GOOD:
-            out_width  /= 4;
-            out_height /= 4;
-            break;
-        case R3DSDK::DECODE_EIGHT_RES_GOOD:
-            out_width  /= 8;
-            out_height /= 8;
-            break;
-        default:
-            break;
-    }
-
-    // --- Handle --extract-audio ---
-
-    if (!opts.extract_audio_path.empty())
+private:
+    void worker_loop()
     {
-        bool ok = extract_audio(clip, opts.extract_audio_path.c_str());
-        delete clip;
-        R3DSDK::FinalizeSdk();
-        if (ok)
+        for (;;)
         {
-            json_done();
-            return 0;
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]{ return m_stop || !m_queue.empty(); });
+                if (m_queue.empty())
+                    return;
+                task = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            task();
         }
-        return 1;
     }
 
-    // --- Emit metadata JSON ---
-    // Immer die volle Sensoraufloesung berichten; der Rust-Runner berechnet
-    // die tatsaechliche Ausgabedimension basierend auf der gewaehlten
-    // Debayer-Qualitaet selbst (out_width/out_height werden nur fuer den
-    // Frame-Buffer intern verwendet).
-    json_metadata(timecode.c_str(), fps_num, fps_den,
-                  (uint32_t)full_width, (uint32_t)full_height, (uint64_t)frame_count);
-    fflush(stderr);
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_queue;
+    bool m_stop = false;
+};
 
-    if (opts.probe_only)
+// Workers decode into `decode_pool` buffers. With an `output_pool` (resize or
+// YUV) each worker runs the post stage into one of its buffers and returns
+// the decode buffer; otherwise the decode buffer is published, swapped in
+// place for rgb24. The decodes run on `workers`, whose threads report on
+// the clip's report stream while they work on its frames.
+class ThreadPoolEngine : public DecodeEngine
+{
+public:
+    ThreadPoolEngine(R3DSDK::Clip* clip, R3DSDK::VideoDecodeMode mode,
+                     const FrameFormat& format, DecodeWorkers* workers,
+                     ReorderBuffer* reorder, FramePool* decode_pool,
+                     const PostProcessor* post, FramePool* output_pool)
+        : m_clip(clip)
+        , m_mode(mode)
+        , m_format(format)
+        , m_out_bytes(post ? post->dst_bytes() : format.frame_bytes)
+        , m_workers(workers)
+        , m_reorder(reorder)
+        , m_decode_pool(decode_pool)
+        , m_post(post)
+        , m_output_pool(output_pool)
+        , m_report(report_stream())
+        , m_input(report_input())
+    {}
+
+    // Waits for the clip's decodes still queued or running
+    ~ThreadPoolEngine() override
     {
-        delete clip;
-        R3DSDK::FinalizeSdk();
-        return 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]{ return m_pending == 0; });
     }
 
-    // --- Allocate frame buffer (16-byte aligned) ---
-
-    size_t frame_bytes = out_width * out_height * 3; // 3 bytes per pixel (BGR→RGB)
-    void* frame_buf_raw = nullptr;
-    if (posix_memalign(&frame_buf_raw, 16, frame_bytes) != 0 || !frame_buf_raw)
+    bool submit(uint64_t frame_idx, uint64_t clip_frame) override
     {
-        json_error("Failed to allocate frame buffer");
-        delete clip;
-        R3DSDK::FinalizeSdk();
-        return 1;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending++;
+        }
+        m_workers->run([this, frame_idx, clip_frame]
+        {
+            {
+                ReportScope report(m_report);
+                ReportInputScope input(m_input);
+                decode(frame_idx, clip_frame);
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_idle.notify_all();
+        });
+        return true;
     }
-    uint8_t* frame_buf = (uint8_t*)frame_buf_raw;
 
-    // --- Frame decode loop ---
+    bool finish_on_write() const override { return false; }
 
-    R3DSDK::VideoDecodeJob job;
-    job.Mode             = opts.decode_mode;
-    job.PixelType        = R3DSDK::PixelType_8Bit_BGR_Interleaved;
-    job.OutputBuffer     = frame_buf;
-    job.OutputBufferSize = frame_bytes;
+private:
+    void decode(uint64_t frame_idx, uint64_t clip_frame)
+    {
+        R3DSDK::VideoDecodeJob job;
+        job.Mode             = m_mode;
+        job.PixelType        = m_format.pixel_type;
+        job.OutputBufferSize = m_decode_pool->buffer_bytes();
 
-    bool had_error = false;
+        uint8_t* frame_buf = m_decode_pool->checkout();
+        job.OutputBuffer = frame_buf;
 
-    for (size_t i = 0; i < frame_count; i++)
-    {
-        R3DSDK::DecodeStatus ds = clip->DecodeVideoFrame(i, job);
+        R3DSDK::DecodeStatus ds = m_clip->DecodeVideoFrame((size_t)clip_frame, job);
         if (ds != R3DSDK::DSDecodeOK)
         {
             char msg[128];
-            snprintf(msg, sizeof(msg), "DecodeVideoFrame failed at frame %zu (status=%d)", i, (int)ds);
+            snprintf(msg, sizeof(msg), "DecodeVideoFrame failed at frame %llu (status=%d)",
+                     (unsigned long long)clip_frame, (int)ds);
             json_error(msg);
-            had_error = true;
-            break;
+            m_decode_pool->give_back(frame_buf);
+            m_reorder->publish(frame_idx, nullptr, 0);
+            return;
         }
 
-        // BGR → RGB: swap R and B channels in-place
-        for (size_t px = 0; px < out_width * out_height; px++)
+        // Workers run in parallel already, so each post-processes
+        // single-threaded
+        if (m_post)
         {
-            uint8_t b = frame_buf[px * 3 + 0];
-            frame_buf[px * 3 + 0] = frame_buf[px * 3 + 2]; // R ← B
-            frame_buf[px * 3 + 2] = b;                      // B ← R
+            uint8_t* out_buf = m_output_pool ? m_output_pool->checkout() : frame_buf;
+            m_post->run(frame_buf, out_buf, nullptr);
+            if (out_buf != frame_buf)
+            {
+                m_decode_pool->give_back(frame_buf);
+                frame_buf = out_buf;
+            }
         }
-
-        fwrite(frame_buf, 1, frame_bytes, stdout);
-        fflush(stdout);
-
-        json_progress((uint64_t)(i + 1), (uint64_t)frame_count);
+        m_reorder->publish(frame_idx, frame_buf, m_out_bytes);
     }
 
-    // --- Cleanup ---
+    R3DSDK::Clip* m_clip;
+    R3DSDK::VideoDecodeMode m_mode;
+    FrameFormat m_format;
+    size_t m_out_bytes;
+    DecodeWorkers* m_workers;
+    ReorderBuffer* m_reorder;
+    FramePool* m_decode_pool;
+    const PostProcessor* m_post;
+    FramePool* m_output_pool;
+    FILE* m_report;
+    const char* m_input;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    uint64_t m_pending = 0;
+};
 
-    free(frame_buf_raw);
-    delete clip;
-    R3DSDK::FinalizeSdk();
+struct SdkDecoderSettings
+{
+    size_t decompression_threads = 0; // 0 = SDK default (cores - 1)
+    size_t concurrent_images = 0;     // 0 = SDK default (cores - 1)
+    size_t memory_pool_mb = 0;        // 0 = SDK default
+};
 
-    if (!had_error)
+// Creates an R3DDecoder on the first CUDA (else OpenCL) device. On failure
+// returns false and sets `error`.
+static bool create_decoder(const SdkDecoderSettings& settings, R3DSDK::R3DDecoder*& decoder,
+                           std::string& error)
+{
+    R3DSDK::R3DDecoderOptions* options = nullptr;
+    if (R3DSDK::R3DDecoderOptions::CreateOptions(&options) != R3DSDK::R3DStatus_Ok || !options)
     {
-        json_done();
-        return 0;
+        error = "R3DDecoderOptions::CreateOptions failed";
+        return false;
     }
 
-    return 1;
+    // First CUDA device, else first OpenCL device
+    bool have_device = false;
+    std::vector<R3DSDK::CudaDeviceInfo> cuda_devices;
+    if (R3DSDK::R3DDecoderOptions::GetCudaDeviceList(cuda_devices) == R3DSDK::R3DStatus_Ok
+        && !cuda_devices.empty())
+        have_device = options->useDevice(cuda_devices[0]) == R3DSDK::R3DStatus_Ok;
+    if (!have_device)
+    {
+        std::vector<R3DSDK::OpenCLDeviceInfo> opencl_devices;
+        if (R3DSDK::R3DDecoderOptions::GetOpenCLDeviceList(opencl_devices) == R3DSDK::R3DStatus_Ok
+            && !opencl_devices.empty())
+            have_device = options->useDevice(opencl_devices[0]) == R3DSDK::R3DStatus_Ok;
+    }
+    if (!have_device)
+    {
+        R3DSDK::R3DDecoderOptions::ReleaseOptions(options);
+        error = "R3DDecoder engine needs a CUDA or OpenCL device; use --engine threads";
+        return false;
+    }
+
+    if (settings.decompression_threads)
+        options->setDecompressionThreadCount(settings.decompression_threads);
+    if (settings.concurrent_images)
+        options->setConcurrentImageCount(settings.concurrent_images);
+    if (settings.memory_pool_mb)
+        options->setMemoryPoolSize(settings.memory_pool_mb);
+
+    R3DSDK::R3DStatus st = R3DSDK::R3DDecoder::CreateDecoder(options, &decoder);
+    R3DSDK::R3DDecoderOptions::ReleaseOptions(options);
+    if (st != R3DSDK::R3DStatus_Ok || !decoder)
+    {
+        decoder = nullptr;
+        error = "R3DDecoder::CreateDecoder failed (status=" + std::to_string((int)st) + ")";
+        return false;
+    }
+    return true;
+}
+
+// Decodes on an R3DDecoder: its own, or with `shared` one that the clips of
+// a playlist decode on side by side. Its callbacks report on the clip's
+// report stream.
+class SdkDecoderEngine : public DecodeEngine
+{
+public:
+    SdkDecoderEngine(R3DSDK::Clip* clip, R3DSDK::VideoDecodeMode mode, const FrameFormat& format,
+                     ReorderBuffer* reorder, FramePool* frame_pool, R3DSDK::R3DDecoder* shared)
+        : m_clip(clip)
+        , m_mode(mode)
+        , m_format(format)
+        , m_reorder(reorder)
+        , m_frame_pool(frame_pool)
+        , m_report(report_stream())
+        , m_input(report_input())
+        , m_decoder(shared)
+        , m_owns_decoder(!shared)
+        , m_jobs(reorder->slot_count(), nullptr)
+        , m_tags(reorder->slot_count())
+    {
+        m_clip->GetDefaultImageProcessingSettings(m_ips);
+    }
+
+    ~SdkDecoderEngine() override
+    {
+        // Every submitted frame has been waited for (or failed) before the
+        // engine goes away, so no job is still in use here.
+        for (R3DSDK::R3DDecodeJob* job : m_jobs)
+            if (job) R3DSDK::R3DDecoder::ReleaseDecodeJob(job);
+        if (m_decoder && m_owns_decoder)
+            R3DSDK::R3DDecoder::ReleaseDecoder(m_decoder);
+    }
+
+    bool init(const SdkDecoderSettings& settings, std::string& error)
+    {
+        if (m_owns_decoder && !create_decoder(settings, m_decoder, error))
+            return false;
+
+        // One job per reorder slot: slot i % N is only reused after frame
+        // i has been written, i.e. after its decode completed.
+        for (auto& job : m_jobs)
+        {
+            if (R3DSDK::R3DDecoder::CreateDecodeJob(&job) != R3DSDK::R3DStatus_Ok || !job)
+            {
+                error = "R3DDecoder::CreateDecodeJob failed";
+                return false;
+            }
+            job->clip                    = m_clip;
+            job->videoTrackNo            = 0;
+            job->callback                = decode_callback;
+            job->mode                    = m_mode;
+            job->pixelType               = m_format.pixel_type;
+            job->bytesPerRow             = m_format.frame_bytes / m_format.height;
+            job->outputBufferSize        = m_frame_pool->buffer_bytes();
+            job->imageProcessingSettings = &m_ips;
+            job->outputFrameMetadata     = nullptr;
+        }
+        return true;
+    }
+
+    bool submit(uint64_t frame_idx, uint64_t clip_frame) override
+    {
+        size_t slot = frame_idx % m_jobs.size();
+        JobTag& tag = m_tags[slot];
+        tag.engine = this;
+        tag.frame_idx = frame_idx;
+
+        R3DSDK::R3DDecodeJob* job = m_jobs[slot];
+        job->videoFrameNo = (size_t)clip_frame;
+        job->outputBuffer = m_frame_pool->checkout();
+        job->privateData  = &tag;
+
+        R3DSDK::R3DStatus st = m_decoder->decode(job);
+        if (st != R3DSDK::R3DStatus_Ok)
+        {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "R3DDecoder::decode failed at frame %llu (status=%d)",
+                     (unsigned long long)clip_frame, (int)st);
+            json_error(msg);
+            m_frame_pool->give_back((uint8_t*)job->outputBuffer);
+            return false;
+        }
+        return true;
+    }
+
+    bool finish_on_write() const override { return true; }
+
+private:
+    static void decode_callback(R3DSDK::R3DDecodeJob* job, R3DSDK::R3DStatus status)
+    {
+        const JobTag* tag = (const JobTag*)job->privateData;
+        SdkDecoderEngine* self = tag->engine;
+        uint64_t frame_idx = tag->frame_idx;
+        ReportScope report(self->m_report);
+        ReportInputScope input(self->m_input);
+
+        if (status != R3DSDK::R3DStatus_Ok)
+        {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "R3DDecoder decode failed at frame %llu (status=%d)",
+                     (unsigned long long)job->videoFrameNo, (int)status);
+            json_error(msg);
+            self->m_frame_pool->give_back((uint8_t*)job->outputBuffer);
+            self->m_reorder->publish(frame_idx, nullptr, 0);
+            return;
+        }
+
+        self->m_reorder->publish(frame_idx, (uint8_t*)job->outputBuffer,
+                                 self->m_format.frame_bytes);
+    }
+
+    R3DSDK::Clip* m_clip;
+    R3DSDK::VideoDecodeMode m_mode;
+    FrameFormat m_format;
+    ReorderBuffer* m_reorder;
+    FramePool* m_frame_pool;
+    FILE* m_report;
+    const char* m_input;
+    R3DSDK::ImageProcessingSettings m_ips;
+
+    // What a job's callback publishes: the reorder frame it decodes
+    struct JobTag
+    {
+        SdkDecoderEngine* engine = nullptr;
+        uint64_t frame_idx = 0;
+    };
+
+    R3DSDK::R3DDecoder* m_decoder;
+    bool m_owns_decoder;
+    std::vector<R3DSDK::R3DDecodeJob*> m_jobs;
+    std::vector<JobTag> m_tags; // one per job
+};
+
+// Worker threads of the threads engine: enough to overlap the serial parts
+// of each decode on many-core machines
+static uint32_t default_decode_workers()
+{
+    uint32_t cores = std::thread::hardware_concurrency();
+    return std::max(2u, std::min(8u, cores / 4));
+}
+
+// Default number of frames decoding at once: one per worker, capped so that
+// the pooled output buffers stay within a fixed memory budget, which the
+// `clips` of a playlist decoding side by side split between them.
+static uint32_t default_inflight(uint64_t frame_bytes, uint32_t clips)
+{
+    static constexpr uint64_t kInflightMemoryBudget = 2ULL << 30; // 2 GiB
+
+    uint32_t n = default_decode_workers();
+    uint64_t budget = kInflightMemoryBudget / std::max(1u, clips);
+
+    if (frame_bytes > 0)
+        n = (uint32_t)std::min<uint64_t>(n, std::max<uint64_t>(2, budget / frame_bytes));
+
+    return n;
+}
+
+// Resolution divisor of a decode mode
+static size_t decode_mode_divisor(R3DSDK::VideoDecodeMode mode)
+{
+    switch (mode)
+    {
+        case R3DSDK::DECODE_HALF_RES_GOOD:
+        case R3DSDK::DECODE_HALF_RES_PREMIUM: return 2;
+        case R3DSDK::DECODE_QUARTER_RES_GOOD: return 4;
+        case R3DSDK::DECODE_EIGHT_RES_GOOD:   return 8;
+        case R3DSDK::DECODE_SIXTEENTH_RES_GOOD: return 16;
+        default:                              return 1;
+    }
+}
+
+// Smallest decode mode, no larger than `requested`, whose frames still cover
+// target_width x target_height; the resizer does the rest. A premium request
+// stays premium at half resolution.
+static R3DSDK::VideoDecodeMode pick_decode_mode(
+    R3DSDK::VideoDecodeMode requested, size_t width, size_t height,
+    size_t target_width, size_t target_height)
+{
+    const bool premium = requested == R3DSDK::DECODE_FULL_RES_PREMIUM
+                      || requested == R3DSDK::DECODE_HALF_RES_PREMIUM;
+    const R3DSDK::VideoDecodeMode smaller[] = {
+        premium ? R3DSDK::DECODE_HALF_RES_PREMIUM : R3DSDK::DECODE_HALF_RES_GOOD,
+        R3DSDK::DECODE_QUARTER_RES_GOOD,
+        R3DSDK::DECODE_EIGHT_RES_GOOD,
+        R3DSDK::DECODE_SIXTEENTH_RES_GOOD,
+    };
+
+    R3DSDK::VideoDecodeMode best = requested;
+    for (R3DSDK::VideoDecodeMode mode : smaller)
+    {
+        size_t divisor = decode_mode_divisor(mode);
+        if (divisor <= decode_mode_divisor(requested))
+            continue;
+        if (width / divisor < target_width || height / divisor < target_height)
+            break;
+        best = mode;
+    }
+    return best;
+}
+
+// ---------------------------------------------------------------------------
+// --serve scrub: single frames at any scale (see frame_server.h)
+// ---------------------------------------------------------------------------
+//
+// Workers of the frame server call Clip::DecodeVideoFrame side by side, as
+// the threads engine's do, each straight into the frame it was handed:
+// rgb24 is swapped there in place, YUV decodes into a scratch frame and is
+// converted into it.
+
+class ScrubDecoder : public ScrubSource
+{
+public:
+    // `width` x `height`: the clip's full resolution. Full and half
+    // resolution decode as premium with --debayer premium.
+    ScrubDecoder(R3DSDK::Clip* clip, size_t width, size_t height, PixFmt pix_fmt, bool premium)
+        : m_clip(clip)
+        , m_width(width)
+        , m_height(height)
+        , m_pix_fmt(pix_fmt)
+        , m_premium(premium)
+    {}
+
+    // Sets up the post stage of every scale. On failure returns false and
+    // sets `error`.
+    bool init(YuvRange range, std::string& error)
+    {
+        if (!pix_fmt_is_yuv(m_pix_fmt) && m_pix_fmt != PixFmt::RGB24)
+            return true;
+        RgbSource source = pix_fmt_bit_depth(m_pix_fmt) > 8 ? RgbSource::RGB16 : RgbSource::BGR8;
+        for (size_t i = 0; i < kScaleCount; i++)
+        {
+            m_post[i].reset(new PostProcessor());
+            if (!m_post[i]->init(source, (uint32_t)(m_width >> i), (uint32_t)(m_height >> i),
+                                 m_pix_fmt, range, nullptr, error))
+                return false;
+        }
+        return true;
+    }
+
+    bool frame_size(uint32_t scale, uint32_t& width, uint32_t& height, size_t& bytes) override
+    {
+        if (scale_index(scale) < 0)
+            return false;
+        width = (uint32_t)(m_width / scale);
+        height = (uint32_t)(m_height / scale);
+        bytes = pix_fmt_frame_bytes(m_pix_fmt, width, height);
+        return width != 0 && height != 0;
+    }
+
+    bool decode(uint64_t frame, uint32_t scale, uint8_t* out, std::string& error) override
+    {
+        int index = scale_index(scale);
+        if (index < 0)
+        {
+            error = "No decode scale 1/" + std::to_string(scale);
+            return false;
+        }
+        FrameFormat format = frame_format_for(m_pix_fmt, m_width / scale, m_height / scale);
+        const PostProcessor* post = m_post[index].get();
+
+        // Only rgb24 keeps its size through the post stage
+        std::unique_ptr<FrameBuffer> scratch;
+        uint8_t* decoded = out;
+        if (post && m_pix_fmt != PixFmt::RGB24)
+        {
+            scratch.reset(new FrameBuffer(format.frame_bytes));
+            if (!scratch->data())
+            {
+                error = "Out of memory for a decode buffer";
+                return false;
+            }
+            decoded = scratch->data();
+        }
+
+        R3DSDK::VideoDecodeJob job;
+        job.Mode             = mode_for(scale);
+        job.PixelType        = format.pixel_type;
+        job.OutputBuffer     = decoded;
+        job.OutputBufferSize = format.frame_bytes;
+        R3DSDK::DecodeStatus ds = m_clip->DecodeVideoFrame((size_t)frame, job);
+        if (ds != R3DSDK::DSDecodeOK)
+        {
+            error = "DecodeVideoFrame failed at frame " + std::to_string(frame)
+                  + " (status=" + std::to_string((int)ds) + ")";
+            return false;
+        }
+        if (post)
+            post->run(decoded, out, nullptr);
+        return true;
+    }
+
+private:
+    static constexpr size_t kScaleCount = 5; // 1, 2, 4, 8, 16
+
+    static int scale_index(uint32_t scale)
+    {
+        for (size_t i = 0; i < kScaleCount; i++)
+            if (scale == 1u << i)
+                return (int)i;
+        return -1;
+    }
+
+    R3DSDK::VideoDecodeMode mode_for(uint32_t scale) const
+    {
+        switch (scale)
+        {
+            case 1:  return R3DSDK::DECODE_FULL_RES_PREMIUM;
+            case 2:  return m_premium ? R3DSDK::DECODE_HALF_RES_PREMIUM : R3DSDK::DECODE_HALF_RES_GOOD;
+            case 4:  return R3DSDK::DECODE_QUARTER_RES_GOOD;
+            case 8:  return R3DSDK::DECODE_EIGHT_RES_GOOD;
+            default: return R3DSDK::DECODE_SIXTEENTH_RES_GOOD;
+        }
+    }
+
+    R3DSDK::Clip* m_clip;
+    size_t m_width;
+    size_t m_height;
+    PixFmt m_pix_fmt;
+    bool m_premium;
+    std::unique_ptr<PostProcessor> m_post[kScaleCount];
+};
+
+// ---------------------------------------------------------------------------
+// CLI parsing
+// ---------------------------------------------------------------------------
+
+enum class Engine
+{
+    Threads, // worker pool over Clip::DecodeVideoFrame
+    Decoder, // R3DDecoder (GPU-assisted)
+};
+
+struct Options
+{
+    std::string input_file; // the clip; the first of `inputs`
+    std::vector<std::string> inputs; // --probe-only and a playlist take several
+    std::string input_list; // --input-list, "-" = stdin
+    std::vector<std::string> outputs; // a playlist's, one per clip (see playlist.h)
+    uint32_t max_clips = 4; // playlist clips decoding at once
+    uint32_t clips_at_once = 1; // a playlist's, for the per-clip defaults
+    std::string clip_cache = clip_cache_default_path("r3d-bridge"); // empty = off
+    std::string extract_audio_path;
+    R3DSDK::VideoDecodeMode decode_mode = R3DSDK::DECODE_HALF_RES_GOOD;
+    HugePageMode huge_pages = HugePageMode::Advise;
+    bool prefault = true;
+    Engine engine = Engine::Threads;
+    uint32_t inflight = 0; // 0 = adaptive default
+    uint32_t write_queue = 0; // 0 = adaptive default
+    SdkDecoderSettings decoder;
+    int32_t output_width = 0;  // 0 = decode size; -1/-2 = follow aspect
+    int32_t output_height = 0;
+    ResizeFilter resize_filter = ResizeFilter::Lanczos;
+    PixFmt pix_fmt = PixFmt::RGB24;
+    YuvRange yuv_range = YuvRange::Limited;
+    int shm_socket = -1; // -1 = frames on stdout
+    std::string encode_path; // empty = frames on stdout
+    std::string encode_codec = "h264";
+    bool mux_nut = false; // stdout: NUT stream with audio instead of bare frames
+    int output_fd = STDOUT_FILENO; // a --serve request's fd otherwise
+    uint64_t first_frame = 0; // --start-frame; a thumbnail request's one frame
+    uint64_t frame_limit = 0; // --frame-count; 0 = to the end of the clip
+    uint32_t frame_step = 1;  // --frame-step; 1 = every frame
+    uint32_t conform_num = 0; // --conform-fps; 0 = the clip's rate
+    uint32_t conform_den = 1;
+    std::string thumbnails_dir; // --thumbnails
+    std::vector<ThumbnailPick> thumbnail_picks; // --thumbnail-at
+    ImageFormat thumbnail_format = ImageFormat::Jpeg;
+    int thumbnail_quality = 85;
+    uint32_t sprite_columns = 0; // --sprite; 0 = one file per thumbnail
+    std::string serve_socket; // --serve
+    uint32_t max_requests = 4;
+    uint32_t frame_cache_mb = 512; // scrub: decoded frames kept
+    uint32_t prefetch = 8;    // scrub: frames decoded ahead during playback
+    bool pix_fmt_given = false;
+    bool probe_only = false;
+    bool self_check = false;
+    bool capabilities = false;
+};
+
+static bool parse_args(int argc, char* argv[], Options& opts)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--input") == 0 || strcmp(argv[i], "-i") == 0) && i + 1 < argc)
+        {
+            opts.inputs.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--input-list") == 0 && i + 1 < argc)
+        {
+            opts.input_list = argv[++i];
+        }
+        else if (strcmp(argv[i], "--clip-cache") == 0 && i + 1 < argc)
+        {
+            i++;
+            opts.clip_cache = strcmp(argv[i], "off") == 0 ? std::string() : std::string(argv[i]);
+        }
+        else if (strcmp(argv[i], "--debayer") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "premium") == 0)
+                opts.decode_mode = R3DSDK::DECODE_FULL_RES_PREMIUM;
+            else if (strcmp(argv[i], "half") == 0)
+                opts.decode_mode = R3DSDK::DECODE_HALF_RES_GOOD;
+            else if (strcmp(argv[i], "quarter") == 0)
+                opts.decode_mode = R3DSDK::DECODE_QUARTER_RES_GOOD;
+            else if (strcmp(argv[i], "eighth") == 0)
+                opts.decode_mode = R3DSDK::DECODE_EIGHT_RES_GOOD;
+            else if (strcmp(argv[i], "sixteenth") == 0)
+                opts.decode_mode = R3DSDK::DECODE_SIXTEENTH_RES_GOOD;
+            else
+            {
+                json_error("Invalid debayer option. Use: premium, half, quarter, eighth, sixteenth");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--extract-audio") == 0 && i + 1 < argc)
+        {
+            opts.extract_audio_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--hugepages") == 0 && i + 1 < argc)
+        {
+            if (!parse_huge_page_mode(argv[++i], opts.huge_pages))
+            {
+                json_error("Invalid --hugepages value. Use: off, thp, hugetlb");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--no-prefault") == 0)
+        {
+            opts.prefault = false;
+        }
+        else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "threads") == 0)
+                opts.engine = Engine::Threads;
+            else if (strcmp(argv[i], "decoder") == 0)
+                opts.engine = Engine::Decoder;
+            else
+            {
+                json_error("Invalid --engine value. Use: threads, decoder");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--inflight") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --inflight value. Use: 1..64");
+                return false;
+            }
+            opts.inflight = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--write-queue") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --write-queue value. Use: 1..64");
+                return false;
+            }
+            opts.write_queue = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--decompression-threads") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 1024)
+            {
+                json_error("Invalid --decompression-threads value. Use: 1..1024");
+                return false;
+            }
+            opts.decoder.decompression_threads = (size_t)n;
+        }
+        else if (strcmp(argv[i], "--concurrent-images") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --concurrent-images value. Use: 1..64");
+                return false;
+            }
+            opts.decoder.concurrent_images = (size_t)n;
+        }
+        else if (strcmp(argv[i], "--memory-pool-mb") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1024)
+            {
+                json_error("Invalid --memory-pool-mb value. Use: >= 1024");
+                return false;
+            }
+            opts.decoder.memory_pool_mb = (size_t)n;
+        }
+        else if (strcmp(argv[i], "--output-size") == 0 && i + 1 < argc)
+        {
+            if (!parse_output_size(argv[++i], opts.output_width, opts.output_height))
+            {
+                json_error("Invalid --output-size value. Use: WxH (one side may be -1 or -2)");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--resize-filter") == 0 && i + 1 < argc)
+        {
+            if (!parse_resize_filter(argv[++i], opts.resize_filter))
+            {
+                json_error("Invalid --resize-filter value. Use: area, bilinear, lanczos");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--pix-fmt") == 0 && i + 1 < argc)
+        {
+            if (!parse_pix_fmt(argv[++i], opts.pix_fmt))
+            {
+                json_error("Invalid --pix-fmt value. Use: rgb24, bgr24, bgra, rgb48le, gbrp16le, "
+                           "dpx10, yuv420p, nv12, yuv422p10le, p010le");
+                return false;
+            }
+            opts.pix_fmt_given = true;
+        }
+        else if (strcmp(argv[i], "--yuv-range") == 0 && i + 1 < argc)
+        {
+            if (!parse_yuv_range(argv[++i], opts.yuv_range))
+            {
+                json_error("Invalid --yuv-range value. Use: limited, full");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--shm-socket") == 0 && i + 1 < argc)
+        {
+            int fd = atoi(argv[++i]);
+            if (fd < 3)
+            {
+                json_error("Invalid --shm-socket value. Use an inherited fd >= 3");
+                return false;
+            }
+            opts.shm_socket = fd;
+        }
+        else if (strcmp(argv[i], "--mux") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "raw") == 0)
+                opts.mux_nut = false;
+            else if (strcmp(argv[i], "nut") == 0)
+                opts.mux_nut = true;
+            else
+            {
+                json_error("Invalid --mux value. Use: raw, nut");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--encode") == 0 && i + 1 < argc)
+        {
+            opts.encode_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--encode-codec") == 0 && i + 1 < argc)
+        {
+            PixFmt unused;
+            opts.encode_codec = argv[++i];
+            if (!AvEncoder::codec_pix_fmt(opts.encode_codec, unused))
+            {
+                json_error("Invalid --encode-codec value. Use: h264, h265, prores_proxy, "
+                           "prores_lt, prores_422, prores_hq");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            opts.serve_socket = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--start-frame") == 0 || strcmp(argv[i], "--frame-count") == 0)
+                 && i + 1 < argc)
+        {
+            bool start = strcmp(argv[i], "--start-frame") == 0;
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long n = strtoull(argv[++i], &end, 10);
+            if (errno != 0 || end == argv[i] || *end != '\0' || argv[i][0] == '-' || (!start && n == 0))
+            {
+                json_error(start ? "Invalid --start-frame value. Use: >= 0"
+                                 : "Invalid --frame-count value. Use: >= 1");
+                return false;
+            }
+            (start ? opts.first_frame : opts.frame_limit) = (uint64_t)n;
+        }
+        else if (strcmp(argv[i], "--frame-step") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 1000)
+            {
+                json_error("Invalid --frame-step value. Use: 1..1000");
+                return false;
+            }
+            opts.frame_step = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--conform-fps") == 0 && i + 1 < argc)
+        {
+            if (!parse_fps(argv[++i], opts.conform_num, opts.conform_den))
+            {
+                json_error("Invalid --conform-fps value. Use: num/den or num, e.g. 24000/1001");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--thumbnails") == 0 && i + 1 < argc)
+        {
+            opts.thumbnails_dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--thumbnail-at") == 0 && i + 1 < argc)
+        {
+            if (!parse_thumbnail_picks(argv[++i], opts.thumbnail_picks))
+            {
+                json_error("Invalid --thumbnail-at value. Use: first, last, a frame, P% or "
+                           "every:S, comma separated");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--thumbnail-format") == 0 && i + 1 < argc)
+        {
+            if (!parse_image_format(argv[++i], opts.thumbnail_format))
+            {
+                json_error("Invalid --thumbnail-format value. Use: jpeg, png");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--thumbnail-quality") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 100)
+            {
+                json_error("Invalid --thumbnail-quality value. Use: 1..100");
+                return false;
+            }
+            opts.thumbnail_quality = n;
+        }
+        else if (strcmp(argv[i], "--sprite") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 100)
+            {
+                json_error("Invalid --sprite value. Use: 1..100 columns");
+                return false;
+            }
+            opts.sprite_columns = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            opts.outputs.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--max-clips") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --max-clips value. Use: 1..64");
+                return false;
+            }
+            opts.max_clips = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--frame-cache-mb") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 16 || n > 65536)
+            {
+                json_error("Invalid --frame-cache-mb value. Use: 16..65536");
+                return false;
+            }
+            opts.frame_cache_mb = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--prefetch") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            long n = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || n < 0 || n > 64)
+            {
+                json_error("Invalid --prefetch value. Use: 0..64");
+                return false;
+            }
+            opts.prefetch = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--max-requests") == 0 && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            if (n < 1 || n > 64)
+            {
+                json_error("Invalid --max-requests value. Use: 1..64");
+                return false;
+            }
+            opts.max_requests = (uint32_t)n;
+        }
+        else if (strcmp(argv[i], "--probe-only") == 0)
+        {
+            opts.probe_only = true;
+        }
+        else if (strcmp(argv[i], "--self-check") == 0)
+        {
+            opts.self_check = true;
+        }
+        else if (strcmp(argv[i], "--capabilities") == 0)
+        {
+            opts.capabilities = true;
+        }
+        else
+        {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Unknown argument: %s", argv[i]);
+            json_error(msg);
+            return false;
+        }
+    }
+
+    if (opts.inputs.empty() && opts.input_list.empty() && !opts.self_check
+        && !opts.capabilities && opts.serve_socket.empty())
+    {
+        json_error("Missing --input <file.R3D>");
+        return false;
+    }
+
+    if (!opts.thumbnails_dir.empty())
+    {
+        if (!opts.encode_path.empty() || opts.mux_nut || opts.shm_socket >= 0
+            || !opts.extract_audio_path.empty() || opts.probe_only || !opts.outputs.empty()
+            || opts.first_frame || opts.frame_limit || opts.frame_step > 1 || opts.conform_num)
+        {
+            json_error("--thumbnails writes images only; drop --encode, --mux, --shm-socket, "
+                       "--extract-audio, --probe-only, --output and the frame range and step");
+            return false;
+        }
+        if (opts.pix_fmt_given && opts.pix_fmt != PixFmt::RGB24)
+        {
+            json_error("--thumbnails needs --pix-fmt rgb24");
+            return false;
+        }
+        opts.pix_fmt = PixFmt::RGB24;
+        if (opts.output_width == 0)
+        {
+            opts.output_width = 320;
+            opts.output_height = -2;
+        }
+        if (opts.thumbnail_picks.empty())
+            parse_thumbnail_picks(opts.sprite_columns ? "every:10" : "first", opts.thumbnail_picks);
+    }
+    else if (!opts.thumbnail_picks.empty() || opts.sprite_columns)
+    {
+        json_error("--thumbnail-at and --sprite need --thumbnails <dir>");
+        return false;
+    }
+
+    if (!opts.encode_path.empty())
+    {
+        if (opts.shm_socket >= 0)
+        {
+            json_error("--encode writes the output itself; drop --shm-socket");
+            return false;
+        }
+        // The encoder's input format unless one was asked for
+        if (!opts.pix_fmt_given)
+            AvEncoder::codec_pix_fmt(opts.encode_codec, opts.pix_fmt);
+    }
+
+    if (opts.frame_step > 1 && opts.conform_num)
+    {
+        json_error("--frame-step and --conform-fps both pick the frames; use one");
+        return false;
+    }
+
+    if (opts.mux_nut)
+    {
+        if (opts.shm_socket >= 0 || !opts.encode_path.empty())
+        {
+            json_error("--mux nut is for frames on stdout; drop --shm-socket and --encode");
+            return false;
+        }
+        if (!NutMuxer::supports(opts.pix_fmt))
+        {
+            json_error("--mux nut needs --pix-fmt rgb24, bgr24, bgra, rgb48le, gbrp16le, "
+                       "yuv420p, nv12 or yuv422p10le");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Adds the --input-list clips ("-" reads `list_fd`) and picks the clip of a
+// single-clip run. Several clips to decode make a playlist, each clip with
+// its output from --output or its list line. Reports and returns false on
+// failure.
+static bool load_inputs(Options& opts, int list_fd)
+{
+    std::string error;
+    size_t listed = opts.inputs.size();
+    if (!opts.input_list.empty() && !load_input_list(opts.input_list, list_fd, opts.inputs, error))
+    {
+        json_error(error.c_str());
+        return false;
+    }
+    if (opts.inputs.empty())
+    {
+        json_error("Missing --input <file.R3D>");
+        return false;
+    }
+    opts.input_file = opts.inputs[0];
+    if (opts.probe_only || !opts.thumbnails_dir.empty()
+        || (opts.inputs.size() == 1 && opts.outputs.empty()))
+    {
+        if (!opts.outputs.empty())
+        {
+            json_error("--output is for decoding; drop it with --probe-only and --thumbnails");
+            return false;
+        }
+        return true;
+    }
+
+    // --- A playlist ---
+
+    split_output_specs(opts.inputs, listed, opts.outputs);
+    if (opts.outputs.size() != opts.inputs.size()
+        || std::find(opts.outputs.begin(), opts.outputs.end(), std::string()) != opts.outputs.end())
+    {
+        json_error("Each clip of a playlist needs its own --output (or a \"clip<TAB>output\" "
+                   "--input-list line)");
+        return false;
+    }
+    if (!opts.extract_audio_path.empty() || opts.shm_socket >= 0 || !opts.encode_path.empty())
+    {
+        json_error("--extract-audio, --shm-socket and --encode take a single clip; a playlist "
+                   "clip encodes to an encode:PATH output");
+        return false;
+    }
+    for (const std::string& spec : opts.outputs)
+    {
+        OutputSpec output;
+        if (!parse_output_spec(spec, output, error))
+        {
+            json_error(error.c_str());
+            return false;
+        }
+        if (output.kind == OutputSpec::Kind::Encode && opts.mux_nut)
+        {
+            json_error("--mux nut is for frames; drop it for encode:PATH outputs");
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// SDK: initialized once per process
+// ---------------------------------------------------------------------------
+
+// Reports and returns false on failure
+static bool init_sdk(const Options& opts)
+{
+    std::string lib_dir = find_sdk_lib_dir();
+
+    // OPTION_RED_DECODER is exclusive and only needed for the R3DDecoder engine
+    unsigned int sdk_flags = opts.engine == Engine::Decoder ? OPTION_RED_DECODER : OPTION_RED_NONE;
+    R3DSDK::InitializeStatus init_status = R3DSDK::InitializeSdk(lib_dir.c_str(), sdk_flags);
+    if (init_status != R3DSDK::ISInitializeOK)
+    {
+        char msg[512];
+        snprintf(msg, sizeof(msg),
+            "Failed to initialize R3D SDK (status=%d). "
+            "Dynamic libraries not found at: %s",
+            (int)init_status, lib_dir.c_str());
+        json_error(msg);
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Clip properties (what a probe reports and the clip cache keeps)
+// ---------------------------------------------------------------------------
+
+// Timecode of `frame`: AbsoluteTimecode first, falling back to Timecode
+static std::string get_timecode(R3DSDK::Clip* clip, size_t frame)
+{
+    const char* tc = clip->AbsoluteTimecode(frame);
+    if (tc && tc[0] != '\0')
+        return tc;
+    tc = clip->Timecode(frame);
+    if (tc && tc[0] != '\0')
+        return tc;
+    return "00:00:00:00";
+}
+
+// Frame count, frame rate, size, timecode and pixel aspect. Reports and
+// returns false on failure.
+static bool read_clip_info(R3DSDK::Clip* clip, ClipInfo& info)
+{
+    info.width = (uint32_t)clip->Width();
+    info.height = (uint32_t)clip->Height();
+    info.frame_count = clip->VideoFrameCount();
+    if (info.width == 0 || info.height == 0 || info.frame_count == 0)
+    {
+        json_error("R3D clip has zero width, height or frames");
+        return false;
+    }
+
+    // Frame rate → rational
+    float fps_float = clip->VideoAudioFramerate();
+    uint32_t fps_num = 0, fps_den = 1;
+    {
+        struct { float rate; uint32_t num; uint32_t den; } known_rates[] = {
+            {23.976f,  24000, 1001},
+            {24.0f,    24,    1},
+            {25.0f,    25,    1},
+            {29.97f,   30000, 1001},
+            {30.0f,    30,    1},
+            {47.952f,  48000, 1001},
+            {48.0f,    48,    1},
+            {50.0f,    50,    1},
+            {59.94f,   60000, 1001},
+            {60.0f,    60,    1},
+            {119.88f,  120000, 1001},
+            {120.0f,   120,   1},
+        };
+
+        bool matched = false;
+        for (auto& kr : known_rates)
+        {
+            if (fabsf(fps_float - kr.rate) < 0.05f)
+            {
+                fps_num = kr.num;
+                fps_den = kr.den;
+                matched = true;
+                break;
+            }
+        }
+        if (!matched)
+        {
+            fps_num = (uint32_t)roundf(fps_float);
+            fps_den = 1;
+        }
+    }
+
+    info.fps_num = fps_num;
+    info.fps_den = fps_den;
+
+    info.timecode = get_timecode(clip, 0);
+
+    info.pixel_aspect = clip->MetadataExists(R3DSDK::RMD_PIXEL_ASPECT_RATIO)
+        ? clip->MetadataItemAsFloat(R3DSDK::RMD_PIXEL_ASPECT_RATIO) : 1.0;
+    if (info.pixel_aspect <= 0.0)
+        info.pixel_aspect = 1.0;
+    return true;
+}
+
+// Audio layout and the clip's metadata store (camera, lens, exposure, ...)
+static void read_clip_extras(R3DSDK::Clip* clip, ClipInfo& info)
+{
+    size_t max_block_size = 0;
+    if (clip->AudioBlockCountAndSize(&max_block_size) > 0 && clip->AudioChannelCount() > 0
+        && clip->AudioSampleCount() > 0)
+    {
+        info.audio_channels = (uint32_t)clip->AudioChannelCount();
+        info.audio_sample_rate = clip->MetadataItemAsInt(R3DSDK::RMD_SAMPLERATE);
+        if (info.audio_sample_rate == 0) info.audio_sample_rate = 48000;
+        info.audio_bits = clip->MetadataExists(R3DSDK::RMD_SAMPLE_SIZE)
+            ? clip->MetadataItemAsInt(R3DSDK::RMD_SAMPLE_SIZE) : 24;
+        info.audio_samples = clip->AudioSampleCount();
+    }
+
+    info.camera = "{";
+    for (size_t i = 0; i < clip->MetadataCount(); i++)
+    {
+        if (i > 0)
+            info.camera += ",";
+        info.camera += "\"" + json_escape(clip->MetadataItemKey(i).c_str()) + "\":";
+        switch (clip->MetadataItemType(i))
+        {
+            case R3DSDK::MetadataTypeInt:
+                info.camera += std::to_string(clip->MetadataItemAsInt(i));
+                break;
+            case R3DSDK::MetadataTypeFloat:
+            {
+                float value = clip->MetadataItemAsFloat(i);
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%.9g", value);
+                // NaN and infinities are not JSON
+                info.camera += std::isfinite(value) ? buf : "null";
+                break;
+            }
+            case R3DSDK::MetadataTypeString:
+                info.camera += "\"" + json_escape(clip->MetadataItemAsString(i).c_str()) + "\"";
+                break;
+            default:
+                info.camera += "null";
+                break;
+        }
+    }
+    info.camera += "}";
+}
+
+// ---------------------------------------------------------------------------
+// One clip: probe, audio extraction or decode
+// ---------------------------------------------------------------------------
+
+// What the clips of a playlist decode on together: the threads engine's
+// workers, or the decoder engine's R3DDecoder
+struct SharedDecode
+{
+    DecodeWorkers* workers = nullptr;
+    R3DSDK::R3DDecoder* decoder = nullptr;
+};
+
+// Does what `opts` asks for with one clip and returns the exit code of the
+// run, decoding on `shared` if given (else on an engine of its own).
+// Everything goes to report_stream().
+static int run_clip(Options& opts, const SharedDecode* shared = nullptr)
+{
+    // --- Clip properties ---
+    //
+    // A probe of an unchanged file is answered from the clip cache without
+    // opening it; one that opens the clip adds it to the cache. --thumbnails
+    // probes too, but needs the clip open.
+
+    bool thumbnailing = !opts.thumbnails_dir.empty();
+    bool probing = opts.probe_only || thumbnailing;
+    ClipInfo info;
+    ClipFingerprint fingerprint;
+    bool cacheable = probing && !opts.clip_cache.empty()
+        && clip_fingerprint(opts.input_file, fingerprint);
+    bool cached = cacheable && !thumbnailing
+        && clip_cache_lookup(opts.clip_cache, opts.input_file, fingerprint, info);
+
+    R3DSDK::Clip* clip = nullptr;
+    if (!cached)
+    {
+        clip = new R3DSDK::Clip(opts.input_file.c_str());
+        if (clip->Status() != R3DSDK::LSClipLoaded)
+        {
+            char msg[512];
+            snprintf(msg, sizeof(msg), "Failed to open R3D clip (status=%d): %s",
+                (int)clip->Status(), opts.input_file.c_str());
+            json_error(msg);
+            delete clip;
+            return 1;
+        }
+        if (!read_clip_info(clip, info))
+        {
+            delete clip;
+            return 1;
+        }
+        if (probing)
+            read_clip_extras(clip, info);
+        if (cacheable)
+        {
+            std::string error;
+            if (!clip_cache_store(opts.clip_cache, opts.input_file, fingerprint, info, error))
+                json_warning(error.c_str());
+        }
+    }
+
+    size_t full_width  = info.width;
+    size_t full_height = info.height;
+    size_t frame_count = info.frame_count;
+    uint32_t fps_num = info.fps_num, fps_den = info.fps_den;
+
+    // --output-size: decode at the smallest mode that still covers the
+    // target, resample the rest
+    size_t output_width = 0, output_height = 0;
+    if (opts.output_width != 0)
+    {
+        int32_t w = opts.output_width, h = opts.output_height;
+        resolve_output_size(w, h, (uint32_t)full_width, (uint32_t)full_height, info.pixel_aspect);
+        output_width = (size_t)w;
+        output_height = (size_t)h;
+        opts.decode_mode = pick_decode_mode(opts.decode_mode, full_width, full_height,
+                                            output_width, output_height);
+    }
+
+    // Dimensions after debayer
+    size_t out_width  = full_width / decode_mode_divisor(opts.decode_mode);
+    size_t out_height = full_height / decode_mode_divisor(opts.decode_mode);
+
+    if (output_width == 0)
+    {
+        output_width = out_width;
+        output_height = out_height;
+    }
+
+    // Frames [first_frame, end_frame) are decoded: --start-frame and
+    // --frame-count, a thumbnail request's one frame, otherwise all of them.
+    // A range is e.g. one segment of a long clip encoded in parallel; with
+    // the audio of frame_audio_range() and the first frame's timecode, the
+    // segments of a clip concatenate to the whole of it.
+    size_t first_frame = (size_t)std::min<uint64_t>(opts.first_frame, frame_count);
+    size_t end_frame = opts.frame_limit
+        ? (size_t)std::min<uint64_t>(frame_count, opts.first_frame + opts.frame_limit)
+        : frame_count;
+    bool ranged = first_frame != 0 || end_frame != frame_count;
+    if (ranged && !opts.probe_only && opts.first_frame >= frame_count)
+    {
+        json_error("Frame is past the end of the clip");
+        delete clip;
+        return 1;
+    }
+
+    // --frame-step/--conform-fps: of those, only the frames the output
+    // keeps (every Nth, or e.g. 119.88 fps material as a 23.976 review
+    // proxy). From here on frames count at the output rate: output frames
+    // [out_first, out_end) of out_count, the metadata line adding the
+    // clip's own rate and frame count as "source_*" (see frame_select.h).
+    FrameSelect select;
+    std::string select_error;
+    if (!frame_select_init(select, fps_num, fps_den, opts.probe_only ? 1 : opts.frame_step,
+                           opts.probe_only ? 0 : opts.conform_num, opts.conform_den, select_error))
+    {
+        json_error(select_error.c_str());
+        delete clip;
+        return 1;
+    }
+    size_t out_first = (size_t)select.output_frame(first_frame);
+    size_t out_end = (size_t)select.output_frame(end_frame);
+    size_t out_count = (size_t)select.output_frame(frame_count);
+    if (!opts.probe_only && out_first >= out_end && first_frame < frame_count)
+    {
+        json_error("No frame of the --start-frame/--frame-count range is kept at this frame step");
+        delete clip;
+        return 1;
+    }
+
+    // --- Handle --extract-audio ---
+
+    if (!opts.extract_audio_path.empty())
+    {
+        bool ok = extract_audio(clip, opts.extract_audio_path.c_str(), out_first, out_end,
+                                out_count, select.fps_num, select.fps_den);
+        delete clip;
+        if (ok)
+        {
+            json_done();
+            return 0;
+        }
+        return 1;
+    }
+
+    // The resizer works on 8-bit RGB only; R3DDecoder (GPU) has no BGRA
+    // and no planar output
+    if ((output_width != out_width || output_height != out_height)
+        && !pix_fmt_resizable(opts.pix_fmt))
+    {
+        json_error("--output-size needs --pix-fmt rgb24, bgr24, yuv420p or nv12");
+        delete clip;
+        return 1;
+    }
+    if (opts.engine == Engine::Decoder
+        && (opts.pix_fmt == PixFmt::BGRA || opts.pix_fmt == PixFmt::GBRP16LE))
+    {
+        json_error("--engine decoder does not support --pix-fmt bgra or gbrp16le");
+        delete clip;
+        return 1;
+    }
+
+    // The timecode of the first frame emitted
+    size_t start_frame = (size_t)select.clip_frame(out_first);
+    std::string start_timecode = select_timecode(
+        start_frame != 0 && clip ? get_timecode(clip, start_frame) : info.timecode,
+        fps_num, fps_den, select);
+
+    // --- Emit metadata JSON ---
+    // width/height: immer die volle Sensoraufloesung; der Rust-Runner
+    // berechnet daraus die Debayer-Dimension selbst. output_width/
+    // output_height/pix_fmt beschreiben die Frames, die tatsaechlich auf
+    // stdout geschrieben werden, fps_num/fps_den/frame_count ebenso (bei
+    // --frame-step/--conform-fps die reduzierte Rate).
+    std::string extra_fields = probing ? clip_info_json_fields(info, cached)
+                             : ranged ? range_json_fields(first_frame, end_frame, start_timecode)
+                                      : std::string();
+    if (select.sparse())
+        extra_fields += select_json_fields(fps_num, fps_den, frame_count);
+    json_metadata(select_timecode(info.timecode, fps_num, fps_den, select).c_str(),
+                  select.fps_num, select.fps_den,
+                  (uint32_t)full_width, (uint32_t)full_height, (uint64_t)out_count,
+                  (uint32_t)output_width, (uint32_t)output_height,
+                  pix_fmt_name(opts.pix_fmt),
+                  pix_fmt_is_yuv(opts.pix_fmt) ? yuv_range_name(opts.yuv_range) : nullptr,
+                  opts.mux_nut, extra_fields);
+    fflush(report_stream());
+
+    // --probe-only ends with the metadata line, which adds the audio layout
+    // and camera metadata (see probe_batch.h)
+    if (opts.probe_only)
+    {
+        delete clip;
+        return 0;
+    }
+
+    if (opts.first_frame >= frame_count)
+    {
+        json_error("Frame is past the end of the clip");
+        delete clip;
+        return 1;
+    }
+
+    // --thumbnails: output frame k is the k-th picked frame (default: the
+    // first; every 10 s for a sprite), decoded at the smallest debayer mode
+    // that covers --output-size (default 320 wide, down to sixteenth) into a
+    // file of its own or a tile of the --sprite sheet. A "thumbnail" line
+    // follows per file, a "sprite" line for the sheet (see thumbnails.h).
+    std::vector<uint64_t> thumbnail_frames;
+    ThumbnailSink thumbnails;
+    if (thumbnailing)
+    {
+        ThumbnailConfig thumbnail_config;
+        thumbnail_config.dir = opts.thumbnails_dir;
+        thumbnail_config.clip_name = thumbnail_clip_name(opts.input_file);
+        thumbnail_config.format = opts.thumbnail_format;
+        thumbnail_config.quality = opts.thumbnail_quality;
+        thumbnail_config.columns = opts.sprite_columns;
+        thumbnail_config.tile_width = (uint32_t)output_width;
+        thumbnail_config.tile_height = (uint32_t)output_height;
+        thumbnail_config.fps_num = fps_num;
+        thumbnail_config.fps_den = fps_den;
+        thumbnail_config.frame_count = frame_count;
+        std::string thumbnail_error;
+        if (!resolve_thumbnail_frames(opts.thumbnail_picks, frame_count, fps_num, fps_den,
+                                      thumbnail_frames, thumbnail_error)
+            || !thumbnails.open(thumbnail_config, thumbnail_frames, thumbnail_error))
+        {
+            json_error(thumbnail_error.c_str());
+            delete clip;
+            return 1;
+        }
+        out_first = 0;
+        out_end = thumbnail_frames.size();
+    }
+
+    // --- Allocate frame buffers (512-byte aligned, mapped once per clip) ---
+    //
+    // decode_pool holds what the SDK writes (--pix-fmt layout, BGR or RGB16
+    // for rgb24/YUV, at the decode size). With --output-size or YUV output,
+    // output_pool holds the converted frames: one per frame in flight for the
+    // threads engine (workers convert), a single conversion buffer for the
+    // decoder engine (the main thread converts). Whichever pool the written
+    // frames come from gets one extra buffer per queued write, and with
+    // --shm-socket lives in the shared ring's slots.
+
+    FrameFormat format = frame_format_for(opts.pix_fmt, out_width, out_height);
+    uint32_t inflight = opts.inflight ? opts.inflight
+                                      : default_inflight(format.frame_bytes, opts.clips_at_once);
+    if (!opts.inflight && opts.engine == Engine::Threads && opts.decoder.decompression_threads)
+        inflight = std::min(inflight, (uint32_t)opts.decoder.decompression_threads);
+    uint32_t write_queue = opts.write_queue
+        ? opts.write_queue
+        : default_write_queue(pix_fmt_frame_bytes(opts.pix_fmt, output_width, output_height));
+    bool converts = output_width != out_width || output_height != out_height
+                    || pix_fmt_is_yuv(opts.pix_fmt);
+
+    ReorderBuffer reorder(inflight);
+
+    FramePoolConfig pool_config;
+    pool_config.buffer_bytes = format.frame_bytes;
+    pool_config.count = inflight + (converts ? 0 : write_queue);
+    pool_config.alignment = kFrameWriterAlignment; // SDK needs 512; whole pages can be vmspliced
+    pool_config.huge_pages = opts.huge_pages;
+    pool_config.prefault = opts.prefault;
+
+    uint32_t output_count = (opts.engine == Engine::Threads ? inflight : 1) + write_queue;
+    size_t output_frame_bytes = pix_fmt_frame_bytes(opts.pix_fmt, output_width, output_height);
+
+    // With --shm-socket the pool lives in the slots of a shared-memory ring
+    // whose fds go over the inherited Unix socket, not stdout (see shm_ring.h)
+    ShmRing ring;
+    std::string pool_error;
+    if (opts.shm_socket >= 0)
+    {
+        if (!ring.init(opts.pix_fmt, output_width, output_height,
+                       converts ? output_frame_bytes : format.frame_bytes,
+                       converts ? output_count : pool_config.count, pool_error)
+            || !ring.send_fds(opts.shm_socket, pool_error))
+        {
+            json_error(pool_error.c_str());
+            delete clip;
+            return 1;
+        }
+        if (!converts)
+            pool_config.external = ring.slots();
+    }
+
+    FramePool decode_pool;
+    if (!decode_pool.init(pool_config, pool_error))
+    {
+        json_error(pool_error.c_str());
+        delete clip;
+        return 1;
+    }
+
+    std::unique_ptr<Resizer> resizer;
+    if (output_width != out_width || output_height != out_height)
+    {
+        resizer.reset(new Resizer());
+        std::string resize_error;
+        if (!resizer->init((uint32_t)out_width, (uint32_t)out_height, 3,
+                           (uint32_t)output_width, (uint32_t)output_height,
+                           opts.resize_filter, resize_error))
+        {
+            json_error(resize_error.c_str());
+            delete clip;
+            return 1;
+        }
+    }
+
+    // Post stage: swap (rgb24), resize and BT.709 YUV (from BGR, or RGB16
+    // for 10-bit) fused in one pass over row tiles. Unscaled bgr24 and the
+    // SDK layouts need none.
+    bool yuv = pix_fmt_is_yuv(opts.pix_fmt);
+    std::unique_ptr<PostProcessor> post;
+    if (resizer || yuv || opts.pix_fmt == PixFmt::RGB24)
+    {
+        post.reset(new PostProcessor());
+        RgbSource source = pix_fmt_bit_depth(opts.pix_fmt) > 8 ? RgbSource::RGB16 : RgbSource::BGR8;
+        std::string post_error;
+        if (!post->init(source, (uint32_t)out_width, (uint32_t)out_height, opts.pix_fmt,
+                        opts.yuv_range, resizer.get(), post_error))
+        {
+            json_error(post_error.c_str());
+            delete clip;
+            return 1;
+        }
+    }
+
+    // Resized or YUV frames need their own buffers; an unscaled rgb24 swap
+    // runs in place
+    FramePool output_pool;
+    if (converts)
+    {
+        FramePoolConfig output_config = pool_config;
+        output_config.buffer_bytes = post->dst_bytes();
+        output_config.count = output_count;
+        output_config.external = opts.shm_socket >= 0 ? ring.slots() : nullptr;
+        if (!output_pool.init(output_config, pool_error))
+        {
+            json_error(pool_error.c_str());
+            delete clip;
+            return 1;
+        }
+    }
+
+    // With --mux nut or --encode the clip's audio is decoded frame by frame
+    // and goes out behind each frame, so memory stays at an audio block and
+    // a frame's worth of samples whatever the clip length; a clip without
+    // audio gets a video-only stream or file
+    AudioStream audio_stream;
+    bool has_audio = false;
+    if (opts.mux_nut || !opts.encode_path.empty())
+    {
+        std::string audio_error;
+        has_audio = audio_stream.open(clip, audio_error)
+            && audio_stream.skip_to(frame_audio_start(out_first, audio_stream.sample_rate(),
+                                                      select.fps_num, select.fps_den));
+    }
+
+    // With --encode the writer thread feeds the encoder instead of stdout,
+    // which muxes the proxy with the clip's audio and timecode itself (see
+    // av_encoder.h). The encoder gets the cores decoding leaves: the
+    // threads engine decodes one frame per worker (of
+    // --decompression-threads, if given, as for a segment of a clip sharing
+    // the machine), the decoder engine's decompression threads get half
+    // unless --decompression-threads says otherwise. A playlist's encoders
+    // split them.
+    bool encoding = !opts.encode_path.empty();
+    AvEncoder encoder;
+    if (encoding)
+    {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        unsigned encoder_threads;
+        if (opts.engine == Engine::Threads)
+        {
+            if (opts.decoder.decompression_threads)
+                cores = (unsigned)opts.decoder.decompression_threads;
+            encoder_threads = cores > inflight ? cores - inflight : 1;
+        }
+        else
+        {
+            encoder_threads = std::max(1u, cores / 2);
+            if (!opts.decoder.decompression_threads)
+                opts.decoder.decompression_threads = std::max(1u, cores - encoder_threads);
+        }
+        encoder_threads = std::max(1u, encoder_threads / opts.clips_at_once);
+
+        AvEncoderConfig encoder_config;
+        encoder_config.output_path = opts.encode_path;
+        encoder_config.codec = opts.encode_codec;
+        encoder_config.pix_fmt = opts.pix_fmt;
+        encoder_config.width = output_width;
+        encoder_config.height = output_height;
+        encoder_config.fps_num = select.fps_num;
+        encoder_config.fps_den = select.fps_den;
+        encoder_config.yuv_range = opts.yuv_range;
+        encoder_config.timecode = start_timecode;
+        encoder_config.threads = encoder_threads;
+        if (has_audio)
+        {
+            encoder_config.sample_rate = audio_stream.sample_rate();
+            encoder_config.channels = audio_stream.channels();
+            encoder_config.bits_per_sample = audio_stream.bits_per_sample();
+        }
+
+        std::string encoder_error;
+        if (!encoder.open(encoder_config, encoder_error))
+        {
+            json_error(encoder_error.c_str());
+            delete clip;
+            return 1;
+        }
+    }
+
+    NutMuxer nut;
+    if (opts.mux_nut)
+    {
+        NutAudioFormat audio_format;
+        if (has_audio)
+        {
+            audio_format.sample_rate = audio_stream.sample_rate();
+            audio_format.channels = audio_stream.channels();
+            audio_format.bits_per_sample = audio_stream.bits_per_sample();
+        }
+
+        std::string nut_error;
+        if (!nut.init(opts.pix_fmt, output_width, output_height, select.fps_num, select.fps_den,
+                      has_audio ? &audio_format : nullptr, nut_error))
+        {
+            json_error(nut_error.c_str());
+            delete clip;
+            return 1;
+        }
+    }
+    bool audio_warned = false;
+
+    // Main-thread post stage for the decoder engine, striped over a few
+    // threads
+    unsigned resize_threads = (post && opts.engine == Engine::Decoder)
+        ? std::min(4u, std::max(1u, std::thread::hardware_concurrency())) : 0;
+    StripePool resize_pool(resize_threads);
+
+    // --- Start decode engine ---
+
+    std::unique_ptr<DecodeWorkers> own_workers;
+    std::unique_ptr<DecodeEngine> engine;
+    if (opts.engine == Engine::Decoder)
+    {
+        SdkDecoderEngine* decoder_engine = new SdkDecoderEngine(
+            clip, opts.decode_mode, format, &reorder, &decode_pool,
+            shared ? shared->decoder : nullptr);
+        engine.reset(decoder_engine);
+
+        std::string engine_error;
+        if (!decoder_engine->init(opts.decoder, engine_error))
+        {
+            json_error(engine_error.c_str());
+            engine.reset();
+            delete clip;
+            return 1;
+        }
+    }
+    else
+    {
+        DecodeWorkers* workers = shared ? shared->workers : nullptr;
+        if (!workers)
+        {
+            own_workers.reset(new DecodeWorkers(inflight));
+            workers = own_workers.get();
+        }
+        engine.reset(new ThreadPoolEngine(clip, opts.decode_mode, format,
+                                          workers, &reorder, &decode_pool,
+                                          post.get(), converts ? &output_pool : nullptr));
+    }
+
+    // Published buffers come from output_pool only when workers convert
+    FramePool& published_pool = (converts && !engine->finish_on_write()) ? output_pool : decode_pool;
+
+    // Frames go to stdout (or the encoder) from their own thread, in order
+    FrameWriter writer(opts.output_fd, opts.pix_fmt, output_width, output_height, write_queue,
+                       opts.shm_socket >= 0 ? &ring : nullptr, encoding ? &encoder : nullptr,
+                       opts.mux_nut ? &nut : nullptr);
+
+    // --- Frame loop: keep `inflight` frames decoding, write in order ---
+    //
+    // Reorder slots and the writer count output frames; the decodes go to
+    // the clip frames they show.
+
+    bool had_error = false;
+    size_t next_submit = out_first;
+    size_t next_write = out_first;
+
+    for (; next_write < out_end; next_write++)
+    {
+        while (!had_error && next_submit < out_end
+               && next_submit - next_write < reorder.slot_count())
+        {
+            if (!engine->submit(next_submit, thumbnailing ? thumbnail_frames[next_submit]
+                                                          : select.clip_frame(next_submit)))
+            {
+                had_error = true;
+                break;
+            }
+            next_submit++;
+        }
+
+        // Nothing in flight for this frame (submission failed) → stop
+        if (next_write >= next_submit)
+            break;
+
+        uint8_t* frame_buf = nullptr;
+        size_t frame_buf_bytes = 0;
+        if (!reorder.wait(next_write, frame_buf, frame_buf_bytes))
+        {
+            had_error = true;
+            break;
+        }
+
+        // The decoder engine converts here; the decoded buffer is free again
+        // as soon as the converted frame exists
+        uint8_t* out_buf = frame_buf;
+        FramePool* out_pool = &published_pool;
+        if (engine->finish_on_write() && post)
+        {
+            if (converts)
+            {
+                out_buf = output_pool.checkout();
+                out_pool = &output_pool;
+            }
+            post->run(frame_buf, out_buf, &resize_pool);
+            if (converts)
+                decode_pool.give_back(frame_buf);
+        }
+
+        if (thumbnailing)
+        {
+            // A thumbnail goes into its file or the sprite sheet right away
+            std::string path, thumbnail_error;
+            bool added = thumbnails.add(next_write, out_buf, path, thumbnail_error);
+            out_pool->give_back(out_buf);
+            reorder.release(next_write);
+            if (!added)
+            {
+                json_error(thumbnail_error.c_str());
+                had_error = true;
+                next_write++;
+                break;
+            }
+            if (!path.empty())
+                json_thumbnail(thumbnail_frames[next_write],
+                               thumbnails.frame_time(thumbnail_frames[next_write]), path);
+        }
+        else
+        {
+            // The reorder slot is released only once the frame is queued,
+            // so buffers in use never exceed the slots plus the write queue.
+            // A NUT stream gets the audio up to the end of the frame with
+            // it, the clip's last frame whatever is left.
+            std::vector<uint8_t> frame_audio;
+            if (has_audio)
+            {
+                uint64_t end = next_write + 1 == out_count
+                    ? UINT64_MAX
+                    : frame_audio_start(next_write + 1, audio_stream.sample_rate(),
+                                        select.fps_num, select.fps_den);
+                if (!audio_stream.read_until(end, frame_audio) && !audio_warned)
+                {
+                    json_warning("Reading clip audio failed; the rest of the stream has none");
+                    audio_warned = true;
+                }
+            }
+            bool queued = writer.push(out_buf, out_pool, std::move(frame_audio));
+            reorder.release(next_write);
+            if (!queued)
+            {
+                json_error(encoding ? encoder.error().c_str()
+                           : opts.shm_socket >= 0 ? "Shared-memory consumer went away"
+                                                  : "Writing frames to stdout failed");
+                had_error = true;
+                next_write++;
+                break;
+            }
+        }
+
+        json_progress((uint64_t)(next_write + 1 - out_first), (uint64_t)(out_end - out_first));
+
+        // A --serve client that went away cancels the request
+        if (ferror(report_stream()))
+        {
+            had_error = true;
+            next_write++;
+            break;
+        }
+    }
+
+    if (!writer.finish())
+        had_error = true;
+    if (encoding && !encoder.finish())
+    {
+        if (!had_error)
+            json_error(encoder.error().c_str());
+        had_error = true;
+    }
+    if (thumbnailing)
+    {
+        std::string thumbnail_error;
+        if (!had_error && !thumbnails.finish(thumbnail_error))
+        {
+            json_error(thumbnail_error.c_str());
+            had_error = true;
+        }
+        if (!had_error && thumbnails.sprite())
+            json_sprite(thumbnails, thumbnail_frames.size(), (uint32_t)output_width,
+                        (uint32_t)output_height);
+    }
+    else
+    {
+        json_writer(writer.stats());
+    }
+
+    // Frames still decoding after an error must finish before their buffers
+    // and jobs go away
+    for (size_t i = next_write; had_error && i < next_submit; i++)
+    {
+        uint8_t* data = nullptr;
+        size_t bytes = 0;
+        reorder.wait(i, data, bytes);
+    }
+
+    // --- Cleanup ---
+
+    engine.reset();
+    delete clip;
+
+    if (!had_error)
+    {
+        json_done();
+        return 0;
+    }
+
+    return 1;
+}
+
+// A playlist: up to --max-clips clips decode side by side on one set of
+// workers (or one R3DDecoder), each into its own --output (fd:N, unix:PATH,
+// a file or FIFO, or encode:PATH), every report line tagged with the clip's
+// "input" (see playlist.h)
+static int run_playlist(Options& opts)
+{
+    // An output whose reader went away fails its clip, not the process
+    signal(SIGPIPE, SIG_IGN);
+
+    uint32_t at_once = (uint32_t)std::min<size_t>(opts.max_clips, opts.inputs.size());
+    SharedDecode shared;
+    std::unique_ptr<DecodeWorkers> workers;
+    if (opts.engine == Engine::Decoder)
+    {
+        // Clips that encode leave half the cores to their encoders, as in
+        // run_clip()
+        bool encodes = std::any_of(opts.outputs.begin(), opts.outputs.end(),
+                                   [](const std::string& spec)
+                                   {
+                                       OutputSpec output;
+                                       std::string unused;
+                                       return parse_output_spec(spec, output, unused)
+                                           && output.kind == OutputSpec::Kind::Encode;
+                                   });
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        if (encodes && !opts.decoder.decompression_threads)
+            opts.decoder.decompression_threads = std::max(1u, cores - std::max(1u, cores / 2));
+
+        std::string error;
+        if (!create_decoder(opts.decoder, shared.decoder, error))
+        {
+            json_error(error.c_str());
+            return 1;
+        }
+    }
+    else
+    {
+        workers.reset(new DecodeWorkers(opts.inflight ? opts.inflight : default_decode_workers()));
+        shared.workers = workers.get();
+    }
+
+    size_t failed = run_each(opts.inputs, at_once, [&opts, &shared, at_once](size_t i)
+    {
+        Options clip_opts = opts;
+        clip_opts.input_file = opts.inputs[i];
+        clip_opts.clips_at_once = at_once;
+
+        OutputSpec output;
+        std::string error;
+        if (!parse_output_spec(opts.outputs[i], output, error) || !open_output(output, error))
+        {
+            json_error(error.c_str());
+            return false;
+        }
+        if (output.kind == OutputSpec::Kind::Encode)
+        {
+            clip_opts.encode_path = output.path;
+            if (!clip_opts.pix_fmt_given)
+                AvEncoder::codec_pix_fmt(clip_opts.encode_codec, clip_opts.pix_fmt);
+        }
+        else
+        {
+            clip_opts.output_fd = output.fd;
+        }
+        bool ok = run_clip(clip_opts, &shared) == 0;
+        close_output(output);
+        return ok;
+    });
+
+    workers.reset();
+    if (shared.decoder)
+        R3DSDK::R3DDecoder::ReleaseDecoder(shared.decoder);
+    return failed ? 1 : 0;
+}
+
+// run_clip() for one clip, a playlist, or a batch --probe-only or
+// --thumbnails over all of them with the clips opened side by side
+static int run_clips(Options& opts)
+{
+    if (!opts.outputs.empty())
+        return run_playlist(opts);
+    if (opts.inputs.size() <= 1)
+        return run_clip(opts);
+
+    // Thumbnails of several clips: up to --max-clips of them side by side
+    if (!opts.thumbnails_dir.empty())
+    {
+        uint32_t at_once = (uint32_t)std::min<size_t>(opts.max_clips, opts.inputs.size());
+        size_t failed = run_each(opts.inputs, at_once, [&opts, at_once](size_t i)
+        {
+            Options clip_opts = opts;
+            clip_opts.input_file = opts.inputs[i];
+            clip_opts.clips_at_once = at_once;
+            return run_clip(clip_opts) == 0;
+        });
+        return failed ? 1 : 0;
+    }
+
+    size_t failed = probe_each(opts.inputs, 0, [&opts](const std::string& input)
+    {
+        Options clip_opts = opts;
+        clip_opts.input_file = input;
+        return run_clip(clip_opts) == 0;
+    });
+    return failed ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// --serve: requests on a Unix socket
+// ---------------------------------------------------------------------------
+//
+// The SDK is initialized once; probe, extract-audio, decode, thumbnail and
+// scrub requests run up to --max-requests at a time, each on a clip of its
+// own (see serve.h). --engine is fixed for the daemon, since it picks how
+// the SDK is set up; a scrub request decodes on the threads engine.
+
+// A scrub request: opens the clip, reports its metadata line (output size
+// at the session's scale) and serves frame requests until the client
+// closes the connection (see frame_server.h)
+static int run_scrub(const Options& opts, const ServeRequest& request)
+{
+    R3DSDK::Clip* clip = new R3DSDK::Clip(opts.input_file.c_str());
+    if (clip->Status() != R3DSDK::LSClipLoaded)
+    {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "Failed to open R3D clip (status=%d): %s",
+            (int)clip->Status(), opts.input_file.c_str());
+        json_error(msg);
+        delete clip;
+        return 1;
+    }
+    ClipInfo info;
+    if (!read_clip_info(clip, info))
+    {
+        delete clip;
+        return 1;
+    }
+
+    ScrubDecoder decoder(clip, info.width, info.height, opts.pix_fmt,
+                         opts.decode_mode == R3DSDK::DECODE_FULL_RES_PREMIUM);
+    uint32_t scale = request.scale ? request.scale : 2;
+    uint32_t width = 0, height = 0;
+    size_t frame_bytes = 0;
+    std::string error;
+    if (!decoder.init(opts.yuv_range, error))
+    {
+        json_error(error.c_str());
+        delete clip;
+        return 1;
+    }
+    if (!decoder.frame_size(scale, width, height, frame_bytes))
+    {
+        json_error("Invalid scrub scale. Use: 1, 2, 4, 8, 16");
+        delete clip;
+        return 1;
+    }
+
+    json_metadata(info.timecode.c_str(), info.fps_num, info.fps_den, info.width, info.height,
+                  info.frame_count, width, height, pix_fmt_name(opts.pix_fmt),
+                  pix_fmt_is_yuv(opts.pix_fmt) ? yuv_range_name(opts.yuv_range) : nullptr,
+                  false, ",\"scale\":" + std::to_string(scale) + ",\"scales\":[1,2,4,8,16]");
+    fflush(report_stream());
+
+    FrameServerConfig config;
+    config.frame_count = info.frame_count;
+    config.scale = scale;
+    config.cache_bytes = (size_t)opts.frame_cache_mb << 20;
+    config.prefetch = opts.prefetch;
+    config.decodes = opts.inflight ? opts.inflight : 4;
+    int code = run_frame_server(request.conn, request.pending, opts.output_fd, decoder, config);
+
+    delete clip;
+    return code;
+}
+
+// The options of one request: its args parsed like a command line, then
+// the op applied. Reports and returns false if the request is invalid.
+static bool request_options(const ServeRequest& request, Options& opts)
+{
+    Engine engine = opts.engine;
+
+    std::vector<char*> argv;
+    argv.push_back((char*)"r3d-bridge");
+    for (const std::string& arg : request.args)
+        argv.push_back((char*)arg.c_str());
+    if (!parse_args((int)argv.size(), argv.data(), opts))
+        return false;
+
+    // Process-wide modes, and fds that would name the daemon's own
+    if (opts.self_check || opts.capabilities || !opts.serve_socket.empty()
+        || opts.shm_socket >= 0 || !opts.outputs.empty())
+    {
+        json_error("--self-check, --capabilities, --serve, --shm-socket and --output are not "
+                   "request options");
+        return false;
+    }
+    if (opts.engine != engine)
+    {
+        json_error("--engine is set when the daemon starts");
+        return false;
+    }
+
+    if (request.op == "extract-audio")
+    {
+        if (opts.extract_audio_path.empty())
+        {
+            json_error("extract-audio needs --extract-audio <file.wav>");
+            return false;
+        }
+        return load_inputs(opts, -1);
+    }
+    if (!opts.extract_audio_path.empty())
+    {
+        json_error("--extract-audio belongs to the extract-audio op");
+        return false;
+    }
+
+    // A probe's --input-list - comes as its fd
+    if (request.op == "probe")
+    {
+        opts.probe_only = true;
+        return load_inputs(opts, request.fds.empty() ? -1 : request.fds[0]);
+    }
+    if (request.op == "decode")
+    {
+        if (!request.fds.empty())
+            opts.output_fd = request.fds[0];
+        else if (opts.encode_path.empty())
+        {
+            json_error("decode needs an fd for the frames (or --encode)");
+            return false;
+        }
+        return load_inputs(opts, -1);
+    }
+    if (request.op == "thumbnail")
+    {
+        if (request.fds.empty())
+        {
+            json_error("thumbnail needs an fd for the frame");
+            return false;
+        }
+        if (!opts.encode_path.empty() || opts.mux_nut)
+        {
+            json_error("thumbnail writes a bare frame; drop --encode and --mux");
+            return false;
+        }
+        opts.output_fd = request.fds[0];
+        opts.first_frame = request.frame;
+        opts.frame_limit = 1;
+        opts.frame_step = 1;
+        opts.conform_num = 0;
+        opts.probe_only = false;
+        return load_inputs(opts, -1);
+    }
+    if (request.op == "scrub")
+    {
+        if (request.fds.empty())
+        {
+            json_error("scrub needs an fd for the frames");
+            return false;
+        }
+        if (opts.engine != Engine::Threads)
+        {
+            json_error("scrub decodes on --engine threads");
+            return false;
+        }
+        if (!opts.encode_path.empty() || opts.mux_nut || opts.output_width != 0
+            || !opts.thumbnails_dir.empty() || opts.probe_only || opts.first_frame
+            || opts.frame_limit || opts.frame_step > 1 || opts.conform_num)
+        {
+            json_error("scrub serves bare frames at a decode scale; drop --encode, --mux, "
+                       "--output-size, --thumbnails, --probe-only and the frame range and step");
+            return false;
+        }
+        opts.output_fd = request.fds[0];
+        if (!load_inputs(opts, -1))
+            return false;
+        if (opts.inputs.size() != 1)
+        {
+            json_error("scrub takes a single clip");
+            return false;
+        }
+        return true;
+    }
+
+    json_error("Unknown request op");
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    Options opts;
+    if (!parse_args(argc, argv, opts))
+        return 1;
+
+    // --- Kernel self-check (no SDK, no input) ---
+
+    if (opts.self_check)
+    {
+        bool ok = resize_self_check(stderr);
+        ok = yuv_convert_self_check(stderr) && ok;
+        ok = post_process_self_check(stderr) && ok;
+        ok = bswap32_self_check(stderr) && ok;
+        ok = transport_self_check(stderr) && ok;
+        return ok ? 0 : 1;
+    }
+
+    // --- Build capabilities, for the backend to pick a path (no SDK) ---
+
+    if (opts.capabilities)
+    {
+        json_capabilities();
+        return 0;
+    }
+
+    if (opts.serve_socket.empty() && !load_inputs(opts, STDIN_FILENO))
+        return 1;
+
+    // --- Initialize R3D SDK ---
+
+    if (!init_sdk(opts))
+        return 1;
+
+    int code;
+    if (!opts.serve_socket.empty())
+    {
+        // Each request starts from the daemon's own options and adds its
+        // args on top
+        Options defaults = opts;
+        defaults.serve_socket.clear();
+        auto handler = [&defaults](const ServeRequest& request)
+        {
+            Options request_opts = defaults;
+            if (!request_options(request, request_opts))
+                return 1;
+            if (request.op == "scrub")
+                return run_scrub(request_opts, request);
+            return run_clips(request_opts);
+        };
+
+        std::string error;
+        code = 0;
+        if (!serve(opts.serve_socket.c_str(), opts.max_requests, handler, error))
+        {
+            json_error(error.c_str());
+            code = 1;
+        }
+    }
+    else
+    {
+        code = run_clips(opts);
+    }
+
+    R3DSDK::FinalizeSdk();
+    return code;
 }